@@ -6,6 +6,7 @@ import 'package:just_audio/just_audio.dart';
 import 'package:share_plus/share_plus.dart';
 
 import 'package:reclo/services/audio_chunk_manager.dart';
+import 'package:reclo/services/audio_decode_service.dart';
 import 'package:reclo/services/audio_stitcher.dart';
 
 class ConversationDetailScreen extends StatefulWidget {
@@ -85,7 +86,8 @@ class _ConversationDetailScreenState extends State<ConversationDetailScreen> {
 
   Future<void> _loadAudio(String path) async {
     try {
-      await _player.setFilePath(path);
+      // Conversations are kept as Ogg Opus; decode on open for playback
+      await _player.setFilePath(await AudioDecodeService.playableFile(path));
     } catch (e) {
       debugPrint('Error loading audio: $e');
     }
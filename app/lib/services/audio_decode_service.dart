@@ -0,0 +1,82 @@
+import 'dart:io';
+import 'dart:isolate';
+import 'dart:ui' show DartPluginRegistrant, RootIsolateToken;
+
+import 'package:flutter/foundation.dart';
+import 'package:flutter/services.dart' show BackgroundIsolateBinaryMessenger;
+import 'package:opus_flutter/opus_flutter.dart' as opus_flutter;
+import 'package:opus_dart/opus_dart.dart';
+import 'package:path_provider/path_provider.dart';
+
+import 'package:reclo/utils/audio/ogg_opus.dart';
+import 'package:reclo/utils/audio/wav_file_writer.dart';
+
+/// Decodes stored Ogg Opus audio to WAV on demand, for anything that needs
+/// PCM: the player (iOS cannot play Ogg Opus) and the waveform view.
+///
+/// Decoding runs on a background isolate. The WAV is kept in the temporary
+/// directory and reused until the source file changes, so the OS may
+/// reclaim it at any time.
+class AudioDecodeService {
+  static final Map<String, Future<String>> _inFlight = {};
+
+  /// Path of a WAV file with the audio of [path], or [path] itself if it is
+  /// not Ogg Opus.
+  static Future<String> playableFile(String path) {
+    if (!path.endsWith('.opus')) return Future.value(path);
+    return _inFlight.putIfAbsent(
+      path,
+      () => _decodeCached(path).whenComplete(() => _inFlight.remove(path)),
+    );
+  }
+
+  static Future<String> _decodeCached(String path) async {
+    final tmp = await getTemporaryDirectory();
+    final dir = Directory('${tmp.path}/decoded_audio');
+    if (!await dir.exists()) await dir.create(recursive: true);
+
+    final name = path.split('/').last.replaceFirst(RegExp(r'\.opus$'), '.wav');
+    final wav  = File('${dir.path}/$name');
+    if (await wav.exists() &&
+        !(await wav.lastModified()).isBefore(await File(path).lastModified())) {
+      return wav.path;
+    }
+
+    final part  = '${wav.path}.part';
+    final token = RootIsolateToken.instance;
+    final sw    = Stopwatch()..start();
+    await Isolate.run(() => _decodeToWav(path, part, token));
+    await File(part).rename(wav.path);
+    debugPrint('AudioDecodeService: decoded $name in ${sw.elapsedMilliseconds} ms');
+    return wav.path;
+  }
+}
+
+/// Load Opus on a background isolate and create a 16 kHz mono decoder.
+///
+/// Plugins are not registered off the main isolate by default; [token]
+/// lets opus_flutter find its platform library there.
+Future<SimpleOpusDecoder> createBackgroundOpusDecoder(RootIsolateToken? token) async {
+  if (token != null) {
+    BackgroundIsolateBinaryMessenger.ensureInitialized(token);
+  }
+  DartPluginRegistrant.ensureInitialized();
+  initOpus(await opus_flutter.load());
+  return SimpleOpusDecoder(sampleRate: 16000, channels: 1);
+}
+
+Future<void> _decodeToWav(String src, String dst, RootIsolateToken? token) async {
+  final decoder = await createBackgroundOpusDecoder(token);
+  try {
+    final wav = await WavFileWriter.open(dst, 16000);
+    try {
+      await decodeOggOpus(src, decoder, wav.add);
+      await wav.close();
+    } catch (_) {
+      await wav.discard();
+      rethrow;
+    }
+  } finally {
+    decoder.destroy();
+  }
+}
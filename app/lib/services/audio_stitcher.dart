@@ -1,11 +1,21 @@
 import 'dart:io';
+import 'dart:math';
 import 'dart:typed_data';
 
 import 'package:path_provider/path_provider.dart';
 
 import 'package:reclo/backend/schema/bt_device/bt_device.dart';
 import 'package:reclo/services/audio_chunk_manager.dart';
+import 'package:reclo/services/audio_decode_service.dart';
 import 'package:reclo/services/silence_detection_service.dart';
+import 'package:reclo/utils/audio/ogg_opus.dart';
+import 'package:reclo/utils/audio/wav_file_writer.dart';
+
+// Chunk WAV files have a plain 44-byte header (PCM format, no extra chunks)
+const int _kWavHeaderBytes = 44;
+
+// Read/write block for streaming PCM between files
+const int _kCopyBufferSize = 64 * 1024;
 
 /// Result of a stitch operation
 class StitchResult {
@@ -24,9 +34,18 @@ class StitchResult {
   });
 }
 
-/// Stitches audio chunks into a single WAV file, stripping silence
+/// Stitches audio chunks into a single file, stripping silence.
+///
+/// Chunks are stored as Ogg Opus: their packets are cut at the speech
+/// segments' edges and remuxed into one Ogg Opus file, with no decoding or
+/// re-encoding. A conversation that still includes WAV chunks saved by an
+/// older version is stitched to WAV as before.
+///
+/// Neither path holds a conversation in memory. The remux moves one Ogg page
+/// at a time. The WAV path sizes its header from the speech segments up
+/// front, then copies each segment's byte range through a fixed buffer.
 class AudioStitcher {
-  /// Stitch a conversation's chunks into one WAV file.
+  /// Stitch a conversation's chunks into one file.
   ///
   /// [conversation]         - The conversation to stitch
   /// [silenceThresholdDb]   - dB threshold (user-settable, same as detection)
@@ -37,46 +56,76 @@ class AudioStitcher {
     String? outputFileName,
   }) async {
     try {
-      final List<Uint8List> speechSegments = [];
-      Duration totalSilenceRemoved = Duration.zero;
-      Duration totalSpeech = Duration.zero;
+      if (conversation.chunks.any((c) => c.filePath.endsWith('.wav'))) {
+        return await _stitchWav(conversation, outputFileName);
+      }
+      return await _stitchOpus(conversation, outputFileName);
+    } catch (e) {
+      return StitchResult(
+        success: false,
+        totalDuration: Duration.zero,
+        silenceRemoved: Duration.zero,
+        error: e.toString(),
+      );
+    }
+  }
+
+  // ─── Private ───────────────────────────────────────────────────────────────
+
+  Future<StitchResult> _stitchOpus(
+    Conversation conversation,
+    String? outputFileName,
+  ) async {
+    final outputPath = await _outputPath(
+        outputFileName ?? 'conversation_${conversation.id}.opus');
+    Duration totalSilenceRemoved = Duration.zero;
+    OggOpusWriter? writer;
 
+    try {
       for (final chunk in conversation.chunks) {
         // Skip chunks with no speech
         if (!chunk.hasSpeech) continue;
+        if (!await File(chunk.filePath).exists()) continue;
+
+        final reader = await OggOpusReader.open(chunk.filePath);
+        try {
+          writer ??= await OggOpusWriter.create(
+            outputPath,
+            inputSampleRate: chunk.sampleRate,
+            tags: {
+              kOggOpusStartTag:
+                  '${conversation.startTime.toUtc().millisecondsSinceEpoch ~/ 1000}',
+            },
+          );
 
-        // Read raw bytes from disk
-        final file = File(chunk.filePath);
-        if (!await file.exists()) continue;
-        final raw = await file.readAsBytes();
-
-        // Strip the 44-byte WAV header so we only process PCM samples
-        const int wavHeaderBytes = 44;
-        final bytes = raw.length > wavHeaderBytes
-            ? raw.sublist(wavHeaderBytes)
-            : raw;
-
-        final analysis = chunk.silenceAnalysis;
-        if (analysis == null) {
           // No analysis — include entire chunk
-          speechSegments.add(bytes);
-          continue;
+          final segments = chunk.silenceAnalysis?.segments;
+          var seg = 0;
+          var pos = 0; // 48 kHz samples into the chunk
+
+          for (var packet = await reader.next(); packet != null; packet = await reader.next()) {
+            final startMs = pos * 1000 ~/ kOggOpusGranuleRate;
+            pos += opusPacketSamples(packet, kOggOpusGranuleRate);
+
+            if (segments != null) {
+              while (seg < segments.length &&
+                     segments[seg].end.inMilliseconds <= startMs) {
+                seg++;
+              }
+              if (seg == segments.length || segments[seg].isSilent) continue;
+            }
+            await writer.add(packet);
+          }
+        } finally {
+          await reader.close();
         }
-
-        // Extract only speech segments from this chunk
-        final extracted = _extractSpeechBytes(
-          bytes: bytes,
-          analysis: analysis,
-          codec: chunk.codec,
-          sampleRate: chunk.sampleRate,
-        );
-
-        speechSegments.addAll(extracted.segments);
-        totalSilenceRemoved += extracted.silenceRemoved;
-        totalSpeech += extracted.speechDuration;
+        totalSilenceRemoved += chunk.silenceAnalysis?.totalSilence ?? Duration.zero;
       }
 
-      if (speechSegments.isEmpty) {
+      if (writer == null || writer.granule == 0) {
+        await writer?.abandon();
+        writer = null;
+        await _deleteQuietly(outputPath);
         return StitchResult(
           success: false,
           totalDuration: Duration.zero,
@@ -85,43 +134,118 @@ class AudioStitcher {
         );
       }
 
-      // Combine all speech segments
-      final combined = _combineSegments(speechSegments);
-
-      // Get sample rate and bit depth from first chunk with speech
-      final firstChunk = conversation.chunks.firstWhere((c) => c.hasSpeech);
-      final sampleRate = firstChunk.sampleRate;
-      final bitDepth = mapCodecToBitDepth(firstChunk.codec);
-
-      // Write WAV file
-      final outputPath = await _writeWavFile(
-        pcmBytes: combined,
-        sampleRate: sampleRate,
-        bitDepth: bitDepth,
-        channels: 1,
-        fileName: outputFileName ?? 'conversation_${conversation.id}.wav',
-      );
-
+      await writer.close();
       return StitchResult(
         success: true,
         outputPath: outputPath,
-        totalDuration: totalSpeech,
+        totalDuration: writer.duration,
         silenceRemoved: totalSilenceRemoved,
       );
-    } catch (e) {
+    } catch (_) {
+      await writer?.abandon();
+      await _deleteQuietly(outputPath);
+      rethrow;
+    }
+  }
+
+  Future<StitchResult> _stitchWav(
+    Conversation conversation,
+    String? outputFileName,
+  ) async {
+    // Plan every copy first, so the header goes out with its final size and
+    // the PCM is then streamed range by range without being held in memory.
+    final List<_ByteRange> ranges = [];
+    Duration totalSilenceRemoved = Duration.zero;
+    Duration totalSpeech = Duration.zero;
+
+    for (final chunk in conversation.chunks) {
+      // Skip chunks with no speech
+      if (!chunk.hasSpeech) continue;
+      if (!await File(chunk.filePath).exists()) continue;
+
+      // Opus chunks are decoded to WAV first
+      final source   = await AudioDecodeService.playableFile(chunk.filePath);
+      final pcmBytes = max(0, await File(source).length() - _kWavHeaderBytes);
+
+      final analysis = chunk.silenceAnalysis;
+      if (analysis == null) {
+        // No analysis — include entire chunk
+        ranges.add(_ByteRange(source, _kWavHeaderBytes, pcmBytes));
+        continue;
+      }
+
+      // Only the speech segments of this chunk
+      final extracted = _speechRanges(
+        path: source,
+        pcmBytes: pcmBytes,
+        analysis: analysis,
+        codec: chunk.codec,
+        sampleRate: chunk.sampleRate,
+      );
+
+      ranges.addAll(extracted.ranges);
+      totalSilenceRemoved += extracted.silenceRemoved;
+      totalSpeech += extracted.speechDuration;
+    }
+
+    if (ranges.isEmpty) {
       return StitchResult(
         success: false,
         totalDuration: Duration.zero,
         silenceRemoved: Duration.zero,
-        error: e.toString(),
+        error: 'No speech segments found',
       );
     }
+
+    // Get sample rate and bit depth from first chunk with speech
+    final firstChunk = conversation.chunks.firstWhere((c) => c.hasSpeech);
+    final outputPath = await _outputPath(
+        outputFileName ?? 'conversation_${conversation.id}.wav');
+
+    final out = await File(outputPath).open(mode: FileMode.write);
+    try {
+      await out.writeFrom(buildWavHeader(
+        ranges.fold(0, (sum, r) => sum + r.length),
+        firstChunk.sampleRate,
+        channels: 1,
+        bitDepth: mapCodecToBitDepth(firstChunk.codec),
+      ));
+      await _copyRanges(ranges, out);
+      await out.flush();
+      await out.close();
+    } catch (_) {
+      await out.close();
+      await _deleteQuietly(outputPath);
+      rethrow;
+    }
+
+    return StitchResult(
+      success: true,
+      outputPath: outputPath,
+      totalDuration: totalSpeech,
+      silenceRemoved: totalSilenceRemoved,
+    );
   }
 
-  // ─── Private ───────────────────────────────────────────────────────────────
+  Future<String> _outputPath(String fileName) async {
+    final dir = await getApplicationDocumentsDirectory();
+    final convsDir = Directory('${dir.path}/conversations');
+    if (!await convsDir.exists()) {
+      await convsDir.create(recursive: true);
+    }
+    return '${convsDir.path}/$fileName';
+  }
 
-  _ExtractedAudio _extractSpeechBytes({
-    required Uint8List bytes,
+  Future<void> _deleteQuietly(String path) async {
+    try {
+      final f = File(path);
+      if (await f.exists()) await f.delete();
+    } catch (_) {}
+  }
+
+  _SpeechRanges _speechRanges({
+    required String path,
+    required int pcmBytes,
     required SilenceAnalysisResult analysis,
     required BleAudioCodec codec,
     required int sampleRate,
@@ -129,7 +253,7 @@ class AudioStitcher {
     final bytesPerSample = mapCodecToBitDepth(codec) == 8 ? 1 : 2;
     final bytesPerMs = (sampleRate * bytesPerSample / 1000).round();
 
-    final List<Uint8List> segments = [];
+    final List<_ByteRange> ranges = [];
     Duration silenceRemoved = Duration.zero;
     Duration speechDuration = Duration.zero;
 
@@ -139,120 +263,73 @@ class AudioStitcher {
         continue;
       }
 
-      // Extract bytes for this speech segment
+      // Byte range of this speech segment in the PCM payload
       final startByte = (segment.start.inMilliseconds * bytesPerMs)
-          .clamp(0, bytes.length);
+          .clamp(0, pcmBytes);
       final endByte = (segment.end.inMilliseconds * bytesPerMs)
-          .clamp(0, bytes.length);
+          .clamp(0, pcmBytes);
 
       if (endByte > startByte) {
-        segments.add(bytes.sublist(startByte, endByte));
+        ranges.add(_ByteRange(path, _kWavHeaderBytes + startByte, endByte - startByte));
         speechDuration += segment.duration;
       }
     }
 
-    return _ExtractedAudio(
-      segments: segments,
+    return _SpeechRanges(
+      ranges: ranges,
       silenceRemoved: silenceRemoved,
       speechDuration: speechDuration,
     );
   }
 
-  Uint8List _combineSegments(List<Uint8List> segments) {
-    final totalLength = segments.fold(0, (sum, s) => sum + s.length);
-    final combined = Uint8List(totalLength);
-    int offset = 0;
-    for (final segment in segments) {
-      combined.setRange(offset, offset + segment.length, segment);
-      offset += segment.length;
-    }
-    return combined;
-  }
+  /// Copy [ranges] into [out] in order through one fixed-size buffer.
+  Future<void> _copyRanges(List<_ByteRange> ranges, RandomAccessFile out) async {
+    final buf = Uint8List(_kCopyBufferSize);
+    RandomAccessFile? src;
+    String? srcPath;
 
-  Future<String> _writeWavFile({
-    required Uint8List pcmBytes,
-    required int sampleRate,
-    required int bitDepth,
-    required int channels,
-    required String fileName,
-  }) async {
-    final dir = await getApplicationDocumentsDirectory();
-    final convsDir = Directory('${dir.path}/conversations');
-    if (!await convsDir.exists()) {
-      await convsDir.create(recursive: true);
+    try {
+      for (final range in ranges) {
+        if (src == null || range.path != srcPath) {
+          await src?.close();
+          src = null;
+          src = await File(range.path).open();
+          srcPath = range.path;
+        }
+        await src.setPosition(range.offset);
+
+        var left = range.length;
+        while (left > 0) {
+          final n = await src.readInto(buf, 0, min(left, buf.length));
+          if (n == 0) {
+            throw FileSystemException('shorter than its WAV header says', range.path);
+          }
+          await out.writeFrom(buf, 0, n);
+          left -= n;
+        }
+      }
+    } finally {
+      await src?.close();
     }
-
-    final outputPath = '${convsDir.path}/$fileName';
-    final wavBytes = _buildWavFile(
-      pcmBytes: pcmBytes,
-      sampleRate: sampleRate,
-      bitDepth: bitDepth,
-      channels: channels,
-    );
-
-    await File(outputPath).writeAsBytes(wavBytes);
-    return outputPath;
   }
+}
 
-  /// Build a standard WAV file from raw PCM bytes
-  Uint8List _buildWavFile({
-    required Uint8List pcmBytes,
-    required int sampleRate,
-    required int bitDepth,
-    required int channels,
-  }) {
-    final byteRate = sampleRate * channels * (bitDepth ~/ 8);
-    final blockAlign = channels * (bitDepth ~/ 8);
-    final dataSize = pcmBytes.length;
-    final chunkSize = 36 + dataSize;
-
-    final header = ByteData(44);
-
-    // RIFF chunk
-    header.setUint8(0, 0x52); // R
-    header.setUint8(1, 0x49); // I
-    header.setUint8(2, 0x46); // F
-    header.setUint8(3, 0x46); // F
-    header.setUint32(4, chunkSize, Endian.little);
-    header.setUint8(8, 0x57);  // W
-    header.setUint8(9, 0x41);  // A
-    header.setUint8(10, 0x56); // V
-    header.setUint8(11, 0x45); // E
-
-    // fmt chunk
-    header.setUint8(12, 0x66); // f
-    header.setUint8(13, 0x6D); // m
-    header.setUint8(14, 0x74); // t
-    header.setUint8(15, 0x20); // (space)
-    header.setUint32(16, 16, Endian.little);         // Subchunk1Size (PCM = 16)
-    header.setUint16(20, 1, Endian.little);           // AudioFormat (PCM = 1)
-    header.setUint16(22, channels, Endian.little);
-    header.setUint32(24, sampleRate, Endian.little);
-    header.setUint32(28, byteRate, Endian.little);
-    header.setUint16(32, blockAlign, Endian.little);
-    header.setUint16(34, bitDepth, Endian.little);
-
-    // data chunk
-    header.setUint8(36, 0x64); // d
-    header.setUint8(37, 0x61); // a
-    header.setUint8(38, 0x74); // t
-    header.setUint8(39, 0x61); // a
-    header.setUint32(40, dataSize, Endian.little);
-
-    final wav = Uint8List(44 + dataSize);
-    wav.setRange(0, 44, header.buffer.asUint8List());
-    wav.setRange(44, 44 + dataSize, pcmBytes);
-    return wav;
-  }
+/// [length] bytes at [offset] in the file at [path].
+class _ByteRange {
+  final String path;
+  final int offset;
+  final int length;
+
+  _ByteRange(this.path, this.offset, this.length);
 }
 
-class _ExtractedAudio {
-  final List<Uint8List> segments;
+class _SpeechRanges {
+  final List<_ByteRange> ranges;
   final Duration silenceRemoved;
   final Duration speechDuration;
 
-  _ExtractedAudio({
-    required this.segments,
+  _SpeechRanges({
+    required this.ranges,
     required this.silenceRemoved,
     required this.speechDuration,
   });
@@ -0,0 +1,462 @@
+import 'dart:async';
+import 'dart:collection';
+import 'dart:io';
+import 'dart:isolate';
+import 'dart:typed_data';
+import 'dart:ui' show RootIsolateToken;
+
+import 'package:flutter/foundation.dart';
+import 'package:opus_flutter/opus_flutter.dart' as opus_flutter;
+import 'package:opus_dart/opus_dart.dart';
+
+import 'package:reclo/services/audio_decode_service.dart';
+import 'package:reclo/services/silence_detection_service.dart';
+import 'package:reclo/utils/audio/ogg_opus.dart';
+
+// ─── Chunk data format ────────────────────────────────────────────────────────
+
+// Chunk data records are [len(2)][Opus packet] of one to three 20 ms frames
+// (the TOC byte says how many); a len of _kSilenceRunMark is followed by a
+// 2-byte count of 20 ms frames the device did not store.
+const int _kSilenceRunMark    = 0xFFFF;
+const int _kPcmBytesPerFrame  = 320 * 2; // 20 ms of 16 kHz PCM16
+
+// Level track: one byte per 100 ms window, RMS = -byte/2 dBFS
+const int _kLevelWindowMs     = 100;
+
+// ─── Jobs ─────────────────────────────────────────────────────────────────────
+
+/// A fully received chunk, to be analysed and saved as an Ogg Opus file.
+class ChunkJob {
+  final int timestamp;
+  final int sampleRate;
+  final Uint8List opus;           // length-prefixed Opus records
+  final Uint8List? levels;        // device level track, if it was sent
+  final double silenceThresholdDb;
+  final String path;
+
+  const ChunkJob({
+    required this.timestamp,
+    required this.sampleRate,
+    required this.opus,
+    required this.levels,
+    required this.silenceThresholdDb,
+    required this.path,
+  });
+}
+
+class ChunkJobResult {
+  final int timestamp;
+  final String path;
+  final SilenceAnalysisResult analysis;
+
+  const ChunkJobResult({
+    required this.timestamp,
+    required this.path,
+    required this.analysis,
+  });
+}
+
+// ─── ChunkProcessingPool ──────────────────────────────────────────────────────
+
+/// Runs chunk silence analysis (decoding Opus where the device sent no
+/// level track) and the file write on a small pool of worker isolates, each
+/// with its own Opus decoder, so a long backlog upload does not block the
+/// UI isolate.
+///
+/// Jobs start in submission order as workers come free; each [process]
+/// future completes once that chunk's file is flushed to disk. If no
+/// worker can be started (e.g. Opus fails to load off the main isolate),
+/// jobs run one at a time on the calling isolate instead.
+///
+/// At most [maxPending] jobs are queued or running at once. Past that,
+/// [process] waits for one of them to finish before queueing its job, so
+/// the pool never holds more than [maxPending] chunks' data.
+class ChunkProcessingPool {
+  final int size;
+  final int maxPending;
+
+  final List<_Worker> _workers = [];
+  final List<_Worker> _idle = [];
+  final Queue<_PendingJob> _queue = Queue();
+  final Queue<Completer<void>> _waitingForRoom = Queue();
+  int _pending = 0;
+
+  bool _started = false;
+  bool _inlineBusy = false;
+  bool _inlineReady = false;
+  SimpleOpusDecoder? _inlineDecoder;
+  final _inlineSilence = SilenceDetectionService();
+
+  ChunkProcessingPool({int? size, int? maxPending})
+      : this._(size ?? (Platform.numberOfProcessors - 1).clamp(1, 3), maxPending);
+
+  ChunkProcessingPool._(this.size, int? maxPending)
+      : maxPending = maxPending ?? size * 2;
+
+  /// Jobs queued or running.
+  int get pending => _pending;
+
+  Future<void> start() async {
+    if (_started) return;
+    _started = true;
+
+    final token = RootIsolateToken.instance;
+    for (var i = 0; i < size; i++) {
+      try {
+        final worker = await _Worker.spawn(i, token);
+        _workers.add(worker);
+        _idle.add(worker);
+      } catch (e) {
+        debugPrint('ChunkProcessingPool: worker $i failed to start: $e');
+        break;
+      }
+    }
+
+    debugPrint('ChunkProcessingPool: ${_workers.length} worker(s)');
+    _pump();
+  }
+
+  /// Queue [job], once fewer than [maxPending] jobs are; completes with its
+  /// result once its file is on disk.
+  Future<ChunkJobResult> process(ChunkJob job) async {
+    while (_pending >= maxPending) {
+      final room = Completer<void>();
+      _waitingForRoom.add(room);
+      await room.future;
+    }
+
+    _pending++;
+    final pending = _PendingJob(job);
+    _queue.add(pending);
+    _pump();
+    try {
+      return await pending.completer.future;
+    } finally {
+      _pending--;
+      if (_waitingForRoom.isNotEmpty) _waitingForRoom.removeFirst().complete();
+    }
+  }
+
+  Future<void> close() async {
+    for (final room in _waitingForRoom) {
+      room.completeError(StateError('pool closed'));
+    }
+    _waitingForRoom.clear();
+    for (final pending in _queue) {
+      pending.completer.completeError(StateError('pool closed'));
+    }
+    _queue.clear();
+    for (final worker in _workers) {
+      worker.close();
+    }
+    _workers.clear();
+    _idle.clear();
+    _inlineDecoder?.destroy();
+    _inlineDecoder = null;
+    _inlineReady = false;
+    _started = false;
+  }
+
+  void _pump() {
+    if (!_started) return;
+
+    if (_workers.isEmpty) {
+      _pumpInline();
+      return;
+    }
+
+    while (_queue.isNotEmpty && _idle.isNotEmpty) {
+      final worker  = _idle.removeLast();
+      final pending = _queue.removeFirst();
+      worker.run(pending.job).then(
+        pending.completer.complete,
+        onError: pending.completer.completeError,
+      ).whenComplete(() {
+        if (!worker.alive) {
+          debugPrint('ChunkProcessingPool: a worker exited');
+          _workers.remove(worker);
+        } else if (_workers.contains(worker)) {
+          _idle.add(worker);
+        }
+        _pump();
+      });
+    }
+  }
+
+  Future<void> _pumpInline() async {
+    if (_inlineBusy) return;
+    _inlineBusy = true;
+    if (!_inlineReady) {
+      _inlineReady = true;
+      debugPrint('ChunkProcessingPool: no workers, processing on this isolate');
+      try {
+        initOpus(await opus_flutter.load());
+        _inlineDecoder = SimpleOpusDecoder(sampleRate: 16000, channels: 1);
+      } catch (e) {
+        debugPrint('ChunkProcessingPool: Opus init error: $e');
+      }
+    }
+    while (_queue.isNotEmpty) {
+      final pending = _queue.removeFirst();
+      try {
+        pending.completer.complete(
+            await processChunkJob(pending.job, _inlineDecoder, _inlineSilence));
+      } catch (e) {
+        pending.completer.completeError(e);
+      }
+      // Let the UI isolate draw between chunks
+      await Future<void>.delayed(Duration.zero);
+    }
+    _inlineBusy = false;
+  }
+}
+
+class _PendingJob {
+  final ChunkJob job;
+  final completer = Completer<ChunkJobResult>();
+  _PendingJob(this.job);
+}
+
+// ─── Worker isolate ───────────────────────────────────────────────────────────
+
+class _Worker {
+  final ReceivePort _replies;
+  final SendPort _jobs;
+  Completer<ChunkJobResult>? _running;
+  bool alive = true;
+
+  _Worker._(this._replies, this._jobs);
+
+  static Future<_Worker> spawn(int index, RootIsolateToken? token) async {
+    final replies = ReceivePort();
+    final isolate = await Isolate.spawn(
+      _workerMain,
+      (replies.sendPort, token),
+      debugName: 'chunk_worker_$index',
+      onExit: replies.sendPort, // sends null
+    );
+
+    // The first reply is the worker's job port, or why it could not start
+    final ready = Completer<SendPort>();
+    late final _Worker worker;
+    replies.listen((msg) {
+      if (!ready.isCompleted) {
+        if (msg is SendPort) {
+          ready.complete(msg);
+        } else {
+          ready.completeError(msg.toString());
+        }
+        return;
+      }
+      worker._onReply(msg);
+    });
+
+    try {
+      worker = _Worker._(replies, await ready.future);
+    } catch (_) {
+      replies.close();
+      isolate.kill();
+      rethrow;
+    }
+    return worker;
+  }
+
+  Future<ChunkJobResult> run(ChunkJob job) {
+    final running = Completer<ChunkJobResult>();
+    _running = running;
+    _jobs.send(job);
+    return running.future;
+  }
+
+  void _onReply(Object? msg) {
+    if (msg == null) alive = false;
+    final running = _running;
+    _running = null;
+    if (running == null) return;
+    if (msg is ChunkJobResult) {
+      running.complete(msg);
+    } else {
+      running.completeError(msg?.toString() ?? 'worker exited');
+    }
+  }
+
+  void close() {
+    _running?.completeError(StateError('pool closed'));
+    _running = null;
+    if (alive) _jobs.send(null);
+    alive = false;
+    _replies.close();
+  }
+}
+
+Future<void> _workerMain((SendPort, RootIsolateToken?) args) async {
+  final (reply, token) = args;
+
+  final SimpleOpusDecoder decoder;
+  try {
+    decoder = await createBackgroundOpusDecoder(token);
+  } catch (e) {
+    reply.send('Opus init error: $e');
+    return;
+  }
+
+  final jobs    = ReceivePort();
+  final silence = SilenceDetectionService();
+  reply.send(jobs.sendPort);
+
+  await for (final msg in jobs) {
+    if (msg is! ChunkJob) break; // null: shut down
+    try {
+      reply.send(await processChunkJob(msg, decoder, silence));
+    } catch (e) {
+      reply.send('chunk ts=${msg.timestamp}: $e');
+    }
+  }
+
+  jobs.close();
+  decoder.destroy();
+  Isolate.exit();
+}
+
+// ─── Processing ───────────────────────────────────────────────────────────────
+
+/// Analyse [job] for silence and save its packets as an Ogg Opus file.
+///
+/// The packets are stored as received, with silence runs kept in the
+/// timeline as empty frames; nothing is decoded for storage. With the
+/// device's level track, silence is known without decoding either.
+/// Otherwise the chunk is decoded once and the PCM analysed as it comes
+/// out, without being kept.
+Future<ChunkJobResult> processChunkJob(
+  ChunkJob job,
+  SimpleOpusDecoder? decoder,
+  SilenceDetectionService silence,
+) async {
+  final levels    = job.levels;
+  final useLevels = levels != null && silence.windowSizeMs == _kLevelWindowMs;
+
+  final ogg = await OggOpusWriter.create(
+    job.path,
+    inputSampleRate: job.sampleRate,
+    tags:            {kOggOpusStartTag: '${job.timestamp}'},
+  );
+  try {
+    var toc = _firstToc(job.opus) ?? kOpusSilenceToc;
+    await _forEachRecord(
+      job.opus,
+      onPacket: (packet) {
+        toc = packet[0];
+        return ogg.add(packet);
+      },
+      onSilence: (frames) => ogg.addSilence(frames, toc: toc),
+    );
+    await ogg.close();
+  } catch (_) {
+    await ogg.abandon();
+    try {
+      await File(job.path).delete();
+    } catch (_) {}
+    rethrow;
+  }
+
+  final List<bool> silentWindows;
+  if (useLevels) {
+    silentWindows = silence.classifyLevels(
+      levels:             levels,
+      silenceThresholdDb: job.silenceThresholdDb,
+    );
+  } else {
+    final accumulator = silence.accumulate(
+      format:             PcmFormat.pcm16bit,
+      silenceThresholdDb: job.silenceThresholdDb,
+    );
+    await decodeOpusFrames(job.opus, decoder, (pcm) async => accumulator.add(pcm));
+    silentWindows = accumulator.finish();
+  }
+
+  return ChunkJobResult(
+    timestamp: job.timestamp,
+    path:      job.path,
+    analysis:  silence.analyzeWindows(silentWindows),
+  );
+}
+
+// One 20 ms frame of digital silence, handed out for silence runs
+final Uint8List _silentFrame = Uint8List(_kPcmBytesPerFrame);
+
+/// Decode a buffer of length-prefixed Opus packets into raw PCM16 bytes,
+/// handing each packet's PCM to [sink] as it is decoded. The PCM passed to
+/// [sink] is only valid until the returned future completes.
+Future<void> decodeOpusFrames(
+  Uint8List opusData,
+  SimpleOpusDecoder? decoder,
+  Future<void> Function(Uint8List pcm) sink,
+) async {
+  if (decoder == null) return sink(opusData);
+
+  await _forEachRecord(
+    opusData,
+    onPacket: (packet) async {
+      Int16List? decoded;
+      try {
+        decoded = decoder.decode(input: packet);
+      } catch (e) {
+        debugPrint('ChunkProcessingPool: packet decode error: $e');
+      }
+      if (decoded != null) {
+        await sink(decoded.buffer.asUint8List(
+            decoded.offsetInBytes, decoded.lengthInBytes));
+      }
+    },
+    onSilence: (frames) async {
+      for (int i = 0; i < frames; i++) {
+        await sink(_silentFrame);
+      }
+    },
+  );
+}
+
+/// Walk the records of a chunk's data.
+///
+/// Storage format: [2-byte LE packet_len][packet bytes] repeated. A packet
+/// holds one or more 20 ms frames (40/60 ms storage modes). [onPacket] gets
+/// a view into [data]; [onSilence] gets the length of a silence run in
+/// 20 ms frames.
+Future<void> _forEachRecord(
+  Uint8List data, {
+  required Future<void> Function(Uint8List packet) onPacket,
+  required Future<void> Function(int frames) onSilence,
+}) async {
+  int offset = 0;
+  while (offset + 2 <= data.length) {
+    final len = data[offset] | (data[offset + 1] << 8);
+    offset += 2;
+
+    if (len == _kSilenceRunMark) {
+      if (offset + 2 > data.length) break;
+      await onSilence(data[offset] | (data[offset + 1] << 8));
+      offset += 2;
+      continue;
+    }
+
+    if (len == 0 || offset + len > data.length) break;
+    await onPacket(Uint8List.sublistView(data, offset, offset + len));
+    offset += len;
+  }
+}
+
+/// TOC byte of the first Opus packet in a chunk's data, so leading silence
+/// uses the same frame configuration as the audio after it.
+int? _firstToc(Uint8List data) {
+  int offset = 0;
+  while (offset + 2 <= data.length) {
+    final len = data[offset] | (data[offset + 1] << 8);
+    if (len == _kSilenceRunMark) {
+      offset += 4;
+      continue;
+    }
+    return len > 0 && offset + 2 < data.length ? data[offset + 2] : null;
+  }
+  return null;
+}
@@ -5,12 +5,11 @@ import 'dart:typed_data';
 
 import 'package:flutter/foundation.dart';
 import 'package:path_provider/path_provider.dart';
-import 'package:opus_flutter/opus_flutter.dart' as opus_flutter;
-import 'package:opus_dart/opus_dart.dart';
 
 import 'package:reclo/backend/schema/bt_device/bt_device.dart';
 import 'package:reclo/services/audio_chunk_manager.dart';
 import 'package:reclo/services/audio_stitcher.dart';
+import 'package:reclo/services/chunk_processing_pool.dart';
 import 'package:reclo/services/devices/device_connection.dart';
 import 'package:reclo/services/silence_detection_service.dart';
 
@@ -20,22 +19,56 @@ import 'package:reclo/services/silence_detection_service.dart';
 const String recloTransferServiceUuid  = '5c7d0001-b5a3-4f43-c0a9-e50e24dc0000';
 const String recloDataCharUuid         = '5c7d0001-b5a3-4f43-c0a9-e50e24dc0001';
 const String recloControlCharUuid      = '5c7d0001-b5a3-4f43-c0a9-e50e24dc0002';
+const String recloPsmCharUuid          = '5c7d0001-b5a3-4f43-c0a9-e50e24dc0003';
 
 const int _kPacketSize  = 244;
 const int _kHeaderSize  = 15;
 const int _kPayloadSize = 229; // _kPacketSize - _kHeaderSize
 
+// v2 framing: MTU-sized packets, compact data header (see reclo_transfer.h)
+const int _kProtoVersion   = 2;
+const int _kV2HeaderSize   = 26; // 30 with encoder settings, 32 with a level track
+const int _kV2DataHdrSize  = 4;
+
 // Packet types (device → phone)
-const int _kPktChunkHeader = 0x01;
-const int _kPktChunkData   = 0x02;
-const int _kPktUploadDone  = 0x03;
+const int _kPktChunkHeader   = 0x01;
+const int _kPktChunkData     = 0x02;
+const int _kPktUploadDone    = 0x03;
+const int _kPktChunkHeaderV2 = 0x11;
+const int _kPktChunkDataV2   = 0x12;
+const int _kPktChunkLevelsV2 = 0x13;
 
 // Control commands (phone → device)
-const int _kCmdRequestUpload = 0x01;
+const int _kCmdRequestUpload = 0x01; // + highest framing version + max chunks(2)
 const int _kCmdAckChunk      = 0x02; // + 4-byte LE timestamp
 const int _kCmdAbort         = 0x03;
-
-// WAV header is always 44 bytes (PCM format, no extra chunks)
+const int _kCmdNackChunk     = 0x04; // + ts(4) + chunk_idx(2) + first_seq(2) + bitmap
+const int _kCmdAckUpto       = 0x05; // + upto(4) + [first(4) + last(4)] × 0–8
+
+// Chunks per batch asked for in REQUEST_UPLOAD (+ uint16 LE). Every chunk of
+// a batch is held in memory until it is saved, and the next batch is only
+// requested once the pool has saved them all, so this bounds the memory a
+// long backlog can take: 32 chunks of 30 s at 32 kbps is about 4 MB. Older
+// firmware ignores it and sends the whole backlog in one batch.
+const int _kMaxBatchChunks = 32;
+const List<int> _kRequestUploadCmd = [
+  _kCmdRequestUpload, _kProtoVersion, _kMaxBatchChunks & 0xFF, _kMaxBatchChunks >> 8,
+];
+
+// Selective retransmission: at most 256 seqs per NACK, re-sent if the
+// missing packets have not arrived within the timeout.
+const int _kNackMaxBitmap     = 32;
+const Duration _kNackTimeout  = Duration(milliseconds: 1500);
+const int _kNackMaxAttempts   = 3;
+
+// Coalesced ACKs (v2 firmware): one ACK_UPTO per _kAckBatchSize saved chunks,
+// or after _kAckFlushDelay, instead of an ACK_CHUNK write per chunk.
+const int _kAckBatchSize        = 8;
+const int _kAckMaxRanges        = 8;
+const Duration _kAckFlushDelay  = Duration(milliseconds: 500);
+
+// Chunks saved before they were kept as Ogg Opus are WAV files with a
+// 44-byte header (PCM format, no extra chunks)
 const int _kWavHeaderSize = 44;
 
 // ─── Progress model ───────────────────────────────────────────────────────────
@@ -63,6 +96,36 @@ class UploadProgress {
 
 // ─── Internal chunk assembly state ───────────────────────────────────────────
 
+// Opus settings a chunk was encoded with (RecloEncoderInfo, 4 bytes):
+//   [0]    complexity
+//   [1]    flags — bit 0: changed within the chunk, bit 1: low-power profile,
+//                  bit 2: silence stored as runs
+//   [2..3] bitrate_kbps (uint16 LE), 0 if the chunk predates the field
+typedef _EncoderInfo = ({int complexity, int flags, int bitrateKbps});
+
+const int _kEncoderInfoSize = 4;
+const int _kEncFlagChanged  = 0x01;
+const int _kEncFlagLowPower = 0x02;
+const int _kEncFlagVad      = 0x04;
+
+_EncoderInfo? _parseEncoderInfo(Uint8List data, int offset) {
+  if (data.length < offset + _kEncoderInfoSize) return null;
+  final bitrateKbps = data[offset + 2] | (data[offset + 3] << 8);
+  if (bitrateKbps == 0) return null;
+  return (complexity: data[offset], flags: data[offset + 1], bitrateKbps: bitrateKbps);
+}
+
+String _describeEncoder(_EncoderInfo? enc) {
+  if (enc == null) return 'encoder unknown';
+  final notes = [
+    if ((enc.flags & _kEncFlagChanged) != 0) 'changed',
+    if ((enc.flags & _kEncFlagLowPower) != 0) 'low power',
+    if ((enc.flags & _kEncFlagVad) != 0) 'VAD',
+  ];
+  return 'complexity ${enc.complexity}, ${enc.bitrateKbps} kbps'
+      '${notes.isEmpty ? '' : ' (${notes.join(', ')})'}';
+}
+
 class _IncomingChunk {
   final int timestamp;    // Unix epoch seconds
   final int chunkIndex;
@@ -72,9 +135,19 @@ class _IncomingChunk {
   final int codecId;
   final int sampleRate;
   final int expectedCrc32;
-
-  final List<int> buffer = []; // accumulates raw Opus bytes
+  final int payloadSize;  // Opus bytes per data packet (last may be shorter)
+  final int chunkTag;     // v2: low byte of chunkIndex carried by each data packet
+  final int batchGen;     // upload batch the chunk arrived in
+  final _EncoderInfo? encoder; // null from firmware that does not report it
+  final Uint8List levels;      // device level track; empty if not sent
+  int levelBytesReceived = 0;
+
+  // Data packets land at (seq - 1) * payloadSize, so retransmitted packets
+  // slot straight into the gaps they fill.
+  final Uint8List buffer;
+  final Uint8List _received;   // 1 per seq; the header is seq 0
   int seqsReceived = 1;        // header is seq 0 and already "processed"
+  int nackAttempts = 0;
 
   _IncomingChunk({
     required this.timestamp,
@@ -85,9 +158,44 @@ class _IncomingChunk {
     required this.codecId,
     required this.sampleRate,
     required this.expectedCrc32,
-  });
+    required this.payloadSize,
+    required this.batchGen,
+    this.encoder,
+    int levelCount = 0,
+  })  : chunkTag  = chunkIndex & 0xFF,
+        levels    = Uint8List(levelCount),
+        buffer    = Uint8List(dataSize),
+        _received = Uint8List(totalSeqs > 0 ? totalSeqs : 1)..[0] = 1;
 
   bool get isComplete => seqsReceived >= totalSeqs;
+
+  /// True once the whole level track has arrived.
+  bool get hasLevels => levels.isNotEmpty && levelBytesReceived >= levels.length;
+
+  /// Store level bytes starting at window [first]. Levels are never resent,
+  /// so every window arrives at most once.
+  void addLevels(int first, Uint8List bytes) {
+    if (first + bytes.length > levels.length) return;
+    levels.setRange(first, first + bytes.length, bytes);
+    levelBytesReceived += bytes.length;
+  }
+
+  /// Store the payload of data packet [seq]. Duplicates and packets that do
+  /// not fit the chunk are ignored.
+  void addData(int seq, Uint8List bytes) {
+    if (seq <= 0 || seq >= totalSeqs || _received[seq] != 0) return;
+    final offset = (seq - 1) * payloadSize;
+    if (offset + bytes.length > dataSize) return;
+    buffer.setRange(offset, offset + bytes.length, bytes);
+    _received[seq] = 1;
+    seqsReceived++;
+  }
+
+  /// Data seqs not received yet, ascending.
+  List<int> get missingSeqs => [
+        for (var seq = 1; seq < totalSeqs; seq++)
+          if (_received[seq] == 0) seq,
+      ];
 }
 
 // ─── ChunkUploadService ───────────────────────────────────────────────────────
@@ -111,15 +219,37 @@ class ChunkUploadService {
   Stream<UploadProgress> get progress => _progressController.stream;
 
   StreamSubscription<List<int>>? _dataSub;
+  L2capChannel? _bulkChannel;
+  StreamSubscription<Uint8List>? _bulkSub;
   _IncomingChunk? _current;
   final List<AudioChunk> _completedChunks = [];
 
+  // Chunks with missing data packets, keyed by timestamp, waiting for the
+  // device to answer our NACKs.
+  final Map<int, _IncomingChunk> _awaitingRetransmit = {};
+  Timer? _nackTimer;
+  bool _uploadDoneDeferred = false;
+
   // Chunks carried over from the previous upload session's open tail.
   List<AudioChunk> _pendingTailChunks = [];
 
-  bool _opusReady = false;
-  SimpleOpusDecoder? _opusDecoder;
+  // Analysis and file writes run off the UI isolate. Chunks still
+  // being processed are tracked so a batch is only finished, and the next
+  // one requested, once every chunk of it is saved.
+  final _pool = ChunkProcessingPool();
+  final Set<Future<void>> _processing = {};
   int _batchReceivedCount = 0;
+  int _earlierBatchesCount = 0; // chunks saved by this session's earlier batches
+
+  // ACK coalescing. Chunk indices restart at 0 with every batch, so saved
+  // chunks are tracked per batch; every index below _ackFrontier is saved
+  // and already covered by an ACK_UPTO.
+  int _batchGen = 0;
+  bool _batchIsV2 = false;
+  final Map<int, int> _batchSavedTs = {};   // chunk index → timestamp
+  final List<int> _pendingAckIdx = [];
+  int _ackFrontier = 0;
+  Timer? _ackTimer;
 
   ChunkUploadService({
     required DeviceTransport transport,
@@ -132,11 +262,14 @@ class ChunkUploadService {
 
   /// Subscribe to BLE notifications and request the upload.
   Future<void> start() async {
-    await _initOpus();
+    await _pool.start();
     await _loadPendingTail();   // carry over open tail from last session
     _completedChunks.clear();
     _current = null;
+    _resetRetransmitState();
+    _resetAckState();
     _batchReceivedCount = 0;
+    _earlierBatchesCount = 0;
 
     _dataSub = _transport
         .getCharacteristicStream(recloTransferServiceUuid, recloDataCharUuid)
@@ -149,19 +282,24 @@ class ChunkUploadService {
       ));
     });
 
+    await _openBulkChannel();
+
     // Small delay so notification subscription is confirmed before we request.
     await Future.delayed(const Duration(milliseconds: 150));
 
     await _transport.writeCharacteristic(
       recloTransferServiceUuid,
       recloControlCharUuid,
-      [_kCmdRequestUpload],
+      _kRequestUploadCmd,
     );
     debugPrint('ChunkUploadService: upload requested');
   }
 
   /// Abort the upload and release resources.
   Future<void> stop() async {
+    await _flushAcks();
+    _ackTimer?.cancel();
+    _ackTimer = null;
     try {
       await _transport.writeCharacteristic(
         recloTransferServiceUuid,
@@ -169,32 +307,85 @@ class ChunkUploadService {
         [_kCmdAbort],
       );
     } catch (_) {}
+    _resetRetransmitState();
     await _dataSub?.cancel();
     _dataSub = null;
+    await _closeBulkChannel();
   }
 
   Future<void> dispose() async {
     await stop();
-    _opusDecoder?.destroy();
-    _opusDecoder = null;
+    await _drainProcessing();
+    await _pool.close();
     await _progressController.close();
   }
 
+  // ─── Bulk channel ─────────────────────────────────────────────────────────
+  //
+  // Firmware built with the L2CAP bulk mode publishes its PSM. If the
+  // transport can open the channel before REQUEST_UPLOAD, the device streams
+  // the batch over it as v2 packets, one per SDU; otherwise everything stays
+  // on GATT notifications. Control commands always use the characteristic.
+
+  Future<void> _openBulkChannel() async {
+    try {
+      final raw = await _transport.readCharacteristic(
+          recloTransferServiceUuid, recloPsmCharUuid);
+      if (raw.length < 2) return;
+      final psm = raw[0] | (raw[1] << 8);
+      if (psm == 0) return;
+
+      final channel = await _transport.openL2capChannel(psm);
+      if (channel == null) return;
+
+      _bulkChannel = channel;
+      _bulkSub = channel.sdus.listen(_onPacket, onError: (e) {
+        debugPrint('ChunkUploadService: bulk channel error: $e');
+      });
+      debugPrint('ChunkUploadService: bulk channel open on PSM 0x${psm.toRadixString(16)}');
+    } catch (e) {
+      debugPrint('ChunkUploadService: bulk channel unavailable, using GATT: $e');
+      await _closeBulkChannel();
+    }
+  }
+
+  Future<void> _closeBulkChannel() async {
+    await _bulkSub?.cancel();
+    _bulkSub = null;
+    try {
+      await _bulkChannel?.close();
+    } catch (_) {}
+    _bulkChannel = null;
+  }
+
   // ─── Packet dispatch ──────────────────────────────────────────────────────
 
+  // Firmware that predates v2 framing ignores the version byte in
+  // REQUEST_UPLOAD and keeps sending 244-byte v1 packets, so both framings
+  // are accepted; the packet type says which one arrived.
   void _onPacket(List<int> rawBytes) {
-    if (rawBytes.length != _kPacketSize) {
-      debugPrint('ChunkUploadService: unexpected packet size ${rawBytes.length}');
-      return;
-    }
-    final data = Uint8List.fromList(rawBytes);
+    if (rawBytes.isEmpty) return;
+    final data = rawBytes is Uint8List ? rawBytes : Uint8List.fromList(rawBytes);
     final pktType = data[0];
 
     switch (pktType) {
       case _kPktChunkHeader:
-        _handleHeader(data);
       case _kPktChunkData:
-        _handleData(data);
+        if (data.length != _kPacketSize) {
+          debugPrint('ChunkUploadService: unexpected packet size ${data.length}');
+          return;
+        }
+        if (pktType == _kPktChunkHeader) {
+          _handleHeader(data);
+        } else {
+          _handleData(data);
+        }
+      case _kPktChunkHeaderV2:
+        _handleHeaderV2(data);
+      case _kPktChunkDataV2:
+        _handleDataV2(data);
+      case _kPktChunkLevelsV2:
+        _handleLevelsV2(data);
       case _kPktUploadDone:
         _handleUploadDone();
       default:
@@ -217,6 +408,7 @@ class ChunkUploadService {
   //     [19]     codec_id
   //     [20..23] sample_rate (uint32 LE)
   //     [24..27] crc32       (uint32 LE)
+  //   [28..31] RecloEncoderInfo, when payload_len >= 17
 
   void _handleHeader(Uint8List data) {
     final v = ByteData.sublistView(data);
@@ -237,6 +429,8 @@ class ChunkUploadService {
     final sampleRate = v.getUint32(20, Endian.little);
     final crc32      = v.getUint32(24, Endian.little);
 
+    _parkIncompleteCurrent();
+    _batchIsV2 = false;
     _current = _IncomingChunk(
       timestamp:    ts,
       chunkIndex:   chunkIdx,
@@ -246,29 +440,219 @@ class ChunkUploadService {
       codecId:      codecId,
       sampleRate:   sampleRate,
       expectedCrc32: crc32,
+      payloadSize:  _kPayloadSize,
+      batchGen:     _batchGen,
+      encoder:      payloadLen >= 13 + _kEncoderInfoSize ? _parseEncoderInfo(data, 28) : null,
     );
 
     debugPrint('ChunkUploadService: chunk $chunkIdx/$totalChunks '
-        'ts=$ts size=$dataSize seqs=$totalSeqs');
+        'ts=$ts size=$dataSize seqs=$totalSeqs '
+        '(${_describeEncoder(_current!.encoder)})');
   }
 
   // ─── Data packet ──────────────────────────────────────────────────────────
 
   void _handleData(Uint8List data) {
-    if (_current == null) return;
-
     final v          = ByteData.sublistView(data);
+    final ts         = v.getUint32(1,  Endian.little);
+    final seq        = v.getUint16(9,  Endian.little);
     final payloadLen = v.getUint16(13, Endian.little);
 
     if (payloadLen == 0 || payloadLen > _kPayloadSize) return;
 
-    _current!.buffer.addAll(data.sublist(_kHeaderSize, _kHeaderSize + payloadLen));
-    _current!.seqsReceived++;
+    final chunk = _current?.timestamp == ts ? _current : _awaitingRetransmit[ts];
+    if (chunk == null) return;
+
+    chunk.addData(seq, Uint8List.sublistView(data, _kHeaderSize, _kHeaderSize + payloadLen));
+    _onChunkProgress(chunk);
+  }
+
+  // ─── v2 packets ───────────────────────────────────────────────────────────
+  //
+  // Header (26 bytes, 30 with encoder settings):
+  //   [0]      pkt_type (0x11)
+  //   [1..4]   chunk_ts     (uint32 LE)
+  //   [5..6]   chunk_idx    (uint16 LE)
+  //   [7..8]   total_chunks (uint16 LE)
+  //   [9..10]  total_seqs   (uint16 LE)
+  //   [11..12] data_payload (uint16 LE) — Opus bytes per data packet
+  //   [13..25] RecloChunkMeta (same 13 bytes as v1)
+  //   [26..29] RecloEncoderInfo (optional)
+  //   [30..31] level_count  (uint16 LE, optional) — bytes of level track
+  //
+  // Levels (right after the header): [0] pkt_type (0x13), [1] chunk_tag,
+  // [2..3] first window (uint16 LE), then one byte per 100 ms window.
+  //
+  // Data: [0] pkt_type (0x12), [1] chunk_tag, [2..3] seq (uint16 LE), then
+  // Opus bytes up to the end of the notification.
+
+  void _handleHeaderV2(Uint8List data) {
+    if (data.length < _kV2HeaderSize) {
+      debugPrint('ChunkUploadService: v2 header too short (${data.length} bytes)');
+      return;
+    }
+    final v = ByteData.sublistView(data);
+
+    final ts          = v.getUint32(1,  Endian.little);
+    final chunkIdx    = v.getUint16(5,  Endian.little);
+    final totalChunks = v.getUint16(7,  Endian.little);
+    final totalSeqs   = v.getUint16(9,  Endian.little);
+    final dataSize    = v.getUint32(13, Endian.little);
+
+    _parkIncompleteCurrent();
+    _batchIsV2 = true;
+    _current = _IncomingChunk(
+      timestamp:     ts,
+      chunkIndex:    chunkIdx,
+      totalChunks:   totalChunks,
+      totalSeqs:     totalSeqs,
+      dataSize:      dataSize,
+      codecId:       data[17],
+      sampleRate:    v.getUint32(18, Endian.little),
+      expectedCrc32: v.getUint32(22, Endian.little),
+      payloadSize:   v.getUint16(11, Endian.little),
+      batchGen:      _batchGen,
+      encoder:       _parseEncoderInfo(data, _kV2HeaderSize),
+      levelCount:    data.length >= 32 ? v.getUint16(30, Endian.little) : 0,
+    );
+
+    debugPrint('ChunkUploadService: chunk $chunkIdx/$totalChunks '
+        'ts=$ts size=$dataSize seqs=$totalSeqs '
+        '(v2, ${v.getUint16(11, Endian.little)} B/packet, '
+        '${_describeEncoder(_current!.encoder)})');
+  }
 
-    if (_current!.isComplete) {
-      final chunk = _current!;
+  void _handleDataV2(Uint8List data) {
+    if (data.length <= _kV2DataHdrSize) return;
+
+    final tag = data[1];
+    final seq = data[2] | (data[3] << 8);
+
+    _IncomingChunk? chunk = _current?.chunkTag == tag ? _current : null;
+    chunk ??= _awaitingRetransmit.values
+        .where((c) => c.chunkTag == tag)
+        .firstOrNull;
+    if (chunk == null) {
+      debugPrint('ChunkUploadService: dropping data for chunk tag $tag');
+      return;
+    }
+
+    chunk.addData(seq, Uint8List.sublistView(data, _kV2DataHdrSize));
+    _onChunkProgress(chunk);
+  }
+
+  void _handleLevelsV2(Uint8List data) {
+    if (data.length <= _kV2DataHdrSize) return;
+
+    final chunk = _current;
+    if (chunk == null || chunk.chunkTag != data[1]) return;
+
+    final first = data[2] | (data[3] << 8);
+    chunk.addLevels(first, Uint8List.sublistView(data, _kV2DataHdrSize));
+  }
+
+  // ─── Selective retransmission ─────────────────────────────────────────────
+  //
+  // A chunk whose data packets did not all arrive by the time the next
+  // header (or UPLOAD_DONE) shows up is parked and NACKed: the device
+  // resends only the missing seqs. After _kNackMaxAttempts unanswered NACKs
+  // the chunk is dropped un-ACKed, so the device sends it again in full on
+  // the next REQUEST_UPLOAD.
+
+  void _onChunkProgress(_IncomingChunk chunk) {
+    if (!chunk.isComplete) return;
+
+    if (identical(chunk, _current)) {
       _current = null;
-      _finalizeChunk(chunk);
+    } else {
+      _awaitingRetransmit.remove(chunk.timestamp);
+    }
+    final done = _finalizeChunk(chunk);
+    _processing.add(done);
+    done.whenComplete(() => _processing.remove(done));
+    _maybeFinishDeferredUpload();
+  }
+
+  void _parkIncompleteCurrent() {
+    final chunk = _current;
+    if (chunk == null) return;
+    _current = null;
+
+    debugPrint('ChunkUploadService: chunk ts=${chunk.timestamp} missing '
+        '${chunk.totalSeqs - chunk.seqsReceived} packet(s), sending NACK');
+    _awaitingRetransmit[chunk.timestamp] = chunk;
+    _sendNack(chunk);
+    _nackTimer ??= Timer(_kNackTimeout, _onNackTimeout);
+  }
+
+  void _onNackTimeout() {
+    _nackTimer = null;
+
+    for (final chunk in _awaitingRetransmit.values.toList()) {
+      chunk.nackAttempts++;
+      if (chunk.nackAttempts >= _kNackMaxAttempts) {
+        debugPrint('ChunkUploadService: giving up on chunk ts=${chunk.timestamp}; '
+            'it stays on the device for the next upload');
+        _awaitingRetransmit.remove(chunk.timestamp);
+      } else {
+        _sendNack(chunk);
+      }
+    }
+
+    if (_awaitingRetransmit.isNotEmpty) {
+      _nackTimer = Timer(_kNackTimeout, _onNackTimeout);
+    }
+    _maybeFinishDeferredUpload();
+  }
+
+  void _maybeFinishDeferredUpload() {
+    if (!_uploadDoneDeferred || _awaitingRetransmit.isNotEmpty) return;
+    _uploadDoneDeferred = false;
+    _handleUploadDone();
+  }
+
+  void _resetRetransmitState() {
+    _nackTimer?.cancel();
+    _nackTimer = null;
+    _awaitingRetransmit.clear();
+    _uploadDoneDeferred = false;
+  }
+
+  /// Send NACK_CHUNK commands covering every missing seq of [chunk], up to
+  /// 256 seqs per command.
+  Future<void> _sendNack(_IncomingChunk chunk) async {
+    final missing = chunk.missingSeqs;
+    var i = 0;
+
+    while (i < missing.length) {
+      final firstSeq = missing[i];
+      final bitmap   = Uint8List(_kNackMaxBitmap);
+      var   used     = 0;
+
+      while (i < missing.length && missing[i] - firstSeq < _kNackMaxBitmap * 8) {
+        final bit = missing[i] - firstSeq;
+        bitmap[bit >> 3] |= 1 << (bit & 7);
+        used = (bit >> 3) + 1;
+        i++;
+      }
+
+      final cmd = ByteData(9 + used)
+        ..setUint8(0,  _kCmdNackChunk)
+        ..setUint32(1, chunk.timestamp,  Endian.little)
+        ..setUint16(5, chunk.chunkIndex, Endian.little)
+        ..setUint16(7, firstSeq,         Endian.little);
+      final bytes = cmd.buffer.asUint8List()..setRange(9, 9 + used, bitmap);
+
+      try {
+        await _transport.writeCharacteristic(
+          recloTransferServiceUuid,
+          recloControlCharUuid,
+          bytes,
+        );
+      } catch (e) {
+        debugPrint('ChunkUploadService: NACK write failed: $e');
+        return;
+      }
     }
   }
 
@@ -276,50 +660,85 @@ class ChunkUploadService {
 
   Future<void> _finalizeChunk(_IncomingChunk incoming) async {
     _batchReceivedCount++;
-    final opusBytes = Uint8List.fromList(incoming.buffer);
-    final pcmBytes  = _decodeOpusFrames(opusBytes);
+
+    final chunkId = 'chunk_${incoming.timestamp}';
+    final ChunkJobResult result;
+    try {
+      result = await _pool.process(ChunkJob(
+        timestamp:          incoming.timestamp,
+        sampleRate:         incoming.sampleRate,
+        opus:               incoming.buffer,
+        levels:             incoming.hasLevels ? incoming.levels : null,
+        silenceThresholdDb: silenceThresholdDb,
+        path:               await _chunkPath(chunkId),
+      ));
+    } catch (e) {
+      // Not ACKed, so the device sends it again on the next upload
+      debugPrint('ChunkUploadService: could not process $chunkId: $e');
+      return;
+    }
 
     final startTime = DateTime.fromMillisecondsSinceEpoch(
       incoming.timestamp * 1000,
       isUtc: true,
     ).toLocal();
 
-    final chunkId  = 'chunk_${incoming.timestamp}';
-    final filePath = await _saveWav(pcmBytes, chunkId, incoming.sampleRate);
-
-    final analysis = _silenceService.analyze(
-      pcmBytes: pcmBytes,
-      format:   PcmFormat.pcm16bit,
-      silenceThresholdDb: silenceThresholdDb,
-    );
-
+    final analysis = result.analysis;
     final chunk = AudioChunk(
       id:              chunkId,
       startTime:       startTime,
-      filePath:        filePath,
+      filePath:        result.path,
       codec:           BleAudioCodec.opusFS320,
       sampleRate:      incoming.sampleRate,
       silenceAnalysis: analysis,
       isComplete:      true,
     );
 
-    _completedChunks.add(chunk);
+    // Workers finish out of order; keep the list in recording order
+    var at = _completedChunks.length;
+    while (at > 0 && _completedChunks[at - 1].startTime.isAfter(startTime)) {
+      at--;
+    }
+    _completedChunks.insert(at, chunk);
 
-    // ACK the device so it can free the SD card storage
-    await _sendAck(incoming.timestamp);
+    // ACK the device so it can free the SD card storage; the chunk file is
+    // already flushed to disk
+    await _sendAck(incoming);
 
     _progressController.add(UploadProgress(
       chunksReceived: _completedChunks.length,
-      totalChunks:    incoming.totalChunks,
+      totalChunks:    _earlierBatchesCount + incoming.totalChunks,
     ));
 
     debugPrint('ChunkUploadService: saved $chunkId '
         '(speech=${analysis.totalSpeech.inSeconds}s)');
   }
 
+  /// Wait for every chunk handed to the pool so far.
+  Future<void> _drainProcessing() async {
+    while (_processing.isNotEmpty) {
+      await Future.wait(_processing.toList());
+    }
+  }
+
   // ─── Upload done ──────────────────────────────────────────────────────────
 
   Future<void> _handleUploadDone() async {
+    // Missing packets of the last chunk(s) are NACKed first; the device
+    // still answers after UPLOAD_DONE.
+    _parkIncompleteCurrent();
+    if (_awaitingRetransmit.isNotEmpty) {
+      _uploadDoneDeferred = true;
+      return;
+    }
+
+    // The device applies ACKs before it starts the next batch, so the
+    // batch's chunks must all be saved first. This also keeps the device
+    // from running ahead of the pool.
+    await _drainProcessing();
+    await _flushAcks();
+    _resetAckState();
+
     if (_batchReceivedCount == 0) {
       debugPrint('ChunkUploadService: upload complete — '
           '${_completedChunks.length} total chunk(s)');
@@ -339,12 +758,13 @@ class ChunkUploadService {
       totalChunks:    _completedChunks.length,
     ));
     _batchReceivedCount = 0;
+    _earlierBatchesCount = _completedChunks.length;
 
     try {
       await _transport.writeCharacteristic(
         recloTransferServiceUuid,
         recloControlCharUuid,
-        [_kCmdRequestUpload],
+        _kRequestUploadCmd,
       );
     } catch (e) {
       debugPrint('ChunkUploadService: re-request failed: $e');
@@ -368,7 +788,8 @@ class ChunkUploadService {
   Future<void> _processConversations() async {
     // Prepend the persisted tail from the previous session so that
     // cross-session conversations are treated as one continuous stream.
-    final allChunks = [..._pendingTailChunks, ..._completedChunks];
+    final allChunks = [..._pendingTailChunks, ..._completedChunks]
+      ..sort((a, b) => a.startTime.compareTo(b.startTime));
 
     if (allChunks.isEmpty) {
       await _savePendingTail([]);
@@ -410,8 +831,8 @@ class ChunkUploadService {
     for (final group in closedGroups) {
       final speechChunks = group.where((c) => c.hasSpeech).toList();
       if (speechChunks.isEmpty) {
-        // All-silence group — no stitch needed, but the WAVs are closed forever.
-        await _deleteChunkWavs(group);
+        // All-silence group — no stitch needed, but the chunks are closed forever.
+        await _deleteChunkFiles(group);
         continue;
       }
 
@@ -434,18 +855,18 @@ class ChunkUploadService {
             '${result.silenceRemoved.inSeconds}s silence removed)');
         conv.stitchedFilePath = result.outputPath;
         onConversationReady?.call(conv);
-        // Raw chunk WAVs are now redundant — the stitched file is the output.
-        await _deleteChunkWavs(group);
+        // Chunk files are now redundant — the stitched file is the output.
+        await _deleteChunkFiles(group);
       } else {
         debugPrint('ChunkUploadService: stitch failed: ${result.error}');
-        // Keep WAVs on stitch failure — they are the only copy of this audio.
+        // Keep chunks on stitch failure — they are the only copy of this audio.
       }
     }
   }
 
-  /// Delete the WAV files for a closed group of chunks.
+  /// Delete the files for a closed group of chunks.
   /// Never called on pending tail chunks (those are still needed next session).
-  Future<void> _deleteChunkWavs(List<AudioChunk> chunks) async {
+  Future<void> _deleteChunkFiles(List<AudioChunk> chunks) async {
     for (final chunk in chunks) {
       try {
         final f = File(chunk.filePath);
@@ -464,8 +885,8 @@ class ChunkUploadService {
   }
 
   /// Load the open tail saved by the previous session.
-  /// Re-runs silence analysis on each WAV file so the data is ready for
-  /// boundary detection without re-decoding Opus.
+  /// Each chunk's silence windows are saved with it, so boundary detection
+  /// needs no decoding; tails saved as WAV before that are re-analysed.
   Future<void> _loadPendingTail() async {
     _pendingTailChunks = [];
     try {
@@ -478,8 +899,17 @@ class ChunkUploadService {
         final entry    = raw as Map<String, dynamic>;
         final filePath = entry['filePath'] as String;
 
-        // Re-analyse the saved WAV to reconstruct silenceAnalysis.
-        final analysis = await _analyzeWavFile(filePath);
+        final silence  = entry['silence'] as String?;
+        final SilenceAnalysisResult? analysis;
+        if (silence != null) {
+          if (!await File(filePath).exists()) continue;
+          analysis = _silenceService.analyzeWindows(
+              [for (final c in silence.codeUnits) c == 0x31]); // '1'
+        } else if (filePath.endsWith('.wav')) {
+          analysis = await _analyzeWavFile(filePath);
+        } else {
+          analysis = null;
+        }
         if (analysis == null) continue; // file deleted / corrupt — skip
 
         _pendingTailChunks.add(AudioChunk(
@@ -518,6 +948,8 @@ class ChunkUploadService {
         'filePath':  c.filePath,
         'codec':     mapCodecToName(c.codec),
         'sampleRate': c.sampleRate,
+        if (c.silenceAnalysis != null)
+          'silence': _silenceWindowString(c.silenceAnalysis!),
       }).toList();
 
       // Ensure the directory exists before writing.
@@ -531,6 +963,17 @@ class ChunkUploadService {
     }
   }
 
+  /// Per-window silence flags of [analysis] as '0'/'1' characters, the form
+  /// [analyzeWindows] rebuilds it from.
+  String _silenceWindowString(SilenceAnalysisResult analysis) {
+    final out = StringBuffer();
+    for (final segment in analysis.segments) {
+      final windows = segment.duration.inMilliseconds ~/ _silenceService.windowSizeMs;
+      out.write((segment.isSilent ? '1' : '0') * windows);
+    }
+    return out.toString();
+  }
+
   /// Read a WAV file from disk and run silence analysis on its PCM payload.
   /// Returns null if the file is missing, too short, or unreadable.
   Future<SilenceAnalysisResult?> _analyzeWavFile(String filePath) async {
@@ -557,62 +1000,101 @@ class ChunkUploadService {
 
   // ─── Helpers ─────────────────────────────────────────────────────────────
 
-  Future<void> _initOpus() async {
-    if (_opusReady) return;
-    try {
-      initOpus(await opus_flutter.load());
-      _opusDecoder = SimpleOpusDecoder(sampleRate: 16000, channels: 1);
-      _opusReady = true;
-    } catch (e) {
-      debugPrint('ChunkUploadService: Opus init error: $e');
+  /// Path of a chunk's Ogg Opus file in the audio_chunks directory.
+  Future<String> _chunkPath(String chunkId) async {
+    final dir       = await getApplicationDocumentsDirectory();
+    final chunksDir = Directory('${dir.path}/audio_chunks');
+    if (!await chunksDir.exists()) await chunksDir.create(recursive: true);
+    return '${chunksDir.path}/$chunkId.opus';
+  }
+
+  // ─── ACKs ─────────────────────────────────────────────────────────────────
+  //
+  // Saved chunks of a v2 batch are acknowledged in bulk with ACK_UPTO: the
+  // cumulative "ts <= upto" covers the unbroken run of chunk indices from 0,
+  // and chunks past a gap (one still awaiting retransmission, or skipped by
+  // the device) go as ts ranges of consecutive indices. The device only
+  // deletes chunks it has uploaded, so a range never removes one we lack.
+
+  Future<void> _sendAck(_IncomingChunk chunk) async {
+    // v1 framing may mean firmware without ACK_UPTO; a chunk finalized after
+    // its batch ended no longer maps onto the batch's indices.
+    if (!_batchIsV2 || chunk.batchGen != _batchGen) {
+      await _sendAckChunk(chunk.timestamp);
+      return;
+    }
+
+    _batchSavedTs[chunk.chunkIndex] = chunk.timestamp;
+    _pendingAckIdx.add(chunk.chunkIndex);
+    if (_pendingAckIdx.length >= _kAckBatchSize) {
+      await _flushAcks();
+    } else {
+      _ackTimer ??= Timer(_kAckFlushDelay, _flushAcks);
     }
   }
 
-  /// Decode a buffer of length-prefixed Opus frames into raw PCM16 bytes.
-  ///
-  /// Storage format: [2-byte LE frame_len][frame bytes] repeated.
-  Uint8List _decodeOpusFrames(Uint8List opusData) {
-    if (_opusDecoder == null) return opusData;
+  Future<void> _flushAcks() async {
+    _ackTimer?.cancel();
+    _ackTimer = null;
+    if (_pendingAckIdx.isEmpty) return;
 
-    final pcm = BytesBuilder();
-    int offset = 0;
+    final oldFrontier = _ackFrontier;
+    while (_batchSavedTs.containsKey(_ackFrontier)) {
+      _ackFrontier++;
+    }
+    var upto = _ackFrontier > oldFrontier ? _batchSavedTs[_ackFrontier - 1]! : 0;
 
-    while (offset + 2 <= opusData.length) {
-      final frameLen = opusData[offset] | (opusData[offset + 1] << 8);
-      offset += 2;
+    final rest = _pendingAckIdx.where((i) => i >= _ackFrontier).toList()..sort();
+    _pendingAckIdx.clear();
 
-      if (frameLen == 0 || offset + frameLen > opusData.length) break;
+    final ranges = <(int, int)>[];
+    for (var i = 0; i < rest.length;) {
+      var j = i;
+      while (j + 1 < rest.length && rest[j + 1] == rest[j] + 1) {
+        j++;
+      }
+      ranges.add((_batchSavedTs[rest[i]]!, _batchSavedTs[rest[j]]!));
+      i = j + 1;
+    }
+
+    var r = 0;
+    do {
+      final n   = (ranges.length - r).clamp(0, _kAckMaxRanges);
+      final cmd = ByteData(5 + n * 8)
+        ..setUint8(0,  _kCmdAckUpto)
+        ..setUint32(1, upto, Endian.little);
+      for (var k = 0; k < n; k++) {
+        cmd
+          ..setUint32(5 + k * 8, ranges[r + k].$1, Endian.little)
+          ..setUint32(9 + k * 8, ranges[r + k].$2, Endian.little);
+      }
+      r    += n;
+      upto  = 0;
 
       try {
-        final frame   = opusData.sublist(offset, offset + frameLen);
-        final decoded = _opusDecoder!.decode(input: frame);
-        pcm.add(decoded.buffer.asUint8List());
+        await _transport.writeCharacteristic(
+          recloTransferServiceUuid,
+          recloControlCharUuid,
+          cmd.buffer.asUint8List(),
+        );
       } catch (e) {
-        debugPrint('ChunkUploadService: frame decode error at offset $offset: $e');
+        debugPrint('ChunkUploadService: ACK write failed: $e');
+        return;
       }
-
-      offset += frameLen;
-    }
-
-    return pcm.toBytes();
+    } while (r < ranges.length);
   }
 
-  /// Save raw PCM16 bytes as a WAV file in the audio_chunks directory.
-  Future<String> _saveWav(Uint8List pcmBytes, String chunkId, int sampleRate) async {
-    final dir       = await getApplicationDocumentsDirectory();
-    final chunksDir = Directory('${dir.path}/audio_chunks');
-    if (!await chunksDir.exists()) await chunksDir.create(recursive: true);
-
-    final file    = File('${chunksDir.path}/$chunkId.wav');
-    final builder = BytesBuilder();
-    builder.add(_buildWavHeader(pcmBytes.length, sampleRate, channels: 1, bitDepth: 16));
-    builder.add(pcmBytes);
-    await file.writeAsBytes(builder.toBytes());
-    return file.path;
+  void _resetAckState() {
+    _ackTimer?.cancel();
+    _ackTimer = null;
+    _batchGen++;
+    _batchSavedTs.clear();
+    _pendingAckIdx.clear();
+    _ackFrontier = 0;
   }
 
   /// Send a 5-byte ACK_CHUNK command to the device.
-  Future<void> _sendAck(int timestamp) async {
+  Future<void> _sendAckChunk(int timestamp) async {
     final ack = ByteData(5)
       ..setUint8(0,  _kCmdAckChunk)
       ..setUint32(1, timestamp, Endian.little);
@@ -626,39 +1108,4 @@ class ChunkUploadService {
       debugPrint('ChunkUploadService: ACK write failed: $e');
     }
   }
-
-  /// Build a standard 44-byte WAV header for PCM audio.
-  Uint8List _buildWavHeader(
-    int dataSize,
-    int sampleRate, {
-    required int channels,
-    required int bitDepth,
-  }) {
-    final bytesPerSample = bitDepth ~/ 8;
-    final byteRate       = sampleRate * channels * bytesPerSample;
-    final blockAlign     = channels * bytesPerSample;
-    final hdr            = ByteData(44);
-
-    hdr.setUint8(0, 0x52); hdr.setUint8(1, 0x49); // 'R','I'
-    hdr.setUint8(2, 0x46); hdr.setUint8(3, 0x46); // 'F','F'
-    hdr.setUint32(4, dataSize + 36, Endian.little);
-    hdr.setUint8(8, 0x57); hdr.setUint8(9, 0x41);  // 'W','A'
-    hdr.setUint8(10, 0x56); hdr.setUint8(11, 0x45); // 'V','E'
-
-    hdr.setUint8(12, 0x66); hdr.setUint8(13, 0x6D); // 'f','m'
-    hdr.setUint8(14, 0x74); hdr.setUint8(15, 0x20); // 't',' '
-    hdr.setUint32(16, 16,          Endian.little);
-    hdr.setUint16(20, 1,           Endian.little);
-    hdr.setUint16(22, channels,    Endian.little);
-    hdr.setUint32(24, sampleRate,  Endian.little);
-    hdr.setUint32(28, byteRate,    Endian.little);
-    hdr.setUint16(32, blockAlign,  Endian.little);
-    hdr.setUint16(34, bitDepth,    Endian.little);
-
-    hdr.setUint8(36, 0x64); hdr.setUint8(37, 0x61); // 'd','a'
-    hdr.setUint8(38, 0x74); hdr.setUint8(39, 0x61); // 't','a'
-    hdr.setUint32(40, dataSize, Endian.little);
-
-    return hdr.buffer.asUint8List();
-  }
 }
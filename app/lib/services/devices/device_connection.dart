@@ -22,6 +22,13 @@ enum DeviceTransportState {
   disconnecting,
 }
 
+/// A connection-oriented bulk channel to the device (LE L2CAP CoC).
+/// Each event on [sdus] is one complete SDU.
+abstract class L2capChannel {
+  Stream<Uint8List> get sdus;
+  Future<void> close();
+}
+
 abstract class DeviceTransport {
   String get deviceId;
   Future<void> connect();
@@ -33,6 +40,10 @@ abstract class DeviceTransport {
   Future<void> writeCharacteristic(String serviceUuid, String characteristicUuid, List<int> data);
   Stream<DeviceTransportState> get connectionStateStream;
   Future<void> dispose();
+
+  /// Open an L2CAP CoC to [psm]. Returns null when this transport or
+  /// platform cannot, in which case callers stay on GATT.
+  Future<L2capChannel?> openL2capChannel(int psm) async => null;
 }
 
 class BleTransport extends DeviceTransport {
@@ -71,22 +71,36 @@ class SilenceDetectionService {
       );
     }
 
-    final samples = format == PcmFormat.pcm8bit
-        ? _bytes8ToSamples(pcmBytes)
-        : _bytes16ToSamples(pcmBytes);
-
-    final samplesPerWindow = (sampleRate * windowSizeMs / 1000).round();
-    final List<bool> windowSilence = [];
-
-    int wi = 0;
-    while (wi * samplesPerWindow < samples.length) {
-      final start = wi * samplesPerWindow;
-      final end = min(start + samplesPerWindow, samples.length);
-      final window = samples.sublist(start, end);
-      windowSilence.add(_calculateRmsDb(window) < silenceThresholdDb);
-      wi++;
-    }
+    final accumulator = accumulate(
+      format: format,
+      silenceThresholdDb: silenceThresholdDb,
+    )..add(pcmBytes);
+    return analyzeWindows(accumulator.finish());
+  }
 
+  /// Start an incremental [analyze]: feed PCM with [SilenceAccumulator.add]
+  /// as it is decoded, then pass [SilenceAccumulator.finish] to
+  /// [analyzeWindows].
+  SilenceAccumulator accumulate({
+    required PcmFormat format,
+    required double silenceThresholdDb,
+  }) =>
+      SilenceAccumulator._(
+        format: format,
+        samplesPerWindow: (sampleRate * windowSizeMs / 1000).round(),
+        silenceThresholdDb: silenceThresholdDb,
+      );
+
+  /// Classify a device level track (one byte per [windowSizeMs], RMS =
+  /// -byte/2 dBFS) the way [analyze] classifies decoded PCM windows.
+  List<bool> classifyLevels({
+    required Uint8List levels,
+    required double silenceThresholdDb,
+  }) =>
+      [for (final level in levels) -level / 2.0 < silenceThresholdDb];
+
+  /// Build the result from per-window silence flags, one per [windowSizeMs].
+  SilenceAnalysisResult analyzeWindows(List<bool> windowSilence) {
     if (windowSilence.isEmpty) {
       return SilenceAnalysisResult(
         segments: [],
@@ -161,25 +175,135 @@ class SilenceDetectionService {
 
     return accumulated >= silenceThreshold;
   }
+}
+
+/// Per-window silence flags for PCM that arrives in pieces, computed the way
+/// [SilenceDetectionService.analyze] always has: a window is silent when its
+/// RMS, in dBFS, is below the threshold.
+///
+/// Samples are read through an [Int16List] view and squared as integers, so
+/// a window costs one pass and no allocation. The dB comparison is replaced
+/// by comparing the integer sum of squares against the smallest sum that
+/// would not be silent. That sum is found with the original dB formula, so
+/// every window is classified exactly as before.
+class SilenceAccumulator {
+  final PcmFormat format;
+  final int samplesPerWindow;
+  final double silenceThresholdDb;
+
+  final List<bool> _windows = [];
+  final Map<int, int> _minLoudSum = {}; // window length → sum of squares
+  int _sum = 0;
+  int _count = 0;
+  int? _oddByte; // first byte of a 16-bit sample split across add() calls
+
+  SilenceAccumulator._({
+    required this.format,
+    required this.samplesPerWindow,
+    required this.silenceThresholdDb,
+  });
+
+  // Full-scale sample squared: samples are normalised to ±1.0 before the
+  // RMS, so a sum of squares S is S / _fullScaleSq in those units.
+  int get _fullScaleSq => format == PcmFormat.pcm8bit ? 128 * 128 : 32768 * 32768;
+
+  void add(Uint8List bytes) {
+    if (bytes.isEmpty) return;
+
+    if (format == PcmFormat.pcm8bit) {
+      for (final b in bytes) {
+        final v = b - 128;
+        _sum += v * v;
+        if (++_count == samplesPerWindow) _closeWindow();
+      }
+      return;
+    }
+
+    var from = 0;
+    final odd = _oddByte;
+    if (odd != null) {
+      _oddByte = null;
+      _addSamples(Int16List.fromList([(odd | (bytes[0] << 8)).toSigned(16)]));
+      from = 1;
+    }
+    final n = (bytes.length - from) >> 1;
+    if (from + n * 2 < bytes.length) _oddByte = bytes[bytes.length - 1];
+    if (n > 0) _addSamples(_int16View(bytes, from, n));
+  }
 
-  List<double> _bytes8ToSamples(Uint8List bytes) =>
-      bytes.map((b) => (b - 128) / 128.0).toList();
+  /// Close the last, possibly partial, window and return one silence flag
+  /// per window.
+  List<bool> finish() {
+    if (_count > 0) _closeWindow();
+    _oddByte = null;
+    return _windows;
+  }
+
+  void _addSamples(Int16List samples) {
+    var i = 0;
+    while (i < samples.length) {
+      final end = min(i + samplesPerWindow - _count, samples.length);
+      var sum = _sum;
+      for (var j = i; j < end; j++) {
+        final v = samples[j];
+        sum += v * v;
+      }
+      _sum = sum;
+      _count += end - i;
+      i = end;
+      if (_count == samplesPerWindow) _closeWindow();
+    }
+  }
 
-  List<double> _bytes16ToSamples(Uint8List bytes) {
-    final samples = <double>[];
-    for (int i = 0; i + 1 < bytes.length; i += 2) {
-      int raw = bytes[i] | (bytes[i + 1] << 8);
-      if (raw > 32767) raw -= 65536;
-      samples.add(raw / 32768.0);
+  void _closeWindow() {
+    final silent = _sum == 0
+        ? _rmsDb(0, _count) < silenceThresholdDb
+        : _sum < _minLoudSum.putIfAbsent(_count, () => _findMinLoudSum(_count));
+    _windows.add(silent);
+    _sum = 0;
+    _count = 0;
+  }
+
+  /// Smallest non-zero sum of squares over [n] samples whose RMS is not
+  /// below the threshold. The dB value only grows with the sum once it is
+  /// non-zero, so start from the closed-form estimate and step to the exact
+  /// boundary.
+  int _findMinLoudSum(int n) {
+    final maxSum = n * _fullScaleSq;
+    bool loud(int sum) => _rmsDb(sum / _fullScaleSq, n) >= silenceThresholdDb;
+
+    final estimate = pow(10, silenceThresholdDb / 10) * n * _fullScaleSq;
+    if (estimate.isNaN || estimate > maxSum) return maxSum + 1;
+    var sum = max(1, estimate.ceil());
+    while (sum > 1 && loud(sum - 1)) {
+      sum--;
+    }
+    while (sum <= maxSum && !loud(sum)) {
+      sum++;
+    }
+    return sum;
+  }
+
+  /// Little-endian PCM16 at [offset] in [bytes] as samples, without copying
+  /// where the platform allows it.
+  static Int16List _int16View(Uint8List bytes, int offset, int count) {
+    final start = bytes.offsetInBytes + offset;
+    if (start.isEven && Endian.host == Endian.little) {
+      return bytes.buffer.asInt16List(start, count);
+    }
+    final data    = ByteData.sublistView(bytes, offset);
+    final samples = Int16List(count);
+    for (var i = 0; i < count; i++) {
+      samples[i] = data.getInt16(i * 2, Endian.little);
     }
     return samples;
   }
 
-  double _calculateRmsDb(List<double> samples) {
-    if (samples.isEmpty) return -100.0;
-    double sumSquares = 0;
-    for (final s in samples) sumSquares += s * s;
-    final rms = sqrt(sumSquares / samples.length);
+  // RMS in dBFS of [count] samples normalised to ±1.0 with the given sum of
+  // squares; -100 for digital silence.
+  static double _rmsDb(double sumSquares, int count) {
+    if (count == 0) return -100.0;
+    final rms = sqrt(sumSquares / count);
     if (rms == 0) return -100.0;
     return 20 * log(rms) / ln10;
   }
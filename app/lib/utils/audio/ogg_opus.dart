@@ -0,0 +1,386 @@
+import 'dart:collection';
+import 'dart:convert';
+import 'dart:io';
+import 'dart:math';
+import 'dart:typed_data';
+
+import 'package:flutter/foundation.dart';
+import 'package:opus_dart/opus_dart.dart';
+
+// Ogg Opus (RFC 7845) files for stored conversations: one mono logical
+// stream, no pre-skip, granule positions in 48 kHz samples from the start of
+// the file. Silence the device did not store is kept in the timeline as
+// packets of zero-length frames, one or two bytes each, so positions in a
+// file still line up with the chunk's wall-clock time.
+
+/// Granule positions are always counted at 48 kHz (RFC 7845 §4).
+const int kOggOpusGranuleRate = 48000;
+
+/// Tag holding the Unix time (seconds) at which the file's audio starts.
+const String kOggOpusStartTag = 'RECLO_START';
+
+/// TOC byte used for silence when there is no encoded packet to copy it
+/// from: SILK wideband, 20 ms frames.
+const int kOpusSilenceToc = 0x48;
+
+// ─── Packet helpers ───────────────────────────────────────────────────────────
+
+/// Number of frames in [packet], from its TOC byte (RFC 6716 §3.1).
+int opusPacketFrameCount(Uint8List packet) {
+  switch (packet[0] & 0x03) {
+    case 0:
+      return 1;
+    case 1:
+    case 2:
+      return 2;
+    default:
+      return packet.length >= 2 ? (packet[1] & 0x3F).clamp(1, 48) : 1;
+  }
+}
+
+/// Duration of one frame of a packet with this TOC byte, in 48 kHz samples.
+int opusFrameSamples48k(int toc) {
+  final config = toc >> 3;
+  if (config < 12) return const [480, 960, 1920, 2880][config & 3]; // SILK
+  if (config < 16) return const [480, 960][config & 1];             // hybrid
+  return const [120, 240, 480, 960][config & 3];                    // CELT
+}
+
+/// Duration of [packet] in samples at [sampleRate].
+int opusPacketSamples(Uint8List packet, int sampleRate) =>
+    opusPacketFrameCount(packet) * opusFrameSamples48k(packet[0]) *
+    sampleRate ~/ kOggOpusGranuleRate;
+
+/// A packet of [frames] zero-length frames with [toc]'s configuration; at
+/// most 120 ms of audio (RFC 6716 §3.2.5).
+Uint8List opusSilencePacket(int toc, int frames) => frames == 1
+    ? Uint8List.fromList([toc & 0xFC])
+    : Uint8List.fromList([(toc & 0xFC) | 3, frames]); // code 3, CBR
+
+/// Whether [packet] is made only of zero-length frames, as written by
+/// [opusSilencePacket]. Those decode to concealment noise; treat them as
+/// digital silence instead.
+bool isOpusSilencePacket(Uint8List packet) {
+  switch (packet[0] & 0x03) {
+    case 0:
+      return packet.length == 1;
+    case 3:
+      return packet.length == 2 && (packet[1] & 0xC0) == 0;
+    default:
+      return false;
+  }
+}
+
+// ─── Writer ───────────────────────────────────────────────────────────────────
+
+/// Writes Opus packets into an Ogg Opus file a page at a time.
+class OggOpusWriter {
+  static const int _kMaxPageBody = 4096;
+  static const int _kFlagBos = 0x02;
+  static const int _kFlagEos = 0x04;
+
+  final RandomAccessFile _file;
+  final int _serial;
+  int _sequence = 0;
+  int _granule = 0;
+
+  final List<Uint8List> _pending = [];
+  int _pendingBytes = 0;
+  int _pendingSegments = 0;
+
+  OggOpusWriter._(this._file, this._serial);
+
+  /// Create [path] and write the OpusHead and OpusTags headers.
+  ///
+  /// [inputSampleRate] is informational: the rate the audio was captured
+  /// at, which decoders may use for output.
+  static Future<OggOpusWriter> create(
+    String path, {
+    required int inputSampleRate,
+    Map<String, String> tags = const {},
+  }) async {
+    final file   = await File(path).open(mode: FileMode.write);
+    final writer = OggOpusWriter._(file, Random().nextInt(1 << 32));
+    try {
+      await writer._writePage([_opusHead(inputSampleRate)], _kFlagBos);
+      await writer._writePage([_opusTags(tags)], 0);
+    } catch (_) {
+      await file.close();
+      rethrow;
+    }
+    return writer;
+  }
+
+  /// Audio written so far, in 48 kHz samples.
+  int get granule => _granule;
+
+  Duration get duration =>
+      Duration(microseconds: _granule * 1000000 ~/ kOggOpusGranuleRate);
+
+  /// Append one Opus packet; its duration is taken from its TOC byte.
+  Future<void> add(Uint8List packet) async {
+    final segments = packet.length ~/ 255 + 1;
+    if (_pending.isNotEmpty &&
+        (_pendingSegments + segments > 255 ||
+         _pendingBytes + packet.length > _kMaxPageBody)) {
+      await _writePage(_pending, 0);
+    }
+    _pending.add(Uint8List.fromList(packet));
+    _pendingBytes    += packet.length;
+    _pendingSegments += segments;
+    _granule         += opusPacketSamples(packet, kOggOpusGranuleRate);
+  }
+
+  /// Append [frames] frames of silence with [toc]'s frame duration.
+  Future<void> addSilence(int frames, {int toc = kOpusSilenceToc}) async {
+    final perPacket = max(1, 5760 ~/ opusFrameSamples48k(toc)); // 120 ms
+    while (frames > 0) {
+      final n = min(frames, perPacket);
+      await add(opusSilencePacket(toc, n));
+      frames -= n;
+    }
+  }
+
+  /// Write the last page, flush to disk and close.
+  Future<void> close() async {
+    await _writePage(_pending, _kFlagEos);
+    await _file.flush();
+    await _file.close();
+  }
+
+  /// Close without finishing the stream, for a file about to be deleted.
+  Future<void> abandon() async {
+    try {
+      await _file.close();
+    } catch (_) {}
+  }
+
+  Future<void> _writePage(List<Uint8List> packets, int flags) async {
+    final table = <int>[];
+    var bodyLen = 0;
+    for (final p in packets) {
+      for (var n = p.length; ; n -= 255) {
+        table.add(min(n, 255));
+        if (n < 255) break;
+      }
+      bodyLen += p.length;
+    }
+
+    final page = Uint8List(27 + table.length + bodyLen);
+    final hdr  = ByteData.sublistView(page);
+    page.setAll(0, 'OggS'.codeUnits);
+    hdr
+      ..setUint8(4,  0)
+      ..setUint8(5,  flags)
+      ..setInt64(6,  _granule, Endian.little)
+      ..setUint32(14, _serial,  Endian.little)
+      ..setUint32(18, _sequence++, Endian.little)
+      ..setUint8(26, table.length);
+    page.setAll(27, table);
+    var at = 27 + table.length;
+    for (final p in packets) {
+      page.setAll(at, p);
+      at += p.length;
+    }
+    hdr.setUint32(22, _oggCrc(page), Endian.little);
+
+    await _file.writeFrom(page);
+    packets.clear();
+    _pendingBytes    = 0;
+    _pendingSegments = 0;
+  }
+
+  static Uint8List _opusHead(int inputSampleRate) {
+    final head = ByteData(19);
+    final b    = head.buffer.asUint8List()..setAll(0, 'OpusHead'.codeUnits);
+    head
+      ..setUint8(8,   1) // version
+      ..setUint8(9,   1) // channels
+      ..setUint16(10, 0, Endian.little) // pre-skip
+      ..setUint32(12, inputSampleRate, Endian.little)
+      ..setInt16(16,  0, Endian.little) // output gain
+      ..setUint8(18,  0); // mapping family
+    return b;
+  }
+
+  static Uint8List _opusTags(Map<String, String> tags) {
+    final out = BytesBuilder();
+    void addString(String s) {
+      final bytes = utf8.encode(s);
+      out.add((ByteData(4)..setUint32(0, bytes.length, Endian.little))
+          .buffer.asUint8List());
+      out.add(bytes);
+    }
+
+    out.add('OpusTags'.codeUnits);
+    addString('reclo');
+    out.add((ByteData(4)..setUint32(0, tags.length, Endian.little))
+        .buffer.asUint8List());
+    tags.forEach((k, v) => addString('$k=$v'));
+    return out.takeBytes();
+  }
+}
+
+// ─── Reader ───────────────────────────────────────────────────────────────────
+
+/// Reads the packets of an Ogg Opus file one page at a time.
+class OggOpusReader {
+  final RandomAccessFile _file;
+  final Queue<Uint8List> _ready = Queue();
+  final BytesBuilder _partial = BytesBuilder();
+
+  late final int inputSampleRate;
+  late final int preSkip;
+  late final Map<String, String> tags;
+
+  OggOpusReader._(this._file);
+
+  /// Open [path] and read its OpusHead and OpusTags headers.
+  static Future<OggOpusReader> open(String path) async {
+    final reader = OggOpusReader._(await File(path).open());
+    try {
+      final head = await reader.next();
+      if (head == null || head.length < 19 ||
+          String.fromCharCodes(head, 0, 8) != 'OpusHead') {
+        throw FormatException('not an Ogg Opus file: $path');
+      }
+      final h = ByteData.sublistView(head);
+      reader.preSkip         = h.getUint16(10, Endian.little);
+      reader.inputSampleRate = h.getUint32(12, Endian.little);
+
+      final tags = await reader.next();
+      if (tags == null || tags.length < 8 ||
+          String.fromCharCodes(tags, 0, 8) != 'OpusTags') {
+        throw FormatException('missing OpusTags: $path');
+      }
+      reader.tags = _parseTags(tags);
+    } catch (_) {
+      await reader.close();
+      rethrow;
+    }
+    return reader;
+  }
+
+  /// Wall-clock start of the audio, if the file was written with one.
+  DateTime? get startTime {
+    final s = int.tryParse(tags[kOggOpusStartTag] ?? '');
+    return s == null
+        ? null
+        : DateTime.fromMillisecondsSinceEpoch(s * 1000, isUtc: true).toLocal();
+  }
+
+  /// The next audio packet, or null at the end of the file. A truncated
+  /// last page ends the stream early.
+  Future<Uint8List?> next() async {
+    while (_ready.isEmpty) {
+      if (!await _readPage()) return null;
+    }
+    return _ready.removeFirst();
+  }
+
+  Future<void> close() => _file.close();
+
+  Future<bool> _readPage() async {
+    final header = await _file.read(27);
+    if (header.length < 27) return false;
+    if (String.fromCharCodes(header, 0, 4) != 'OggS') {
+      throw const FormatException('lost Ogg page sync');
+    }
+
+    final table = await _file.read(header[26]);
+    if (table.length < header[26]) return false;
+    final body = await _file.read(table.fold<int>(0, (sum, n) => sum + n));
+
+    var at = 0;
+    for (final lace in table) {
+      if (at + lace > body.length) return false;
+      _partial.add(Uint8List.sublistView(body, at, at + lace));
+      at += lace;
+      if (lace < 255) _ready.add(_partial.takeBytes());
+    }
+    return true;
+  }
+
+  static Map<String, String> _parseTags(Uint8List packet) {
+    final data = ByteData.sublistView(packet);
+    final tags = <String, String>{};
+    var at = 8;
+    String? readString() {
+      if (at + 4 > packet.length) return null;
+      final len = data.getUint32(at, Endian.little);
+      if (at + 4 + len > packet.length) return null;
+      final s = utf8.decode(Uint8List.sublistView(packet, at + 4, at + 4 + len),
+          allowMalformed: true);
+      at += 4 + len;
+      return s;
+    }
+
+    if (readString() == null || at + 4 > packet.length) return tags; // vendor
+    final count = data.getUint32(at, Endian.little);
+    at += 4;
+    for (var i = 0; i < count; i++) {
+      final c = readString();
+      if (c == null) break;
+      final eq = c.indexOf('=');
+      if (eq > 0) tags[c.substring(0, eq).toUpperCase()] = c.substring(eq + 1);
+    }
+    return tags;
+  }
+}
+
+// ─── Decoding ─────────────────────────────────────────────────────────────────
+
+/// Decode the Ogg Opus file at [path], handing PCM16 at [sampleRate] (the
+/// decoder's rate) to [sink] a packet at a time. Silence packets come out
+/// as zeros without touching the decoder.
+Future<void> decodeOggOpus(
+  String path,
+  SimpleOpusDecoder decoder,
+  Future<void> Function(Uint8List pcm) sink, {
+  int sampleRate = 16000,
+}) async {
+  final reader = await OggOpusReader.open(path);
+  try {
+    for (var packet = await reader.next(); packet != null; packet = await reader.next()) {
+      if (isOpusSilencePacket(packet)) {
+        await sink(Uint8List(opusPacketSamples(packet, sampleRate) * 2));
+        continue;
+      }
+      Int16List? pcm;
+      try {
+        pcm = decoder.decode(input: packet);
+      } catch (e) {
+        debugPrint('decodeOggOpus: packet decode error in $path: $e');
+      }
+      if (pcm != null) {
+        await sink(pcm.buffer.asUint8List(pcm.offsetInBytes, pcm.lengthInBytes));
+      }
+    }
+  } finally {
+    await reader.close();
+  }
+}
+
+// ─── CRC ──────────────────────────────────────────────────────────────────────
+
+// Ogg page checksum: CRC-32, polynomial 0x04C11DB7, not reflected, zero
+// initial value and no final XOR, computed with the CRC field zeroed.
+final Uint32List _crcTable = () {
+  final table = Uint32List(256);
+  for (var i = 0; i < 256; i++) {
+    var r = i << 24;
+    for (var j = 0; j < 8; j++) {
+      r = (r & 0x80000000) != 0 ? (r << 1) ^ 0x04C11DB7 : r << 1;
+    }
+    table[i] = r;
+  }
+  return table;
+}();
+
+int _oggCrc(Uint8List data) {
+  var crc = 0;
+  for (final b in data) {
+    crc = ((crc << 8) & 0xFFFFFFFF) ^ _crcTable[((crc >> 24) ^ b) & 0xFF];
+  }
+  return crc;
+}
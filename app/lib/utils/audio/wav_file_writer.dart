@@ -0,0 +1,104 @@
+import 'dart:io';
+import 'dart:math';
+import 'dart:typed_data';
+
+/// Mono PCM16 WAV file written through a small buffer. The header goes out
+/// first with the sizes left at zero and is patched once the length is
+/// known.
+class WavFileWriter {
+  static const int _kBufferSize = 16 * 1024;
+
+  final String _path;
+  final RandomAccessFile _file;
+  final Uint8List _buf = Uint8List(_kBufferSize);
+  int _fill = 0;
+  int _dataSize = 0;
+
+  WavFileWriter._(this._path, this._file);
+
+  static Future<WavFileWriter> open(String path, int sampleRate) async {
+    final file = await File(path).open(mode: FileMode.write);
+    try {
+      await file.writeFrom(buildWavHeader(0, sampleRate, channels: 1, bitDepth: 16));
+    } catch (_) {
+      await file.close();
+      rethrow;
+    }
+    return WavFileWriter._(path, file);
+  }
+
+  Future<void> add(Uint8List pcm) async {
+    _dataSize += pcm.length;
+    var from = 0;
+    while (from < pcm.length) {
+      final n = min(pcm.length - from, _kBufferSize - _fill);
+      _buf.setRange(_fill, _fill + n, pcm, from);
+      _fill += n;
+      from  += n;
+      if (_fill == _kBufferSize) await _writeBuffer();
+    }
+  }
+
+  /// Patch the header sizes, flush to disk and close.
+  Future<void> close() async {
+    await _writeBuffer();
+    final size = ByteData(4);
+    size.setUint32(0, _dataSize + 36, Endian.little);
+    await _file.setPosition(4);
+    await _file.writeFrom(size.buffer.asUint8List());
+    size.setUint32(0, _dataSize, Endian.little);
+    await _file.setPosition(40);
+    await _file.writeFrom(size.buffer.asUint8List());
+    await _file.flush();
+    await _file.close();
+  }
+
+  /// Close and delete a file that will not be completed.
+  Future<void> discard() async {
+    try {
+      await _file.close();
+      await File(_path).delete();
+    } catch (_) {}
+  }
+
+  Future<void> _writeBuffer() async {
+    if (_fill == 0) return;
+    await _file.writeFrom(_buf, 0, _fill);
+    _fill = 0;
+  }
+}
+
+/// Build a standard 44-byte WAV header for PCM audio.
+Uint8List buildWavHeader(
+  int dataSize,
+  int sampleRate, {
+  required int channels,
+  required int bitDepth,
+}) {
+  final bytesPerSample = bitDepth ~/ 8;
+  final byteRate       = sampleRate * channels * bytesPerSample;
+  final blockAlign     = channels * bytesPerSample;
+  final hdr            = ByteData(44);
+
+  hdr.setUint8(0, 0x52); hdr.setUint8(1, 0x49); // 'R','I'
+  hdr.setUint8(2, 0x46); hdr.setUint8(3, 0x46); // 'F','F'
+  hdr.setUint32(4, dataSize + 36, Endian.little);
+  hdr.setUint8(8, 0x57); hdr.setUint8(9, 0x41);  // 'W','A'
+  hdr.setUint8(10, 0x56); hdr.setUint8(11, 0x45); // 'V','E'
+
+  hdr.setUint8(12, 0x66); hdr.setUint8(13, 0x6D); // 'f','m'
+  hdr.setUint8(14, 0x74); hdr.setUint8(15, 0x20); // 't',' '
+  hdr.setUint32(16, 16,          Endian.little);
+  hdr.setUint16(20, 1,           Endian.little);
+  hdr.setUint16(22, channels,    Endian.little);
+  hdr.setUint32(24, sampleRate,  Endian.little);
+  hdr.setUint32(28, byteRate,    Endian.little);
+  hdr.setUint16(32, blockAlign,  Endian.little);
+  hdr.setUint16(34, bitDepth,    Endian.little);
+
+  hdr.setUint8(36, 0x64); hdr.setUint8(37, 0x61); // 'd','a'
+  hdr.setUint8(38, 0x74); hdr.setUint8(39, 0x61); // 't','a'
+  hdr.setUint32(40, dataSize, Endian.little);
+
+  return hdr.buffer.asUint8List();
+}
@@ -4,6 +4,7 @@ import 'dart:typed_data';
 
 import 'package:flutter/foundation.dart';
 
+import 'package:reclo/services/audio_decode_service.dart';
 import 'package:reclo/utils/logger.dart';
 
 class WavInfo {
@@ -49,12 +50,14 @@ class WaveformUtils {
   static Future<List<double>> _generateWaveformFromWavFile(String wavFilePath) async {
     Logger.debug('Generating waveform from WAV file: $wavFilePath');
 
-    final file = File(wavFilePath);
-    if (!file.existsSync()) {
+    if (!File(wavFilePath).existsSync()) {
       Logger.debug('WAV file does not exist');
       return _generateFallbackWaveform();
     }
 
+    // Ogg Opus files are decoded on demand
+    final file = File(await AudioDecodeService.playableFile(wavFilePath));
+
     final wavData = await file.readAsBytes();
     final wavInfo = _parseWavHeader(wavData);
 
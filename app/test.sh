@@ -44,6 +44,10 @@ if [[ ${#missing_files[@]} -gt 0 ]]; then
   dart run build_runner build --delete-conflicting-outputs
 fi
 
-flutter test test/providers/capture_provider_test.dart
-flutter test test/widgets/transcript_test.dart
-flutter test test/unit/audio_player_utils_test.dart
+flutter test test/chunk_processing_pool_test.dart
+flutter test test/silence_detection_service_test.dart
+flutter test test/ogg_opus_test.dart
+flutter test test/wav_file_writer_test.dart
+flutter test test/audio_stitcher_test.dart
+flutter test test/chunk_upload_loss_test.dart
+flutter test test/chunk_upload_l2cap_test.dart
@@ -0,0 +1,216 @@
+import 'dart:async';
+import 'dart:io';
+import 'dart:math';
+import 'dart:typed_data';
+
+import 'package:flutter/foundation.dart';
+import 'package:flutter/services.dart';
+import 'package:flutter_test/flutter_test.dart';
+
+import 'package:reclo/backend/schema/bt_device/bt_device.dart';
+import 'package:reclo/services/audio_chunk_manager.dart';
+import 'package:reclo/services/audio_stitcher.dart';
+import 'package:reclo/services/silence_detection_service.dart';
+import 'package:reclo/utils/audio/wav_file_writer.dart';
+
+// ─── Synthetic chunks ─────────────────────────────────────────────────────────
+
+const int _kSampleRate = 16000;
+
+/// Payload bytes that differ between chunks and from any nearby window, so
+/// a range taken from the wrong file or offset shows up.
+Uint8List _payload(int seed, int length) {
+  final out = Uint8List(length);
+  for (var i = 0; i < length; i++) {
+    out[i] = (i * 7 + i ~/ 253 + seed * 101) & 0xFF;
+  }
+  return out;
+}
+
+/// A WAV chunk as older versions stored it: a 44-byte header and the PCM.
+Future<Uint8List> _writeWav(String path, int seed, int bytes, int bitDepth) async {
+  final pcm = _payload(seed, bytes);
+  await File(path).writeAsBytes(Uint8List(44 + bytes)
+    ..setAll(0, buildWavHeader(bytes, _kSampleRate, channels: 1, bitDepth: bitDepth))
+    ..setAll(44, pcm));
+  return pcm;
+}
+
+/// Analysis with the given speech spans (ms) and silence in between.
+SilenceAnalysisResult _analysis(int lengthMs, List<(int, int)> speech) {
+  final segments = <AudioSegment>[];
+  var at = 0;
+  for (final (start, end) in speech) {
+    if (start > at) {
+      segments.add(AudioSegment(
+          start: Duration(milliseconds: at), end: Duration(milliseconds: start), isSilent: true));
+    }
+    segments.add(AudioSegment(
+        start: Duration(milliseconds: start), end: Duration(milliseconds: end), isSilent: false));
+    at = end;
+  }
+  if (at < lengthMs) {
+    segments.add(AudioSegment(
+        start: Duration(milliseconds: at), end: Duration(milliseconds: lengthMs), isSilent: true));
+  }
+  final silent = segments.where((s) => s.isSilent);
+  return SilenceAnalysisResult(
+    segments: segments,
+    totalSilence: silent.fold(Duration.zero, (sum, s) => sum + s.duration),
+    totalSpeech: segments.where((s) => !s.isSilent).fold(Duration.zero, (sum, s) => sum + s.duration),
+    isEntirelySilent: speech.isEmpty,
+    longestSilenceGap: silent.fold(Duration.zero, (m, s) => s.duration > m ? s.duration : m),
+  );
+}
+
+AudioChunk _chunk(int i, String path, BleAudioCodec codec, SilenceAnalysisResult analysis) => AudioChunk(
+      id: 'chunk_$i',
+      startTime: DateTime.fromMillisecondsSinceEpoch((1700000000 + i * 30) * 1000),
+      filePath: path,
+      codec: codec,
+      sampleRate: _kSampleRate,
+      silenceAnalysis: analysis,
+      isComplete: true,
+    );
+
+Conversation _conversation(String id, List<AudioChunk> chunks) => Conversation(
+      id: id,
+      startTime: chunks.first.startTime,
+      endTime: chunks.last.endTime,
+      chunks: chunks,
+    );
+
+/// The bytes of [pcm] that [speech] covers, worked out from the segment
+/// times alone: [bytesPerMs] per millisecond, cut short at the end of
+/// the data.
+List<int> _expectedRanges(Uint8List pcm, int bytesPerMs, List<(int, int)> speech) => [
+      for (final (start, end) in speech)
+        ...pcm.sublist(min(start * bytesPerMs, pcm.length), min(end * bytesPerMs, pcm.length)),
+    ];
+
+void main() {
+  TestWidgetsFlutterBinding.ensureInitialized();
+
+  late Directory dir;
+
+  setUp(() async {
+    dir = await Directory.systemTemp.createTemp('reclo_stitch_test');
+    TestDefaultBinaryMessengerBinding.instance.defaultBinaryMessenger.setMockMethodCallHandler(
+      const MethodChannel('plugins.flutter.io/path_provider'),
+      (call) async => dir.path,
+    );
+  });
+
+  tearDown(() async {
+    TestDefaultBinaryMessengerBinding.instance.defaultBinaryMessenger
+        .setMockMethodCallHandler(const MethodChannel('plugins.flutter.io/path_provider'), null);
+    await dir.delete(recursive: true);
+  });
+
+  test('PCM16: the stitched bytes are the speech ranges, in order', () async {
+    // Cuts at odd milliseconds, ranges bigger than the copy buffer, a chunk
+    // shorter than its analysis, chunks without speech or without a file,
+    // and a file that comes back after another
+    final a = await _writeWav('${dir.path}/a.wav', 1, 10000 * 32, 16);
+    final b = await _writeWav('${dir.path}/b.wav', 2, 30000 * 32, 16);
+    final c = await _writeWav('${dir.path}/c.wav', 3, 2000 * 32, 16);
+    await _writeWav('${dir.path}/quiet.wav', 4, 30000 * 32, 16);
+
+    const aSpeech = [(0, 1234), (5000, 7777), (9001, 10000)];
+    const bSpeech = [(3, 29997)];
+    const cSpeech = [(500, 30000)];
+    const pcm16 = BleAudioCodec.pcm16;
+    final conversation = _conversation('pcm16', [
+      _chunk(0, '${dir.path}/a.wav', pcm16, _analysis(10000, aSpeech)),
+      _chunk(1, '${dir.path}/quiet.wav', pcm16, _analysis(30000, [])),
+      _chunk(2, '${dir.path}/b.wav', pcm16, _analysis(30000, bSpeech)),
+      _chunk(3, '${dir.path}/missing.wav', pcm16, _analysis(30000, [(0, 30000)])),
+      _chunk(4, '${dir.path}/c.wav', pcm16, _analysis(30000, cSpeech)),
+      _chunk(5, '${dir.path}/a.wav', pcm16, _analysis(10000, aSpeech)),
+    ]);
+
+    final result = await AudioStitcher().stitch(conversation: conversation, silenceThresholdDb: -40.0);
+    expect(result.success, isTrue, reason: result.error);
+
+    final expected = [
+      ..._expectedRanges(a, 32, aSpeech),
+      ..._expectedRanges(b, 32, bSpeech),
+      ..._expectedRanges(c, 32, cSpeech),
+      ..._expectedRanges(a, 32, aSpeech),
+    ];
+    final out = await File(result.outputPath!).readAsBytes();
+    final h = ByteData.sublistView(out);
+    expect(out.length, 44 + expected.length);
+    expect(h.getUint32(4, Endian.little), out.length - 8);
+    expect(h.getUint32(40, Endian.little), expected.length);
+    expect(out.sublist(0, 44), buildWavHeader(expected.length, _kSampleRate, channels: 1, bitDepth: 16));
+    expect(out.sublist(44), expected);
+  });
+
+  test('PCM8: one byte per sample, 8-bit header', () async {
+    final a = await _writeWav('${dir.path}/a.wav', 5, 30000 * 16, 8);
+    final b = await _writeWav('${dir.path}/b.wav', 6, 30000 * 16, 8);
+    const aSpeech = [(100, 4100), (20000, 30000)];
+    const bSpeech = [(0, 15001)];
+    final conversation = _conversation('pcm8', [
+      _chunk(0, '${dir.path}/a.wav', BleAudioCodec.pcm8, _analysis(30000, aSpeech)),
+      _chunk(1, '${dir.path}/b.wav', BleAudioCodec.pcm8, _analysis(30000, bSpeech)),
+    ]);
+
+    final result = await AudioStitcher().stitch(conversation: conversation, silenceThresholdDb: -40.0);
+    expect(result.success, isTrue, reason: result.error);
+    expect(result.totalDuration, const Duration(milliseconds: 4000 + 10000 + 15001));
+    expect(result.silenceRemoved, const Duration(milliseconds: 60000 - 29001));
+
+    final expected = [..._expectedRanges(a, 16, aSpeech), ..._expectedRanges(b, 16, bSpeech)];
+    final out = await File(result.outputPath!).readAsBytes();
+    expect(out.sublist(0, 44), buildWavHeader(expected.length, _kSampleRate, channels: 1, bitDepth: 8));
+    expect(out.sublist(44), expected);
+  });
+
+  test('no speech anywhere fails without writing a file', () async {
+    await _writeWav('${dir.path}/quiet.wav', 7, 30000 * 32, 16);
+    final conversation = _conversation('quiet', [
+      _chunk(0, '${dir.path}/quiet.wav', BleAudioCodec.pcm16, _analysis(30000, [])),
+    ]);
+    final result = await AudioStitcher().stitch(conversation: conversation, silenceThresholdDb: -40.0);
+    expect(result.success, isFalse);
+    expect(File('${dir.path}/conversations/conversation_quiet.wav').existsSync(), isFalse);
+  });
+
+  // A 4-hour conversation of 30 s PCM16 chunks, two thirds speech: about
+  // 300 MB of output. Held in memory it would be several times that; the
+  // stitch should not grow the process by more than its copy buffer and
+  // the VM's own slack.
+  test('four hours stitched in bounded memory', () async {
+    const chunks = 4 * 120;
+    const speech = [(0, 10000), (15000, 25000)];
+    await _writeWav('${dir.path}/even.wav', 8, 30000 * 32, 16);
+    await _writeWav('${dir.path}/odd.wav', 9, 30000 * 32, 16);
+    final conversation = _conversation('long', [
+      for (var i = 0; i < chunks; i++)
+        _chunk(i, '${dir.path}/${i.isEven ? 'even' : 'odd'}.wav', BleAudioCodec.pcm16, _analysis(30000, speech)),
+    ]);
+
+    final baseline = ProcessInfo.currentRss;
+    var peak = baseline;
+    final sampler = Timer.periodic(const Duration(milliseconds: 20), (_) {
+      peak = max(peak, ProcessInfo.currentRss);
+    });
+    final watch = Stopwatch()..start();
+    final result = await AudioStitcher().stitch(conversation: conversation, silenceThresholdDb: -40.0);
+    watch.stop();
+    sampler.cancel();
+    peak = max(peak, ProcessInfo.currentRss);
+
+    expect(result.success, isTrue, reason: result.error);
+    expect(result.totalDuration, const Duration(seconds: 20) * chunks);
+    final outBytes = await File(result.outputPath!).length();
+    expect(outBytes, 44 + chunks * 20000 * 32);
+
+    final growth = peak - baseline;
+    debugPrint('AudioStitcher: ${outBytes ~/ (1024 * 1024)} MB stitched in ${watch.elapsedMilliseconds} ms, '
+        'RSS grew by ${(growth / (1024 * 1024)).toStringAsFixed(1)} MB');
+    expect(growth, lessThan(32 * 1024 * 1024));
+  });
+}
@@ -0,0 +1,319 @@
+import 'dart:async';
+import 'dart:io';
+import 'dart:math';
+import 'dart:typed_data';
+
+import 'package:flutter/foundation.dart';
+import 'package:flutter/services.dart';
+import 'package:flutter_test/flutter_test.dart';
+import 'package:opus_dart/opus_dart.dart';
+import 'package:opus_flutter/opus_flutter.dart' as opus_flutter;
+
+import 'package:reclo/services/chunk_processing_pool.dart';
+import 'package:reclo/services/chunk_upload_service.dart';
+import 'package:reclo/services/silence_detection_service.dart';
+import 'package:reclo/utils/audio/ogg_opus.dart';
+
+import 'fake_reclo_device.dart';
+
+// ─── Synthetic chunks ─────────────────────────────────────────────────────────
+
+const int _kFramesPerChunk = 1500; // 30 s of 20 ms frames
+const int _kPacketBytes    = 80;   // 32 kbps
+
+/// A chunk's data as the device stores it: [len(2)][packet] records of
+/// 20 ms packets, with a silence run of [silentFrames] in the middle.
+Uint8List _chunkData(Random rng, {int silentFrames = 0}) {
+  final out = BytesBuilder();
+  final packets = _kFramesPerChunk - silentFrames;
+  for (var i = 0; i < packets; i++) {
+    if (silentFrames > 0 && i == packets ~/ 2) {
+      out.add([0xFF, 0xFF, silentFrames & 0xFF, silentFrames >> 8]);
+    }
+    final packet = Uint8List(_kPacketBytes)..[0] = kOpusSilenceToc;
+    for (var j = 1; j < _kPacketBytes; j++) {
+      packet[j] = rng.nextInt(256);
+    }
+    out.add([_kPacketBytes & 0xFF, _kPacketBytes >> 8]);
+    out.add(packet);
+  }
+  return out.takeBytes();
+}
+
+ChunkJob _job(Directory dir, int i, Uint8List data, {bool withLevels = true}) => ChunkJob(
+      timestamp:          1700000000 + i * 30,
+      sampleRate:         16000,
+      opus:               data,
+      // 0 dBFS throughout: the level-track path, no decoding
+      levels:             withLevels ? Uint8List(_kFramesPerChunk ~/ 5) : null,
+      silenceThresholdDb: -40.0,
+      path:               '${dir.path}/chunk_$i.ogg',
+    );
+
+void main() {
+  TestWidgetsFlutterBinding.ensureInitialized();
+
+  late Directory dir;
+  final rng  = Random(21);
+  final data = _chunkData(rng, silentFrames: 250);
+
+  setUp(() async {
+    dir = await Directory.systemTemp.createTemp('reclo_pool_test');
+    TestDefaultBinaryMessengerBinding.instance.defaultBinaryMessenger.setMockMethodCallHandler(
+      const MethodChannel('plugins.flutter.io/path_provider'),
+      (call) async => dir.path,
+    );
+  });
+
+  tearDown(() async {
+    TestDefaultBinaryMessengerBinding.instance.defaultBinaryMessenger
+        .setMockMethodCallHandler(const MethodChannel('plugins.flutter.io/path_provider'), null);
+    await dir.delete(recursive: true);
+  });
+
+  test('never holds more than maxPending jobs', () async {
+    final pool = ChunkProcessingPool(size: 1, maxPending: 2);
+    await pool.start();
+
+    var peak = 0;
+    final results = <Future<ChunkJobResult>>[];
+    for (var i = 0; i < 8; i++) {
+      results.add(pool.process(_job(dir, i, data)));
+      peak = max(peak, pool.pending);
+    }
+    expect(peak, 2);
+
+    final done = await Future.wait(results);
+    expect(pool.pending, 0);
+    expect([for (final r in done) r.timestamp], [for (var i = 0; i < 8; i++) 1700000000 + i * 30]);
+    for (final r in done) {
+      expect(File(r.path).existsSync(), isTrue);
+      expect(r.analysis.totalSpeech, const Duration(seconds: 30));
+    }
+    await pool.close();
+  });
+
+  test('close fails the jobs still waiting for room', () async {
+    final pool = ChunkProcessingPool(size: 1, maxPending: 1);
+    await pool.start();
+
+    final outcomes = Future.wait([
+      for (var i = 0; i < 4; i++)
+        pool.process(_job(dir, i, data)).then((_) => true, onError: (_) => false),
+    ]);
+    await pool.close();
+    expect((await outcomes).sublist(1), [false, false, false]);
+  });
+
+  // Benchmark harness: an upload's packet stream replayed through
+  // ChunkUploadService, as BLE notifications would arrive, with the pool
+  // saving the chunks. Reports chunks per second and how long the main
+  // isolate went without running a 1 ms timer, i.e. without being able to
+  // draw. Run with `flutter test` on the target to compare pool sizes; set
+  // RECLO_CAPTURE to a file of [len(2)][packet] records to replay a stream
+  // captured from a device instead.
+  test('packet replay, level track', () async {
+    await _replay(dir, data, withLevels: true);
+  });
+
+  test('packet replay, decoded', () async {
+    // Without a decoder the pool would "analyse" the Opus bytes as PCM
+    if (!await _haveOpusDecoder()) {
+      debugPrint('packet replay, decoded: skipped, no Opus decoder on this host');
+      return;
+    }
+    await _replay(dir, data, withLevels: false);
+  });
+
+  // A two-hour backlog, 240 chunks of 30 s, through the pool as an upload
+  // hands them over: each chunk's data is a buffer of its own. Held, the
+  // Opus data alone would be 24 MB and the decoded PCM 230 MB; the pool
+  // should hold only maxPending chunks at once.
+  test('two-hour backlog in bounded memory, level track', () async {
+    await _backlog(dir, data, withLevels: true);
+  });
+
+  test('two-hour backlog in bounded memory, decoded', () async {
+    if (!await _haveOpusDecoder()) {
+      debugPrint('backlog, decoded: skipped, no Opus decoder on this host');
+      return;
+    }
+    await _backlog(dir, data, withLevels: false);
+  });
+
+  // Benchmark: the time to analyse and save one 30 s chunk on this isolate.
+  // "decode + analyze()" is what _finalizeChunk did before the level track:
+  // decode the whole chunk into one PCM buffer, then analyse that.
+  // processChunkJob without levels still decodes, but streams the PCM
+  // through the analysis; with levels it decodes nothing. Both
+  // processChunkJob figures include writing the Ogg file.
+  test('per-chunk time, level track vs decoding', () async {
+    final silence = SilenceDetectionService();
+    final levels  = await _perChunk(() => processChunkJob(_job(dir, 0, data), null, silence));
+
+    if (!await _haveOpusDecoder()) {
+      debugPrint('per chunk: level track ${levels.toStringAsFixed(2)} ms; '
+          'decoding skipped, no Opus decoder on this host');
+      return;
+    }
+    final decoder = SimpleOpusDecoder(sampleRate: 16000, channels: 1);
+    final before  = await _perChunk(() => _decodeThenAnalyze(data, decoder, silence));
+    final decoded = await _perChunk(
+        () => processChunkJob(_job(dir, 0, data, withLevels: false), decoder, silence));
+
+    // Streaming the PCM through the analysis finds what the whole buffer did
+    final whole    = await _decodeThenAnalyze(data, decoder, silence);
+    final streamed = await processChunkJob(_job(dir, 0, data, withLevels: false), decoder, silence);
+    decoder.destroy();
+    expect(streamed.analysis.totalSpeech, whole.totalSpeech);
+    expect(streamed.analysis.segments.length, whole.segments.length);
+
+    expect(levels, lessThan(before));
+    expect(levels, lessThan(decoded));
+    debugPrint('per chunk (30 s): level track ${levels.toStringAsFixed(2)} ms, '
+        'decode + analyze() ${before.toStringAsFixed(2)} ms, '
+        'processChunkJob decoding ${decoded.toStringAsFixed(2)} ms');
+  });
+}
+
+// ─── Backlog ──────────────────────────────────────────────────────────────────
+
+const int _kBacklogChunks = 2 * 3600 ~/ 30;
+
+/// Process [_kBacklogChunks] copies of [data] on a pool of two workers and
+/// check that the process RSS, sampled every few chunks, grows by less
+/// than 16 MB over what it was with the workers started.
+Future<void> _backlog(Directory dir, Uint8List data, {required bool withLevels}) async {
+  final pool = ChunkProcessingPool(size: 2, maxPending: 4);
+  await pool.start();
+
+  final baseline = ProcessInfo.currentRss;
+  var peak = baseline;
+  final results = <Future<ChunkJobResult>>[];
+  for (var i = 0; i < _kBacklogChunks; i++) {
+    final job = _job(dir, i, Uint8List.fromList(data), withLevels: withLevels);
+    results.add(pool.process(job).then((r) async {
+      await File(r.path).delete();
+      return r;
+    }));
+    if (i % 8 == 0) peak = max(peak, ProcessInfo.currentRss);
+    // Let the pool take the job, as BLE packets arriving would
+    while (pool.pending >= pool.maxPending) {
+      await Future<void>.delayed(const Duration(milliseconds: 1));
+      peak = max(peak, ProcessInfo.currentRss);
+    }
+  }
+  final done = await Future.wait(results);
+  peak = max(peak, ProcessInfo.currentRss);
+  await pool.close();
+
+  expect([for (final r in done) r.timestamp], [for (var i = 0; i < _kBacklogChunks; i++) 1700000000 + i * 30]);
+  final growth = peak - baseline;
+  debugPrint('backlog, ${withLevels ? 'level track' : 'decoded'}: $_kBacklogChunks chunks, '
+      '${(_kBacklogChunks * data.length / 1048576).toStringAsFixed(1)} MB of Opus, '
+      'RSS grew by ${(growth / 1048576).toStringAsFixed(1)} MB');
+  expect(growth, lessThan(16 * 1024 * 1024));
+}
+
+// ─── Per-chunk benchmark ──────────────────────────────────────────────────────
+
+const int _kBenchRuns = 20;
+
+/// Mean milliseconds per call of [run], after two warm-up calls.
+Future<double> _perChunk(Future<Object?> Function() run) async {
+  await run();
+  await run();
+  final watch = Stopwatch()..start();
+  for (var i = 0; i < _kBenchRuns; i++) {
+    await run();
+  }
+  return watch.elapsedMicroseconds / 1000 / _kBenchRuns;
+}
+
+/// The analysis as _finalizeChunk did it: the whole chunk decoded into one
+/// buffer, then [SilenceDetectionService.analyze].
+Future<SilenceAnalysisResult> _decodeThenAnalyze(
+  Uint8List data,
+  SimpleOpusDecoder decoder,
+  SilenceDetectionService silence,
+) async {
+  final pcm = BytesBuilder();
+  await decodeOpusFrames(data, decoder, (frame) async => pcm.add(frame));
+  return silence.analyze(
+    pcmBytes:           pcm.takeBytes(),
+    format:             PcmFormat.pcm16bit,
+    silenceThresholdDb: -40.0,
+  );
+}
+
+// ─── Replay harness ───────────────────────────────────────────────────────────
+
+const int _kReplayChunks = 64;
+
+Future<bool> _haveOpusDecoder() async {
+  try {
+    initOpus(await opus_flutter.load());
+    return true;
+  } catch (_) {
+    return false;
+  }
+}
+
+/// Run an upload of [_kReplayChunks] copies of [data] from [FakeRecloDevice]
+/// and keep the packets the phone received.
+Future<List<Uint8List>> _record(Directory dir, Uint8List data, {required bool withLevels}) async {
+  final device = FakeRecloDevice()..recording = [];
+  for (var i = 0; i < _kReplayChunks; i++) {
+    device.store(1700000000 + i * 30, data,
+        levels: withLevels ? Uint8List(_kFramesPerChunk ~/ 5) : null);
+  }
+  await _upload(device);
+  await Directory('${dir.path}/audio_chunks').delete(recursive: true);
+  return device.recording!;
+}
+
+Future<UploadProgress> _upload(FakeRecloDevice device) async {
+  final service = ChunkUploadService(transport: device);
+  final complete = service.progress.firstWhere((p) => p.isComplete);
+  await service.start();
+  final progress = await complete.timeout(const Duration(minutes: 5));
+  await service.dispose();
+  await device.dispose();
+  return progress;
+}
+
+Future<void> _replay(Directory dir, Uint8List data, {required bool withLevels}) async {
+  final capturePath = Platform.environment['RECLO_CAPTURE'];
+  final capture = capturePath != null
+      ? await readCapture(capturePath)
+      : await _record(dir, data, withLevels: withLevels);
+  final device = FakeRecloDevice.replay(capture);
+
+  // Gaps between ticks of a 1 ms timer on this isolate
+  final ticks = Stopwatch()..start();
+  var last = Duration.zero;
+  var worst = Duration.zero;
+  var over16ms = 0;
+  final timer = Timer.periodic(const Duration(milliseconds: 1), (_) {
+    final now = ticks.elapsed;
+    final gap = now - last;
+    last = now;
+    if (gap > worst) worst = gap;
+    if (gap > const Duration(milliseconds: 16)) over16ms++;
+  });
+
+  final watch = Stopwatch()..start();
+  final progress = await _upload(device);
+  watch.stop();
+  timer.cancel();
+
+  expect(progress.error, isNull);
+  if (capturePath == null) expect(progress.chunksReceived, _kReplayChunks);
+
+  final ms = max(1, watch.elapsedMilliseconds);
+  debugPrint('packet replay, ${withLevels ? 'level track' : 'decoded'}: '
+      '${capture.length} packets, ${progress.chunksReceived} chunks in $ms ms, '
+      '${(progress.chunksReceived * 1000 / ms).toStringAsFixed(1)} chunks/s; '
+      'main isolate stalled at most ${worst.inMilliseconds} ms, '
+      '$over16ms stall(s) over 16 ms');
+}
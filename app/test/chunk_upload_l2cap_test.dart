@@ -0,0 +1,87 @@
+import 'dart:async';
+import 'dart:io';
+import 'dart:math';
+import 'dart:typed_data';
+
+import 'package:flutter/services.dart';
+import 'package:flutter_test/flutter_test.dart';
+
+import 'package:reclo/services/chunk_upload_service.dart';
+import 'package:reclo/utils/audio/ogg_opus.dart';
+
+import 'fake_reclo_device.dart';
+
+const int _kChunks  = 4;
+const int _kFirstTs = 1700000000;
+const int _kPsm     = 0x00C5;
+
+/// [frames] 80-byte Opus packets as [len(2)][packet] records.
+Uint8List _chunkData(Random rng, int frames) {
+  final out = BytesBuilder();
+  for (var i = 0; i < frames; i++) {
+    final packet = Uint8List(80)..[0] = kOpusSilenceToc;
+    for (var j = 1; j < packet.length; j++) {
+      packet[j] = rng.nextInt(256);
+    }
+    out.add([packet.length, 0]);
+    out.add(packet);
+  }
+  return out.takeBytes();
+}
+
+/// Upload [_kChunks] chunks from [device]; every chunk must be saved and
+/// ACKed whichever way its packets came.
+Future<void> _upload(Directory dir, FakeRecloDevice device) async {
+  final rng = Random(5);
+  for (var i = 0; i < _kChunks; i++) {
+    device.store(_kFirstTs + i * 30, _chunkData(rng, 500), levels: Uint8List(100));
+  }
+
+  final service = ChunkUploadService(transport: device);
+  final complete = service.progress.firstWhere((p) => p.isComplete);
+  await service.start();
+  final progress = await complete.timeout(const Duration(seconds: 30));
+  await service.dispose();
+  await device.dispose();
+
+  expect(progress.error, isNull);
+  expect(progress.chunksReceived, _kChunks);
+  expect(device.chunks, isEmpty);
+  for (var i = 0; i < _kChunks; i++) {
+    expect(File('${dir.path}/audio_chunks/chunk_${_kFirstTs + i * 30}.opus').existsSync(), isTrue);
+  }
+}
+
+void main() {
+  TestWidgetsFlutterBinding.ensureInitialized();
+
+  late Directory dir;
+
+  setUp(() async {
+    dir = await Directory.systemTemp.createTemp('reclo_l2cap_test');
+    TestDefaultBinaryMessengerBinding.instance.defaultBinaryMessenger.setMockMethodCallHandler(
+      const MethodChannel('plugins.flutter.io/path_provider'),
+      (call) async => dir.path,
+    );
+  });
+
+  tearDown(() async {
+    TestDefaultBinaryMessengerBinding.instance.defaultBinaryMessenger
+        .setMockMethodCallHandler(const MethodChannel('plugins.flutter.io/path_provider'), null);
+    await dir.delete(recursive: true);
+  });
+
+  test('a published PSM moves the batch onto the bulk channel', () async {
+    final device = FakeRecloDevice(psm: _kPsm);
+    await _upload(dir, device);
+    // Headers, DATA and every batch's UPLOAD_DONE, the empty last one too
+    expect(device.sdusSent, device.packetsSent);
+  });
+
+  test('without a PSM the upload stays on notifications', () async {
+    final device = FakeRecloDevice();
+    await _upload(dir, device);
+    expect(device.sdusSent, 0);
+    expect(device.packetsSent, greaterThan(0));
+  });
+}
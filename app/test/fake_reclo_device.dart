@@ -0,0 +1,410 @@
+import 'dart:async';
+import 'dart:collection';
+import 'dart:io';
+import 'dart:typed_data';
+
+import 'package:reclo/services/chunk_upload_service.dart';
+import 'package:reclo/services/devices/device_connection.dart';
+
+// ─── Firmware protocol (see reclo_transfer.h) ─────────────────────────────────
+
+const int _kPktChunkHeader   = 0x01;
+const int _kPktChunkData     = 0x02;
+const int _kPktUploadDone    = 0x03;
+const int _kPktChunkHeaderV2 = 0x11;
+const int _kPktChunkDataV2   = 0x12;
+const int _kPktChunkLevelsV2 = 0x13;
+
+const int _kCmdRequestUpload = 0x01;
+const int _kCmdAckChunk      = 0x02;
+const int _kCmdAbort         = 0x03;
+const int _kCmdNackChunk     = 0x04;
+const int _kCmdAckUpto       = 0x05;
+
+const int _kV1PacketSize   = 244;
+const int _kV1PayloadSize  = 229;
+const int _kV2HeaderSize   = 32;
+const int _kV2DataHdrSize  = 4;
+const int _kV2MaxPacket    = 495;
+const int _kL2capSdu       = 1974; // RECLO_L2CAP_SDU_MAX fitted to MPS 247
+const int _kCodecOpus      = 21;
+const int _kSampleRate     = 16000;
+
+/// A chunk as the fake device stores it.
+class FakeChunk {
+  final int timestamp;
+  final Uint8List data;    // [len(2)][packet] records
+  final Uint8List levels;  // one byte per 100 ms window; empty for none
+
+  FakeChunk(this.timestamp, this.data, this.levels);
+}
+
+// ─── FakeRecloDevice ──────────────────────────────────────────────────────────
+
+/// The RecLo firmware's side of the upload, behind a [DeviceTransport], so
+/// tests drive [ChunkUploadService] through its real packet path.
+///
+/// REQUEST_UPLOAD sends up to the requested number of stored chunks, framed
+/// as v2 packets of [mtu] (or v1 when the phone asks for v1 or [v2] is
+/// off), then UPLOAD_DONE. With a [psm], a phone that opened the bulk
+/// channel gets a v2 batch over it instead, one packet per SDU. NACK_CHUNK
+/// is answered by resending the missing seqs between chunks, or after
+/// UPLOAD_DONE. ACK_UPTO and ACK_CHUNK delete chunks, so once everything
+/// is saved the next request gets an empty batch.
+///
+/// [FakeRecloDevice.replay] plays back a recorded stream instead: each
+/// REQUEST_UPLOAD gets the recorded packets up to and including the next
+/// UPLOAD_DONE, whatever the phone writes in between.
+///
+/// Every notification is its own event, one per turn of the event loop, as
+/// the BLE plugin delivers them.
+class FakeRecloDevice implements DeviceTransport {
+  final int mtu;
+  final bool v2;
+  final int psm;   // published bulk channel PSM; 0 for none
+
+  /// Lose DATA packet [seq] of the chunk with timestamp [ts] in the air.
+  bool Function(int ts, int seq)? lose;
+
+  /// Every notification that reached the phone, in order, when set.
+  List<Uint8List>? recording;
+
+  final SplayTreeMap<int, FakeChunk> chunks = SplayTreeMap();
+
+  int packetsSent = 0;   // notifications and SDUs
+  int sdusSent    = 0;
+  int packetsLost = 0;
+  int nacks       = 0;
+  int batches     = 0;
+
+  final List<Uint8List>? _capture;
+  int _captureAt = 0;
+
+  FakeRecloDevice({this.mtu = 247, this.v2 = true, this.psm = 0, this.lose}) : _capture = null;
+
+  FakeRecloDevice.replay(List<Uint8List> capture)
+      : mtu = 247,
+        v2 = true,
+        psm = 0,
+        _capture = capture;
+
+  final _data = StreamController<List<int>>.broadcast();
+  final _state = StreamController<DeviceTransportState>.broadcast();
+
+  // Work for the send loop: a requested batch, and NACKed seqs to resend
+  ({int proto, int maxChunks})? _request;
+  final Queue<(int, List<int>)> _resends = Queue();
+  bool _busy = false;
+  bool _aborted = false;
+
+  // Chunks of the last batch by timestamp, with their index in it; only
+  // these are deleted by ACKs
+  final Map<int, int> _batchIdx = {};
+  int _batchTotal = 0;
+  bool _batchV2 = true;
+  bool _batchL2cap = false;
+
+  StreamController<Uint8List>? _channel;
+
+  void store(int timestamp, Uint8List data, {Uint8List? levels}) {
+    chunks[timestamp] = FakeChunk(timestamp, data, levels ?? Uint8List(0));
+  }
+
+  int get _v2Payload =>
+      (_batchL2cap ? _kL2capSdu : (mtu - 3).clamp(0, _kV2MaxPacket)) - _kV2DataHdrSize;
+
+  // ─── DeviceTransport ──────────────────────────────────────────────────────
+
+  @override
+  String get deviceId => 'fake-reclo';
+
+  @override
+  Future<void> connect() async => _state.add(DeviceTransportState.connected);
+
+  @override
+  Future<void> disconnect() async => _state.add(DeviceTransportState.disconnected);
+
+  @override
+  Future<bool> isConnected() async => true;
+
+  @override
+  Future<bool> ping() async => true;
+
+  @override
+  Stream<List<int>> getCharacteristicStream(String serviceUuid, String characteristicUuid) =>
+      characteristicUuid == recloDataCharUuid ? _data.stream : const Stream.empty();
+
+  @override
+  Future<List<int>> readCharacteristic(String serviceUuid, String characteristicUuid) async =>
+      characteristicUuid == recloPsmCharUuid ? [psm & 0xFF, psm >> 8] : [];
+
+  @override
+  Future<L2capChannel?> openL2capChannel(int psm) async {
+    if (this.psm == 0 || psm != this.psm) return null;
+    final channel = StreamController<Uint8List>();
+    _channel = channel;
+    return _FakeL2capChannel(channel, () => _channel = null);
+  }
+
+  @override
+  Stream<DeviceTransportState> get connectionStateStream => _state.stream;
+
+  @override
+  Future<void> dispose() async {
+    _aborted = true;
+    await _channel?.close();
+    await _data.close();
+    await _state.close();
+  }
+
+  @override
+  Future<void> writeCharacteristic(String serviceUuid, String characteristicUuid, List<int> data) async {
+    if (characteristicUuid != recloControlCharUuid || data.isEmpty) return;
+    final cmd = Uint8List.fromList(data);
+    final v = ByteData.sublistView(cmd);
+
+    switch (cmd[0]) {
+      case _kCmdRequestUpload:
+        final proto = cmd.length >= 2 ? cmd[1] : 1;
+        final maxChunks = cmd.length >= 4 ? v.getUint16(2, Endian.little) : 0;
+        _aborted = false;
+        _request = (proto: proto, maxChunks: maxChunks == 0 ? chunks.length : maxChunks);
+        _kick();
+      case _kCmdAbort:
+        _aborted = true;
+        _resends.clear();
+      case _kCmdNackChunk:
+        if (cmd.length < 10) return;
+        final ts = v.getUint32(1, Endian.little);
+        final first = v.getUint16(7, Endian.little);
+        nacks++;
+        _resends.add((ts, [
+          for (var bit = 0; bit < (cmd.length - 9) * 8; bit++)
+            if ((cmd[9 + (bit >> 3)] & (1 << (bit & 7))) != 0) first + bit,
+        ]));
+        _kick();
+      case _kCmdAckChunk:
+        if (cmd.length >= 5) chunks.remove(v.getUint32(1, Endian.little));
+      case _kCmdAckUpto:
+        if (cmd.length < 5) return;
+        final upto = v.getUint32(1, Endian.little);
+        if (upto != 0) _delete(0, upto);
+        for (var at = 5; at + 8 <= cmd.length; at += 8) {
+          _delete(v.getUint32(at, Endian.little), v.getUint32(at + 4, Endian.little));
+        }
+    }
+  }
+
+  void _delete(int first, int last) {
+    for (final ts in _batchIdx.keys.where((ts) => ts >= first && ts <= last).toList()) {
+      chunks.remove(ts);
+      _batchIdx.remove(ts);
+    }
+  }
+
+  // ─── Sending ──────────────────────────────────────────────────────────────
+
+  void _kick() {
+    if (_busy) return;
+    _busy = true;
+    _run();
+  }
+
+  Future<void> _run() async {
+    try {
+      while (!_data.isClosed) {
+        if (_resends.isNotEmpty) {
+          await _serveResends();
+          continue;
+        }
+        final request = _request;
+        if (request == null) break;
+        _request = null;
+        await _sendBatch(request.proto, request.maxChunks);
+      }
+    } finally {
+      _busy = false;
+    }
+  }
+
+  Future<void> _sendBatch(int proto, int maxChunks) async {
+    batches++;
+    final capture = _capture;
+    if (capture != null) {
+      while (_captureAt < capture.length && !_aborted) {
+        final packet = capture[_captureAt++];
+        await _notify(packet);
+        if (packet[0] == _kPktUploadDone) break;
+      }
+      return;
+    }
+
+    _batchV2 = v2 && proto >= 2;
+    _batchL2cap = _batchV2 && _channel != null;
+    final batch = chunks.values.take(maxChunks).toList();
+    _batchTotal = batch.length;
+    _batchIdx
+      ..clear()
+      ..addEntries([for (var i = 0; i < batch.length; i++) MapEntry(batch[i].timestamp, i)]);
+
+    for (var i = 0; i < batch.length && !_aborted; i++) {
+      await _sendChunk(batch[i], i, batch.length);
+      await _serveResends();
+    }
+    if (!_aborted) await _notify(Uint8List.fromList([_kPktUploadDone]));
+  }
+
+  Future<void> _serveResends() async {
+    while (_resends.isNotEmpty && !_aborted) {
+      final (ts, seqs) = _resends.removeFirst();
+      final chunk = chunks[ts];
+      final idx = _batchIdx[ts];
+      if (chunk == null || idx == null) continue;
+      for (final seq in seqs) {
+        await _sendData(chunk, idx, _batchTotal, seq);
+      }
+    }
+  }
+
+  int _payload() => _batchV2 ? _v2Payload : _kV1PayloadSize;
+
+  int _totalSeqs(FakeChunk chunk) => 1 + (chunk.data.length + _payload() - 1) ~/ _payload();
+
+  Future<void> _sendChunk(FakeChunk chunk, int idx, int total) async {
+    final meta = ByteData(17)
+      ..setUint32(0, chunk.data.length, Endian.little)
+      ..setUint8(4, _kCodecOpus)
+      ..setUint32(5, _kSampleRate, Endian.little)
+      ..setUint32(9, _crc32(chunk.data), Endian.little)
+      ..setUint8(13, 5)                    // complexity
+      ..setUint16(15, 32, Endian.little);  // bitrate_kbps
+
+    if (_batchV2) {
+      final h = ByteData(_kV2HeaderSize)
+        ..setUint8(0, _kPktChunkHeaderV2)
+        ..setUint32(1, chunk.timestamp, Endian.little)
+        ..setUint16(5, idx, Endian.little)
+        ..setUint16(7, total, Endian.little)
+        ..setUint16(9, _totalSeqs(chunk), Endian.little)
+        ..setUint16(11, _v2Payload, Endian.little)
+        ..setUint16(30, chunk.levels.length, Endian.little);
+      final header = h.buffer.asUint8List()..setRange(13, 30, meta.buffer.asUint8List());
+      await _notify(header);
+
+      for (var first = 0; first < chunk.levels.length; first += _v2Payload) {
+        final end = (first + _v2Payload).clamp(0, chunk.levels.length);
+        final packet = Uint8List(_kV2DataHdrSize + end - first)
+          ..[0] = _kPktChunkLevelsV2
+          ..[1] = idx & 0xFF
+          ..[2] = first & 0xFF
+          ..[3] = first >> 8
+          ..setRange(_kV2DataHdrSize, _kV2DataHdrSize + end - first, chunk.levels, first);
+        await _notify(packet);
+      }
+    } else {
+      final h = _v1Packet(_kPktChunkHeader, chunk, idx, total, 0, 17);
+      h.buffer.asUint8List().setRange(15, 32, meta.buffer.asUint8List());
+      await _notify(h.buffer.asUint8List());
+    }
+
+    for (var seq = 1; seq < _totalSeqs(chunk) && !_aborted; seq++) {
+      await _sendData(chunk, idx, total, seq);
+    }
+  }
+
+  Future<void> _sendData(FakeChunk chunk, int idx, int total, int seq) async {
+    final payload = _payload();
+    final offset = (seq - 1) * payload;
+    if (seq <= 0 || offset >= chunk.data.length) return;
+    final n = (chunk.data.length - offset).clamp(0, payload);
+    final bytes = Uint8List.sublistView(chunk.data, offset, offset + n);
+
+    final Uint8List packet;
+    if (_batchV2) {
+      packet = Uint8List(_kV2DataHdrSize + n)
+        ..[0] = _kPktChunkDataV2
+        ..[1] = idx & 0xFF
+        ..[2] = seq & 0xFF
+        ..[3] = seq >> 8
+        ..setRange(_kV2DataHdrSize, _kV2DataHdrSize + n, bytes);
+    } else {
+      packet = _v1Packet(_kPktChunkData, chunk, idx, total, seq, n).buffer.asUint8List()
+        ..setRange(15, 15 + n, bytes);
+    }
+
+    if (lose?.call(chunk.timestamp, seq) ?? false) {
+      packetsSent++;
+      packetsLost++;
+      await Future<void>.delayed(Duration.zero);
+      return;
+    }
+    await _notify(packet);
+  }
+
+  ByteData _v1Packet(int type, FakeChunk chunk, int idx, int total, int seq, int payloadLen) =>
+      ByteData(_kV1PacketSize)
+        ..setUint8(0, type)
+        ..setUint32(1, chunk.timestamp, Endian.little)
+        ..setUint16(5, idx, Endian.little)
+        ..setUint16(7, total, Endian.little)
+        ..setUint16(9, seq, Endian.little)
+        ..setUint16(11, _totalSeqs(chunk), Endian.little)
+        ..setUint16(13, payloadLen, Endian.little);
+
+  Future<void> _notify(Uint8List packet) async {
+    if (_data.isClosed) return;
+    packetsSent++;
+    recording?.add(packet);
+    final channel = _channel;
+    if (_batchL2cap && channel != null) {
+      sdusSent++;
+      channel.add(packet);
+    } else {
+      _data.add(packet);
+    }
+    await Future<void>.delayed(Duration.zero);
+  }
+}
+
+/// CRC-32 (IEEE), as crc32_ieee() on the device.
+int _crc32(Uint8List data) {
+  var crc = 0xFFFFFFFF;
+  for (final b in data) {
+    crc ^= b;
+    for (var i = 0; i < 8; i++) {
+      crc = (crc & 1) != 0 ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+    }
+  }
+  return crc ^ 0xFFFFFFFF;
+}
+
+class _FakeL2capChannel implements L2capChannel {
+  final StreamController<Uint8List> _sdus;
+  final void Function() _onClose;
+
+  _FakeL2capChannel(this._sdus, this._onClose);
+
+  @override
+  Stream<Uint8List> get sdus => _sdus.stream;
+
+  @override
+  Future<void> close() async {
+    _onClose();
+    await _sdus.close();
+  }
+}
+
+/// A packet stream saved as [len(2)][packet] records, e.g. captured from a
+/// real device, for [FakeRecloDevice.replay].
+Future<List<Uint8List>> readCapture(String path) async {
+  final bytes = await File(path).readAsBytes();
+  final packets = <Uint8List>[];
+  for (var at = 0; at + 2 <= bytes.length;) {
+    final len = bytes[at] | (bytes[at + 1] << 8);
+    at += 2;
+    if (len == 0 || at + len > bytes.length) break;
+    packets.add(Uint8List.sublistView(bytes, at, at + len));
+    at += len;
+  }
+  return packets;
+}
@@ -0,0 +1,363 @@
+import 'dart:io';
+import 'dart:math';
+import 'dart:typed_data';
+
+import 'package:flutter/foundation.dart';
+import 'package:flutter/services.dart';
+import 'package:flutter_test/flutter_test.dart';
+
+import 'package:reclo/backend/schema/bt_device/bt_device.dart';
+import 'package:reclo/services/audio_chunk_manager.dart';
+import 'package:reclo/services/audio_stitcher.dart';
+import 'package:reclo/services/silence_detection_service.dart';
+import 'package:reclo/utils/audio/ogg_opus.dart';
+import 'package:reclo/utils/audio/wav_file_writer.dart';
+
+// ─── Reading pages back ───────────────────────────────────────────────────────
+
+class _Page {
+  final int flags;
+  final int granule;
+  final int serial;
+  final int sequence;
+  final int crc;
+  final List<int> lacing;
+  final Uint8List body;
+  final Uint8List raw;
+
+  _Page(this.flags, this.granule, this.serial, this.sequence, this.crc, this.lacing, this.body, this.raw);
+}
+
+/// Split a whole Ogg file into its pages, checking only the framing.
+List<_Page> _pages(Uint8List file) {
+  final pages = <_Page>[];
+  var at = 0;
+  while (at < file.length) {
+    expect(String.fromCharCodes(file, at, at + 4), 'OggS', reason: 'page ${pages.length} at byte $at');
+    expect(file[at + 4], 0, reason: 'stream structure version');
+    final h = ByteData.sublistView(file, at);
+    final lacing = file.sublist(at + 27, at + 27 + file[at + 26]);
+    final bodyAt = at + 27 + lacing.length;
+    final end = bodyAt + lacing.fold<int>(0, (sum, n) => sum + n);
+    pages.add(_Page(
+      h.getUint8(5),
+      h.getInt64(6, Endian.little),
+      h.getUint32(14, Endian.little),
+      h.getUint32(18, Endian.little),
+      h.getUint32(22, Endian.little),
+      lacing,
+      file.sublist(bodyAt, end),
+      file.sublist(at, end),
+    ));
+    at = end;
+  }
+  return pages;
+}
+
+/// Ogg's CRC-32 a bit at a time, to check the writer's table-driven one.
+int _referenceCrc(List<int> data) {
+  var crc = 0;
+  for (final b in data) {
+    crc ^= b << 24;
+    for (var i = 0; i < 8; i++) {
+      crc = (crc & 0x80000000) != 0 ? ((crc << 1) ^ 0x04C11DB7) & 0xFFFFFFFF : (crc << 1) & 0xFFFFFFFF;
+    }
+  }
+  return crc;
+}
+
+// ─── Test stream ──────────────────────────────────────────────────────────────
+
+const int _kStartTime = 1700000000;
+
+/// A packet of [length] bytes with [toc] and random contents.
+Uint8List _packet(Random rng, int toc, int length) {
+  final p = Uint8List(length)..[0] = toc;
+  for (var i = 1; i < length; i++) {
+    p[i] = rng.nextInt(256);
+  }
+  return p;
+}
+
+/// Writes a stream to [path] through [OggOpusWriter] and records the
+/// packets it should read back as, with their durations worked out by hand.
+class _Stream {
+  final OggOpusWriter writer;
+  final List<Uint8List> packets = [];
+  final List<int> samples = [];
+
+  _Stream(this.writer);
+
+  Future<void> add(Uint8List packet, int samples48k) async {
+    await writer.add(packet);
+    packets.add(packet);
+    samples.add(samples48k);
+  }
+
+  /// [frames] frames of [frameSamples] each, [perPacket] to a packet
+  Future<void> silence(int frames, int toc, int frameSamples, int perPacket) async {
+    await writer.addSilence(frames, toc: toc);
+    for (; frames > 0; frames -= perPacket) {
+      final n = min(frames, perPacket);
+      packets.add(Uint8List.fromList(n == 1 ? [toc & 0xFC] : [(toc & 0xFC) | 3, n]));
+      samples.add(n * frameSamples);
+    }
+  }
+}
+
+Future<_Stream> _writeStream(String path, Random rng) async {
+  final s = _Stream(await OggOpusWriter.create(
+    path,
+    inputSampleRate: 16000,
+    tags: {kOggOpusStartTag: '$_kStartTime', 'note': 'a=b'},
+  ));
+
+  for (var i = 0; i < 3; i++) {
+    await s.add(_packet(rng, kOpusSilenceToc, 80), 960);
+  }
+  await s.silence(1, kOpusSilenceToc, 960, 6);
+
+  // Either side of the 255-byte lacing boundary, and multiples of it
+  for (final len in [254, 255, 256, 510, 765]) {
+    await s.add(_packet(rng, kOpusSilenceToc, len), 960);
+  }
+  await s.silence(7, kOpusSilenceToc, 960, 6);
+
+  // Code 3 with three 20 ms frames, and a 10 ms CELT frame
+  await s.add(_packet(rng, kOpusSilenceToc | 3, 120)..[1] = 3, 3 * 960);
+  await s.add(_packet(rng, 30 << 3, 60), 480);
+
+  // Enough one-byte packets to fill a page's 255 lacing values
+  for (var i = 0; i < 300; i++) {
+    await s.add(opusSilencePacket(kOpusSilenceToc, 1), 960);
+  }
+
+  // Enough bytes to fill several pages, then one packet too big for a page
+  for (var i = 0; i < 200; i++) {
+    await s.add(_packet(rng, kOpusSilenceToc, 80), 960);
+  }
+  await s.add(_packet(rng, kOpusSilenceToc, 4100), 960);
+
+  // 2.5 ms CELT frames: 48 to a 120 ms packet
+  await s.silence(100, 16 << 3, 120, 48);
+  await s.add(_packet(rng, kOpusSilenceToc, 80), 960);
+
+  await s.writer.close();
+  return s;
+}
+
+// ─── Stitch benchmark ─────────────────────────────────────────────────────────
+
+const int _kBenchChunks = 60; // half an hour of 30 s chunks
+
+/// Speech for the first and last 10 s of each chunk, silence in between.
+SilenceAnalysisResult _chunkAnalysis() => SilenceAnalysisResult(
+      segments: [
+        AudioSegment(start: Duration.zero, end: const Duration(seconds: 10), isSilent: false),
+        AudioSegment(start: const Duration(seconds: 10), end: const Duration(seconds: 20), isSilent: true),
+        AudioSegment(start: const Duration(seconds: 20), end: const Duration(seconds: 30), isSilent: false),
+      ],
+      totalSilence: const Duration(seconds: 10),
+      totalSpeech: const Duration(seconds: 20),
+      isEntirelySilent: false,
+      longestSilenceGap: const Duration(seconds: 10),
+    );
+
+/// A chunk as received: 32 kbps Opus with the silent middle as silence packets.
+Future<void> _writeOggChunk(String path, Random rng, int ts) async {
+  final w = await OggOpusWriter.create(path, inputSampleRate: 16000, tags: {kOggOpusStartTag: '$ts'});
+  for (var i = 0; i < 500; i++) {
+    await w.add(_packet(rng, kOpusSilenceToc, 80));
+  }
+  await w.addSilence(500);
+  for (var i = 0; i < 500; i++) {
+    await w.add(_packet(rng, kOpusSilenceToc, 80));
+  }
+  await w.close();
+}
+
+/// The same chunk as the WAV the app used to keep: 16 kHz PCM16.
+Future<void> _writeWavChunk(String path, Uint8List block) async {
+  final w = await WavFileWriter.open(path, 16000);
+  for (var i = 0; i < 30 * 32000 ~/ block.length; i++) {
+    await w.add(block);
+  }
+  await w.close();
+}
+
+void main() {
+  TestWidgetsFlutterBinding.ensureInitialized();
+
+  late Directory dir;
+
+  setUp(() async {
+    dir = await Directory.systemTemp.createTemp('reclo_ogg_test');
+    TestDefaultBinaryMessengerBinding.instance.defaultBinaryMessenger.setMockMethodCallHandler(
+      const MethodChannel('plugins.flutter.io/path_provider'),
+      (call) async => dir.path,
+    );
+  });
+
+  tearDown(() async {
+    TestDefaultBinaryMessengerBinding.instance.defaultBinaryMessenger
+        .setMockMethodCallHandler(const MethodChannel('plugins.flutter.io/path_provider'), null);
+    await dir.delete(recursive: true);
+  });
+
+  test('reference CRC matches the Ogg check value', () {
+    expect(_referenceCrc('123456789'.codeUnits), 0x89A1897F);
+  });
+
+  test('pages: framing, lacing, granule positions and CRC', () async {
+    final path = '${dir.path}/stream.opus';
+    final s = await _writeStream(path, Random(24));
+    final pages = _pages(await File(path).readAsBytes());
+
+    expect(s.writer.granule, s.samples.fold<int>(0, (sum, n) => sum + n));
+    expect(pages.length, greaterThan(5));
+
+    final packets = <Uint8List>[];
+    var granule = 0;
+    for (var i = 0; i < pages.length; i++) {
+      final p = pages[i];
+      expect(p.flags, i == 0 ? 0x02 : i == pages.length - 1 ? 0x04 : 0, reason: 'page $i flags');
+      expect(p.serial, pages.first.serial);
+      expect(p.sequence, i);
+
+      final zeroed = Uint8List.fromList(p.raw)..fillRange(22, 26, 0);
+      expect(p.crc, _referenceCrc(zeroed), reason: 'page $i CRC');
+
+      expect(p.lacing.length, lessThanOrEqualTo(255));
+      // Packets never continue onto the next page
+      expect(p.lacing.last, lessThan(255), reason: 'page $i');
+
+      final onPage = <Uint8List>[];
+      var at = 0;
+      var start = 0;
+      for (final lace in p.lacing) {
+        at += lace;
+        if (lace < 255) {
+          onPage.add(p.body.sublist(start, at));
+          start = at;
+        }
+      }
+      expect(p.body.length <= 4096 || onPage.length == 1, isTrue, reason: 'page $i body ${p.body.length}');
+
+      if (i < 2) {
+        // OpusHead, then OpusTags, each alone at granule 0
+        expect(onPage.length, 1);
+        expect(String.fromCharCodes(onPage.single, 0, 8), i == 0 ? 'OpusHead' : 'OpusTags');
+        expect(p.granule, 0);
+        continue;
+      }
+      for (final packet in onPage) {
+        granule += s.samples[packets.length];
+        packets.add(packet);
+      }
+      expect(p.granule, granule, reason: 'page $i granule');
+    }
+
+    expect(packets, s.packets);
+    expect(pages.any((p) => p.lacing.length == 255), isTrue);
+    expect(pages.any((p) => p.body.length > 4096), isTrue);
+  });
+
+  test('reader returns the packets, headers and tags written', () async {
+    final path = '${dir.path}/stream.opus';
+    final s = await _writeStream(path, Random(25));
+
+    final reader = await OggOpusReader.open(path);
+    final packets = <Uint8List>[];
+    for (var p = await reader.next(); p != null; p = await reader.next()) {
+      packets.add(p);
+    }
+    await reader.close();
+
+    expect(packets, s.packets);
+    expect([for (final p in packets) opusPacketSamples(p, kOggOpusGranuleRate)], s.samples);
+    expect(packets.where(isOpusSilencePacket).length, 1 + 2 + 300 + 3);
+    expect(reader.inputSampleRate, 16000);
+    expect(reader.preSkip, 0);
+    expect(reader.tags, {kOggOpusStartTag: '$_kStartTime', 'NOTE': 'a=b'});
+    expect(reader.startTime!.toUtc(), DateTime.fromMillisecondsSinceEpoch(_kStartTime * 1000, isUtc: true));
+    expect(s.writer.duration, Duration(microseconds: s.writer.granule * 1000000 ~/ 48000));
+  });
+
+  test('a truncated last page ends the stream after the whole pages', () async {
+    final path = '${dir.path}/stream.opus';
+    final s = await _writeStream(path, Random(26));
+    final bytes = await File(path).readAsBytes();
+    final pages = _pages(bytes);
+    await File(path).writeAsBytes(bytes.sublist(0, bytes.length - pages.last.raw.length ~/ 2));
+
+    final lastPagePackets = pages.last.lacing.where((n) => n < 255).length;
+    final reader = await OggOpusReader.open(path);
+    var count = 0;
+    while (await reader.next() != null) {
+      count++;
+    }
+    await reader.close();
+    expect(count, s.packets.length - lastPagePackets);
+  });
+
+  // Benchmark harness: half an hour of 30 s chunks, kept as Ogg Opus and as
+  // the WAV files the app used to keep, each stitched into a conversation.
+  // Reports the disk used and the stitch time, scaled up to a day of
+  // recording.
+  test('footprint and stitch time, Ogg Opus against WAV', () async {
+    final rng = Random(27);
+    final block = _packet(rng, 0, 3200); // 100 ms of PCM16 noise
+    final chunksDir = Directory('${dir.path}/chunks')..createSync();
+    const day = 24 * 3600 ~/ (_kBenchChunks * 30);
+
+    for (final ogg in [true, false]) {
+      final chunks = <AudioChunk>[];
+      var chunkBytes = 0;
+      for (var i = 0; i < _kBenchChunks; i++) {
+        final ts = _kStartTime + i * 30;
+        final path = '${chunksDir.path}/$ts.${ogg ? 'opus' : 'wav'}';
+        if (ogg) {
+          await _writeOggChunk(path, rng, ts);
+        } else {
+          await _writeWavChunk(path, block);
+        }
+        chunkBytes += await File(path).length();
+        chunks.add(AudioChunk(
+          id: '$ts',
+          startTime: DateTime.fromMillisecondsSinceEpoch(ts * 1000),
+          filePath: path,
+          codec: ogg ? BleAudioCodec.opusFS320 : BleAudioCodec.pcm16,
+          sampleRate: 16000,
+          silenceAnalysis: _chunkAnalysis(),
+          isComplete: true,
+        ));
+      }
+      final conversation = Conversation(
+        id: ogg ? 'ogg' : 'wav',
+        startTime: chunks.first.startTime,
+        endTime: chunks.last.endTime,
+        chunks: chunks,
+      );
+
+      final watch = Stopwatch()..start();
+      final result = await AudioStitcher().stitch(conversation: conversation, silenceThresholdDb: -40.0);
+      watch.stop();
+
+      expect(result.success, isTrue, reason: result.error);
+      expect(result.totalDuration, const Duration(seconds: 20) * _kBenchChunks);
+      expect(result.silenceRemoved, const Duration(seconds: 10) * _kBenchChunks);
+      final outBytes = await File(result.outputPath!).length();
+      if (!ogg) {
+        expect(outBytes, 44 + _kBenchChunks * 20 * 32000);
+      }
+
+      final mb = (chunkBytes + outBytes) / (1024 * 1024);
+      debugPrint('${ogg ? 'Ogg Opus' : 'WAV'}: $_kBenchChunks chunks ${(chunkBytes / 1048576).toStringAsFixed(1)} MB, '
+          'conversation ${(outBytes / 1048576).toStringAsFixed(1)} MB, stitched in ${watch.elapsedMilliseconds} ms; '
+          'a day: ${(mb * day / 1024).toStringAsFixed(2)} GB, '
+          '${(watch.elapsedMilliseconds * day / 1000).toStringAsFixed(1)} s of stitching');
+
+      await chunksDir.list().forEach((f) => f.deleteSync());
+    }
+  });
+}
@@ -0,0 +1,177 @@
+import 'dart:math';
+import 'dart:typed_data';
+
+import 'package:flutter_test/flutter_test.dart';
+
+import 'package:reclo/services/silence_detection_service.dart';
+
+// ─── Reference ────────────────────────────────────────────────────────────────
+
+// The per-window classification analyze() used before SilenceAccumulator:
+// samples normalised to ±1.0 as doubles, RMS in dBFS per window, -100 for
+// digital silence. Kept here verbatim to check the integer version against.
+List<bool> _referenceWindows(Uint8List bytes, PcmFormat format, double thresholdDb, int samplesPerWindow) {
+  final List<double> samples;
+  if (format == PcmFormat.pcm8bit) {
+    samples = bytes.map((b) => (b - 128) / 128.0).toList();
+  } else {
+    samples = <double>[];
+    for (int i = 0; i + 1 < bytes.length; i += 2) {
+      int raw = bytes[i] | (bytes[i + 1] << 8);
+      if (raw > 32767) raw -= 65536;
+      samples.add(raw / 32768.0);
+    }
+  }
+
+  final windows = <bool>[];
+  for (int wi = 0; wi * samplesPerWindow < samples.length; wi++) {
+    final start = wi * samplesPerWindow;
+    final end = min(start + samplesPerWindow, samples.length);
+    windows.add(_referenceRmsDb(samples.sublist(start, end)) < thresholdDb);
+  }
+  return windows;
+}
+
+double _referenceRmsDb(List<double> samples) {
+  if (samples.isEmpty) return -100.0;
+  double sumSquares = 0;
+  for (final s in samples) {
+    sumSquares += s * s;
+  }
+  final rms = sqrt(sumSquares / samples.length);
+  if (rms == 0) return -100.0;
+  return 20 * log(rms) / ln10;
+}
+
+// ─── Test signals ─────────────────────────────────────────────────────────────
+
+const int _kSamplesPerWindow = 1600; // 100 ms at 16 kHz
+
+/// [windows] windows of noise whose levels cluster around [aroundDb], so
+/// many land within a fraction of a dB of the threshold, plus digital
+/// silence, a near-silent window and a full-scale one. A partial window
+/// ends it.
+Uint8List _signal(Random rng, PcmFormat format, double aroundDb, int windows) {
+  final is8 = format == PcmFormat.pcm8bit;
+  final fullScale = is8 ? 127 : 32767;
+  final samples = <int>[];
+
+  for (var w = 0; w < windows; w++) {
+    final n = w == windows - 1 ? _kSamplesPerWindow ~/ 3 : _kSamplesPerWindow;
+    final double peak;
+    switch (w % 8) {
+      case 0:
+        peak = 0; // digital silence
+      case 1:
+        peak = 1; // the quietest non-zero level
+      case 2:
+        peak = fullScale.toDouble();
+      default:
+        final db = aroundDb + (rng.nextDouble() - 0.5) * 2;
+        // Uniform noise of amplitude a has an RMS of a / sqrt(3)
+        peak = min(fullScale.toDouble(), (pow(10, db / 20) * (fullScale + 1) * sqrt(3)).toDouble());
+    }
+    for (var i = 0; i < n; i++) {
+      samples.add(((rng.nextDouble() * 2 - 1) * peak).round().clamp(-fullScale - 1, fullScale));
+    }
+  }
+
+  if (is8) {
+    return Uint8List.fromList([for (final s in samples) s + 128]);
+  }
+  final out = ByteData(samples.length * 2);
+  for (var i = 0; i < samples.length; i++) {
+    out.setInt16(i * 2, samples[i], Endian.little);
+  }
+  return out.buffer.asUint8List();
+}
+
+/// Feed [bytes] to [acc] in pieces of awkward sizes, odd ones included, each
+/// a view at an odd or even offset into a larger buffer.
+void _addInPieces(SilenceAccumulator acc, Uint8List bytes, Random rng) {
+  const sizes = [1, 3, 2, 7, 641, 1, 1, 320, 3199, 5];
+  var at = 0;
+  var k = 0;
+  while (at < bytes.length) {
+    final n = min(sizes[k++ % sizes.length], bytes.length - at);
+    final pad = rng.nextInt(2);
+    final backing = Uint8List(n + pad)..setRange(pad, pad + n, bytes, at);
+    acc.add(Uint8List.sublistView(backing, pad));
+    at += n;
+  }
+}
+
+const List<double> _kThresholds = [-96.0, -80.0, -60.0, -45.5, -40.0, -35.25, -20.0, -6.0, -0.5, 0.0];
+
+void main() {
+  final service = SilenceDetectionService();
+
+  for (final format in PcmFormat.values) {
+    group('$format', () {
+      test('windows match the float implementation at every threshold', () {
+        final rng = Random(22);
+        for (final threshold in _kThresholds) {
+          final pcm = _signal(rng, format, threshold, 41);
+          final expected = _referenceWindows(pcm, format, threshold, _kSamplesPerWindow);
+
+          final whole = service.accumulate(format: format, silenceThresholdDb: threshold)..add(pcm);
+          expect(whole.finish(), expected, reason: 'threshold $threshold dB, one add()');
+
+          final pieces = service.accumulate(format: format, silenceThresholdDb: threshold);
+          _addInPieces(pieces, pcm, rng);
+          expect(pieces.finish(), expected, reason: 'threshold $threshold dB, split add()');
+
+          // Both outcomes occur, or the comparison proves little; nothing
+          // but full-scale square waves reaches the top thresholds
+          expect(expected, contains(true), reason: 'threshold $threshold dB');
+          if (threshold > -96.0 && threshold < -3.0) {
+            expect(expected, contains(false), reason: 'threshold $threshold dB');
+          }
+        }
+      });
+
+      test('analyze() gives the same segments as before', () {
+        final rng = Random(23);
+        final pcm = _signal(rng, format, -40.0, 60);
+        final expected = service.analyzeWindows(_referenceWindows(pcm, format, -40.0, _kSamplesPerWindow));
+        final result = service.analyze(pcmBytes: pcm, format: format, silenceThresholdDb: -40.0);
+
+        expect(result.segments.map((s) => s.toString()).toList(),
+            expected.segments.map((s) => s.toString()).toList());
+        expect(result.totalSilence, expected.totalSilence);
+        expect(result.totalSpeech, expected.totalSpeech);
+        expect(result.longestSilenceGap, expected.longestSilenceGap);
+        expect(result.isEntirelySilent, expected.isEntirelySilent);
+      });
+    });
+  }
+
+  test('a trailing odd byte of PCM16 is ignored, as before', () {
+    final rng = Random(24);
+    final pcm = _signal(rng, PcmFormat.pcm16bit, -40.0, 5);
+    final odd = Uint8List(pcm.length + 1)
+      ..setAll(0, pcm)
+      ..[pcm.length] = 0x7F;
+    final expected = _referenceWindows(odd, PcmFormat.pcm16bit, -40.0, _kSamplesPerWindow);
+
+    final acc = service.accumulate(format: PcmFormat.pcm16bit, silenceThresholdDb: -40.0);
+    _addInPieces(acc, odd, rng);
+    expect(acc.finish(), expected);
+  });
+
+  test('a sample split across add() calls is joined', () {
+    // 0x8000 and 0x7FFF split byte by byte: full-scale, never silent
+    final acc = service.accumulate(format: PcmFormat.pcm16bit, silenceThresholdDb: -1.0);
+    for (var i = 0; i < _kSamplesPerWindow; i++) {
+      acc.add(Uint8List.fromList([i.isEven ? 0x00 : 0xFF]));
+      acc.add(Uint8List.fromList([i.isEven ? 0x80 : 0x7F]));
+    }
+    expect(acc.finish(), [false]);
+  });
+
+  test('empty input', () {
+    final result = service.analyze(pcmBytes: Uint8List(0), format: PcmFormat.pcm16bit, silenceThresholdDb: -40.0);
+    expect(result.segments, isEmpty);
+    expect(result.isEntirelySilent, isTrue);
+  });
+}
@@ -0,0 +1,97 @@
+/*
+ * Opus encode cost per 20 ms frame at complexity 0 to 10, on the fixed
+ * conversation in opus_corpus.c and with codec_start()'s other settings.
+ *
+ * This is the vendored library built for the host (build/libopus.a), so
+ * the Arm kernels are out and the figures are host cycles: use them to set
+ * one complexity against another, not for the duty cycle on the nRF5340.
+ * Each complexity encodes the same 30 s; the best of REPEATS runs counts.
+ * Cycles are TSC ticks on x86 and nanoseconds elsewhere.
+ */
+
+#include "lib/core/config.h"
+
+#include "fake_zephyr.h"
+#include "opus_corpus.h"
+
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CYCLES_UNIT "TSC cycles"
+static uint64_t cycles(void)
+{
+    return __rdtsc();
+}
+#else
+#define CYCLES_UNIT "ns"
+static uint64_t cycles(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+#endif
+
+#define SECONDS 30
+#define FRAMES  (SECONDS * 50)
+#define REPEATS 5
+
+static int16_t corpus[FRAMES][OPUS_CORPUS_FRAME];
+
+struct run {
+    uint64_t cycles;   /* all frames */
+    int64_t  us;
+    uint64_t bytes;
+};
+
+static struct run encode_all(int complexity)
+{
+    struct run   run = { 0 };
+    OpusEncoder *enc = opus_corpus_encoder(complexity);
+    CHECK(enc != NULL);
+    if (!enc) {
+        return run;
+    }
+    static uint8_t out[CODEC_OUTPUT_MAX_BYTES];
+    int64_t        t0 = k_uptime_ticks();
+    uint64_t       c0 = cycles();
+    for (int f = 0; f < FRAMES; f++) {
+        opus_int32 len = opus_encode(enc, corpus[f], OPUS_CORPUS_FRAME, out, sizeof(out));
+        CHECK(len > 0);
+        run.bytes += (uint64_t) len;
+    }
+    run.cycles = cycles() - c0;
+    run.us     = k_uptime_ticks() - t0;
+    opus_encoder_destroy(enc);
+    return run;
+}
+
+int main(void)
+{
+    for (int f = 0; f < FRAMES; f++) {
+        opus_corpus_next(corpus[f]);
+    }
+
+    /* Round robin, so a busy spell on the host hits every complexity */
+    struct run best[11] = { 0 };
+    for (int r = 0; r < REPEATS; r++) {
+        for (int c = 0; c <= 10; c++) {
+            struct run run = encode_all(c);
+            if (r == 0 || run.cycles < best[c].cycles) {
+                best[c] = run;
+            }
+        }
+    }
+
+    printf("Opus encode, %d s of speech and pauses, %d kbps VBR, 20 ms frames (host build)\n", SECONDS,
+           CODEC_OPUS_BITRATE / 1000);
+    printf("complexity  %s/frame  us/frame  B/frame  vs %d\n", CYCLES_UNIT, CODEC_OPUS_COMPLEXITY);
+    for (int c = 0; c <= 10; c++) {
+        printf("%10d  %*.0f  %8.1f  %7.1f  %4.2fx%s\n", c, (int) sizeof(CYCLES_UNIT "/frame") - 1,
+               (double) best[c].cycles / FRAMES, (double) best[c].us / FRAMES, (double) best[c].bytes / FRAMES,
+               (double) best[c].cycles / best[CODEC_OPUS_COMPLEXITY].cycles,
+               c == CODEC_OPUS_COMPLEXITY ? "  (codec default)" : "");
+    }
+
+    return fake_test_result("bench_opus_encode");
+}
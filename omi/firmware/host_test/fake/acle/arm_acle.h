@@ -0,0 +1,63 @@
+#ifndef FAKE_ARM_ACLE_H
+#define FAKE_ARM_ACLE_H
+
+/*
+ * Portable models of the ACLE SIMD32 intrinsics mic_dsp.c and the Opus
+ * Armv8-M kernels use, written from the instruction pseudocode in the
+ * Armv8-M Architecture Reference Manual (SHADD16, QADD16, SMLAD, SMLALD).
+ * With these, the DSP-extension code runs on the host and can be compared
+ * with its C reference.
+ */
+
+#include <stdint.h>
+
+typedef int32_t int16x2_t;
+
+static inline int32_t acle_lo(int16x2_t x)
+{
+    return (int16_t) (uint16_t) ((uint32_t) x & 0xFFFFU);
+}
+
+static inline int32_t acle_hi(int16x2_t x)
+{
+    return (int16_t) (uint16_t) ((uint32_t) x >> 16);
+}
+
+static inline int16x2_t acle_pack(int32_t lo, int32_t hi)
+{
+    return (int16x2_t) (((uint32_t) (uint16_t) hi << 16) | (uint16_t) lo);
+}
+
+static inline int32_t acle_sat16(int32_t v)
+{
+    return v > INT16_MAX ? INT16_MAX : v < INT16_MIN ? INT16_MIN : v;
+}
+
+/* SHADD16: halved sums, sum<16:1> of the 17-bit result (rounds down) */
+static inline int16x2_t __shadd16(int16x2_t a, int16x2_t b)
+{
+    int32_t lo = acle_lo(a) + acle_lo(b);
+    int32_t hi = acle_hi(a) + acle_hi(b);
+    return acle_pack(lo >= 0 ? lo / 2 : -((-lo + 1) / 2), hi >= 0 ? hi / 2 : -((-hi + 1) / 2));
+}
+
+/* QADD16: sums saturated to int16 */
+static inline int16x2_t __qadd16(int16x2_t a, int16x2_t b)
+{
+    return acle_pack(acle_sat16(acle_lo(a) + acle_lo(b)), acle_sat16(acle_hi(a) + acle_hi(b)));
+}
+
+/* SMLAD: acc + lo(a)·lo(b) + hi(a)·hi(b), wrapping at 32 bits (the Q flag,
+ * set on overflow, is not modelled) */
+static inline int32_t __smlad(int16x2_t a, int16x2_t b, int32_t acc)
+{
+    return (int32_t) ((uint32_t) acc + (uint32_t) (acle_lo(a) * acle_lo(b)) + (uint32_t) (acle_hi(a) * acle_hi(b)));
+}
+
+/* SMLALD: acc + lo(a)·lo(b) + hi(a)·hi(b), 64-bit */
+static inline int64_t __smlald(int16x2_t a, int16x2_t b, int64_t acc)
+{
+    return acc + (int64_t) acle_lo(a) * acle_lo(b) + (int64_t) acle_hi(a) * acle_hi(b);
+}
+
+#endif /* FAKE_ARM_ACLE_H */
@@ -0,0 +1,1407 @@
+/* clock_gettime(), nanosleep() and strdup() under -std=c11 too */
+#define _POSIX_C_SOURCE 200809L
+
+#include "fake_zephyr.h"
+
+#include <ff.h>
+#include <nrfx_pdm.h>
+#include <zephyr/audio/dmic.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/sys/crc.h>
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+int fake_test_failures;
+
+int fake_test_result(const char *name)
+{
+    if (fake_test_failures) {
+        fprintf(stderr, "%s: %d check(s) failed\n", name, fake_test_failures);
+        return 1;
+    }
+    printf("%s: ok\n", name);
+    return 0;
+}
+
+/* ── Time ───────────────────────────────────────────────────────────────────*/
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void busy_wait_us(uint32_t us)
+{
+    int64_t until = now_us() + us;
+    while (now_us() < until) {
+    }
+}
+
+static void sleep_until_us(int64_t until)
+{
+    struct timespec ts = { until / 1000000, (until % 1000000) * 1000 };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) {
+    }
+}
+
+int64_t k_uptime_get(void)
+{
+    return now_us() / 1000;
+}
+
+int64_t k_uptime_ticks(void)
+{
+    return now_us();
+}
+
+uint64_t k_ticks_to_ms_floor64(uint64_t ticks)
+{
+    return ticks / 1000;
+}
+
+uint32_t k_cycle_get_32(void)
+{
+    return (uint32_t) now_us();
+}
+
+uint32_t k_cyc_to_us_floor32(uint32_t cycles)
+{
+    return cycles;
+}
+
+int32_t k_sleep(k_timeout_t timeout)
+{
+    if (timeout.ms > 0) {
+        struct timespec ts = { timeout.ms / 1000, (timeout.ms % 1000) * 1000000 };
+        nanosleep(&ts, NULL);
+    }
+    return 0;
+}
+
+int32_t k_msleep(int32_t ms)
+{
+    return k_sleep(K_MSEC(ms));
+}
+
+/* ── Threads ──────────────────────────────────────────────────────────────
+ * One lock guards every semaphore, queue and mutex, and one condition is
+ * broadcast whenever any of them changes; waiters recheck their own. Without
+ * threads nothing else can change them, so a wait fails at once.
+ */
+
+static bool            threads_enabled;
+static pthread_mutex_t kernel_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  kernel_changed = PTHREAD_COND_INITIALIZER;
+
+/* Distinct per thread: identifies a mutex owner */
+static _Thread_local char thread_tag;
+
+void fake_threads_enable(void)
+{
+    threads_enabled = true;
+}
+
+/* With kernel_lock held: wait for a change, or return false once @p timeout,
+ * counted from @p start, has run out */
+static bool wait_for_change(k_timeout_t timeout, int64_t start)
+{
+    if (timeout.ms == 0 || !threads_enabled) {
+        return false;
+    }
+    if (timeout.ms < 0) {
+        pthread_cond_wait(&kernel_changed, &kernel_lock);
+        return true;
+    }
+    int64_t left = start + timeout.ms * 1000 - now_us();
+    if (left <= 0) {
+        return false;
+    }
+    /* The condition runs on CLOCK_REALTIME */
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    int64_t ns = ts.tv_nsec + (left % 1000000) * 1000;
+    ts.tv_sec += left / 1000000 + ns / 1000000000;
+    ts.tv_nsec = ns % 1000000000;
+    pthread_cond_timedwait(&kernel_changed, &kernel_lock, &ts);
+    return true;
+}
+
+static void kernel_unlock_changed(void)
+{
+    pthread_cond_broadcast(&kernel_changed);
+    pthread_mutex_unlock(&kernel_lock);
+}
+
+struct thread_start {
+    k_thread_entry_t entry;
+    void            *p1, *p2, *p3;
+};
+
+static void *thread_main(void *arg)
+{
+    struct thread_start start = *(struct thread_start *) arg;
+    free(arg);
+    start.entry(start.p1, start.p2, start.p3);
+    return NULL;
+}
+
+k_tid_t k_thread_create(struct k_thread *thread, k_thread_stack_t *stack, size_t stack_size,
+                        k_thread_entry_t entry, void *p1, void *p2, void *p3, int prio, uint32_t options,
+                        k_timeout_t delay)
+{
+    (void) stack, (void) stack_size, (void) prio, (void) options, (void) delay;
+    if (threads_enabled) {
+        struct thread_start *start = malloc(sizeof(*start));
+        *start = (struct thread_start){ entry, p1, p2, p3 };
+        pthread_t tid;
+        pthread_create(&tid, NULL, thread_main, start);
+        pthread_detach(tid);
+    }
+    return thread;
+}
+
+void k_thread_start(k_tid_t thread)
+{
+    k_thread_create(thread, NULL, 0, thread->entry, thread->p1, thread->p2, thread->p3, 0, 0, K_NO_WAIT);
+}
+
+void k_thread_abort(k_tid_t thread)
+{
+    /* A host thread cannot be stopped from outside */
+    assert(!threads_enabled);
+    (void) thread;
+}
+
+int k_thread_name_set(k_tid_t thread, const char *name)
+{
+    thread->name = name;
+    return 0;
+}
+
+void k_yield(void)
+{
+    if (threads_enabled) {
+        sched_yield();
+    }
+}
+
+/* ── Mutexes and semaphores ─────────────────────────────────────────────────*/
+
+int k_mutex_init(struct k_mutex *mutex)
+{
+    mutex->locked = 0;
+    mutex->owner = NULL;
+    return 0;
+}
+
+int k_mutex_lock(struct k_mutex *mutex, k_timeout_t timeout)
+{
+    int64_t start = now_us();
+    pthread_mutex_lock(&kernel_lock);
+    while (mutex->locked && mutex->owner != &thread_tag) {
+        if (!wait_for_change(timeout, start)) {
+            pthread_mutex_unlock(&kernel_lock);
+            return timeout.ms == 0 ? -EBUSY : -EAGAIN;
+        }
+    }
+    mutex->locked++;
+    mutex->owner = &thread_tag;
+    pthread_mutex_unlock(&kernel_lock);
+    return 0;
+}
+
+int k_mutex_unlock(struct k_mutex *mutex)
+{
+    pthread_mutex_lock(&kernel_lock);
+    if (mutex->locked == 0 || mutex->owner != &thread_tag) {
+        pthread_mutex_unlock(&kernel_lock);
+        return mutex->locked == 0 ? -EINVAL : -EPERM;
+    }
+    if (--mutex->locked == 0) {
+        mutex->owner = NULL;
+    }
+    kernel_unlock_changed();
+    return 0;
+}
+
+int k_sem_init(struct k_sem *sem, unsigned int initial, unsigned int limit)
+{
+    pthread_mutex_lock(&kernel_lock);
+    sem->count = initial;
+    sem->limit = limit;
+    kernel_unlock_changed();
+    return 0;
+}
+
+int k_sem_take(struct k_sem *sem, k_timeout_t timeout)
+{
+    int64_t start = now_us();
+    pthread_mutex_lock(&kernel_lock);
+    while (sem->count == 0) {
+        if (!wait_for_change(timeout, start)) {
+            pthread_mutex_unlock(&kernel_lock);
+            return timeout.ms == 0 ? -EBUSY : -EAGAIN;
+        }
+    }
+    sem->count--;
+    pthread_mutex_unlock(&kernel_lock);
+    return 0;
+}
+
+void k_sem_give(struct k_sem *sem)
+{
+    pthread_mutex_lock(&kernel_lock);
+    if (sem->count < sem->limit) {
+        sem->count++;
+    }
+    kernel_unlock_changed();
+}
+
+unsigned k_sem_count_get(struct k_sem *sem)
+{
+    pthread_mutex_lock(&kernel_lock);
+    unsigned count = sem->count;
+    pthread_mutex_unlock(&kernel_lock);
+    return count;
+}
+
+static pthread_mutex_t spin_lock = PTHREAD_MUTEX_INITIALIZER;
+
+k_spinlock_key_t k_spin_lock(struct k_spinlock *lock)
+{
+    (void) lock;
+    pthread_mutex_lock(&spin_lock);
+    return (k_spinlock_key_t){ 0 };
+}
+
+void k_spin_unlock(struct k_spinlock *lock, k_spinlock_key_t key)
+{
+    (void) lock, (void) key;
+    pthread_mutex_unlock(&spin_lock);
+}
+
+/* ── Message queues ─────────────────────────────────────────────────────────*/
+
+void k_msgq_init(struct k_msgq *q, char *buf, size_t msg_size, uint32_t max_msgs)
+{
+    pthread_mutex_lock(&kernel_lock);
+    q->buf = buf;
+    q->msg_size = msg_size;
+    q->max_msgs = max_msgs;
+    q->head = 0;
+    q->used = 0;
+    kernel_unlock_changed();
+}
+
+int k_msgq_put(struct k_msgq *q, const void *data, k_timeout_t timeout)
+{
+    int64_t start = now_us();
+    pthread_mutex_lock(&kernel_lock);
+    while (q->used == q->max_msgs) {
+        if (!wait_for_change(timeout, start)) {
+            pthread_mutex_unlock(&kernel_lock);
+            return timeout.ms == 0 ? -ENOMSG : -EAGAIN;
+        }
+    }
+    uint32_t slot = (q->head + q->used) % q->max_msgs;
+    memcpy(q->buf + slot * q->msg_size, data, q->msg_size);
+    q->used++;
+    kernel_unlock_changed();
+    return 0;
+}
+
+int k_msgq_peek(struct k_msgq *q, void *data)
+{
+    pthread_mutex_lock(&kernel_lock);
+    int err = q->used == 0 ? -ENOMSG : 0;
+    if (!err) {
+        memcpy(data, q->buf + q->head * q->msg_size, q->msg_size);
+    }
+    pthread_mutex_unlock(&kernel_lock);
+    return err;
+}
+
+int k_msgq_get(struct k_msgq *q, void *data, k_timeout_t timeout)
+{
+    int64_t start = now_us();
+    pthread_mutex_lock(&kernel_lock);
+    while (q->used == 0) {
+        if (!wait_for_change(timeout, start)) {
+            pthread_mutex_unlock(&kernel_lock);
+            return timeout.ms == 0 ? -ENOMSG : -EAGAIN;
+        }
+    }
+    memcpy(data, q->buf + q->head * q->msg_size, q->msg_size);
+    q->head = (q->head + 1) % q->max_msgs;
+    q->used--;
+    kernel_unlock_changed();
+    return 0;
+}
+
+uint32_t k_msgq_num_used_get(struct k_msgq *q)
+{
+    pthread_mutex_lock(&kernel_lock);
+    uint32_t used = q->used;
+    pthread_mutex_unlock(&kernel_lock);
+    return used;
+}
+
+void k_msgq_purge(struct k_msgq *q)
+{
+    pthread_mutex_lock(&kernel_lock);
+    q->head = 0;
+    q->used = 0;
+    kernel_unlock_changed();
+}
+
+/* ── Memory slabs ───────────────────────────────────────────────────────────*/
+
+int k_mem_slab_alloc(struct k_mem_slab *slab, void **mem, k_timeout_t timeout)
+{
+    int64_t start = now_us();
+    pthread_mutex_lock(&kernel_lock);
+    if (!slab->ready) {
+        for (uint32_t i = slab->num_blocks; i-- > 0;) {
+            char *block = slab->buffer + i * slab->block_size;
+            *(char **) block = slab->free_list;
+            slab->free_list = block;
+        }
+        slab->ready = true;
+    }
+    while (slab->free_list == NULL) {
+        if (!wait_for_change(timeout, start)) {
+            pthread_mutex_unlock(&kernel_lock);
+            *mem = NULL;
+            return timeout.ms == 0 ? -ENOMEM : -EAGAIN;
+        }
+    }
+    *mem = slab->free_list;
+    slab->free_list = *(char **) slab->free_list;
+    slab->num_used++;
+    pthread_mutex_unlock(&kernel_lock);
+    return 0;
+}
+
+void k_mem_slab_free(struct k_mem_slab *slab, void *mem)
+{
+    pthread_mutex_lock(&kernel_lock);
+    *(char **) mem = slab->free_list;
+    slab->free_list = mem;
+    slab->num_used--;
+    kernel_unlock_changed();
+}
+
+uint32_t k_mem_slab_num_used_get(struct k_mem_slab *slab)
+{
+    pthread_mutex_lock(&kernel_lock);
+    uint32_t used = slab->num_used;
+    pthread_mutex_unlock(&kernel_lock);
+    return used;
+}
+
+/* ── Work items ─────────────────────────────────────────────────────────────*/
+
+static struct k_work *work_head;
+static struct k_work *work_tail;
+
+void k_work_init(struct k_work *work, k_work_handler_t handler)
+{
+    work->handler = handler;
+    work->pending = false;
+    work->next = NULL;
+}
+
+int k_work_submit(struct k_work *work)
+{
+    pthread_mutex_lock(&kernel_lock);
+    if (work->pending) {
+        pthread_mutex_unlock(&kernel_lock);
+        return 0;
+    }
+    work->pending = true;
+    work->next = NULL;
+    if (work_tail) {
+        work_tail->next = work;
+    } else {
+        work_head = work;
+    }
+    work_tail = work;
+    pthread_mutex_unlock(&kernel_lock);
+    return 1;
+}
+
+static struct k_work *work_pop(void)
+{
+    pthread_mutex_lock(&kernel_lock);
+    struct k_work *work = work_head;
+    if (work) {
+        work_head = work->next;
+        if (!work_head) {
+            work_tail = NULL;
+        }
+        work->pending = false;
+        work->next = NULL;
+    }
+    pthread_mutex_unlock(&kernel_lock);
+    return work;
+}
+
+void fake_work_run_all(void)
+{
+    struct k_work *work;
+    while ((work = work_pop()) != NULL) {
+        work->handler(work);
+    }
+}
+
+struct k_work *fake_work_run_one(void)
+{
+    struct k_work *work = work_pop();
+    if (work) {
+        work->handler(work);
+    }
+    return work;
+}
+
+bool k_work_flush(struct k_work *work, struct k_work_sync *sync)
+{
+    (void) sync;
+    pthread_mutex_lock(&kernel_lock);
+    bool pending = work->pending;
+    pthread_mutex_unlock(&kernel_lock);
+    if (!pending) {
+        return false;
+    }
+    /* The system workqueue is FIFO, so everything ahead of it runs too */
+    struct k_work *w;
+    while ((w = work_pop()) != NULL) {
+        w->handler(w);
+        if (w == work) {
+            break;
+        }
+    }
+    return true;
+}
+
+void k_work_init_delayable(struct k_work_delayable *dwork, k_work_handler_t handler)
+{
+    k_work_init(&dwork->work, handler);
+}
+
+int k_work_schedule(struct k_work_delayable *dwork, k_timeout_t delay)
+{
+    (void) delay;
+    return k_work_submit(&dwork->work);
+}
+
+/* ── CRC ────────────────────────────────────────────────────────────────────*/
+
+uint32_t crc32_ieee_update(uint32_t crc, const uint8_t *data, size_t len)
+{
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++) {
+            crc = (crc >> 1) ^ (0xEDB88320U & (0U - (crc & 1U)));
+        }
+    }
+    return ~crc;
+}
+
+uint32_t crc32_ieee(const uint8_t *data, size_t len)
+{
+    return crc32_ieee_update(0, data, len);
+}
+
+/* ── File system ────────────────────────────────────────────────────────────
+ * Nodes live in a growable array; a path → node hash table with linear
+ * probing finds them. Unlinked nodes leave a tombstone in the table and are
+ * rehashed away once tombstones pile up.
+ */
+
+struct fs_node {
+    char    *path;
+    uint8_t *data;
+    size_t   size;
+    size_t   cap;
+    bool     is_dir;
+    bool     live;
+};
+
+#define HASH_TOMBSTONE (-2)
+#define HASH_EMPTY     (-1)
+
+static struct fs_node *nodes;
+static int             node_count;
+static int             node_cap;
+static int            *hash;
+static int             hash_cap;
+static int             hash_used;   /* live entries and tombstones */
+
+/* The card serves one operation at a time, latency included */
+static pthread_mutex_t card_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint32_t latency_us[FAKE_FS_OP_COUNT];
+static uint32_t op_calls[FAKE_FS_OP_COUNT];
+static uint32_t op_failures[FAKE_FS_OP_COUNT];
+
+/* Account for a call of @p op; non-zero when it is to fail */
+static int fs_op(enum fake_fs_op op)
+{
+    op_calls[op]++;
+    if (latency_us[op] && threads_enabled) {
+        sleep_until_us(now_us() + latency_us[op]);
+    } else if (latency_us[op]) {
+        busy_wait_us(latency_us[op]);
+    }
+    if (op_failures[op]) {
+        op_failures[op]--;
+        return -EIO;
+    }
+    return 0;
+}
+
+static uint32_t path_hash(const char *path)
+{
+    uint32_t h = 2166136261U;
+    while (*path) {
+        h = (h ^ (uint8_t) *path++) * 16777619U;
+    }
+    return h;
+}
+
+static void hash_insert(int node)
+{
+    uint32_t i = path_hash(nodes[node].path) & (uint32_t) (hash_cap - 1);
+    while (hash[i] >= 0) {
+        i = (i + 1) & (uint32_t) (hash_cap - 1);
+    }
+    if (hash[i] == HASH_EMPTY) {
+        hash_used++;
+    }
+    hash[i] = node;
+}
+
+static void hash_rebuild(int cap)
+{
+    free(hash);
+    hash_cap = cap;
+    hash_used = 0;
+    hash = malloc(sizeof(*hash) * (size_t) cap);
+    for (int i = 0; i < cap; i++) {
+        hash[i] = HASH_EMPTY;
+    }
+    for (int n = 0; n < node_count; n++) {
+        if (nodes[n].live) {
+            hash_insert(n);
+        }
+    }
+}
+
+/* Index into hash[] of @p path, or -1 */
+static int hash_find(const char *path)
+{
+    if (!hash) {
+        return -1;
+    }
+    uint32_t i = path_hash(path) & (uint32_t) (hash_cap - 1);
+    while (hash[i] != HASH_EMPTY) {
+        if (hash[i] >= 0 && strcmp(nodes[hash[i]].path, path) == 0) {
+            return (int) i;
+        }
+        i = (i + 1) & (uint32_t) (hash_cap - 1);
+    }
+    return -1;
+}
+
+static int node_find(const char *path)
+{
+    int h = hash_find(path);
+    return h < 0 ? -1 : hash[h];
+}
+
+static int node_create(const char *path, bool is_dir)
+{
+    if (node_count == node_cap) {
+        node_cap = node_cap ? node_cap * 2 : 256;
+        nodes = realloc(nodes, sizeof(*nodes) * (size_t) node_cap);
+    }
+    if (!hash || (hash_used + 1) * 2 > hash_cap) {
+        int cap = hash_cap ? hash_cap : 1024;
+        while (cap < (node_count + 1) * 4) {
+            cap *= 2;
+        }
+        hash_rebuild(cap);
+    }
+
+    int n = node_count++;
+    nodes[n] = (struct fs_node){ .path = strdup(path), .is_dir = is_dir, .live = true };
+    hash_insert(n);
+    return n;
+}
+
+static void node_unlink(int h)
+{
+    struct fs_node *node = &nodes[hash[h]];
+    node->live = false;
+    free(node->data);
+    node->data = NULL;
+    node->size = node->cap = 0;
+    hash[h] = HASH_TOMBSTONE;
+}
+
+/* The mount point ("/SD:") always exists; deeper parents must be made */
+static bool parent_exists(const char *path)
+{
+    const char *slash = strrchr(path, '/');
+    if (!slash || slash == path) {
+        return true;
+    }
+    char parent[MAX_FILE_NAME + 1];
+    size_t len = (size_t) (slash - path);
+    memcpy(parent, path, len);
+    parent[len] = '\0';
+    if (strchr(parent + 1, '/') == NULL) {
+        return true;
+    }
+    int n = node_find(parent);
+    return n >= 0 && nodes[n].is_dir;
+}
+
+void fake_fs_reset(void)
+{
+    for (int n = 0; n < node_count; n++) {
+        free(nodes[n].path);
+        free(nodes[n].data);
+    }
+    node_count = 0;
+    hash_rebuild(1024);
+    memset(latency_us, 0, sizeof(latency_us));
+    memset(op_calls, 0, sizeof(op_calls));
+    memset(op_failures, 0, sizeof(op_failures));
+}
+
+void fake_fs_set_latency(enum fake_fs_op op, uint32_t us)
+{
+    latency_us[op] = us;
+}
+
+void fake_fs_fail_next(enum fake_fs_op op, uint32_t count)
+{
+    op_failures[op] = count;
+}
+
+uint32_t fake_fs_calls(enum fake_fs_op op)
+{
+    return op_calls[op];
+}
+
+bool fake_fs_exists(const char *path)
+{
+    pthread_mutex_lock(&card_lock);
+    bool exists = node_find(path) >= 0;
+    pthread_mutex_unlock(&card_lock);
+    return exists;
+}
+
+int fake_fs_put(const char *path, const void *data, size_t len)
+{
+    pthread_mutex_lock(&card_lock);
+    int n = node_find(path);
+    if (n < 0) {
+        n = node_create(path, false);
+    }
+    struct fs_node *node = &nodes[n];
+    free(node->data);
+    node->data = malloc(len ? len : 1);
+    memcpy(node->data, data, len);
+    node->size = node->cap = len;
+    pthread_mutex_unlock(&card_lock);
+    return 0;
+}
+
+static int open_locked(struct fs_file_t *f, const char *path, int flags)
+{
+    int err = fs_op(FAKE_FS_OPEN);
+    if (err) {
+        return err;
+    }
+
+    int n = node_find(path);
+    if (n < 0) {
+        if (!(flags & FS_O_CREATE)) {
+            return -ENOENT;
+        }
+        if (!parent_exists(path)) {
+            return -ENOENT;
+        }
+        n = node_create(path, false);
+    }
+    if (nodes[n].is_dir) {
+        return -EISDIR;
+    }
+    if (flags & FS_O_TRUNC) {
+        nodes[n].size = 0;
+    }
+    f->node = n;
+    f->pos = 0;
+    f->flags = flags;
+    f->filep = f;
+    return 0;
+}
+
+int fs_close(struct fs_file_t *f)
+{
+    if (f->node < 0) {
+        return -EBADF;
+    }
+    f->node = -1;
+    return 0;
+}
+
+static ssize_t read_locked(struct fs_file_t *f, void *buf, size_t len)
+{
+    int err = fs_op(FAKE_FS_READ);
+    if (err) {
+        return err;
+    }
+    if (f->node < 0 || !(f->flags & FS_O_READ)) {
+        return -EBADF;
+    }
+    struct fs_node *node = &nodes[f->node];
+    if (!node->live) {
+        return -EIO;
+    }
+    if ((size_t) f->pos >= node->size) {
+        return 0;
+    }
+    size_t n = MIN(len, node->size - (size_t) f->pos);
+    memcpy(buf, node->data + f->pos, n);
+    f->pos += (off_t) n;
+    return (ssize_t) n;
+}
+
+static ssize_t write_locked(struct fs_file_t *f, const void *buf, size_t len)
+{
+    int err = fs_op(FAKE_FS_WRITE);
+    if (err) {
+        return err;
+    }
+    if (f->node < 0 || !(f->flags & FS_O_WRITE)) {
+        return -EBADF;
+    }
+    struct fs_node *node = &nodes[f->node];
+    if (!node->live) {
+        return -EIO;
+    }
+    if (f->flags & FS_O_APPEND) {
+        f->pos = (off_t) node->size;
+    }
+    if (fake_fs_write_hook) {
+        fake_fs_write_hook(node->path, f->pos, len);
+    }
+    size_t end = (size_t) f->pos + len;
+    if (end > node->cap) {
+        node->cap = MAX(end, node->cap * 2);
+        node->data = realloc(node->data, node->cap);
+    }
+    if ((size_t) f->pos > node->size) {
+        memset(node->data + node->size, 0, (size_t) f->pos - node->size);
+    }
+    memcpy(node->data + f->pos, buf, len);
+    f->pos = (off_t) end;
+    node->size = MAX(node->size, end);
+    return (ssize_t) len;
+}
+
+void (*fake_fs_write_hook)(const char *path, off_t offset, size_t len);
+void (*fake_fs_unlink_hook)(const char *path);
+
+static int seek_locked(struct fs_file_t *f, off_t offset, int whence)
+{
+    if (f->node < 0) {
+        return -EBADF;
+    }
+    off_t base = whence == FS_SEEK_SET ? 0 : whence == FS_SEEK_CUR ? f->pos : (off_t) nodes[f->node].size;
+    if (base + offset < 0) {
+        return -EINVAL;
+    }
+    f->pos = base + offset;
+    return 0;
+}
+
+off_t fs_tell(struct fs_file_t *f)
+{
+    return f->node < 0 ? -EBADF : f->pos;
+}
+
+static int truncate_locked(struct fs_file_t *f, off_t length)
+{
+    if (f->node < 0) {
+        return -EBADF;
+    }
+    struct fs_node *node = &nodes[f->node];
+    if ((size_t) length > node->cap) {
+        node->cap = (size_t) length;
+        node->data = realloc(node->data, node->cap);
+    }
+    if ((size_t) length > node->size) {
+        memset(node->data + node->size, 0, (size_t) length - node->size);
+    }
+    node->size = (size_t) length;
+    return 0;
+}
+
+int fs_sync(struct fs_file_t *f)
+{
+    return f->node < 0 ? -EBADF : 0;
+}
+
+static int unlink_locked(const char *path)
+{
+    int err = fs_op(FAKE_FS_UNLINK);
+    if (err) {
+        return err;
+    }
+    if (fake_fs_unlink_hook) {
+        fake_fs_unlink_hook(path);
+    }
+    int h = hash_find(path);
+    if (h < 0) {
+        return -ENOENT;
+    }
+    node_unlink(h);
+    return 0;
+}
+
+static int rename_locked(const char *from, const char *to)
+{
+    int err = fs_op(FAKE_FS_RENAME);
+    if (err) {
+        return err;
+    }
+    int hf = hash_find(from);
+    if (hf < 0) {
+        return -ENOENT;
+    }
+    int n = hash[hf];
+    int ht = hash_find(to);
+    if (ht >= 0) {
+        node_unlink(ht);
+    }
+    hash[hf] = HASH_TOMBSTONE;
+    free(nodes[n].path);
+    nodes[n].path = strdup(to);
+    hash_insert(n);
+    return 0;
+}
+
+static int stat_locked(const char *path, struct fs_dirent *entry)
+{
+    int n = node_find(path);
+    if (n < 0) {
+        return -ENOENT;
+    }
+    const char *name = strrchr(path, '/');
+    snprintf(entry->name, sizeof(entry->name), "%s", name ? name + 1 : path);
+    entry->type = nodes[n].is_dir ? FS_DIR_ENTRY_DIR : FS_DIR_ENTRY_FILE;
+    entry->size = nodes[n].size;
+    return 0;
+}
+
+static int mkdir_locked(const char *path)
+{
+    if (node_find(path) >= 0) {
+        return -EEXIST;
+    }
+    if (!parent_exists(path)) {
+        return -ENOENT;
+    }
+    node_create(path, true);
+    return 0;
+}
+
+static int opendir_locked(struct fs_dir_t *d, const char *path)
+{
+    int n = node_find(path);
+    if (n < 0 || !nodes[n].is_dir) {
+        return -ENOENT;
+    }
+    snprintf(d->dir, sizeof(d->dir), "%s", path);
+    d->next = 0;
+    d->open = true;
+    return 0;
+}
+
+/* An empty name marks the end of the directory, as in Zephyr */
+static int readdir_locked(struct fs_dir_t *d, struct fs_dirent *entry)
+{
+    if (!d->open) {
+        return -EBADF;
+    }
+    size_t dlen = strlen(d->dir);
+    while (d->next < node_count) {
+        struct fs_node *node = &nodes[d->next++];
+        if (!node->live || strncmp(node->path, d->dir, dlen) != 0 || node->path[dlen] != '/' ||
+            strchr(node->path + dlen + 1, '/') != NULL) {
+            continue;
+        }
+        snprintf(entry->name, sizeof(entry->name), "%s", node->path + dlen + 1);
+        entry->type = node->is_dir ? FS_DIR_ENTRY_DIR : FS_DIR_ENTRY_FILE;
+        entry->size = node->size;
+        return 0;
+    }
+    entry->name[0] = '\0';
+    return 0;
+}
+
+int fs_closedir(struct fs_dir_t *d)
+{
+    d->open = false;
+    return 0;
+}
+
+/* The API proper: each call holds the card */
+
+int fs_open(struct fs_file_t *f, const char *path, int flags)
+{
+    pthread_mutex_lock(&card_lock);
+    int ret = open_locked(f, path, flags);
+    pthread_mutex_unlock(&card_lock);
+    return ret;
+}
+
+ssize_t fs_read(struct fs_file_t *f, void *buf, size_t len)
+{
+    pthread_mutex_lock(&card_lock);
+    ssize_t ret = read_locked(f, buf, len);
+    pthread_mutex_unlock(&card_lock);
+    return ret;
+}
+
+ssize_t fs_write(struct fs_file_t *f, const void *buf, size_t len)
+{
+    pthread_mutex_lock(&card_lock);
+    ssize_t ret = write_locked(f, buf, len);
+    pthread_mutex_unlock(&card_lock);
+    return ret;
+}
+
+int fs_seek(struct fs_file_t *f, off_t offset, int whence)
+{
+    pthread_mutex_lock(&card_lock);
+    int ret = seek_locked(f, offset, whence);
+    pthread_mutex_unlock(&card_lock);
+    return ret;
+}
+
+int fs_truncate(struct fs_file_t *f, off_t length)
+{
+    pthread_mutex_lock(&card_lock);
+    int ret = truncate_locked(f, length);
+    pthread_mutex_unlock(&card_lock);
+    return ret;
+}
+
+/* FatFs seeks past the end of a file opened for writing by allocating
+ * clusters, leaving their contents undefined; zeros here */
+FRESULT f_lseek(FIL *fp, FSIZE_t ofs)
+{
+    pthread_mutex_lock(&card_lock);
+    FRESULT res = FR_OK;
+    if (fp->node < 0) {
+        res = FR_INVALID_OBJECT;
+    } else if (ofs > nodes[fp->node].size && (fp->flags & FS_O_WRITE)) {
+        if (fs_op(FAKE_FS_EXTEND) != 0) {
+            res = FR_DISK_ERR;
+        } else {
+            truncate_locked(fp, (off_t) ofs);
+        }
+    }
+    if (res == FR_OK) {
+        fp->pos = (off_t) MIN(ofs, nodes[fp->node].size);
+    }
+    pthread_mutex_unlock(&card_lock);
+    return res;
+}
+
+int fs_unlink(const char *path)
+{
+    pthread_mutex_lock(&card_lock);
+    int ret = unlink_locked(path);
+    pthread_mutex_unlock(&card_lock);
+    return ret;
+}
+
+int fs_rename(const char *from, const char *to)
+{
+    pthread_mutex_lock(&card_lock);
+    int ret = rename_locked(from, to);
+    pthread_mutex_unlock(&card_lock);
+    return ret;
+}
+
+int fs_stat(const char *path, struct fs_dirent *entry)
+{
+    pthread_mutex_lock(&card_lock);
+    int ret = stat_locked(path, entry);
+    pthread_mutex_unlock(&card_lock);
+    return ret;
+}
+
+int fs_mkdir(const char *path)
+{
+    pthread_mutex_lock(&card_lock);
+    int ret = mkdir_locked(path);
+    pthread_mutex_unlock(&card_lock);
+    return ret;
+}
+
+int fs_opendir(struct fs_dir_t *d, const char *path)
+{
+    pthread_mutex_lock(&card_lock);
+    int ret = opendir_locked(d, path);
+    pthread_mutex_unlock(&card_lock);
+    return ret;
+}
+
+int fs_readdir(struct fs_dir_t *d, struct fs_dirent *entry)
+{
+    pthread_mutex_lock(&card_lock);
+    int ret = readdir_locked(d, entry);
+    pthread_mutex_unlock(&card_lock);
+    return ret;
+}
+
+/* ── Microphone ─────────────────────────────────────────────────────────────
+ * The PDM's DMA is a host thread: every block period it takes a block from
+ * the stream's slab, fills it and queues it for dmic_read(). A trigger bumps
+ * the generation, which ends the thread of the one before.
+ */
+
+const struct device fake_device_dmic0 = { "pdm0" };
+NRF_PDM_Type        fake_pdm0;
+
+void (*fake_dmic_fill)(int16_t *interleaved, size_t frames, uint64_t first);
+
+#define DMIC_QUEUE_BLOCKS 16
+
+static struct pcm_stream_cfg  dmic_stream;
+static struct k_msgq          dmic_q;
+static char                   dmic_q_buf[DMIC_QUEUE_BLOCKS * sizeof(void *)];
+static uint32_t               dmic_speedup = 1;
+static uint32_t               dmic_generation;   /* kernel_lock */
+static uint64_t               dmic_next_pair;    /* DMA thread only */
+static struct fake_dmic_stats dmic_stats;        /* kernel_lock */
+
+void fake_dmic_set_speedup(uint32_t speedup)
+{
+    dmic_speedup = speedup ? speedup : 1;
+}
+
+struct fake_dmic_stats fake_dmic_stats(void)
+{
+    pthread_mutex_lock(&kernel_lock);
+    struct fake_dmic_stats stats = dmic_stats;
+    pthread_mutex_unlock(&kernel_lock);
+    return stats;
+}
+
+static bool dmic_count(uint32_t generation, bool delivered)
+{
+    pthread_mutex_lock(&kernel_lock);
+    bool live = dmic_generation == generation;
+    if (live) {
+        *(delivered ? &dmic_stats.blocks : &dmic_stats.overruns) += 1;
+    }
+    pthread_mutex_unlock(&kernel_lock);
+    return live;
+}
+
+static void *dmic_dma(void *arg)
+{
+    uint32_t generation = (uint32_t) (uintptr_t) arg;
+    size_t   pairs = dmic_stream.block_size / (2 * sizeof(int16_t));
+    int64_t  period_us = (int64_t) pairs * 1000000 / dmic_stream.pcm_rate / dmic_speedup;
+
+    for (int64_t due = now_us() + period_us;; due += period_us) {
+        sleep_until_us(due);
+        void *block;
+        if (k_mem_slab_alloc(dmic_stream.mem_slab, &block, K_NO_WAIT) != 0) {
+            dmic_next_pair += pairs;
+            if (!dmic_count(generation, false)) {
+                return NULL;
+            }
+            continue;
+        }
+        if (fake_dmic_fill) {
+            fake_dmic_fill(block, pairs, dmic_next_pair);
+        } else {
+            memset(block, 0, dmic_stream.block_size);
+        }
+        dmic_next_pair += pairs;
+        bool queued = k_msgq_put(&dmic_q, &block, K_NO_WAIT) == 0;
+        if (!queued) {
+            k_mem_slab_free(dmic_stream.mem_slab, block);
+        }
+        if (!dmic_count(generation, queued)) {
+            return NULL;
+        }
+    }
+}
+
+int dmic_configure(const struct device *dev, struct dmic_cfg *cfg)
+{
+    (void) dev;
+    if (cfg->channel.req_num_streams != 1 || cfg->channel.req_num_chan != 2 || cfg->streams->pcm_width != 16 ||
+        cfg->streams->block_size % (2 * sizeof(int16_t)) != 0) {
+        return -EINVAL;
+    }
+    dmic_stream = cfg->streams[0];
+    dmic_next_pair = 0;
+    k_msgq_init(&dmic_q, dmic_q_buf, sizeof(void *), DMIC_QUEUE_BLOCKS);
+    return 0;
+}
+
+int dmic_trigger(const struct device *dev, enum dmic_trigger cmd)
+{
+    (void) dev;
+    assert(threads_enabled);
+    pthread_mutex_lock(&kernel_lock);
+    uint32_t generation = ++dmic_generation;
+    pthread_mutex_unlock(&kernel_lock);
+
+    if (cmd == DMIC_TRIGGER_START) {
+        pthread_t tid;
+        pthread_create(&tid, NULL, dmic_dma, (void *) (uintptr_t) generation);
+        pthread_detach(tid);
+    } else {
+        void *block;
+        while (k_msgq_get(&dmic_q, &block, K_NO_WAIT) == 0) {
+            k_mem_slab_free(dmic_stream.mem_slab, block);
+        }
+    }
+    return 0;
+}
+
+int dmic_read(const struct device *dev, uint8_t stream, void **buffer, uint32_t *size, int32_t timeout)
+{
+    (void) dev, (void) stream;
+    int err = k_msgq_get(&dmic_q, buffer, K_MSEC(timeout));
+    if (err) {
+        return -EAGAIN;
+    }
+    *size = dmic_stream.block_size;
+    return 0;
+}
+
+/* ── Bluetooth ──────────────────────────────────────────────────────────────
+ * Notifications in flight wait in a FIFO under kernel_lock. The link thread
+ * completes the head once it has been on air for air_time_us, counted from
+ * when it was queued or the previous one completed, whichever is later.
+ */
+
+#define TX_QUEUE_MAX 64
+
+#ifndef CONFIG_BT_CONN_TX_MAX
+#define CONFIG_BT_CONN_TX_MAX 10
+#endif
+
+struct pending_tx {
+    struct bt_conn         *conn;
+    bt_gatt_complete_func_t func;
+    void                   *user_data;
+    int64_t                 queued_us;
+};
+
+int (*fake_bt_notify_hook)(const void *data, uint16_t len);
+uint16_t fake_bt_mtu = 247;
+uint16_t fake_bt_tx_max = CONFIG_BT_CONN_TX_MAX;
+
+static struct pending_tx         tx_queue[TX_QUEUE_MAX];
+static uint32_t                  tx_head;
+static uint32_t                  tx_used;
+static uint32_t                  air_time_us;
+static bool                      tx_held;
+static bool                      link_started;
+static int64_t                   link_last_done;
+static int64_t                   link_idle_since = -1;   /* -1: busy, or nothing sent yet */
+static struct fake_bt_link_stats link_stats;
+
+/* With kernel_lock held */
+static struct pending_tx tx_pop(void)
+{
+    struct pending_tx tx = tx_queue[tx_head];
+    tx_head = (tx_head + 1) % TX_QUEUE_MAX;
+    if (--tx_used == 0) {
+        link_idle_since = now_us();
+    }
+    link_last_done = now_us();
+    return tx;
+}
+
+static void *link_main(void *arg)
+{
+    (void) arg;
+    pthread_mutex_lock(&kernel_lock);
+    while (true) {
+        if (tx_used == 0 || tx_held || air_time_us == 0) {
+            pthread_cond_wait(&kernel_changed, &kernel_lock);
+            continue;
+        }
+        int64_t due = MAX(tx_queue[tx_head].queued_us, link_last_done) + air_time_us;
+        pthread_mutex_unlock(&kernel_lock);
+        sleep_until_us(due);
+        pthread_mutex_lock(&kernel_lock);
+        if (tx_used == 0 || tx_held) {
+            continue;
+        }
+        struct pending_tx tx = tx_pop();
+        link_last_done = due;
+        kernel_unlock_changed();
+        if (tx.func) {
+            tx.func(tx.conn, tx.user_data);
+        }
+        pthread_mutex_lock(&kernel_lock);
+    }
+    return NULL;
+}
+
+void fake_bt_set_air_time(uint32_t us)
+{
+    assert(us == 0 || threads_enabled);
+    pthread_mutex_lock(&kernel_lock);
+    air_time_us = us;
+    if (us && !link_started) {
+        pthread_t tid;
+        pthread_create(&tid, NULL, link_main, NULL);
+        pthread_detach(tid);
+        link_started = true;
+    }
+    kernel_unlock_changed();
+}
+
+void fake_bt_hold_completions(bool hold)
+{
+    pthread_mutex_lock(&kernel_lock);
+    tx_held = hold;
+    kernel_unlock_changed();
+}
+
+uint32_t fake_bt_complete(uint32_t count)
+{
+    uint32_t done = 0;
+    pthread_mutex_lock(&kernel_lock);
+    while (done < count && tx_used > 0) {
+        struct pending_tx tx = tx_pop();
+        kernel_unlock_changed();
+        if (tx.func) {
+            tx.func(tx.conn, tx.user_data);
+        }
+        done++;
+        pthread_mutex_lock(&kernel_lock);
+    }
+    pthread_mutex_unlock(&kernel_lock);
+    return done;
+}
+
+struct fake_bt_link_stats fake_bt_link_stats(void)
+{
+    pthread_mutex_lock(&kernel_lock);
+    struct fake_bt_link_stats stats = link_stats;
+    stats.in_flight = tx_used;
+    pthread_mutex_unlock(&kernel_lock);
+    return stats;
+}
+
+void fake_bt_link_stats_reset(void)
+{
+    pthread_mutex_lock(&kernel_lock);
+    link_stats = (struct fake_bt_link_stats){ 0 };
+    link_stats.max_in_flight = tx_used;
+    link_idle_since = -1;
+    pthread_mutex_unlock(&kernel_lock);
+}
+
+struct bt_conn *bt_conn_ref(struct bt_conn *conn)
+{
+    conn->refs++;
+    return conn;
+}
+
+void bt_conn_unref(struct bt_conn *conn)
+{
+    conn->refs--;
+}
+
+/* The hook sees what reaches the phone, so it runs only for notifications
+ * the controller accepts */
+int bt_gatt_notify_cb(struct bt_conn *conn, struct bt_gatt_notify_params *params)
+{
+    pthread_mutex_lock(&kernel_lock);
+    bool queued = air_time_us != 0 || tx_held;
+    if (queued && tx_used >= MIN(fake_bt_tx_max, TX_QUEUE_MAX)) {
+        link_stats.refused++;
+        pthread_mutex_unlock(&kernel_lock);
+        return -ENOMEM;
+    }
+    pthread_mutex_unlock(&kernel_lock);
+
+    int err = fake_bt_notify_hook ? fake_bt_notify_hook(params->data, params->len) : 0;
+    if (err) {
+        return err;
+    }
+
+    pthread_mutex_lock(&kernel_lock);
+    link_stats.sent++;
+    if (!queued) {
+        pthread_mutex_unlock(&kernel_lock);
+        if (params->func) {
+            params->func(conn, params->user_data);
+        }
+        return 0;
+    }
+    int64_t now = now_us();
+    if (link_idle_since >= 0) {
+        link_stats.idle_us += now - link_idle_since;
+        link_idle_since = -1;
+    }
+    tx_queue[(tx_head + tx_used) % TX_QUEUE_MAX] =
+        (struct pending_tx){ conn, params->func, params->user_data, now };
+    tx_used++;
+    link_stats.max_in_flight = MAX(link_stats.max_in_flight, tx_used);
+    kernel_unlock_changed();
+    return 0;
+}
+
+int bt_gatt_notify(struct bt_conn *conn, const struct bt_gatt_attr *attr, const void *data, uint16_t len)
+{
+    struct bt_gatt_notify_params params = { .attr = attr, .data = data, .len = len };
+    return bt_gatt_notify_cb(conn, &params);
+}
+
+uint16_t bt_gatt_get_mtu(struct bt_conn *conn)
+{
+    (void) conn;
+    return fake_bt_mtu;
+}
+
+ssize_t bt_gatt_attr_read(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf, uint16_t buf_len,
+                          uint16_t offset, const void *value, uint16_t value_len)
+{
+    (void) conn, (void) attr;
+    if (offset > value_len) {
+        return BT_GATT_ERR(0x07);
+    }
+    uint16_t len = MIN(buf_len, value_len - offset);
+    memcpy(buf, (const uint8_t *) value + offset, len);
+    return len;
+}
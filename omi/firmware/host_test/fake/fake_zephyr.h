@@ -0,0 +1,139 @@
+#ifndef FAKE_ZEPHYR_H
+#define FAKE_ZEPHYR_H
+
+/* Test-side controls of the host Zephyr stand-in (fake/zephyr/...) */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/fs/fs.h>
+
+/* Start threads for real from now on (see zephyr/kernel.h). Call before the
+ * module under test creates its threads; there is no way back. */
+void fake_threads_enable(void);
+
+/* Run every submitted work item, including ones submitted meanwhile */
+void fake_work_run_all(void);
+
+/* Run the next submitted work item; NULL if there was none */
+struct k_work *fake_work_run_one(void);
+
+/* ── File system ────────────────────────────────────────────────────────────*/
+
+enum fake_fs_op {
+    FAKE_FS_OPEN,
+    FAKE_FS_READ,
+    FAKE_FS_WRITE,
+    FAKE_FS_UNLINK,
+    FAKE_FS_RENAME,
+    FAKE_FS_EXTEND,   /* f_lseek() past the end of a file (ff.h) */
+    FAKE_FS_OP_COUNT,
+};
+
+/* Forget every file and directory and all latencies */
+void fake_fs_reset(void);
+
+/* Spend @p us microseconds in every call of @p op: busy-waiting, or with
+ * threads enabled, sleeping while the card is held, as a DMA transfer would */
+void fake_fs_set_latency(enum fake_fs_op op, uint32_t us);
+
+/* Make the next @p count calls of @p op fail with -EIO */
+void fake_fs_fail_next(enum fake_fs_op op, uint32_t count);
+
+/* Number of calls of @p op since the last reset */
+uint32_t fake_fs_calls(enum fake_fs_op op);
+
+bool fake_fs_exists(const char *path);
+
+/* Create (or replace) a file holding @p len bytes of @p data */
+int fake_fs_put(const char *path, const void *data, size_t len);
+
+/* Called for every fs_write() that reaches the card, with the file's offset
+ * at the time */
+extern void (*fake_fs_write_hook)(const char *path, off_t offset, size_t len);
+
+/* Called for every fs_unlink() that reaches the card */
+extern void (*fake_fs_unlink_hook)(const char *path);
+
+/* ── Bluetooth ──────────────────────────────────────────────────────────────*/
+
+/* Called for every notification; a non-zero return is passed back to the
+ * caller of bt_gatt_notify_cb() and the notification is dropped */
+extern int (*fake_bt_notify_hook)(const void *data, uint16_t len);
+
+extern uint16_t fake_bt_mtu;
+
+/* Notifications the controller can hold (CONFIG_BT_CONN_TX_MAX). While that
+ * many are in flight, bt_gatt_notify_cb() fails with -ENOMEM. */
+extern uint16_t fake_bt_tx_max;
+
+/* Link model. With an air time (threads enabled), notifications queue in the
+ * controller and a link thread completes them in order, one per @p us. 0,
+ * the default, completes each one before bt_gatt_notify_cb() returns. */
+void fake_bt_set_air_time(uint32_t us);
+
+/* Keep queued notifications in flight until fake_bt_complete(); @p hold
+ * queues them even without an air time */
+void fake_bt_hold_completions(bool hold);
+
+/* Complete up to @p count notifications in flight, oldest first; returns how
+ * many were */
+uint32_t fake_bt_complete(uint32_t count);
+
+struct fake_bt_link_stats {
+    uint32_t sent;            /* notifications accepted */
+    uint32_t refused;         /* -ENOMEM: the controller queue was full */
+    uint32_t in_flight;
+    uint32_t max_in_flight;
+    int64_t  idle_us;         /* time the queue sat empty between two notifications */
+};
+
+struct fake_bt_link_stats fake_bt_link_stats(void);
+void fake_bt_link_stats_reset(void);
+
+/* ── Microphone ─────────────────────────────────────────────────────────────*/
+
+/* Deliver DMIC blocks @p speedup times faster than real time (default 1) */
+void fake_dmic_set_speedup(uint32_t speedup);
+
+/* Fills each block with @p frames interleaved left/right sample pairs, the
+ * first being pair @p first of the stream since dmic_configure(). Silence
+ * when NULL. */
+extern void (*fake_dmic_fill)(int16_t *interleaved, size_t frames, uint64_t first);
+
+struct fake_dmic_stats {
+    uint32_t blocks;     /* queued for dmic_read() */
+    uint32_t overruns;   /* block periods lost to an empty slab or a full queue */
+};
+
+struct fake_dmic_stats fake_dmic_stats(void);
+
+/* ── Checks ─────────────────────────────────────────────────────────────────*/
+
+extern int fake_test_failures;
+
+#define CHECK(cond)                                                                                \
+    do {                                                                                           \
+        if (!(cond)) {                                                                             \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond);               \
+            fake_test_failures++;                                                                  \
+        }                                                                                          \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                                             \
+    do {                                                                                           \
+        long long _a = (long long) (a), _b = (long long) (b);                                      \
+        if (_a != _b) {                                                                            \
+            fprintf(stderr, "%s:%d: CHECK_EQ failed: %s = %lld, %s = %lld\n", __FILE__, __LINE__,  \
+                    #a, _a, #b, _b);                                                               \
+            fake_test_failures++;                                                                  \
+        }                                                                                          \
+    } while (0)
+
+/* Exit status for main() */
+int fake_test_result(const char *name);
+
+#endif /* FAKE_ZEPHYR_H */
@@ -0,0 +1,24 @@
+#ifndef FAKE_FF_H
+#define FAKE_FF_H
+
+/* The corner of ELM FatFs the firmware reaches past Zephyr's fs API for:
+ * seeking an open file (fs_file_t.filep) past its end to preallocate it */
+
+#include <stdint.h>
+
+#include <zephyr/fs/fs.h>
+
+typedef struct fs_file_t FIL;
+typedef uint32_t         FSIZE_t;
+
+typedef enum {
+    FR_OK = 0,
+    FR_DISK_ERR = 1,
+    FR_INVALID_OBJECT = 9,
+} FRESULT;
+
+FRESULT f_lseek(FIL *fp, FSIZE_t ofs);
+
+#define f_tell(fp) ((FSIZE_t) (fp)->pos)
+
+#endif /* FAKE_FF_H */
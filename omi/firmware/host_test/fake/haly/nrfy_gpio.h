@@ -0,0 +1,7 @@
+#ifndef FAKE_HALY_NRFY_GPIO_H
+#define FAKE_HALY_NRFY_GPIO_H
+
+/* Only the pin mapping, for config.h */
+#define NRF_GPIO_PIN_MAP(port, pin) (((port) << 5) | ((pin) & 0x1F))
+
+#endif /* FAKE_HALY_NRFY_GPIO_H */
@@ -0,0 +1,23 @@
+#ifndef FAKE_NRFX_PDM_H
+#define FAKE_NRFX_PDM_H
+
+/* The PDM gain register; the modelled microphone (zephyr/audio/dmic.h)
+ * delivers its samples unscaled whatever it is set to */
+
+#include <stdint.h>
+
+typedef struct {
+    uint8_t gain_l, gain_r;
+} NRF_PDM_Type;
+
+extern NRF_PDM_Type fake_pdm0;
+
+#define NRF_PDM0_NS (&fake_pdm0)
+
+static inline void nrf_pdm_gain_set(NRF_PDM_Type *reg, uint8_t gain_l, uint8_t gain_r)
+{
+    reg->gain_l = gain_l;
+    reg->gain_r = gain_r;
+}
+
+#endif /* FAKE_NRFX_PDM_H */
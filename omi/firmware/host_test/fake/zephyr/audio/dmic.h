@@ -0,0 +1,69 @@
+#ifndef FAKE_ZEPHYR_AUDIO_DMIC_H
+#define FAKE_ZEPHYR_AUDIO_DMIC_H
+
+/*
+ * The DMIC API over a modelled PDM peripheral. Once started it fills a block
+ * of the configured size from the stream's slab every block period, from a
+ * thread of its own as the DMA would, and dmic_read() waits for the next one.
+ * With no free block the period's samples are lost, as on the nRF driver.
+ * Needs fake_threads_enable(); fake_zephyr.h sets what the blocks hold and
+ * how fast they come.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zephyr/device.h>
+#include <zephyr/kernel.h>
+
+enum dmic_trigger {
+    DMIC_TRIGGER_STOP,
+    DMIC_TRIGGER_START,
+};
+
+enum pdm_lr {
+    PDM_CHAN_LEFT,
+    PDM_CHAN_RIGHT,
+};
+
+struct pdm_io_cfg {
+    uint32_t min_pdm_clk_freq;
+    uint32_t max_pdm_clk_freq;
+    uint8_t  min_pdm_clk_dc;
+    uint8_t  max_pdm_clk_dc;
+};
+
+struct pcm_stream_cfg {
+    uint32_t            pcm_rate;
+    uint8_t             pcm_width;
+    uint16_t            block_size;
+    struct k_mem_slab  *mem_slab;
+};
+
+struct pdm_chan_cfg {
+    uint32_t req_chan_map_lo;
+    uint32_t req_chan_map_hi;
+    uint8_t  req_num_chan;
+    uint8_t  act_num_chan;
+    uint8_t  req_num_streams;
+    uint8_t  act_num_streams;
+};
+
+struct dmic_cfg {
+    struct pdm_io_cfg      io;
+    struct pcm_stream_cfg *streams;
+    struct pdm_chan_cfg    channel;
+};
+
+static inline uint32_t dmic_build_channel_map(uint8_t channel, uint8_t pdm, enum pdm_lr lr)
+{
+    return (uint32_t) ((pdm << 1) | lr) << (channel * 4);
+}
+
+int dmic_configure(const struct device *dev, struct dmic_cfg *cfg);
+int dmic_trigger(const struct device *dev, enum dmic_trigger cmd);
+
+/* @p size is a size_t on the target, where that is 32 bits */
+int dmic_read(const struct device *dev, uint8_t stream, void **buffer, uint32_t *size, int32_t timeout);
+
+#endif /* FAKE_ZEPHYR_AUDIO_DMIC_H */
@@ -0,0 +1,6 @@
+#ifndef FAKE_ZEPHYR_BLUETOOTH_BLUETOOTH_H
+#define FAKE_ZEPHYR_BLUETOOTH_BLUETOOTH_H
+
+#include <zephyr/bluetooth/conn.h>
+
+#endif /* FAKE_ZEPHYR_BLUETOOTH_BLUETOOTH_H */
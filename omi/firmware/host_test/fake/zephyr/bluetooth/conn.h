@@ -0,0 +1,21 @@
+#ifndef FAKE_ZEPHYR_BLUETOOTH_CONN_H
+#define FAKE_ZEPHYR_BLUETOOTH_CONN_H
+
+#include <stdint.h>
+
+struct bt_conn {
+    int refs;
+};
+
+struct bt_conn_cb {
+    void (*connected)(struct bt_conn *conn, uint8_t err);
+    void (*disconnected)(struct bt_conn *conn, uint8_t reason);
+};
+
+/* Registered callbacks are not called by the fake; tests call them directly */
+#define BT_CONN_CB_DEFINE(name) static const struct bt_conn_cb name __attribute__((unused))
+
+struct bt_conn *bt_conn_ref(struct bt_conn *conn);
+void bt_conn_unref(struct bt_conn *conn);
+
+#endif /* FAKE_ZEPHYR_BLUETOOTH_CONN_H */
@@ -0,0 +1,73 @@
+#ifndef FAKE_ZEPHYR_BLUETOOTH_GATT_H
+#define FAKE_ZEPHYR_BLUETOOTH_GATT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/uuid.h>
+
+#define BT_ATT_ERR_INVALID_ATTRIBUTE_LEN 0x0d
+#define BT_GATT_ERR(att_err)             (-(att_err))
+
+#define BT_GATT_CHRC_READ               0x02
+#define BT_GATT_CHRC_WRITE_WITHOUT_RESP 0x04
+#define BT_GATT_CHRC_WRITE              0x08
+#define BT_GATT_CHRC_NOTIFY             0x10
+
+#define BT_GATT_PERM_NONE  0
+#define BT_GATT_PERM_READ  0x01
+#define BT_GATT_PERM_WRITE 0x02
+
+#define BT_GATT_CCC_NOTIFY 0x0001
+
+struct bt_gatt_attr;
+
+typedef ssize_t (*bt_gatt_attr_read_func_t)(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf,
+                                            uint16_t len, uint16_t offset);
+typedef ssize_t (*bt_gatt_attr_write_func_t)(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                                             const void *buf, uint16_t len, uint16_t offset, uint8_t flags);
+
+struct bt_gatt_attr {
+    const struct bt_uuid     *uuid;
+    bt_gatt_attr_read_func_t  read;
+    bt_gatt_attr_write_func_t write;
+    void                     *user_data;
+    uint16_t                  perm;
+};
+
+struct bt_gatt_service_static {
+    const struct bt_gatt_attr *attrs;
+    size_t                     attr_count;
+};
+
+/* Same attribute layout as Zephyr: a characteristic is a declaration
+ * followed by its value, a CCC is one descriptor */
+#define BT_GATT_PRIMARY_SERVICE(uuid) { (uuid), NULL, NULL, NULL, BT_GATT_PERM_READ }
+#define BT_GATT_CHARACTERISTIC(uuid, props, perm, read, write, data)                               \
+    { NULL, NULL, NULL, NULL, BT_GATT_PERM_READ }, { (uuid), (read), (write), (data), (perm) }
+#define BT_GATT_CCC(changed, perm) { NULL, NULL, NULL, (void *) (changed), (perm) }
+
+#define BT_GATT_SERVICE_DEFINE(name, ...)                                                          \
+    static const struct bt_gatt_attr _attrs_##name[] = { __VA_ARGS__ };                            \
+    const struct bt_gatt_service_static name = { _attrs_##name, sizeof(_attrs_##name) / sizeof(_attrs_##name[0]) }
+
+typedef void (*bt_gatt_complete_func_t)(struct bt_conn *conn, void *user_data);
+
+struct bt_gatt_notify_params {
+    const struct bt_uuid      *uuid;
+    const struct bt_gatt_attr *attr;
+    const void                *data;
+    uint16_t                   len;
+    bt_gatt_complete_func_t    func;
+    void                      *user_data;
+};
+
+int      bt_gatt_notify_cb(struct bt_conn *conn, struct bt_gatt_notify_params *params);
+int      bt_gatt_notify(struct bt_conn *conn, const struct bt_gatt_attr *attr, const void *data, uint16_t len);
+uint16_t bt_gatt_get_mtu(struct bt_conn *conn);
+ssize_t  bt_gatt_attr_read(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf, uint16_t buf_len,
+                           uint16_t offset, const void *value, uint16_t value_len);
+
+#endif /* FAKE_ZEPHYR_BLUETOOTH_GATT_H */
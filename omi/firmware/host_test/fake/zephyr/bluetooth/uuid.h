@@ -0,0 +1,12 @@
+#ifndef FAKE_ZEPHYR_BLUETOOTH_UUID_H
+#define FAKE_ZEPHYR_BLUETOOTH_UUID_H
+
+/* UUIDs are not compared on the host; services keep their layout only */
+struct bt_uuid {
+    int type;
+};
+
+#define BT_UUID_128_ENCODE(w32, w1, w2, w3, w48) 0
+#define BT_UUID_DECLARE_128(value)               ((const struct bt_uuid *) 0)
+
+#endif /* FAKE_ZEPHYR_BLUETOOTH_UUID_H */
@@ -0,0 +1,19 @@
+#ifndef FAKE_ZEPHYR_DRIVERS_RTC_H
+#define FAKE_ZEPHYR_DRIVERS_RTC_H
+
+/* Only the type settings.h passes around */
+
+struct rtc_time {
+    int tm_sec;
+    int tm_min;
+    int tm_hour;
+    int tm_mday;
+    int tm_mon;
+    int tm_year;
+    int tm_wday;
+    int tm_yday;
+    int tm_isdst;
+    int tm_nsec;
+};
+
+#endif /* FAKE_ZEPHYR_DRIVERS_RTC_H */
@@ -0,0 +1,83 @@
+#ifndef FAKE_ZEPHYR_FS_FS_H
+#define FAKE_ZEPHYR_FS_FS_H
+
+/*
+ * In-memory file system behind the Zephyr fs_* API. Paths are flat strings;
+ * a directory lists the files whose path is "<dir>/<name>". Each operation
+ * can be given a latency (fake_fs_set_latency()) to stand in for a slow card.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define MAX_FILE_NAME 255
+
+#define FS_O_READ    0x01
+#define FS_O_WRITE   0x02
+#define FS_O_RDWR    (FS_O_READ | FS_O_WRITE)
+#define FS_O_CREATE  0x10
+#define FS_O_APPEND  0x20
+#define FS_O_TRUNC   0x40
+
+#define FS_SEEK_SET 0
+#define FS_SEEK_CUR 1
+#define FS_SEEK_END 2
+
+enum fs_dir_entry_type {
+    FS_DIR_ENTRY_FILE = 0,
+    FS_DIR_ENTRY_DIR,
+};
+
+struct fs_dirent {
+    enum fs_dir_entry_type type;
+    char                   name[MAX_FILE_NAME + 1];
+    size_t                 size;
+};
+
+struct fs_file_t {
+    int   node;
+    off_t pos;
+    int   flags;
+    void *filep;   /* the file itself, as the FIL of ff.h */
+};
+
+struct fs_dir_t {
+    char dir[MAX_FILE_NAME + 1];
+    int  next;
+    bool open;
+};
+
+static inline void fs_file_t_init(struct fs_file_t *f)
+{
+    f->node = -1;
+    f->pos = 0;
+    f->flags = 0;
+    f->filep = NULL;
+}
+
+static inline void fs_dir_t_init(struct fs_dir_t *d)
+{
+    d->dir[0] = '\0';
+    d->next = 0;
+    d->open = false;
+}
+
+int     fs_open(struct fs_file_t *f, const char *path, int flags);
+int     fs_close(struct fs_file_t *f);
+ssize_t fs_read(struct fs_file_t *f, void *buf, size_t len);
+ssize_t fs_write(struct fs_file_t *f, const void *buf, size_t len);
+int     fs_seek(struct fs_file_t *f, off_t offset, int whence);
+off_t   fs_tell(struct fs_file_t *f);
+int     fs_truncate(struct fs_file_t *f, off_t length);
+int     fs_sync(struct fs_file_t *f);
+int     fs_unlink(const char *path);
+int     fs_rename(const char *from, const char *to);
+int     fs_stat(const char *path, struct fs_dirent *entry);
+int     fs_mkdir(const char *path);
+int     fs_opendir(struct fs_dir_t *d, const char *path);
+int     fs_readdir(struct fs_dir_t *d, struct fs_dirent *entry);
+int     fs_closedir(struct fs_dir_t *d);
+
+#endif /* FAKE_ZEPHYR_FS_FS_H */
@@ -0,0 +1,273 @@
+#ifndef FAKE_ZEPHYR_KERNEL_H
+#define FAKE_ZEPHYR_KERNEL_H
+
+/*
+ * Host stand-in for the parts of the Zephyr kernel API the RecLo modules use.
+ *
+ * By default everything runs on the test's own thread: k_thread_create() does
+ * not start anything, timers never fire, message queues, memory slabs and
+ * semaphores never block (an empty queue or slab or a taken semaphore fails
+ * at once, whatever the timeout), and submitted work items run when the test
+ * calls fake_work_run_all() or k_work_flush().
+ *
+ * After fake_threads_enable() (fake_zephyr.h), k_thread_create() starts a
+ * host thread and semaphores, message queues, slabs and mutexes wait for
+ * their timeout as on the target. Priorities are ignored. Work items still run only
+ * when called for.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/* ── Utilities ──────────────────────────────────────────────────────────────*/
+
+#define ARG_UNUSED(x)     (void) (x)
+#define __aligned(x)      __attribute__((aligned(x)))
+#define __ALIGN(x)        __aligned(x)
+#define BIT(n)            (1UL << (n))
+#ifndef MIN
+#define MIN(a, b)         ((a) < (b) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a, b)         ((a) > (b) ? (a) : (b))
+#endif
+#define ARRAY_SIZE(a)     (sizeof(a) / sizeof((a)[0]))
+#define DIV_ROUND_UP(n, d) (((n) + (d) - 1) / (d))
+#define ROUND_UP(x, a)    ((((x) + (a) - 1) / (a)) * (a))
+#define CLAMP(v, lo, hi)  MIN(MAX(v, lo), hi)
+
+#define __ASSERT_NO_MSG(test)  assert(test)
+
+/* IS_ENABLED(CONFIG_X): 1 when CONFIG_X is defined to 1, else 0 */
+#define _FAKE_XXXX1                         _FAKE_YYYY,
+#define IS_ENABLED(config_macro)            _FAKE_IS_ENABLED1(config_macro)
+#define _FAKE_IS_ENABLED1(config_macro)     _FAKE_IS_ENABLED2(_FAKE_XXXX##config_macro)
+#define _FAKE_IS_ENABLED2(one_or_two_args)  _FAKE_IS_ENABLED3(one_or_two_args 1, 0)
+#define _FAKE_IS_ENABLED3(ignore, val, ...) val
+
+/* ── Timeouts and time ──────────────────────────────────────────────────────*/
+
+typedef struct {
+    int64_t ms;
+} k_timeout_t;
+
+#define K_FOREVER     ((k_timeout_t){ -1 })
+#define K_NO_WAIT     ((k_timeout_t){ 0 })
+#define K_MSEC(x)     ((k_timeout_t){ (x) })
+#define K_SECONDS(x)  ((k_timeout_t){ (int64_t) (x) * 1000 })
+
+/* One tick per microsecond */
+int64_t  k_uptime_get(void);
+int64_t  k_uptime_ticks(void);
+uint64_t k_ticks_to_ms_floor64(uint64_t ticks);
+uint32_t k_cycle_get_32(void);
+uint32_t k_cyc_to_us_floor32(uint32_t cycles);
+int32_t  k_sleep(k_timeout_t timeout);
+int32_t  k_msleep(int32_t ms);
+
+/* ── Atomics ────────────────────────────────────────────────────────────────*/
+
+typedef long atomic_t;
+typedef long atomic_val_t;
+
+#define ATOMIC_INIT(x) (x)
+
+static inline atomic_val_t atomic_get(const atomic_t *a)
+{
+    return __atomic_load_n(a, __ATOMIC_SEQ_CST);
+}
+
+static inline atomic_val_t atomic_set(atomic_t *a, atomic_val_t v)
+{
+    return __atomic_exchange_n(a, v, __ATOMIC_SEQ_CST);
+}
+
+static inline atomic_val_t atomic_inc(atomic_t *a)
+{
+    return __atomic_fetch_add(a, 1, __ATOMIC_SEQ_CST);
+}
+
+static inline atomic_val_t atomic_dec(atomic_t *a)
+{
+    return __atomic_fetch_sub(a, 1, __ATOMIC_SEQ_CST);
+}
+
+static inline atomic_val_t atomic_add(atomic_t *a, atomic_val_t v)
+{
+    return __atomic_fetch_add(a, v, __ATOMIC_SEQ_CST);
+}
+
+static inline atomic_val_t atomic_clear(atomic_t *a)
+{
+    return atomic_set(a, 0);
+}
+
+static inline bool atomic_cas(atomic_t *a, atomic_val_t old, atomic_val_t new_val)
+{
+    return __atomic_compare_exchange_n(a, &old, new_val, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+/* ── Threads ────────────────────────────────────────────────────────────────*/
+
+typedef void (*k_thread_entry_t)(void *, void *, void *);
+
+struct k_thread {
+    const char      *name;
+    k_thread_entry_t entry;   /* K_THREAD_DEFINE() threads, for k_thread_start() */
+    void            *p1, *p2, *p3;
+};
+
+typedef struct k_thread *k_tid_t;
+typedef char k_thread_stack_t;
+
+#define K_THREAD_STACK_DEFINE(name, size)  static k_thread_stack_t name[size]
+#define K_THREAD_STACK_SIZEOF(sym)         sizeof(sym)
+#define K_PRIO_PREEMPT(x)                  (x)
+
+k_tid_t k_thread_create(struct k_thread *thread, k_thread_stack_t *stack, size_t stack_size,
+                        k_thread_entry_t entry, void *p1, void *p2, void *p3, int prio, uint32_t options,
+                        k_timeout_t delay);
+int k_thread_name_set(k_tid_t thread, const char *name);
+
+/* Threads defined this way start only when k_thread_start() is called,
+ * whatever @p delay says */
+#define K_THREAD_DEFINE(tid, stack_size, entry_fn, a1, a2, a3, prio, options, delay)                \
+    static struct k_thread _k_thread_##tid = { #tid, (entry_fn), (a1), (a2), (a3) };                 \
+    const k_tid_t tid = &_k_thread_##tid
+
+void k_thread_start(k_tid_t thread);
+
+/* Only a thread that has not been started can be aborted */
+void k_thread_abort(k_tid_t thread);
+void k_yield(void);
+
+/* ── Timers ─────────────────────────────────────────────────────────────────*/
+
+struct k_timer;
+typedef void (*k_timer_expiry_t)(struct k_timer *timer);
+
+struct k_timer {
+    k_timer_expiry_t expiry;
+    bool             running;
+};
+
+#define K_TIMER_DEFINE(name, expiry_fn, stop_fn) struct k_timer name = { (expiry_fn), false }
+
+static inline void k_timer_start(struct k_timer *timer, k_timeout_t duration, k_timeout_t period)
+{
+    (void) duration, (void) period;
+    timer->running = true;
+}
+
+static inline void k_timer_stop(struct k_timer *timer)
+{
+    timer->running = false;
+}
+
+/* ── Mutexes and semaphores ─────────────────────────────────────────────────*/
+
+struct k_mutex {
+    int         locked;   /* lock depth; the owner may lock again */
+    const void *owner;
+};
+
+#define K_MUTEX_DEFINE(name) struct k_mutex name = { 0 }
+
+int k_mutex_init(struct k_mutex *mutex);
+int k_mutex_lock(struct k_mutex *mutex, k_timeout_t timeout);
+int k_mutex_unlock(struct k_mutex *mutex);
+
+struct k_sem {
+    unsigned int count;
+    unsigned int limit;
+};
+
+#define K_SEM_DEFINE(name, initial, max) struct k_sem name = { (initial), (max) }
+
+int      k_sem_init(struct k_sem *sem, unsigned int initial, unsigned int limit);
+int      k_sem_take(struct k_sem *sem, k_timeout_t timeout);
+void     k_sem_give(struct k_sem *sem);
+unsigned k_sem_count_get(struct k_sem *sem);
+
+/* A spinlock is one host mutex shared by all of them */
+struct k_spinlock {
+    int unused;
+};
+
+typedef struct {
+    int unused;
+} k_spinlock_key_t;
+
+k_spinlock_key_t k_spin_lock(struct k_spinlock *lock);
+void             k_spin_unlock(struct k_spinlock *lock, k_spinlock_key_t key);
+
+/* ── Message queues ─────────────────────────────────────────────────────────*/
+
+struct k_msgq {
+    char    *buf;
+    size_t   msg_size;
+    uint32_t max_msgs;
+    uint32_t head;
+    uint32_t used;
+};
+
+#define K_MSGQ_DEFINE(name, size, max, align)                                                      \
+    static char __aligned(align) _msgq_buf_##name[(size) * (max)];                                \
+    struct k_msgq name = { _msgq_buf_##name, (size), (max), 0, 0 }
+
+void     k_msgq_init(struct k_msgq *q, char *buf, size_t msg_size, uint32_t max_msgs);
+int      k_msgq_put(struct k_msgq *q, const void *data, k_timeout_t timeout);
+int      k_msgq_get(struct k_msgq *q, void *data, k_timeout_t timeout);
+int      k_msgq_peek(struct k_msgq *q, void *data);
+uint32_t k_msgq_num_used_get(struct k_msgq *q);
+void     k_msgq_purge(struct k_msgq *q);
+
+/* ── Memory slabs ───────────────────────────────────────────────────────────*/
+
+struct k_mem_slab {
+    char    *buffer;
+    size_t   block_size;
+    uint32_t num_blocks;
+    uint32_t num_used;
+    char    *free_list;   /* threaded through the free blocks; built on first use */
+    bool     ready;
+};
+
+#define K_MEM_SLAB_DEFINE_STATIC(name, size, count, align)                                         \
+    static char __aligned(align) _slab_buf_##name[(size) * (count)];                              \
+    static struct k_mem_slab name = { _slab_buf_##name, (size), (count), 0, NULL, false }
+
+int      k_mem_slab_alloc(struct k_mem_slab *slab, void **mem, k_timeout_t timeout);
+void     k_mem_slab_free(struct k_mem_slab *slab, void *mem);
+uint32_t k_mem_slab_num_used_get(struct k_mem_slab *slab);
+
+/* ── Work items ─────────────────────────────────────────────────────────────*/
+
+struct k_work;
+typedef void (*k_work_handler_t)(struct k_work *work);
+
+struct k_work {
+    k_work_handler_t handler;
+    bool             pending;
+    struct k_work   *next;
+};
+
+struct k_work_sync {
+    int unused;
+};
+
+struct k_work_delayable {
+    struct k_work work;
+};
+
+void k_work_init(struct k_work *work, k_work_handler_t handler);
+int  k_work_submit(struct k_work *work);
+bool k_work_flush(struct k_work *work, struct k_work_sync *sync);
+void k_work_init_delayable(struct k_work_delayable *dwork, k_work_handler_t handler);
+int  k_work_schedule(struct k_work_delayable *dwork, k_timeout_t delay);
+
+#endif /* FAKE_ZEPHYR_KERNEL_H */
@@ -0,0 +1,11 @@
+#ifndef FAKE_ZEPHYR_SYS_CRC_H
+#define FAKE_ZEPHYR_SYS_CRC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Same results as Zephyr's: reflected 0xEDB88320, init and xorout ~0 */
+uint32_t crc32_ieee(const uint8_t *data, size_t len);
+uint32_t crc32_ieee_update(uint32_t crc, const uint8_t *data, size_t len);
+
+#endif /* FAKE_ZEPHYR_SYS_CRC_H */
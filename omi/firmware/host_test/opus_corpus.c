@@ -0,0 +1,72 @@
+#include "opus_corpus.h"
+
+#include "lib/core/config.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define SEED 12345
+
+static uint32_t rng = SEED;
+static int      left;        /* frames before talk and pause swap */
+static bool     talking;
+static uint32_t t, f;        /* sample and frame counts */
+
+static double uniform(void)
+{
+    rng = rng * 1664525U + 1013904223U;
+    return (double) (int32_t) rng / 2147483648.0;
+}
+
+void opus_corpus_reset(void)
+{
+    rng     = SEED;
+    left    = 0;
+    talking = false;
+    t = f   = 0;
+}
+
+/* Noise of about -50 dBFS, with speech in bursts of 0.5-3 s and pauses of
+ * 0.2-5 s; the level swings by 12 dB at 4 Hz for syllables */
+void opus_corpus_next(int16_t pcm[OPUS_CORPUS_FRAME])
+{
+    if (left == 0) {
+        talking = !talking;
+        double u = (uniform() + 1) / 2;
+        left = talking ? 25 + (int) (u * 125) : 10 + (int) (u * 240);
+    }
+    left--;
+    double rms = 2000.0 * (0.625 + 0.375 * sin(2 * M_PI * 4 * f++ / 50.0));
+    for (int i = 0; i < OPUS_CORPUS_FRAME; i++, t++) {
+        double x = uniform() * 100.0 * sqrt(3.0);
+        if (talking) {
+            for (int h = 1; h <= 8; h++) {
+                x += sin(2 * M_PI * 150.0 * h * t / OPUS_CORPUS_RATE) / h * rms / 0.95;
+            }
+        }
+        pcm[i] = (int16_t) fmax(-32768.0, fmin(32767.0, round(x)));
+    }
+}
+
+OpusEncoder *opus_corpus_encoder(int complexity)
+{
+    int          err;
+    OpusEncoder *enc = opus_encoder_create(OPUS_CORPUS_RATE, 1, CODEC_OPUS_APPLICATION, &err);
+    if (err != OPUS_OK) {
+        return NULL;
+    }
+    if (opus_encoder_ctl(enc, OPUS_SET_BITRATE(CODEC_OPUS_BITRATE)) != OPUS_OK ||
+        opus_encoder_ctl(enc, OPUS_SET_VBR(CODEC_OPUS_VBR)) != OPUS_OK ||
+        opus_encoder_ctl(enc, OPUS_SET_VBR_CONSTRAINT(0)) != OPUS_OK ||
+        opus_encoder_ctl(enc, OPUS_SET_COMPLEXITY(complexity)) != OPUS_OK ||
+        opus_encoder_ctl(enc, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE)) != OPUS_OK ||
+        opus_encoder_ctl(enc, OPUS_SET_LSB_DEPTH(16)) != OPUS_OK ||
+        opus_encoder_ctl(enc, OPUS_SET_DTX(0)) != OPUS_OK ||
+        opus_encoder_ctl(enc, OPUS_SET_INBAND_FEC(0)) != OPUS_OK ||
+        opus_encoder_ctl(enc, OPUS_SET_PACKET_LOSS_PERC(0)) != OPUS_OK) {
+        opus_encoder_destroy(enc);
+        return NULL;
+    }
+    return enc;
+}
@@ -0,0 +1,26 @@
+#ifndef HOST_TEST_OPUS_CORPUS_H
+#define HOST_TEST_OPUS_CORPUS_H
+
+/*
+ * A fixed synthetic conversation for tests that run the real Opus encoder:
+ * talk bursts of a voiced harmonic series over background noise, the same
+ * frames on every run. And the encoder that codec_start() sets up.
+ */
+
+#include <stdint.h>
+
+#include "lib/core/lib/opus-1.2.1/opus.h"
+
+#define OPUS_CORPUS_RATE  16000
+#define OPUS_CORPUS_FRAME 320   /* 20 ms */
+
+/* Start again from the first frame */
+void opus_corpus_reset(void);
+
+/* The next 20 ms of the conversation */
+void opus_corpus_next(int16_t pcm[OPUS_CORPUS_FRAME]);
+
+/* codec_start()'s encoder at @p complexity; NULL if Opus refuses it */
+OpusEncoder *opus_corpus_encoder(int complexity);
+
+#endif /* HOST_TEST_OPUS_CORPUS_H */
@@ -0,0 +1,43 @@
+#include "opus_stub.h"
+
+#include <stdarg.h>
+
+/* codec.c's OPUS_ENCODER_SIZE in CELT mode */
+#define ENCODER_SIZE 7180
+
+int opus_stub_complexity;
+int opus_stub_bitrate;
+
+opus_int32 (*opus_stub_encode_hook)(const opus_int16 *pcm, int frame_size, unsigned char *data,
+                                    opus_int32 max_data_bytes);
+
+int opus_encoder_get_size(int channels)
+{
+    return ENCODER_SIZE;
+}
+
+int opus_encoder_init(OpusEncoder *st, opus_int32 fs, int channels, int application)
+{
+    return OPUS_OK;
+}
+
+int opus_encoder_ctl(OpusEncoder *st, int request, ...)
+{
+    va_list ap;
+    va_start(ap, request);
+    int value = va_arg(ap, opus_int32);
+    va_end(ap);
+
+    if (request == OPUS_SET_COMPLEXITY_REQUEST) {
+        opus_stub_complexity = value;
+    } else if (request == OPUS_SET_BITRATE_REQUEST) {
+        opus_stub_bitrate = value;
+    }
+    return OPUS_OK;
+}
+
+opus_int32 opus_encode(OpusEncoder *st, const opus_int16 *pcm, int frame_size, unsigned char *data,
+                       opus_int32 max_data_bytes)
+{
+    return opus_stub_encode_hook ? opus_stub_encode_hook(pcm, frame_size, data, max_data_bytes) : 0;
+}
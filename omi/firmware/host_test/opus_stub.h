@@ -0,0 +1,18 @@
+#ifndef HOST_TEST_OPUS_STUB_H
+#define HOST_TEST_OPUS_STUB_H
+
+/*
+ * The Opus encoder API that codec.c calls, for tests built with codec.c
+ * (CELT mode). It keeps the complexity and bitrate last set, and encodes
+ * through opus_stub_encode_hook, or to nothing without one.
+ */
+
+#include "lib/core/lib/opus-1.2.1/opus.h"
+
+extern int opus_stub_complexity;
+extern int opus_stub_bitrate;
+
+extern opus_int32 (*opus_stub_encode_hook)(const opus_int16 *pcm, int frame_size, unsigned char *data,
+                                           opus_int32 max_data_bytes);
+
+#endif /* HOST_TEST_OPUS_STUB_H */
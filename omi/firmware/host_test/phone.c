@@ -0,0 +1,237 @@
+#include "phone.h"
+
+#include "reclo_transfer.h"
+
+#include "fake_zephyr.h"
+
+#include <zephyr/sys/crc.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct phone phone;
+
+/* Receive runs on the upload thread; the test reads between packets */
+static pthread_mutex_t phone_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* v2 DATA packets name their chunk by tag: the last header with that tag */
+static int tag_chunk[256];
+
+void phone_reset(void)
+{
+    pthread_mutex_lock(&phone_lock);
+    for (int i = 0; i < phone.chunk_count; i++) {
+        free(phone.chunks[i].data);
+    }
+    memset(&phone, 0, sizeof(phone));
+    memset(tag_chunk, 0xFF, sizeof(tag_chunk));
+    fake_bt_notify_hook = phone_receive;
+    pthread_mutex_unlock(&phone_lock);
+}
+
+static struct phone_chunk *find_chunk(uint32_t ts)
+{
+    for (int i = 0; i < phone.chunk_count; i++) {
+        if (phone.chunks[i].ts == ts) {
+            return &phone.chunks[i];
+        }
+    }
+    return NULL;
+}
+
+/* A header starts the chunk over: a later batch sends it again in full */
+static void on_header(uint32_t ts, uint16_t idx, uint16_t total_seqs, uint16_t payload,
+                      const RecloChunkMeta *meta)
+{
+    struct phone_chunk *c = find_chunk(ts);
+    if (!c) {
+        if (phone.chunk_count == PHONE_MAX_CHUNKS || total_seqs > PHONE_MAX_SEQS) {
+            phone.strays++;
+            return;
+        }
+        c = &phone.chunks[phone.chunk_count++];
+    }
+    free(c->data);
+    *c = (struct phone_chunk){
+        .ts = ts,
+        .idx = idx,
+        .total_seqs = total_seqs,
+        .payload = payload,
+        .data_size = meta->data_size,
+        .crc32 = meta->crc32,
+        .data = calloc(1, meta->data_size ? meta->data_size : 1),
+        .packets = 1,
+    };
+    c->have[0] = true;
+    tag_chunk[idx & 0xFF] = (int) (c - phone.chunks);
+    phone.headers++;
+}
+
+static void on_data(struct phone_chunk *c, uint16_t seq, const uint8_t *bytes, size_t n)
+{
+    if (!c || seq == 0 || seq >= c->total_seqs || c->payload == 0) {
+        phone.strays++;
+        return;
+    }
+    c->packets++;
+    if (phone.lose && phone.lose(c, seq)) {
+        return;
+    }
+    uint32_t off = (uint32_t) (seq - 1) * c->payload;
+    if (off >= c->data_size || n != MIN(c->payload, c->data_size - off)) {
+        phone.strays++;
+        return;
+    }
+    memcpy(c->data + off, bytes, n);
+    c->have[seq] = true;
+}
+
+static void receive_v1(const RecloPacket *pkt, uint16_t len)
+{
+    if (len != RECLO_PACKET_SIZE) {
+        phone.strays++;
+        return;
+    }
+    phone.proto = RECLO_PROTO_V1;
+    switch (pkt->pkt_type) {
+    case RECLO_PKT_CHUNK_HEADER: {
+        RecloChunkMeta meta;
+        memcpy(&meta, pkt->payload, sizeof(meta));
+        on_header(pkt->chunk_ts, pkt->chunk_idx, pkt->total_seqs, RECLO_PAYLOAD_SIZE, &meta);
+        break;
+    }
+    case RECLO_PKT_CHUNK_DATA:
+        on_data(find_chunk(pkt->chunk_ts), pkt->seq, pkt->payload, pkt->payload_len);
+        break;
+    }
+}
+
+static void receive_v2(const uint8_t *bytes, uint16_t len)
+{
+    phone.proto = RECLO_PROTO_V2;
+    switch (bytes[0]) {
+    case RECLO_PKT_CHUNK_HEADER_V2: {
+        RecloHeaderV2 h;
+        if (len != sizeof(h)) {
+            phone.strays++;
+            return;
+        }
+        memcpy(&h, bytes, sizeof(h));
+        on_header(h.chunk_ts, h.chunk_idx, h.total_seqs, h.data_payload, &h.meta);
+        break;
+    }
+    case RECLO_PKT_CHUNK_LEVELS_V2:
+    case RECLO_PKT_CHUNK_DATA_V2: {
+        RecloDataHdrV2 h;
+        if (len < sizeof(h)) {
+            phone.strays++;
+            return;
+        }
+        memcpy(&h, bytes, sizeof(h));
+        int i = tag_chunk[h.chunk_tag];
+        struct phone_chunk *c = i >= 0 ? &phone.chunks[i] : NULL;
+        if (h.pkt_type == RECLO_PKT_CHUNK_DATA_V2) {
+            on_data(c, h.seq, bytes + sizeof(h), len - sizeof(h));
+        } else if (c) {
+            c->packets++;
+        }
+        break;
+    }
+    }
+}
+
+int phone_receive(const void *data, uint16_t len)
+{
+    if (phone.refuse) {
+        int err = phone.refuse();
+        if (err) {
+            return err;
+        }
+    }
+
+    const uint8_t *bytes = data;
+    pthread_mutex_lock(&phone_lock);
+    phone.packets++;
+    phone.max_len = MAX(phone.max_len, len);
+    if (len == 0) {
+        phone.strays++;
+    } else if (bytes[0] == RECLO_PKT_UPLOAD_DONE) {
+        phone.done = true;
+    } else if (bytes[0] >= RECLO_PKT_CHUNK_HEADER_V2) {
+        receive_v2(bytes, len);
+    } else {
+        receive_v1(data, len);
+    }
+    pthread_mutex_unlock(&phone_lock);
+    return 0;
+}
+
+bool phone_wait_done(uint32_t timeout_ms)
+{
+    int64_t until = k_uptime_get() + timeout_ms;
+    while (true) {
+        pthread_mutex_lock(&phone_lock);
+        bool done = phone.done;
+        phone.done = false;
+        pthread_mutex_unlock(&phone_lock);
+        if (done) {
+            return true;
+        }
+        if (k_uptime_get() >= until) {
+            return false;
+        }
+        k_msleep(1);
+    }
+}
+
+const struct phone_chunk *phone_chunk(uint32_t ts)
+{
+    pthread_mutex_lock(&phone_lock);
+    const struct phone_chunk *c = find_chunk(ts);
+    pthread_mutex_unlock(&phone_lock);
+    return c;
+}
+
+bool phone_chunk_complete(const struct phone_chunk *chunk)
+{
+    pthread_mutex_lock(&phone_lock);
+    bool complete = chunk->total_seqs > 0;
+    for (uint16_t seq = 0; seq < chunk->total_seqs && complete; seq++) {
+        complete = chunk->have[seq];
+    }
+    complete = complete && crc32_ieee(chunk->data, chunk->data_size) == chunk->crc32;
+    pthread_mutex_unlock(&phone_lock);
+    return complete;
+}
+
+size_t phone_nack(const struct phone_chunk *chunk, uint8_t *cmd)
+{
+    pthread_mutex_lock(&phone_lock);
+    uint16_t first = 0;
+    for (uint16_t seq = 1; seq < chunk->total_seqs && first == 0; seq++) {
+        if (!chunk->have[seq]) {
+            first = seq;
+        }
+    }
+    size_t len = 0;
+    if (first != 0) {
+        cmd[0] = RECLO_CMD_NACK_CHUNK;
+        memcpy(&cmd[1], &chunk->ts, sizeof(chunk->ts));
+        memcpy(&cmd[5], &chunk->idx, sizeof(chunk->idx));
+        memcpy(&cmd[7], &first, sizeof(first));
+        memset(&cmd[9], 0, RECLO_NACK_MAX_BITMAP);
+
+        unsigned bits = MIN(chunk->total_seqs - first, RECLO_NACK_MAX_BITMAP * 8);
+        unsigned last = 0;
+        for (unsigned bit = 0; bit < bits; bit++) {
+            if (!chunk->have[first + bit]) {
+                cmd[9 + bit / 8] |= (uint8_t) (1U << (bit % 8));
+                last = bit;
+            }
+        }
+        len = 9 + last / 8 + 1;
+    }
+    pthread_mutex_unlock(&phone_lock);
+    return len;
+}
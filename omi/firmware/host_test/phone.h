@@ -0,0 +1,68 @@
+#ifndef HOST_TEST_PHONE_H
+#define HOST_TEST_PHONE_H
+
+/*
+ * The phone's side of the RecLo upload protocol, for tests that run a
+ * transfer end to end on the threaded fake. phone_reset() installs
+ * phone_receive() as fake_bt_notify_hook; it reassembles each chunk of a
+ * batch from v1 or v2 packets, and can lose packets or refuse them as a
+ * congested stack would.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define PHONE_MAX_CHUNKS  64
+#define PHONE_MAX_SEQS    1024
+
+struct phone_chunk {
+    uint32_t ts;
+    uint16_t idx;
+    uint16_t total_seqs;     /* header + data packets */
+    uint16_t payload;        /* Opus bytes per DATA packet */
+    uint32_t data_size;
+    uint32_t crc32;
+    uint8_t *data;
+    bool     have[PHONE_MAX_SEQS];
+    uint32_t packets;        /* header, levels and DATA packets, repeats included */
+};
+
+struct phone {
+    uint8_t  proto;          /* framing of the last header */
+    struct phone_chunk chunks[PHONE_MAX_CHUNKS];
+    int      chunk_count;
+    uint32_t packets;        /* every packet received */
+    uint32_t headers;
+    uint16_t max_len;        /* longest notification */
+    uint32_t strays;         /* unknown chunk, bad seq or wrong length */
+    bool     done;           /* UPLOAD_DONE seen */
+
+    /* Lose this DATA packet in the air: the device thinks it sent it */
+    bool (*lose)(const struct phone_chunk *chunk, uint16_t seq);
+    /* Non-zero: refuse the notification with that error (e.g. -ENOMEM)
+     * instead of receiving it */
+    int (*refuse)(void);
+};
+
+extern struct phone phone;
+
+/* Forget every chunk and counter, keep no hooks, and listen for notifications */
+void phone_reset(void);
+
+/* fake_bt_notify_hook */
+int phone_receive(const void *data, uint16_t len);
+
+/* Wait for UPLOAD_DONE and clear it for the next batch; false on a timeout */
+bool phone_wait_done(uint32_t timeout_ms);
+
+/* The chunk with timestamp @p ts, or NULL */
+const struct phone_chunk *phone_chunk(uint32_t ts);
+
+bool phone_chunk_complete(const struct phone_chunk *chunk);
+
+/* A NACK_CHUNK command for the seqs @p chunk is missing, from the first one
+ * on; its length, or 0 when nothing is missing */
+size_t phone_nack(const struct phone_chunk *chunk, uint8_t *cmd);
+
+#endif /* HOST_TEST_PHONE_H */
@@ -0,0 +1,168 @@
+/*
+ * Audio path copies: between the PDM's DMA and the encoder a sample is
+ * written once, by the downmix into a pooled frame that the codec encodes
+ * in place, and only pointers move through the queues.
+ *
+ * mic.c and codec.c (#include below) run on the threaded fake with the
+ * modelled DMIC at ten times real time. The link wraps memcpy, memmove and
+ * mic_dsp_downmix() to count the bytes each moves; the Opus stand-in checks
+ * that every frame it is given lies in the codec's pool and was filled
+ * there, whole, by the downmix. The RAM report sets the buffers on this
+ * path against the ring and staging buffers they replaced.
+ */
+
+#include "../omi/src/lib/core/codec.c"
+
+#include "lib/core/mic.h"
+
+#include "fake_zephyr.h"
+#include "opus_stub.h"
+
+uint8_t battery_percentage;
+
+uint8_t app_settings_get_mic_gain(void)
+{
+    return 6;
+}
+
+#define FRAMES      500
+#define FRAME_BYTES (CODEC_PACKAGE_SAMPLES * 2)
+#define SPEEDUP     10
+
+/* mic.c's slab, as it sizes it */
+#define MIC_BLOCK_BYTES (16000 * CONFIG_OMI_MIC_BLOCK_MS / 1000 * 2 * 2)
+#define MIC_BLOCKS      MAX(4, 80 / CONFIG_OMI_MIC_BLOCK_MS)
+
+/* What the pool and queue replaced: a 1 s ring in codec.c, and mic.c's
+ * 100 ms mono buffer and codec.c's input frame that staged each copy */
+#define OLD_RING_BYTES  (16000 * 2)
+#define OLD_MONO_BYTES  (1600 * 2)
+#define OLD_INPUT_BYTES FRAME_BYTES
+
+#define TARGET_POINTER  4
+
+/* ── Copy counters ──────────────────────────────────────────────────────────*/
+
+static uint64_t memcpy_bytes, memmove_bytes, downmix_bytes, stray_bytes;
+
+void *__real_memcpy(void *dst, const void *src, size_t n);
+void *__real_memmove(void *dst, const void *src, size_t n);
+void  __real_mic_dsp_downmix(const int16_t *restrict interleaved, size_t frames, int16_t *restrict mono);
+
+void *__wrap_memcpy(void *dst, const void *src, size_t n)
+{
+    __atomic_fetch_add(&memcpy_bytes, n, __ATOMIC_RELAXED);
+    return __real_memcpy(dst, src, n);
+}
+
+void *__wrap_memmove(void *dst, const void *src, size_t n)
+{
+    __atomic_fetch_add(&memmove_bytes, n, __ATOMIC_RELAXED);
+    return __real_memmove(dst, src, n);
+}
+
+/* Bytes the downmix has written into each frame of the pool since its encode */
+static uint32_t filled[CODEC_FRAME_POOL_SIZE];
+
+static bool in_pool(const int16_t *p)
+{
+    const char *c = (const char *) p;
+    return c >= codec_frame_slab.buffer && c < codec_frame_slab.buffer + sizeof(_slab_buf_codec_frame_slab);
+}
+
+static size_t frame_index(const int16_t *p)
+{
+    return ((const char *) p - codec_frame_slab.buffer) / FRAME_BYTES;
+}
+
+void __wrap_mic_dsp_downmix(const int16_t *restrict interleaved, size_t frames, int16_t *restrict mono)
+{
+    __atomic_fetch_add(&downmix_bytes, frames * 2, __ATOMIC_RELAXED);
+    if (in_pool(mono)) {
+        filled[frame_index(mono)] += frames * 2;
+    } else {
+        __atomic_fetch_add(&stray_bytes, frames * 2, __ATOMIC_RELAXED);
+    }
+    __real_mic_dsp_downmix(interleaved, frames, mono);
+}
+
+/* ── Encoder ────────────────────────────────────────────────────────────────*/
+
+static uint32_t encoded, in_place;
+
+static opus_int32 encode(const opus_int16 *pcm, int frame_size, unsigned char *data, opus_int32 max_data_bytes)
+{
+    if (in_pool(pcm) && (const char *) pcm == codec_frame_slab.buffer + frame_index(pcm) * FRAME_BYTES) {
+        in_place += filled[frame_index(pcm)] == FRAME_BYTES;
+        filled[frame_index(pcm)] = 0;
+    }
+    encoded++;
+    data[0] = 0;
+    return 1;
+}
+
+/* main.c's mic handler */
+static void mic_handler(int16_t *frame)
+{
+    codec_frame_submit(frame);
+}
+
+int main(void)
+{
+    fake_threads_enable();
+    fake_dmic_set_speedup(SPEEDUP);
+    opus_stub_encode_hook = encode;
+    int sub = codec_subscribe("test");
+    CHECK_EQ(codec_start(), 0);
+
+    set_mic_frame_allocator(codec_frame_alloc, CODEC_PACKAGE_SAMPLES);
+    set_mic_callback(mic_handler);
+    CHECK_EQ(mic_start(), 0);
+
+    uint32_t received = 0;
+    while (received < FRAMES) {
+        struct codec_packet *pkt = codec_packet_get(sub, K_SECONDS(1));
+        if (!pkt) {
+            break;
+        }
+        codec_packet_release(pkt);
+        received++;
+    }
+
+    /* Snapshot before checking: the mic and codec threads keep running */
+    uint32_t frames = __atomic_load_n(&encoded, __ATOMIC_SEQ_CST);
+    uint32_t direct = __atomic_load_n(&in_place, __ATOMIC_SEQ_CST);
+    uint64_t pcm = (uint64_t) frames * FRAME_BYTES;
+    uint64_t downmixed = __atomic_load_n(&downmix_bytes, __ATOMIC_SEQ_CST);
+    uint64_t moved = __atomic_load_n(&memcpy_bytes, __ATOMIC_SEQ_CST) +
+                     __atomic_load_n(&memmove_bytes, __ATOMIC_SEQ_CST);
+
+    CHECK_EQ(received, FRAMES);
+    CHECK_EQ(fake_dmic_stats().overruns, 0);
+
+    /* Every frame encoded where the downmix wrote it; the downmix wrote
+     * nothing anywhere else, and at most one frame ahead of the encoder */
+    CHECK_EQ(direct, frames);
+    CHECK_EQ(__atomic_load_n(&stray_bytes, __ATOMIC_SEQ_CST), 0);
+    CHECK(downmixed >= pcm);
+    CHECK(downmixed <= pcm + (uint64_t) MIC_BLOCKS * MIC_BLOCK_BYTES / 2 + FRAME_BYTES);
+
+    /* memcpy/memmove carry queue entries only: a few pointers per frame,
+     * where the ring cost two full copies of every frame */
+    CHECK(moved < pcm / 10);
+
+    printf("%u frames of %u B encoded in place: %.2f writes of each PCM byte, memcpy/memmove %.1f B per frame "
+           "(the ring's copies: %u B per frame)\n",
+           frames, FRAME_BYTES, (double) downmixed / pcm, (double) moved / frames, 2 * FRAME_BYTES);
+
+    unsigned pool = sizeof(_slab_buf_codec_frame_slab);
+    unsigned queue = CODEC_FRAME_POOL_SIZE * TARGET_POINTER;
+    unsigned old = OLD_RING_BYTES + OLD_MONO_BYTES + OLD_INPUT_BYTES;
+    CHECK(pool + queue < old);
+    printf("RAM: frame pool %u B + queue %u B, replacing ring %u B + mono buffer %u B + input frame %u B "
+           "(%u B saved); mic slab %u x %u B = %u B either way\n",
+           pool, queue, OLD_RING_BYTES, OLD_MONO_BYTES, OLD_INPUT_BYTES, old - pool - queue, MIC_BLOCKS,
+           MIC_BLOCK_BYTES, MIC_BLOCKS * MIC_BLOCK_BYTES);
+
+    return fake_test_result("test_audio_copies");
+}
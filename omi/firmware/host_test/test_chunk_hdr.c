@@ -0,0 +1,270 @@
+/*
+ * reclo_chunk_hdr: encode/parse round trips, and parsing of every header
+ * layout ever written to a card (v1, v2 before and after the encoder fields,
+ * v3 before packet_frames) by the current parser.
+ */
+
+#include "reclo_chunk_hdr.h"
+
+#include "fake_zephyr.h"
+
+#include <errno.h>
+#include <string.h>
+
+static void put_le16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t) v;
+    p[1] = (uint8_t) (v >> 8);
+}
+
+static void put_le32(uint8_t *p, uint32_t v)
+{
+    put_le16(p, (uint16_t) v);
+    put_le16(p + 2, (uint16_t) (v >> 16));
+}
+
+/* The fields every version shares */
+static void build_common(uint8_t *buf, const char *magic, uint32_t ts, uint32_t data_size)
+{
+    memcpy(buf, magic, 4);
+    put_le32(&buf[4], ts);
+    buf[8] = 21;
+    put_le32(&buf[9], 16000);
+    put_le32(&buf[13], data_size);
+}
+
+static void test_v3_round_trip(void)
+{
+    uint8_t levels[RECLO_LEVEL_MAX];
+    for (int i = 0; i < RECLO_LEVEL_MAX; i++) {
+        levels[i] = (uint8_t) (i * 3);
+    }
+
+    struct reclo_chunk_hdr in = {
+        .ts = 1712345678,
+        .codec_id = 21,
+        .sample_rate = 16000,
+        .data_size = 123456,
+        .crc32 = 0xDEADBEEF,
+        .version = 99,    /* ignored by encode */
+        .hdr_size = 7,    /* less than the header: ignored by encode */
+        .enc_complexity = 5,
+        .enc_flags = RECLO_ENC_F_CHANGED | RECLO_ENC_F_VAD,
+        .enc_bitrate_kbps = 24,
+        .level_count = 150,
+        .packet_frames = 3,
+        .levels = levels,
+    };
+    uint8_t buf[RECLO_FILE_HDR_SIZE];
+    reclo_chunk_hdr_encode(buf, &in);
+    CHECK(memcmp(buf, "RCLV", 4) == 0);
+
+    struct reclo_chunk_hdr out;
+    CHECK_EQ(reclo_chunk_hdr_parse(buf, sizeof(buf), &out), 0);
+    CHECK_EQ(out.ts, in.ts);
+    CHECK_EQ(out.codec_id, in.codec_id);
+    CHECK_EQ(out.sample_rate, in.sample_rate);
+    CHECK_EQ(out.data_size, in.data_size);
+    CHECK_EQ(out.crc32, in.crc32);
+    CHECK_EQ(out.version, RECLO_FILE_VERSION);
+    CHECK_EQ(out.hdr_size, RECLO_FILE_HDR_SIZE);
+    CHECK_EQ(out.enc_complexity, in.enc_complexity);
+    CHECK_EQ(out.enc_flags, in.enc_flags);
+    CHECK_EQ(out.enc_bitrate_kbps, in.enc_bitrate_kbps);
+    CHECK_EQ(out.packet_frames, 3);
+    CHECK_EQ(out.level_count, 150);
+    CHECK(out.levels == &buf[RECLO_FILE_OFF_LEVELS]);
+    CHECK(memcmp(out.levels, levels, 150) == 0);
+    CHECK(reclo_chunk_hdr_has_crc(&out));
+
+    /* Unused level bytes stay zero */
+    for (int i = 150; i < RECLO_LEVEL_MAX; i++) {
+        CHECK_EQ(buf[RECLO_FILE_OFF_LEVELS + i], 0);
+    }
+
+    /* Too many levels are clamped; none without a source buffer */
+    in.level_count = RECLO_LEVEL_MAX + 10;
+    reclo_chunk_hdr_encode(buf, &in);
+    CHECK_EQ(reclo_chunk_hdr_parse(buf, sizeof(buf), &out), 0);
+    CHECK_EQ(out.level_count, RECLO_LEVEL_MAX);
+
+    in.levels = NULL;
+    reclo_chunk_hdr_encode(buf, &in);
+    CHECK_EQ(reclo_chunk_hdr_parse(buf, sizeof(buf), &out), 0);
+    CHECK_EQ(out.level_count, 0);
+
+    /* packet_frames 0 is written as 1 */
+    in.packet_frames = 0;
+    reclo_chunk_hdr_encode(buf, &in);
+    CHECK_EQ(buf[30], 1);
+    CHECK_EQ(reclo_chunk_hdr_parse(buf, sizeof(buf), &out), 0);
+    CHECK_EQ(out.packet_frames, 1);
+
+    /* An unfinalised chunk has no usable CRC */
+    in.data_size = 0;
+    reclo_chunk_hdr_encode(buf, &in);
+    CHECK_EQ(reclo_chunk_hdr_parse(buf, sizeof(buf), &out), 0);
+    CHECK(!reclo_chunk_hdr_has_crc(&out));
+
+    /* Multi-byte fields are little-endian whatever the host */
+    in.ts = 0x01020304;
+    reclo_chunk_hdr_encode(buf, &in);
+    CHECK_EQ(buf[RECLO_FILE_OFF_TS], 0x04);
+    CHECK_EQ(buf[RECLO_FILE_OFF_TS + 3], 0x01);
+    CHECK_EQ(buf[18] | (buf[19] << 8), RECLO_FILE_HDR_SIZE);
+
+    /* A larger hdr_size is kept: the caller pads the header out to it */
+    in.hdr_size = RECLO_FILE_HDR_SIZE + 512;
+    in.levels = levels;
+    in.level_count = 150;
+    reclo_chunk_hdr_encode(buf, &in);
+    CHECK_EQ(reclo_chunk_hdr_parse(buf, sizeof(buf), &out), 0);
+    CHECK_EQ(out.hdr_size, RECLO_FILE_HDR_SIZE + 512);
+    CHECK_EQ(out.level_count, 150);
+}
+
+static void test_v1(void)
+{
+    uint8_t buf[RECLO_FILE_V1_HDR_SIZE + 8];
+    memset(buf, 0xAA, sizeof(buf));   /* Opus data follows the header */
+    build_common(buf, "RCLO", 1600000000, 4000);
+
+    struct reclo_chunk_hdr out;
+    CHECK_EQ(reclo_chunk_hdr_parse(buf, sizeof(buf), &out), 0);
+    CHECK_EQ(out.version, 1);
+    CHECK_EQ(out.hdr_size, RECLO_FILE_V1_HDR_SIZE);
+    CHECK_EQ(out.ts, 1600000000);
+    CHECK_EQ(out.codec_id, 21);
+    CHECK_EQ(out.sample_rate, 16000);
+    CHECK_EQ(out.data_size, 4000);
+    CHECK_EQ(out.crc32, 0);
+    CHECK_EQ(out.level_count, 0);
+    CHECK_EQ(out.enc_bitrate_kbps, 0);
+    CHECK(!reclo_chunk_hdr_has_crc(&out));
+
+    CHECK_EQ(reclo_chunk_hdr_parse(buf, RECLO_FILE_V1_HDR_SIZE, &out), 0);
+    CHECK_EQ(reclo_chunk_hdr_parse(buf, RECLO_FILE_V1_HDR_SIZE - 1, &out), -ENODATA);
+}
+
+/* v2 as first written: 24-byte header, CRC only */
+static void test_v2_crc_only(void)
+{
+    uint8_t buf[24];
+    build_common(buf, "RCLV", 1650000000, 5000);
+    buf[17] = 2;
+    put_le16(&buf[18], 24);
+    put_le32(&buf[20], 0x12345678);
+
+    struct reclo_chunk_hdr out;
+    CHECK_EQ(reclo_chunk_hdr_parse(buf, sizeof(buf), &out), 0);
+    CHECK_EQ(out.version, 2);
+    CHECK_EQ(out.hdr_size, 24);
+    CHECK_EQ(out.crc32, 0x12345678);
+    CHECK_EQ(out.enc_complexity, 0);
+    CHECK_EQ(out.enc_bitrate_kbps, 0);
+    CHECK_EQ(out.packet_frames, 1);
+    CHECK(reclo_chunk_hdr_has_crc(&out));
+}
+
+/* v2 with the encoder fields: 32-byte header, bytes 28..31 reserved */
+static void test_v2_encoder_fields(void)
+{
+    uint8_t buf[32] = { 0 };
+    build_common(buf, "RCLV", 1650000030, 6000);
+    buf[17] = 2;
+    put_le16(&buf[18], 32);
+    put_le32(&buf[20], 0xCAFEF00D);
+    buf[24] = 7;
+    buf[25] = RECLO_ENC_F_LOW_POWER;
+    put_le16(&buf[26], 16);
+    put_le16(&buf[28], 0x00FF);   /* junk in what became level_count */
+    buf[30] = 3;                  /* and packet_frames */
+
+    struct reclo_chunk_hdr out;
+    CHECK_EQ(reclo_chunk_hdr_parse(buf, sizeof(buf), &out), 0);
+    CHECK_EQ(out.hdr_size, 32);
+    CHECK_EQ(out.crc32, 0xCAFEF00D);
+    CHECK_EQ(out.enc_complexity, 7);
+    CHECK_EQ(out.enc_flags, RECLO_ENC_F_LOW_POWER);
+    CHECK_EQ(out.enc_bitrate_kbps, 16);
+    /* v2 has neither a level track nor packet_frames */
+    CHECK_EQ(out.level_count, 0);
+    CHECK_EQ(out.packet_frames, 1);
+
+    /* Encoder fields cut off: parsed as far as the buffer goes */
+    CHECK_EQ(reclo_chunk_hdr_parse(buf, 24, &out), 0);
+    CHECK_EQ(out.crc32, 0xCAFEF00D);
+    CHECK_EQ(out.enc_complexity, 0);
+}
+
+/* v3 from before packet_frames (byte 30 zero) and with a short read */
+static void test_v3_old_layout(void)
+{
+    uint8_t buf[RECLO_FILE_HDR_SIZE] = { 0 };
+    build_common(buf, "RCLV", 1700000000, 7000);
+    buf[17] = 3;
+    put_le16(&buf[18], RECLO_FILE_HDR_SIZE);
+    put_le16(&buf[28], 10);
+    memset(&buf[RECLO_FILE_OFF_LEVELS], 40, 10);
+
+    struct reclo_chunk_hdr out;
+    CHECK_EQ(reclo_chunk_hdr_parse(buf, sizeof(buf), &out), 0);
+    CHECK_EQ(out.packet_frames, 1);
+    CHECK_EQ(out.level_count, 10);
+    CHECK_EQ(out.levels[9], 40);
+
+    /* Level track not in the buffer: header still valid, no levels */
+    CHECK_EQ(reclo_chunk_hdr_parse(buf, RECLO_FILE_OFF_LEVELS + 5, &out), 0);
+    CHECK_EQ(out.level_count, 0);
+    CHECK(out.levels == NULL);
+
+    /* level_count larger than the header has room for is ignored */
+    put_le16(&buf[28], RECLO_LEVEL_MAX + 1);
+    CHECK_EQ(reclo_chunk_hdr_parse(buf, sizeof(buf), &out), 0);
+    CHECK_EQ(out.level_count, 0);
+}
+
+static void test_malformed(void)
+{
+    uint8_t buf[RECLO_FILE_HDR_SIZE];
+    struct reclo_chunk_hdr in = { .ts = 1, .codec_id = 21, .sample_rate = 16000, .data_size = 10 };
+    struct reclo_chunk_hdr out;
+
+    reclo_chunk_hdr_encode(buf, &in);
+    CHECK_EQ(reclo_chunk_hdr_parse(buf, 3, &out), -ENODATA);
+    CHECK_EQ(reclo_chunk_hdr_parse(buf, 19, &out), -ENODATA);
+    CHECK_EQ(reclo_chunk_hdr_parse(buf, 23, &out), -ENODATA);
+
+    buf[0] = 'X';
+    CHECK_EQ(reclo_chunk_hdr_parse(buf, sizeof(buf), &out), -EILSEQ);
+    buf[0] = 'R';
+
+    buf[17] = 1;   /* 'RCLV' is v2 or later */
+    CHECK_EQ(reclo_chunk_hdr_parse(buf, sizeof(buf), &out), -EINVAL);
+    buf[17] = RECLO_FILE_VERSION;
+
+    put_le16(&buf[18], 23);
+    CHECK_EQ(reclo_chunk_hdr_parse(buf, sizeof(buf), &out), -EINVAL);
+}
+
+static void test_levels(void)
+{
+    CHECK_EQ(reclo_level_from_energy(0), RECLO_LEVEL_SILENT);
+    CHECK_EQ(reclo_level_from_energy(1U << 30), 0);
+    CHECK_EQ(reclo_level_from_energy((1U << 30) / 10), 20);    /* -10 dBFS */
+    CHECK_EQ(reclo_level_from_energy((1U << 30) / 1000), 60);  /* -30 dBFS */
+    CHECK_EQ(reclo_level_from_energy(1), 181);                 /* -90.3 dBFS */
+}
+
+int main(void)
+{
+    test_v3_round_trip();
+    test_v1();
+    test_v2_crc_only();
+    test_v2_encoder_fields();
+    test_v3_old_layout();
+    test_malformed();
+    test_levels();
+
+    return fake_test_result("test_chunk_hdr");
+}
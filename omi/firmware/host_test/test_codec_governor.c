@@ -0,0 +1,162 @@
+/*
+ * Codec governor: complexity settles where the encoder's duty cycle meets
+ * the target, and a load spike that backs frames up is met with as few
+ * steps down as it takes to drain them, without the frame pool running dry.
+ *
+ * Built with the module itself (#include below) and driven by a discrete
+ * model instead of the codec thread: a frame arrives every 20 ms into the
+ * real frame pool and queue, and each encode costs encode_us() of the
+ * complexity in effect, scaled by a load factor that stands in for the
+ * rest of the system. governor_update() sees that cost and the queue as
+ * they are when the encode finishes.
+ */
+
+#include "../omi/src/lib/core/codec.c"
+
+#include "fake_zephyr.h"
+#include "opus_stub.h"
+
+uint8_t battery_percentage;
+
+/* ── Load model ─────────────────────────────────────────────────────────────*/
+
+#define FRAME_US  GOVERNOR_FRAME_PERIOD_US
+
+/* 10 % of the frame period at complexity 0, 7.5 % more per step, at a
+ * load of 100 % */
+static uint32_t encode_us(int complexity, uint32_t load_pct)
+{
+    return load_pct * (2000 + 1500 * (uint32_t) complexity) / 100;
+}
+
+struct run {
+    uint32_t frames;
+    uint32_t overruns;      /* codec_frame_alloc() found the pool empty */
+    uint32_t max_backlog;
+    uint32_t steps_down;
+    int      min_complexity;
+};
+
+static int64_t now;          /* model time, us */
+static int64_t next_frame;   /* arrival of the next frame */
+
+/* Deliver every frame due by @p until, as the mic would */
+static void arrive_until(int64_t until, struct run *run)
+{
+    for (; next_frame <= until; next_frame += FRAME_US) {
+        int16_t *frame = codec_frame_alloc();
+        if (!frame) {
+            run->overruns++;
+            continue;
+        }
+        CHECK_EQ(codec_frame_submit(frame), 0);
+    }
+}
+
+/* Run @p seconds at @p load_pct; returns what happened */
+static struct run run_for(uint32_t seconds, uint32_t load_pct)
+{
+    struct run run = { .min_complexity = opus_stub_complexity };
+    int64_t end = now + (int64_t) seconds * 1000000;
+
+    while (now < end) {
+        int16_t *frame;
+        if (k_msgq_get(&codec_frame_q, &frame, K_NO_WAIT) != 0) {
+            now = next_frame;
+            arrive_until(now, &run);
+            continue;
+        }
+
+        int before = opus_stub_complexity;
+        uint32_t cost = encode_us(before, load_pct);
+        k_mem_slab_free(&codec_frame_slab, frame);
+        now += cost;
+        arrive_until(now, &run);
+        governor_update(cost);
+
+        run.frames++;
+        run.max_backlog = MAX(run.max_backlog, k_msgq_num_used_get(&codec_frame_q));
+        run.min_complexity = MIN(run.min_complexity, opus_stub_complexity);
+        if (opus_stub_complexity < before) {
+            run.steps_down++;
+        }
+    }
+    return run;
+}
+
+static uint32_t duty_pct(int complexity)
+{
+    return encode_us(complexity, 100) * 100 / FRAME_US;
+}
+
+/* Empty the queue and start a fresh window at @p complexity */
+static void restart(int complexity)
+{
+    int16_t *frame;
+    while (k_msgq_get(&codec_frame_q, &frame, K_NO_WAIT) == 0) {
+        k_mem_slab_free(&codec_frame_slab, frame);
+    }
+    governor_apply(complexity, CODEC_OPUS_BITRATE, false);
+    m_governor_cycles  = 0;
+    m_governor_frames  = 0;
+    m_governor_backlog = 0;
+}
+
+static void report(const char *name, struct run run)
+{
+    printf("%-16s %4u frames, complexity %d (min %d), %u step(s) down, backlog up to %u, %u overrun(s)\n", name,
+           run.frames, opus_stub_complexity, run.min_complexity, run.steps_down, run.max_backlog, run.overruns);
+}
+
+int main(void)
+{
+    CHECK_EQ(codec_start(), 0);
+    CHECK_EQ(opus_stub_complexity, CODEC_OPUS_COMPLEXITY);
+
+    /* Settles on the highest complexity within the target, a step a second */
+    struct run settle = run_for(10, 100);
+    report("steady load", settle);
+    CHECK_EQ(settle.overruns, 0);
+    CHECK(duty_pct(opus_stub_complexity) <= CONFIG_OMI_CODEC_TARGET_DUTY_PCT);
+    CHECK(duty_pct(opus_stub_complexity + 1) > CONFIG_OMI_CODEC_TARGET_DUTY_PCT);
+    const int settled = opus_stub_complexity;
+    CHECK(settled >= 2);
+
+    /* Encodes take 5.5x as long: the backlog builds until the governor
+     * steps down, and that one step drains it, if slowly. Stepping again
+     * while it drains would cost quality for nothing. */
+    restart(settled);
+    struct run spike = run_for(1, 550);
+    report("5.5x load, 1 s", spike);
+    CHECK_EQ(spike.overruns, 0);
+    CHECK(spike.max_backlog >= GOVERNOR_BACKLOG_FRAMES);
+    CHECK_EQ(spike.steps_down, 1);
+    CHECK_EQ(spike.min_complexity, settled - 1);
+
+    /* 8x: one step is not enough and the backlog keeps growing, so a second
+     * one follows before the pool runs out */
+    restart(settled);
+    struct run surge = run_for(1, 800);
+    report("8x load, 1 s", surge);
+    CHECK_EQ(surge.overruns, 0);
+    CHECK_EQ(surge.steps_down, 2);
+    CHECK_EQ(surge.min_complexity, settled - 2);
+
+    /* Climbs back into the target band once the load is gone */
+    struct run recover = run_for(10, 100);
+    report("recovery", recover);
+    CHECK_EQ(recover.overruns, 0);
+    CHECK(duty_pct(opus_stub_complexity) <= CONFIG_OMI_CODEC_TARGET_DUTY_PCT);
+    CHECK(duty_pct(opus_stub_complexity) >= CONFIG_OMI_CODEC_TARGET_DUTY_PCT / 2);
+
+    /* Low battery caps complexity and lowers the bitrate within a second */
+    battery_percentage = CONFIG_OMI_CODEC_LOW_BATTERY_PCT - 1;
+    run_for(1, 100);
+    CHECK(opus_stub_complexity <= CONFIG_OMI_CODEC_LOW_POWER_COMPLEXITY);
+    CHECK_EQ(opus_stub_bitrate, CONFIG_OMI_CODEC_LOW_POWER_BITRATE);
+    struct codec_settings settings;
+    codec_get_settings(&settings);
+    CHECK(settings.low_power);
+
+    return fake_test_result("test_codec_governor");
+}
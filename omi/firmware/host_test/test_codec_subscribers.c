@@ -0,0 +1,184 @@
+/*
+ * Codec output bus: a subscriber that stops draining loses frames from its
+ * own queue only. The others still get every frame, in order and as soon
+ * as before, the encoder never waits, and unsubscribing hands every packet
+ * back to the pool.
+ *
+ * codec.c (#include below) runs its thread on the threaded fake. The test
+ * submits a numbered frame every PERIOD_MS and the Opus stand-in encodes
+ * that number. Two subscribers drain on threads of their own, as the
+ * recorder and the BLE pusher do. The first half of the run has only
+ * those two; for the second, a third subscriber holds every packet for
+ * SLOW_HOLD_MS, as one stuck on a card write would.
+ */
+
+#include "../omi/src/lib/core/codec.c"
+
+#include "fake_zephyr.h"
+#include "opus_stub.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+uint8_t battery_percentage;
+
+#define FRAMES       250               /* per half */
+#define PERIOD_MS    4                 /* five times real time */
+#define SLOW_HOLD_MS 50
+
+static int64_t submitted_us[2 * FRAMES];
+
+static opus_int32 encode(const opus_int16 *pcm, int frame_size, unsigned char *data, opus_int32 max_data_bytes)
+{
+    memcpy(data, pcm, sizeof(uint32_t));
+    return sizeof(uint32_t);
+}
+
+struct subscriber {
+    const char   *name;
+    int           id;
+    uint32_t      hold_ms;
+    volatile bool stop;
+    struct k_thread thread;
+
+    uint32_t received;
+    uint32_t next;           /* frame expected next */
+    uint32_t gaps;           /* frames skipped */
+    uint32_t out_of_order;
+    uint32_t latency_us[2 * FRAMES];   /* submit to receipt, by frame */
+};
+
+K_THREAD_STACK_DEFINE(sub_stack, 1024);
+
+static void subscriber_entry(void *p1, void *p2, void *p3)
+{
+    struct subscriber *s = p1;
+    while (!s->stop) {
+        struct codec_packet *pkt = codec_packet_get(s->id, K_MSEC(100));
+        if (!pkt) {
+            continue;
+        }
+        uint32_t frame;
+        memcpy(&frame, pkt->data, sizeof(frame));
+        if (frame < s->next) {
+            s->out_of_order++;
+        } else {
+            s->gaps += frame - s->next;
+            s->next = frame + 1;
+        }
+        if (frame < 2 * FRAMES) {
+            s->latency_us[frame] = k_uptime_ticks() - submitted_us[frame];
+        }
+        s->received++;
+        if (s->hold_ms) {
+            k_msleep(s->hold_ms);
+        }
+        codec_packet_release(pkt);
+    }
+}
+
+static void subscribe(struct subscriber *s, const char *name, uint32_t hold_ms, uint32_t first)
+{
+    *s = (struct subscriber){ .name = name, .hold_ms = hold_ms, .next = first };
+    s->id = codec_subscribe(name);
+    CHECK(s->id >= 0);
+    k_thread_create(&s->thread, sub_stack, K_THREAD_STACK_SIZEOF(sub_stack), subscriber_entry, s, NULL, NULL,
+                    K_PRIO_PREEMPT(8), 0, K_NO_WAIT);
+}
+
+/* Submit frames [@p from, @p to); returns how many found the pool empty */
+static uint32_t submit(uint32_t from, uint32_t to)
+{
+    uint32_t overruns = 0;
+    for (uint32_t n = from; n < to; n++) {
+        int16_t *frame = codec_frame_alloc();
+        if (!frame) {
+            overruns++;
+        } else {
+            memcpy(frame, &n, sizeof(n));
+            submitted_us[n] = k_uptime_ticks();
+            CHECK_EQ(codec_frame_submit(frame), 0);
+        }
+        k_msleep(PERIOD_MS);
+    }
+    return overruns;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+    return (x > y) - (x < y);
+}
+
+/* p90 delivery latency of frames [@p from, @p from + FRAMES) */
+static uint32_t p90(const struct subscriber *s, uint32_t from)
+{
+    static uint32_t v[FRAMES];
+    memcpy(v, &s->latency_us[from], sizeof(v));
+    qsort(v, FRAMES, sizeof(v[0]), cmp_u32);
+    return v[FRAMES * 9 / 10];
+}
+
+/* Wait for every thread to take what is queued for it */
+static void settle(void)
+{
+    k_msleep(100 + SLOW_HOLD_MS * CONFIG_OMI_CODEC_SUBSCRIBER_QUEUE_DEPTH);
+}
+
+int main(void)
+{
+    static struct subscriber recorder, pusher, stuck;
+
+    fake_threads_enable();
+    opus_stub_encode_hook = encode;
+    CHECK_EQ(codec_start(), 0);
+    subscribe(&recorder, "recorder", 0, 0);
+    subscribe(&pusher, "pusher", 0, 0);
+
+    uint32_t overruns = submit(0, FRAMES);
+    settle();
+    uint32_t before[2] = { p90(&recorder, 0), p90(&pusher, 0) };
+
+    subscribe(&stuck, "stuck", SLOW_HOLD_MS, FRAMES);
+    overruns += submit(FRAMES, 2 * FRAMES);
+    settle();
+    uint32_t after[2] = { p90(&recorder, FRAMES), p90(&pusher, FRAMES) };
+
+    /* The encoder kept up throughout */
+    CHECK_EQ(overruns, 0);
+
+    /* The two that keep up got every frame, in order, and no later */
+    struct subscriber *fast[] = { &recorder, &pusher };
+    for (int i = 0; i < 2; i++) {
+        CHECK_EQ(fast[i]->received, 2 * FRAMES);
+        CHECK_EQ(fast[i]->gaps, 0);
+        CHECK_EQ(fast[i]->out_of_order, 0);
+        CHECK_EQ(codec_subscriber_dropped(fast[i]->id), 0);
+        CHECK(after[i] < before[i] + PERIOD_MS * 1000 / 2);
+    }
+
+    /* The stuck one lost frames, all of them counted, none out of order */
+    CHECK(stuck.received < FRAMES / 2);
+    CHECK_EQ(stuck.out_of_order, 0);
+    CHECK_EQ(codec_subscriber_dropped(stuck.id), FRAMES - stuck.received);
+    CHECK_EQ(stuck.gaps + stuck.received + (2 * FRAMES - stuck.next), FRAMES);
+
+    printf("%s/%s: %u of %u frames each, p90 latency %u/%u us alone, %u/%u us beside a subscriber holding "
+           "each packet %d ms\n",
+           recorder.name, pusher.name, recorder.received, 2 * FRAMES, before[0], before[1], after[0], after[1],
+           SLOW_HOLD_MS);
+    printf("%s: %u of %u frames, %u dropped; the encoder missed %u frames\n", stuck.name, stuck.received, FRAMES,
+           codec_subscriber_dropped(stuck.id), overruns);
+
+    /* Every packet goes back to the pool once nobody holds it */
+    for (int i = 0; i < 2; i++) {
+        fast[i]->stop = true;
+        codec_unsubscribe(fast[i]->id);
+    }
+    stuck.stop = true;
+    codec_unsubscribe(stuck.id);
+    k_msleep(200 + SLOW_HOLD_MS);
+    CHECK_EQ(k_mem_slab_num_used_get(&codec_packet_slab), 0);
+
+    return fake_test_result("test_codec_subscribers");
+}
@@ -0,0 +1,139 @@
+/*
+ * Codec wakeups: the codec thread sleeps on the frame queue, so it wakes
+ * once per mic block instead of every 10 ms, it starts within scheduling
+ * latency of a block's first frame, and a frame waits only behind the
+ * frames of its own block.
+ *
+ * Built with codec.c (#include below) and mic.c on the threaded fake: the
+ * modelled DMIC delivers 100 ms blocks (the Kconfig default) in real time,
+ * main.c's wiring hands the mic's frames to the codec, and the Opus
+ * stand-in spends ENCODE_US on each. A frame's latency runs from its submit
+ * to the start of its encode; the codec woke for it if it was submitted
+ * after the previous encode had finished.
+ */
+
+#include "../omi/src/lib/core/codec.c"
+
+#include "lib/core/mic.h"
+
+#include "fake_zephyr.h"
+#include "opus_stub.h"
+
+#include <stdlib.h>
+
+uint8_t battery_percentage;
+
+uint8_t app_settings_get_mic_gain(void)
+{
+    return 6;
+}
+
+#define SECONDS      2
+#define FRAMES       (SECONDS * 50)
+#define BLOCK_FRAMES (CONFIG_OMI_MIC_BLOCK_MS / 20)
+#define ENCODE_US    4000   /* 20 % of the frame period */
+#define POLL_MS      10     /* the codec thread's old sleep between polls */
+
+static int64_t submitted_us[CODEC_FRAME_POOL_SIZE];   /* by frame in the pool */
+static int64_t encoded_us;                            /* end of the last encode */
+
+static uint32_t frames, wakeups;
+static uint32_t latency_us[FRAMES];
+static uint32_t wake_latency_us[FRAMES];
+
+static size_t frame_index(const int16_t *frame)
+{
+    return ((const char *) frame - codec_frame_slab.buffer) / codec_frame_slab.block_size;
+}
+
+/* main.c's mic handler, noting when the frame was handed over */
+static void mic_handler(int16_t *frame)
+{
+    submitted_us[frame_index(frame)] = k_uptime_ticks();
+    codec_frame_submit(frame);
+}
+
+static opus_int32 encode(const opus_int16 *pcm, int frame_size, unsigned char *data, opus_int32 max_data_bytes)
+{
+    int64_t start = k_uptime_ticks();
+    if (frames < FRAMES) {
+        int64_t submitted = submitted_us[frame_index(pcm)];
+        latency_us[frames++] = start - submitted;
+        if (submitted >= encoded_us) {
+            wake_latency_us[wakeups++] = start - submitted;
+        }
+    }
+    while (k_uptime_ticks() < start + ENCODE_US) {
+    }
+    encoded_us = k_uptime_ticks();
+    data[0] = 0;
+    return 1;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+    return (x > y) - (x < y);
+}
+
+/* @p pct percentile of @p n values, sorting them */
+static uint32_t percentile(uint32_t *v, uint32_t n, uint32_t pct)
+{
+    qsort(v, n, sizeof(*v), cmp_u32);
+    return v[(n - 1) * pct / 100];
+}
+
+int main(void)
+{
+    fake_threads_enable();
+    opus_stub_encode_hook = encode;
+    int sub = codec_subscribe("test");
+    CHECK(sub >= 0);
+    CHECK_EQ(codec_start(), 0);
+
+    set_mic_frame_allocator(codec_frame_alloc, CODEC_PACKAGE_SAMPLES);
+    set_mic_callback(mic_handler);
+    CHECK_EQ(mic_start(), 0);
+
+    /* Take every packet, as a subscriber that keeps up would */
+    uint32_t received = 0;
+    while (received < FRAMES) {
+        struct codec_packet *pkt = codec_packet_get(sub, K_SECONDS(1));
+        if (!pkt) {
+            break;
+        }
+        codec_packet_release(pkt);
+        received++;
+    }
+    struct fake_dmic_stats dmic = fake_dmic_stats();
+
+    CHECK_EQ(received, FRAMES);
+    CHECK_EQ(frames, FRAMES);
+    CHECK_EQ(dmic.overruns, 0);
+    CHECK_EQ(codec_subscriber_dropped(sub), 0);
+
+    /* One wakeup per block at most, where polling woke twice per frame */
+    CHECK(wakeups > 0);
+    CHECK(wakeups <= FRAMES / BLOCK_FRAMES);
+    CHECK(wakeups <= dmic.blocks);
+
+    uint32_t wake_p50 = percentile(wake_latency_us, wakeups, 50);
+    uint32_t wake_max = percentile(wake_latency_us, wakeups, 100);
+    uint32_t p50 = percentile(latency_us, FRAMES, 50);
+    uint32_t p90 = percentile(latency_us, FRAMES, 90);
+    uint32_t p99 = percentile(latency_us, FRAMES, 99);
+
+    /* Woken at once, not at the next poll (5 ms on average), then waiting
+     * only behind the block's earlier frames; medians and p90, so a host
+     * preemption does not fail the test */
+    CHECK(wake_p50 < POLL_MS * 1000 / 4);
+    CHECK(p90 < (BLOCK_FRAMES - 1) * ENCODE_US + POLL_MS * 1000 / 4);
+
+    printf("%d ms blocks, %u frames: %u wakeups (%.2f per frame; a %d ms poll makes %.2f)\n",
+           CONFIG_OMI_MIC_BLOCK_MS, FRAMES, wakeups, (double) wakeups / FRAMES, POLL_MS, 20.0 / POLL_MS);
+    printf("wakeup latency p50 %u us, max %u us; frame latency p50 %u us, p90 %u us, p99 %u us "
+           "(%d us per encode)\n",
+           wake_p50, wake_max, p50, p90, p99, ENCODE_US);
+
+    return fake_test_result("test_codec_wakeup");
+}
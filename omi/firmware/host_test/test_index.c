@@ -0,0 +1,257 @@
+/*
+ * reclo_index: a retimestamped chunk keeps its size through a journal
+ * replay, and compaction runs in bounded steps on the work queue while
+ * chunks keep being added, removed and retimestamped, producing a journal
+ * that replays to the same table.
+ *
+ * Built with the module itself (#include below) to reach the table and to
+ * run the compaction work item one step at a time.
+ *
+ * A card holding 10 000 chunks, more than the default table of 2048, is
+ * enumerated oldest first in rounds: each round uploads what the table
+ * holds, and the rescan queued once it has drained by half brings in the
+ * next oldest.
+ */
+
+#include "../omi/src/reclo_index.c"
+
+#include "fake_zephyr.h"
+
+#include <string.h>
+
+#define FIRST_TS  1700000000U
+
+/* The newest ADD in the journal is checked against the card on replay */
+static void put_chunk(uint32_t ts, uint8_t state)
+{
+    char path[64];
+    reclo_index_chunk_path(path, sizeof(path), ts, state);
+    CHECK_EQ(fake_fs_put(path, "x", 1), 0);
+}
+
+static void add(uint32_t ts, uint32_t size)
+{
+    put_chunk(ts, RECLO_CHUNK_UNSYNCED);
+    CHECK_EQ(reclo_index_add(ts, RECLO_CHUNK_UNSYNCED, size), 0);
+}
+
+static void retimestamp(uint32_t old_ts, uint32_t new_ts)
+{
+    put_chunk(new_ts, RECLO_CHUNK_READY);
+    CHECK_EQ(reclo_index_retimestamp(old_ts, new_ts), 0);
+}
+
+static void fresh(void)
+{
+    journal_close();
+    snapshot_abort();
+    fake_work_run_all();
+    fake_fs_reset();
+    CHECK_EQ(reclo_index_init(), 0);
+}
+
+/* Re-initialise from the journal on the card, as after a reboot */
+static void reboot(void)
+{
+    journal_close();
+    CHECK(!_snap_open);
+    table_clear();
+    CHECK_EQ(reclo_index_init(), 0);
+}
+
+static void test_retimestamp_keeps_size(void)
+{
+    fresh();
+    add(1000, 4321);
+    add(1060, 777);
+    retimestamp(1000, FIRST_TS);
+    reboot();
+
+    struct reclo_chunk_info info;
+    CHECK_EQ(reclo_index_find_from(RECLO_CHUNK_READY, 0, &info), 0);
+    CHECK_EQ(info.ts, FIRST_TS);
+    CHECK_EQ(info.size, 4321);
+    CHECK_EQ(reclo_index_find_from(RECLO_CHUNK_UNSYNCED, 0, &info), 0);
+    CHECK_EQ(info.size, 777);
+}
+
+/* The table as (ts, state, size) triples, to compare across a replay */
+static int table_copy(struct index_entry *out)
+{
+    memcpy(out, _entries, (size_t) _count * sizeof(_entries[0]));
+    for (int i = 0; i < _count; i++) {
+        out[i].sent = 0;   /* not journaled */
+    }
+    return _count;
+}
+
+static void test_compaction_in_steps(void)
+{
+    fresh();
+
+    /* Enough churn to go past COMPACT_SLACK */
+    const uint32_t n = 200 + COMPACT_SLACK;
+    for (uint32_t i = 0; i < n; i++) {
+        add(FIRST_TS + i * 30, 1000 + i);
+    }
+    for (uint32_t i = 200; i < n; i++) {
+        CHECK_EQ(reclo_index_remove(FIRST_TS + i * 30), 0);
+    }
+    CHECK(_jnl_records > (uint32_t) _count + COMPACT_SLACK);
+
+    /* The append that crossed the limit only queued the work */
+    CHECK(_compact_work.pending);
+    CHECK(!_snap_open);
+
+    /* Step by step, with changes either side of the snapshot's position */
+    uint32_t steps = 0;
+    uint32_t next  = FIRST_TS + n * 30;
+    while (_compact_work.pending) {
+        uint32_t writes = fake_fs_calls(FAKE_FS_WRITE);
+        CHECK(fake_work_run_one() == &_compact_work);
+        steps++;
+        /* The header plus one batch at most */
+        CHECK(fake_fs_calls(FAKE_FS_WRITE) - writes <= 2);
+        if (!_snap_open) {
+            break;
+        }
+
+        /* Already in the snapshot: removed and added again, and
+         * retimestamped past the position */
+        int      i    = lower_bound(_snap_next);
+        uint32_t last = _entries[i - 1].ts;
+        uint32_t prev = _entries[i - 2].ts;
+        CHECK_EQ(reclo_index_remove(last), 0);
+        if (steps % 2 == 0) {
+            add(last, 5000 + steps);
+        }
+        retimestamp(prev, next);
+        next += 30;
+
+        /* Not yet in it: retimestamped behind the position, and a new chunk */
+        i = lower_bound(_snap_next);
+        if (i < _count && _entries[i].ts < FIRST_TS + n * 30) {
+            retimestamp(_entries[i].ts, last - 1);
+        }
+        add(next, 6000 + steps);
+        next += 30;
+    }
+    CHECK(steps > 2);
+    CHECK(!_snap_open);
+    CHECK(!fake_fs_exists(RECLO_INDEX_NEW_PATH));
+    CHECK(_jnl_records < (uint32_t) _count + COMPACT_SLACK);
+
+    /* Appends after the swap go to the compacted journal */
+    add(next, 42);
+
+    static struct index_entry before[RECLO_INDEX_MAX_ENTRIES], after[RECLO_INDEX_MAX_ENTRIES];
+    int count = table_copy(before);
+    reboot();
+    CHECK_EQ(table_copy(after), count);
+    CHECK(memcmp(before, after, (size_t) count * sizeof(before[0])) == 0);
+    printf("compaction: %u step(s), %d chunks, %u journal records\n", steps, count, _jnl_records);
+}
+
+/* A full snapshot (boot, rescan) while compacting replaces the partial one */
+static void test_snapshot_while_compacting(void)
+{
+    fresh();
+    for (uint32_t i = 0; i < 100 + COMPACT_SLACK; i++) {
+        add(FIRST_TS + i * 30, 100);
+        if (i >= 100) {
+            CHECK_EQ(reclo_index_remove(FIRST_TS + i * 30), 0);
+        }
+    }
+    CHECK(fake_work_run_one() == &_compact_work);
+    CHECK(_snap_open);
+
+    k_mutex_lock(&_idx_mutex, K_FOREVER);
+    CHECK_EQ(journal_write_snapshot(), 0);
+    k_mutex_unlock(&_idx_mutex);
+    CHECK(!_snap_open);
+    CHECK_EQ(_jnl_records, 1 + 100);
+
+    /* The queued step finds nothing left to do */
+    fake_work_run_all();
+    CHECK_EQ(_jnl_records, 1 + 100);
+    reboot();
+    CHECK_EQ(_count, 100);
+}
+
+#define CARD_CHUNKS  10000   /* ~83 h of 30 s chunks */
+
+static void test_enumerate_full_card(void)
+{
+    fresh();
+
+    /* FAT hands files back in directory order, which is not time order */
+    for (uint32_t k = 0; k < CARD_CHUNKS; k++) {
+        put_chunk(FIRST_TS + (k * 7919 % CARD_CHUNKS) * 30, RECLO_CHUNK_READY);
+    }
+    journal_close();
+    table_clear();
+    CHECK_EQ(fs_unlink(RECLO_INDEX_PATH), 0);
+
+    int64_t t0 = k_uptime_ticks();
+    CHECK_EQ(reclo_index_init(), 0);
+    int64_t scan_us = k_uptime_ticks() - t0;
+    CHECK_EQ(_count, RECLO_INDEX_MAX_ENTRIES);
+    CHECK(_overflowed);
+
+    uint32_t expect    = FIRST_TS;
+    uint32_t rounds    = 0;
+    uint32_t rescans   = 0;
+    int64_t  enum_us   = 0;
+    int64_t  remove_us = 0;
+    while (reclo_index_count(RECLO_CHUNK_READY) > 0) {
+        static uint32_t batch[RECLO_INDEX_MAX_ENTRIES];
+        uint32_t n = 0;
+
+        /* As the upload thread does: oldest first, from the last one sent */
+        struct reclo_chunk_info info;
+        t0 = k_uptime_ticks();
+        for (uint32_t from = 0; reclo_index_find_from(RECLO_CHUNK_READY, from, &info) == 0; from = info.ts + 1) {
+            batch[n++] = info.ts;
+        }
+        enum_us += k_uptime_ticks() - t0;
+
+        /* The oldest chunks left on the card, none skipped */
+        for (uint32_t i = 0; i < n; i++) {
+            CHECK_EQ(batch[i], expect);
+            expect += 30;
+        }
+
+        t0 = k_uptime_ticks();
+        for (uint32_t i = 0; i < n; i++) {
+            char path[64];
+            reclo_index_chunk_path(path, sizeof(path), batch[i], RECLO_CHUNK_READY);
+            CHECK_EQ(fs_unlink(path), 0);
+            CHECK_EQ(reclo_index_remove(batch[i]), 0);
+        }
+        remove_us += k_uptime_ticks() - t0;
+        rounds++;
+
+        if (_rebuild_work.pending) {
+            rescans++;
+        }
+        fake_work_run_all();
+    }
+    CHECK_EQ(expect, FIRST_TS + CARD_CHUNKS * 30);
+    CHECK_EQ(rescans, DIV_ROUND_UP(CARD_CHUNKS, RECLO_INDEX_MAX_ENTRIES) - 1);
+    CHECK(!_overflowed);
+
+    printf("%u chunks, %u-entry table: boot scan %lld us, %u round(s), %u rescan(s), "
+           "enumerate %lld us (%lld ns/chunk), remove %lld us\n",
+           CARD_CHUNKS, RECLO_INDEX_MAX_ENTRIES, (long long) scan_us, rounds, rescans, (long long) enum_us,
+           (long long) enum_us * 1000 / CARD_CHUNKS, (long long) remove_us);
+}
+
+int main(void)
+{
+    test_retimestamp_keeps_size();
+    test_compaction_in_steps();
+    test_snapshot_while_compacting();
+    test_enumerate_full_card();
+
+    return fake_test_result("test_index");
+}
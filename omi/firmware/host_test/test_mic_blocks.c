@@ -0,0 +1,122 @@
+/*
+ * Mic block size: whatever CONFIG_OMI_MIC_BLOCK_MS is (10, 20, 50 or 100;
+ * one build of this test each), every sample the PDM delivers reaches the
+ * codec's frames once, in order, with no gap where a block ends part way
+ * through a frame.
+ *
+ * mic.c (#include below) runs on the threaded fake with the modelled DMIC,
+ * which writes each stereo pair's sequence number into both channels, so
+ * the downmix hands it on unchanged. Frames come from a pool of two, as
+ * from the codec's, and the handler checks each sample against the one
+ * expected next. The report gives the slab RAM, the mic thread's reads per
+ * second and how old a frame's first sample is when the frame is handed
+ * over.
+ */
+
+#include "../omi/src/mic.c"
+
+#include "fake_zephyr.h"
+
+#include <stdlib.h>
+
+uint8_t app_settings_get_mic_gain(void)
+{
+    return 6;
+}
+
+#define SECONDS       2
+#define FRAME_SAMPLES 320
+#define FRAMES        (SECONDS * 50)
+#define SPEEDUP       2
+
+/* ── Modelled PDM ────────────────────────────────────────────────────────────*/
+
+static int64_t dma_start_us;
+
+static void fill(int16_t *interleaved, size_t frames, uint64_t first)
+{
+    if (first == 0) {
+        dma_start_us = k_uptime_ticks() - (int64_t) frames * 1000000 / MAX_SAMPLE_RATE / SPEEDUP;
+    }
+    for (size_t i = 0; i < frames; i++) {
+        interleaved[2 * i] = interleaved[2 * i + 1] = (int16_t) (first + i);
+    }
+}
+
+/* When pair @p n had been captured, in host time */
+static int64_t captured_us(uint64_t n)
+{
+    return dma_start_us + (int64_t) ((n + 1) * 1000000 / MAX_SAMPLE_RATE / SPEEDUP);
+}
+
+/* ── Codec side ──────────────────────────────────────────────────────────────*/
+
+static int16_t  pool[2][FRAME_SAMPLES];
+static uint32_t next_frame;
+
+static int16_t *pool_alloc(void)
+{
+    return pool[next_frame++ % 2];
+}
+
+static volatile uint32_t frames;
+static uint64_t          expected;      /* sequence number of the next sample */
+static uint32_t          mismatches;
+static uint32_t          age_us[FRAMES];
+
+static void mic_handler(int16_t *frame)
+{
+    int64_t now = k_uptime_ticks();
+    if (frames >= FRAMES) {
+        return;
+    }
+    age_us[frames] = (uint32_t) ((now - captured_us(expected)) * SPEEDUP);
+    for (int i = 0; i < FRAME_SAMPLES; i++, expected++) {
+        mismatches += frame[i] != (int16_t) expected;
+    }
+    frames++;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+    return (x > y) - (x < y);
+}
+
+int main(void)
+{
+    fake_threads_enable();
+    fake_dmic_set_speedup(SPEEDUP);
+    fake_dmic_fill = fill;
+    set_mic_frame_allocator(pool_alloc, FRAME_SAMPLES);
+    set_mic_callback(mic_handler);
+    CHECK_EQ(mic_start(), 0);
+
+    for (int waited = 0; frames < FRAMES && waited < 4 * SECONDS * 1000 / SPEEDUP; waited += 10) {
+        k_msleep(10);
+    }
+    struct fake_dmic_stats dmic = fake_dmic_stats();
+
+    /* Every sample, once and in order, and the slab never ran dry */
+    CHECK_EQ(frames, FRAMES);
+    CHECK_EQ(mismatches, 0);
+    CHECK_EQ(expected, (uint64_t) FRAMES * FRAME_SAMPLES);
+    CHECK_EQ(dmic.overruns, 0);
+
+    /* A frame goes as soon as the block holding its last sample is read:
+     * its first sample waits for the rest of the frame, or of the block */
+    qsort(age_us, FRAMES, sizeof(age_us[0]), cmp_u32);
+    uint32_t p50 = age_us[FRAMES / 2];
+    CHECK(p50 <= MAX(20, CONFIG_OMI_MIC_BLOCK_MS) * 1000 + 5000);
+
+    unsigned slab = sizeof(_slab_buf_mem_slab);
+    CHECK_EQ(slab, MAX_BLOCK_SIZE * BLOCK_COUNT);
+    printf("%d ms blocks: slab %u x %u B = %u B, %d reads/s; %u frames, first sample %u us old at "
+           "handover (p50), %u us (max)\n",
+           CONFIG_OMI_MIC_BLOCK_MS, BLOCK_COUNT, (unsigned) MAX_BLOCK_SIZE, slab, 1000 / CONFIG_OMI_MIC_BLOCK_MS,
+           frames, p50, age_us[FRAMES - 1]);
+
+    char name[32];
+    snprintf(name, sizeof(name), "test_mic_blocks_%d", CONFIG_OMI_MIC_BLOCK_MS);
+    return fake_test_result(name);
+}
@@ -0,0 +1,149 @@
+/*
+ * mic_dsp: the DSP-extension kernels must match the C reference bit for bit.
+ *
+ * mic_dsp.c is built here with CONFIG_OMI_MIC_DSP_SIMD and
+ * __ARM_FEATURE_SIMD32 against fake/acle/arm_acle.h, so mic_dsp_downmix()
+ * and friends run the packed-halfword code paths, while the *_ref functions
+ * in the same object are the reference. Inputs cover full-scale and
+ * saturating samples, every block length up to 33 (odd lengths exercise the
+ * scalar tail) and unaligned buffers.
+ */
+
+#include "mic_dsp.h"
+
+#include "fake_zephyr.h"
+
+#include <string.h>
+
+#define MAX_SAMPLES 512
+
+static const int16_t edges[] = {
+    INT16_MIN, INT16_MIN + 1, -16385, -16384, -1, 0, 1, 16383, 16384, INT16_MAX - 1, INT16_MAX,
+};
+
+static uint32_t rng = 12345;
+
+static int16_t next_sample(void)
+{
+    rng = rng * 1664525U + 1013904223U;
+    uint32_t r = rng >> 8;
+    /* A third full-range noise, a third edge values, a third quiet */
+    switch (r % 3) {
+    case 0:
+        return (int16_t) (r >> 2);
+    case 1:
+        return edges[(r >> 2) % (sizeof(edges) / sizeof(edges[0]))];
+    default:
+        return (int16_t) ((int32_t) ((r >> 2) % 512) - 256);
+    }
+}
+
+static void fill(int16_t *buf, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        buf[i] = next_sample();
+    }
+}
+
+/* Odd sample offsets give 2-byte-aligned but not word-aligned buffers */
+static void test_downmix(size_t frames, size_t offset)
+{
+    int16_t in[2 * MAX_SAMPLES + 2];
+    int16_t simd[MAX_SAMPLES + 2];
+    int16_t ref[MAX_SAMPLES + 2];
+
+    fill(in, 2 * frames + offset);
+    memset(simd, 0x5A, sizeof(simd));
+    memset(ref, 0x5A, sizeof(ref));
+
+    mic_dsp_downmix(in + offset, frames, simd + offset);
+    mic_dsp_downmix_ref(in + offset, frames, ref + offset);
+    CHECK(memcmp(simd, ref, sizeof(simd)) == 0);
+}
+
+static void test_gain(size_t n, size_t offset, unsigned shift)
+{
+    int16_t simd[MAX_SAMPLES + 2];
+    int16_t ref[MAX_SAMPLES + 2];
+
+    fill(simd, n + offset);
+    memcpy(ref, simd, sizeof(simd));
+
+    mic_dsp_gain(simd + offset, n, shift);
+    mic_dsp_gain_ref(ref + offset, n, shift);
+    CHECK(memcmp(simd, ref, sizeof(simd)) == 0);
+}
+
+static void test_energy(size_t n, size_t offset)
+{
+    int16_t buf[MAX_SAMPLES + 2];
+    fill(buf, n + offset);
+    CHECK_EQ(mic_dsp_energy(buf + offset, n), mic_dsp_energy_ref(buf + offset, n));
+}
+
+/* Every pair of edge values through each kernel */
+static void test_edge_pairs(void)
+{
+    size_t ne = sizeof(edges) / sizeof(edges[0]);
+    int16_t in[2 * 11 * 11];
+    int16_t simd[11 * 11], ref[11 * 11];
+
+    for (size_t a = 0; a < ne; a++) {
+        for (size_t b = 0; b < ne; b++) {
+            in[2 * (a * ne + b)] = edges[a];
+            in[2 * (a * ne + b) + 1] = edges[b];
+        }
+    }
+    mic_dsp_downmix(in, ne * ne, simd);
+    mic_dsp_downmix_ref(in, ne * ne, ref);
+    CHECK(memcmp(simd, ref, sizeof(simd)) == 0);
+
+    for (unsigned shift = 1; shift <= 16; shift++) {
+        memcpy(simd, in, sizeof(simd));
+        memcpy(ref, in, sizeof(ref));
+        mic_dsp_gain(simd, ne * ne, shift);
+        mic_dsp_gain_ref(ref, ne * ne, shift);
+        CHECK(memcmp(simd, ref, sizeof(simd)) == 0);
+    }
+
+    /* All full-scale negative: the largest possible energy per sample */
+    int16_t full[MAX_SAMPLES];
+    for (size_t i = 0; i < MAX_SAMPLES; i++) {
+        full[i] = INT16_MIN;
+    }
+    CHECK_EQ(mic_dsp_energy(full, MAX_SAMPLES), (uint64_t) MAX_SAMPLES << 30);
+    CHECK_EQ(mic_dsp_energy_ref(full, MAX_SAMPLES), (uint64_t) MAX_SAMPLES << 30);
+
+    /* (-32768 + -32768) >> 1 and (32767 + 32767) >> 1 */
+    int16_t pair[4] = { INT16_MIN, INT16_MIN, INT16_MAX, INT16_MAX };
+    mic_dsp_downmix(pair, 2, simd);
+    CHECK_EQ(simd[0], INT16_MIN);
+    CHECK_EQ(simd[1], INT16_MAX);
+
+    /* -1 + 0 halves to -1: both round towards minus infinity */
+    int16_t odd[4] = { -1, 0, 1, 0 };
+    mic_dsp_downmix(odd, 2, simd);
+    CHECK_EQ(simd[0], -1);
+    CHECK_EQ(simd[1], 0);
+}
+
+int main(void)
+{
+    for (int round = 0; round < 20; round++) {
+        for (size_t n = 0; n <= 33; n++) {
+            for (size_t offset = 0; offset <= 1; offset++) {
+                test_downmix(n, offset);
+                test_energy(n, offset);
+                for (unsigned shift = 0; shift <= 4; shift++) {
+                    test_gain(n, offset, shift);
+                }
+            }
+        }
+        test_downmix(MAX_SAMPLES - 1, 1);
+        test_gain(MAX_SAMPLES - 1, 1, 3);
+        test_energy(MAX_SAMPLES - 1, 1);
+    }
+    test_edge_pairs();
+
+    return fake_test_result("test_mic_dsp");
+}
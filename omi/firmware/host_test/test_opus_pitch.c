@@ -0,0 +1,140 @@
+/*
+ * Opus Armv8-M kernels (arm/pitch_armv8m.h): celt_inner_prod, dual_inner_prod
+ * and xcorr_kernel must match the generic C versions in pitch.h bit for bit.
+ *
+ * pitch.h is included without any ARM configuration, so it supplies the *_c
+ * references with the generic MAC16_16; the SMLAD kernels run on the modelled
+ * intrinsics in fake/acle/arm_acle.h. Built with -fwrapv: on the target the
+ * 32-bit accumulators wrap, and full-scale input makes them overflow here.
+ */
+
+#include "arch.h"
+#include "pitch.h"
+
+/* pitch.h already mapped the generic names to the C kernels */
+#undef celt_inner_prod
+#undef dual_inner_prod
+#undef xcorr_kernel
+#include "arm/pitch_armv8m.h"
+
+#include "fake_zephyr.h"
+
+#include <string.h>
+#include <time.h>
+
+#define MAX_N 960   /* the longest vector the 48 kHz 20 ms CELT mode passes */
+
+static const opus_val16 edges[] = { INT16_MIN, INT16_MIN + 1, -1, 0, 1, INT16_MAX - 1, INT16_MAX };
+
+static uint32_t rng = 2024;
+
+static opus_val16 next_sample(void)
+{
+    rng = rng * 1664525U + 1013904223U;
+    uint32_t r = rng >> 8;
+    switch (r % 4) {
+    case 0:
+        return edges[(r >> 2) % (sizeof(edges) / sizeof(edges[0]))];
+    case 1:
+        return (opus_val16) ((int32_t) ((r >> 2) % 2048) - 1024);
+    default:
+        return (opus_val16) (r >> 2);
+    }
+}
+
+static void fill(opus_val16 *buf, int n)
+{
+    for (int i = 0; i < n; i++) {
+        buf[i] = next_sample();
+    }
+}
+
+/* Odd offsets hand the kernels 2-byte-aligned but not word-aligned vectors */
+static void test_lengths(int n, int off)
+{
+    opus_val16 x[MAX_N + 8], y0[MAX_N + 8], y1[MAX_N + 8];
+    fill(x, n + off + 4);
+    fill(y0, n + off + 4);
+    fill(y1, n + off + 4);
+
+    CHECK_EQ(celt_inner_prod_armv8m(x + off, y0 + off, n), celt_inner_prod_c(x + off, y0 + off, n));
+
+    opus_val32 a1, a2, c1, c2;
+    dual_inner_prod_armv8m(x + off, y0 + off, y1 + off, n, &a1, &a2);
+    dual_inner_prod_c(x + off, y0 + off, y1 + off, n, &c1, &c2);
+    CHECK_EQ(a1, c1);
+    CHECK_EQ(a2, c2);
+
+    if (n >= 3) {
+        /* Non-zero starting sums: callers accumulate across calls */
+        opus_val32 sa[4], sc[4];
+        for (int k = 0; k < 4; k++) {
+            sa[k] = sc[k] = (opus_val32) (next_sample() * 1000);
+        }
+        /* x and y at different parities, as in celt_fir's sliding window */
+        xcorr_kernel_armv8m(x + off, y0 + 1 - off, sa, n);
+        xcorr_kernel_c(x + off, y0 + 1 - off, sc, n);
+        CHECK(memcmp(sa, sc, sizeof(sa)) == 0);
+    }
+}
+
+/* Every sample INT16_MIN: 2^30 per product, the accumulators wrap */
+static void test_full_scale(void)
+{
+    opus_val16 x[MAX_N + 4];
+    for (int i = 0; i < MAX_N + 4; i++) {
+        x[i] = INT16_MIN;
+    }
+    for (int n = 1; n <= 9; n++) {
+        CHECK_EQ(celt_inner_prod_armv8m(x, x, n), celt_inner_prod_c(x, x, n));
+        CHECK_EQ(celt_inner_prod_armv8m(x, x, n), (opus_val32) ((uint32_t) n << 30));
+    }
+    CHECK_EQ(celt_inner_prod_armv8m(x, x, MAX_N), celt_inner_prod_c(x, x, MAX_N));
+
+    opus_val32 sa[4] = { INT32_MAX, INT32_MIN, 0, -1 }, sc[4];
+    memcpy(sc, sa, sizeof(sc));
+    xcorr_kernel_armv8m(x, x, sa, MAX_N - 1);
+    xcorr_kernel_c(x, x, sc, MAX_N - 1);
+    CHECK(memcmp(sa, sc, sizeof(sa)) == 0);
+}
+
+/* Host timing only shows the loop structure; the M33 cycle counts need the
+ * target (DWT_CYCCNT around opus_encode) */
+static void report_timing(void)
+{
+    static opus_val16 x[MAX_N + 4], y[MAX_N + 4];
+    volatile opus_val32 sink = 0;
+    const int reps = 20000;
+    fill(x, MAX_N + 4);
+    fill(y, MAX_N + 4);
+
+    clock_t t0 = clock();
+    for (int r = 0; r < reps; r++) {
+        sink += celt_inner_prod_c(x, y, MAX_N - (r & 1));
+    }
+    clock_t t1 = clock();
+    for (int r = 0; r < reps; r++) {
+        sink += celt_inner_prod_armv8m(x, y, MAX_N - (r & 1));
+    }
+    clock_t t2 = clock();
+    (void) sink;
+
+    printf("celt_inner_prod, N=%d, %d calls (host, modelled SMLAD): C %ld us, armv8m %ld us\n", MAX_N, reps,
+           (long) ((t1 - t0) * 1000000 / CLOCKS_PER_SEC), (long) ((t2 - t1) * 1000000 / CLOCKS_PER_SEC));
+}
+
+int main(void)
+{
+    for (int round = 0; round < 50; round++) {
+        for (int n = 0; n <= 40; n++) {
+            test_lengths(n, 0);
+            test_lengths(n, 1);
+        }
+        test_lengths(MAX_N, 1);
+        test_lengths(MAX_N - 1, 0);
+    }
+    test_full_scale();
+    report_timing();
+
+    return fake_test_result("test_opus_pitch");
+}
@@ -0,0 +1,257 @@
+/*
+ * Recorder packet size: bytes per hour on the card with 20, 40 or 60 ms
+ * records (CONFIG_OMI_RECLO_PACKET_FRAMES 1, 2 or 3; one build of this test
+ * each).
+ *
+ * Five minutes of the fixed conversation in opus_corpus.c are encoded with
+ * the vendored Opus at the codec's settings. The frames go through
+ * on_codec_output() (#include below) in 30 s chunks, with the writer run as
+ * in test_recorder_write. Every packet on the card must then decode to the
+ * frames it holds, all frames must be there, and the bytes they take are
+ * set against what the same frames cost as 20 ms records.
+ */
+
+#include "../omi/src/reclo_recorder.c"
+
+#include "lib/core/config.h"
+
+#include "fake_zephyr.h"
+#include "opus_corpus.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define RATE         OPUS_CORPUS_RATE
+#define FRAME        OPUS_CORPUS_FRAME
+#define SECONDS      300
+#define FRAMES       (SECONDS * 50)
+#define CHUNK_FRAMES (RECLO_CHUNK_DURATION_S * 50)
+#define MAX_CHUNKS   (FRAMES / CHUNK_FRAMES + 1)
+#define N            RECLO_PACKET_FRAMES
+
+/* ── Stand-ins for the codec, RTC and transfer modules ───────────────────────*/
+
+int codec_subscribe(const char *name)
+{
+    return 0;
+}
+
+uint32_t codec_subscriber_dropped(int sub)
+{
+    return 0;
+}
+
+struct codec_packet *codec_packet_get(int sub, k_timeout_t timeout)
+{
+    return NULL;
+}
+
+void codec_packet_release(struct codec_packet *pkt)
+{
+}
+
+void codec_get_settings(struct codec_settings *settings)
+{
+    *settings = (struct codec_settings){ .complexity = 3, .bitrate = 32000 };
+}
+
+uint32_t get_utc_time(void)
+{
+    return 0;
+}
+
+int reclo_transfer_count_chunks(void)
+{
+    return reclo_index_count(RECLO_CHUNK_UNSYNCED);
+}
+
+/* ── Driving the recorder ────────────────────────────────────────────────────*/
+
+/* Mean square, as the codec fills codec_packet::energy */
+static uint32_t energy(const int16_t *pcm)
+{
+    uint64_t sum = 0;
+    for (int i = 0; i < FRAME; i++) {
+        sum += (uint64_t) ((int32_t) pcm[i] * pcm[i]);
+    }
+    return (uint32_t) (sum / FRAME);
+}
+
+static void writer_run(void)
+{
+    struct write_req req;
+    while (k_msgq_get(&_write_q, &req, K_NO_WAIT) == 0) {
+        handle_write_req(&req);
+        k_sem_take(&_writer_ack, K_NO_WAIT);
+    }
+}
+
+/* As test_recorder_write: open the first chunk, then let frames in */
+static void start(void)
+{
+    struct write_req req = { .op = WRITE_OP_OPEN };
+    handle_write_req(&req);
+    k_sem_take(&_writer_ack, K_NO_WAIT);
+    CHECK(_file_open);
+    _level_count[_level_track] = 0;
+    _reserve_header = true;
+    _recording      = true;
+}
+
+/* ── Reading the card ────────────────────────────────────────────────────────*/
+
+static uint8_t *read_file(const char *path, size_t *size)
+{
+    struct fs_dirent ent;
+    struct fs_file_t f;
+    CHECK_EQ(fs_stat(path, &ent), 0);
+    uint8_t *buf = malloc(ent.size);
+    fs_file_t_init(&f);
+    CHECK_EQ(fs_open(&f, path, FS_O_READ), 0);
+    CHECK_EQ(fs_read(&f, buf, ent.size), (ssize_t) ent.size);
+    fs_close(&f);
+    *size = ent.size;
+    return buf;
+}
+
+static int cmp_str(const void *a, const void *b)
+{
+    return strcmp(a, b);
+}
+
+struct card {
+    int      chunks;
+    uint64_t file_bytes;   /* headers included */
+    uint64_t data_bytes;
+    uint32_t records;
+    uint32_t frames;
+};
+
+/* Parse and decode every chunk on the card */
+static struct card read_card(void)
+{
+    struct card card = { 0 };
+    char names[MAX_CHUNKS][MAX_FILE_NAME + 1];
+
+    struct fs_dir_t  dir;
+    struct fs_dirent ent;
+    fs_dir_t_init(&dir);
+    CHECK_EQ(fs_opendir(&dir, RECLO_STORAGE_DIR), 0);
+    while (fs_readdir(&dir, &ent) == 0 && ent.name[0] != '\0') {
+        size_t len = strlen(ent.name);
+        if (len > 4 && (strcmp(ent.name + len - 4, ".upt") == 0 || strcmp(ent.name + len - 4, ".bin") == 0) &&
+            card.chunks < MAX_CHUNKS) {
+            memcpy(names[card.chunks++], ent.name, len + 1);
+        }
+    }
+    fs_closedir(&dir);
+    qsort(names, (size_t) card.chunks, sizeof(names[0]), cmp_str);
+
+    int err;
+    OpusDecoder *dec = opus_decoder_create(RATE, 1, &err);
+    CHECK_EQ(err, OPUS_OK);
+    static opus_int16 pcm[N * FRAME];
+
+    for (int c = 0; c < card.chunks; c++) {
+        char path[sizeof(RECLO_STORAGE_DIR) + sizeof(names[0])];
+        snprintf(path, sizeof(path), RECLO_STORAGE_DIR "/%.*s", MAX_FILE_NAME, names[c]);
+        size_t   size;
+        uint8_t *buf = read_file(path, &size);
+
+        struct reclo_chunk_hdr hdr;
+        CHECK_EQ(reclo_chunk_hdr_parse(buf, size, &hdr), 0);
+        CHECK_EQ(hdr.packet_frames, N);
+        CHECK_EQ(hdr.data_size, size - hdr.hdr_size);
+        card.file_bytes += size;
+        card.data_bytes += hdr.data_size;
+
+        size_t off = hdr.hdr_size;
+        while (off + 2 <= size) {
+            uint16_t len = (uint16_t) (buf[off] | (buf[off + 1] << 8));
+            CHECK(off + 2 + len <= size);
+            int frames = opus_packet_get_nb_frames(&buf[off + 2], len);
+            CHECK(frames >= 1 && frames <= N);
+            CHECK_EQ(opus_decode(dec, &buf[off + 2], len, pcm, N * FRAME, 0), frames * FRAME);
+            card.records++;
+            card.frames += frames;
+            off += 2 + (size_t) len;
+        }
+        CHECK_EQ(off, size);
+        free(buf);
+    }
+    opus_decoder_destroy(dec);
+    return card;
+}
+
+int main(void)
+{
+    CHECK_EQ(reclo_recorder_init(), 0);
+    OpusEncoder *enc = opus_corpus_encoder(CODEC_OPUS_COMPLEXITY);
+    CHECK(enc != NULL);
+
+    static union {
+        struct codec_packet pkt;
+        uint8_t             raw[sizeof(struct codec_packet) + CODEC_OUTPUT_MAX_BYTES];
+    } out;
+    static int16_t pcm[FRAME];
+    uint64_t single_bytes = 0;      /* the same frames as 20 ms records */
+    int64_t  encode_us = 0, store_us = 0;
+
+    start();
+    for (uint32_t f = 0; f < FRAMES; f++) {
+        if (f > 0 && f % CHUNK_FRAMES == 0) {
+            writer_run();
+            atomic_set(&_rotate_pending, 1);   /* the 30 s timer */
+        }
+        opus_corpus_next(pcm);
+        int64_t t0 = k_uptime_ticks();
+        opus_int32 len = opus_encode(enc, pcm, FRAME, out.pkt.data, CODEC_OUTPUT_MAX_BYTES);
+        int64_t t1 = k_uptime_ticks();
+        CHECK(len > 0);
+        out.pkt.len    = (uint16_t) len;
+        out.pkt.energy = energy(pcm);
+        out.pkt.voiced = true;
+        single_bytes += 2 + (uint64_t) len;
+
+        /* As a writer thread keeping up with the card would */
+        if (slot_capacity() < RECLO_FILE_HDR_SIZE + 2 * (2 + N * (2 + CODEC_OUTPUT_MAX_BYTES))) {
+            writer_run();
+        }
+        int64_t t2 = k_uptime_ticks();
+        on_codec_output(&out.pkt);
+        store_us += k_uptime_ticks() - t2;
+        encode_us += t1 - t0;
+    }
+    reclo_recorder_stop();
+    writer_run();
+    opus_encoder_destroy(enc);
+
+    struct card card = read_card();
+    CHECK_EQ(card.chunks, FRAMES / CHUNK_FRAMES);
+    CHECK_EQ(card.frames, FRAMES);
+    CHECK_EQ(reclo_recorder_dropped_frames(), 0);
+
+    /* The TOC never changes at fixed settings, and chunks hold whole
+     * packets, so every packet is full */
+    CHECK_EQ(card.records, FRAMES / N);
+    if (N == 1) {
+        CHECK_EQ(card.data_bytes, single_bytes);
+    } else {
+        /* Each merged frame drops its length prefix and TOC for a length
+         * byte in the packet; three or more frames also take a count byte */
+        uint64_t saved = (uint64_t) (FRAMES - FRAMES / N) * 2 - (N > 2 ? FRAMES / N : 0);
+        CHECK(card.data_bytes <= single_bytes - saved);
+    }
+
+    printf("%d ms records: %.2f MB/hour on the card (%u packets, %.0f B each); the same frames as 20 ms "
+           "records: %.2f MB/hour, %.1f%% more\n",
+           20 * N, card.file_bytes * 3600.0 / SECONDS / 1e6, card.records, (double) card.data_bytes / card.records,
+           (single_bytes + card.file_bytes - card.data_bytes) * 3600.0 / SECONDS / 1e6,
+           100.0 * (single_bytes - card.data_bytes) / card.data_bytes);
+    printf("host CPU per 20 ms frame: encode %.1f us, recorder %.1f us\n", (double) encode_us / FRAMES,
+           (double) store_us / FRAMES);
+
+    char name[32];
+    snprintf(name, sizeof(name), "test_recorder_packets_%d", N);
+    return fake_test_result(name);
+}
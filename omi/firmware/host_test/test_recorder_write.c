@@ -0,0 +1,558 @@
+/*
+ * Recorder writer recovery: a failed slot write or chunk open must never
+ * corrupt a chunk file, the writer must pick the stream up again with the
+ * next slot, and every frame that did not make it to the card must be
+ * counted in reclo_recorder_dropped_frames().
+ *
+ * Built with the module itself (#include below) so the test can feed frames
+ * through on_codec_output() and run the writer's requests one at a time.
+ * Each frame carries its sequence number; after every scenario the chunk
+ * files are parsed and the frames found plus the frames counted as dropped
+ * must be exactly the frames fed, in order. Every write to a chunk file
+ * must cover whole 512-byte sectors at a sector-aligned offset, and each
+ * chunk file is preallocated once, when it is opened.
+ *
+ * Last, the writer runs on a thread of its own against a slow card, and the
+ * time each on_codec_output() call takes is measured.
+ */
+
+#include "../omi/src/reclo_recorder.c"
+
+#include "fake_zephyr.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define FRAME_BYTES  60   /* a 62-byte record: records straddle slot ends */
+#define MAX_CHUNKS   16
+
+/* ── Stand-ins for the codec, RTC and transfer modules ───────────────────────*/
+
+int codec_subscribe(const char *name)
+{
+    return 0;
+}
+
+uint32_t codec_subscriber_dropped(int sub)
+{
+    return 0;
+}
+
+struct codec_packet *codec_packet_get(int sub, k_timeout_t timeout)
+{
+    return NULL;
+}
+
+void codec_packet_release(struct codec_packet *pkt)
+{
+}
+
+void codec_get_settings(struct codec_settings *settings)
+{
+    *settings = (struct codec_settings){ .complexity = 5, .bitrate = 32000 };
+}
+
+static uint32_t utc_now;   /* 0: never synced, chunks are named by uptime */
+
+uint32_t get_utc_time(void)
+{
+    return utc_now;
+}
+
+int reclo_transfer_count_chunks(void)
+{
+    return reclo_index_count(RECLO_CHUNK_UNSYNCED);
+}
+
+/* ── Driving the recorder ────────────────────────────────────────────────────*/
+
+static uint32_t fed;
+static bool     writer_paused;   /* let the slots fill up, as a stalled card would */
+
+static bool writer_step(void);
+static void writer_run(void);
+
+/* Feed @p frames frames, running the writer whenever the slots fill up, as
+ * a writer thread keeping up with the card would */
+/* The next frame, carrying its sequence number */
+static const struct codec_packet *next_frame(void)
+{
+    static union {
+        struct codec_packet pkt;
+        uint8_t             raw[sizeof(struct codec_packet) + FRAME_BYTES];
+    } buf;
+
+    buf.pkt.len    = FRAME_BYTES;
+    buf.pkt.energy = 1U << 20;
+    buf.pkt.voiced = true;
+    memcpy(buf.pkt.data, &fed, sizeof(fed));
+    memset(buf.pkt.data + sizeof(fed), (int) (fed & 0xFF), FRAME_BYTES - sizeof(fed));
+    return &buf.pkt;
+}
+
+static void feed(uint32_t frames)
+{
+    for (uint32_t i = 0; i < frames; i++, fed++) {
+        if (!writer_paused && slot_capacity() < RECLO_FILE_HDR_SIZE + 2 * (2 + FRAME_BYTES)) {
+            writer_run();
+        }
+        on_codec_output(next_frame());
+    }
+}
+
+/* Run the writer's next request; false when there is none */
+static bool writer_step(void)
+{
+    struct write_req req;
+    if (k_msgq_get(&_write_q, &req, K_NO_WAIT) != 0) {
+        return false;
+    }
+    handle_write_req(&req);
+    k_sem_take(&_writer_ack, K_NO_WAIT);
+    return true;
+}
+
+static void writer_run(void)
+{
+    while (writer_step()) {
+    }
+}
+
+/* reclo_recorder_start() waits for the writer, which never runs by itself
+ * here; open the first chunk the same way, then let frames in */
+static void start(void)
+{
+    struct write_req req = { .op = WRITE_OP_OPEN };
+    handle_write_req(&req);
+    k_sem_take(&_writer_ack, K_NO_WAIT);
+    CHECK(_file_open);
+    _level_count[_level_track] = 0;
+    _reserve_header = true;
+    _recording      = true;
+}
+
+static void stop(void)
+{
+    reclo_recorder_stop();
+    writer_run();
+    CHECK(!_file_open);
+}
+
+static void rotate(void)
+{
+    atomic_set(&_rotate_pending, 1);
+}
+
+/* ── Checking the card ───────────────────────────────────────────────────────*/
+
+static uint32_t chunk_writes;
+static uint32_t unaligned_writes;
+
+static void on_fs_write(const char *path, off_t offset, size_t len)
+{
+    size_t n = strlen(path);
+    if (n < 4 || (strcmp(path + n - 4, ".tmp") != 0 && strcmp(path + n - 4, ".upt") != 0 &&
+                  strcmp(path + n - 4, ".bin") != 0)) {
+        return;   /* the index journal */
+    }
+    chunk_writes++;
+    if (offset % RECLO_SECTOR_SIZE != 0 || len % RECLO_SECTOR_SIZE != 0) {
+        printf("unaligned write to %s: %zu bytes at %lld\n", path, len, (long long) offset);
+        unaligned_writes++;
+    }
+}
+
+static size_t file_size(const char *path)
+{
+    struct fs_dirent ent;
+    CHECK_EQ(fs_stat(path, &ent), 0);
+    return ent.size;
+}
+
+static uint8_t *read_file(const char *path, size_t *size)
+{
+    struct fs_file_t f;
+    fs_file_t_init(&f);
+    if (fs_open(&f, path, FS_O_READ) != 0) {
+        return NULL;
+    }
+    size_t   cap = 1 << 16, len = 0;
+    uint8_t *buf = malloc(cap);
+    ssize_t  n;
+    while ((n = fs_read(&f, buf + len, cap - len)) > 0) {
+        len += (size_t) n;
+        if (len == cap) {
+            buf = realloc(buf, cap *= 2);
+        }
+    }
+    fs_close(&f);
+    *size = len;
+    return buf;
+}
+
+static int cmp_str(const void *a, const void *b)
+{
+    return strcmp(a, b);
+}
+
+/* Parse every chunk on the card, oldest first. Returns the frames found;
+ * each chunk must be well formed and its frames must follow the previous
+ * chunk's. */
+static uint32_t check_chunks(int *chunks_out)
+{
+    char names[MAX_CHUNKS][MAX_FILE_NAME + 1];
+    int  chunks = 0;
+
+    struct fs_dir_t dir;
+    struct fs_dirent ent;
+    fs_dir_t_init(&dir);
+    CHECK_EQ(fs_opendir(&dir, RECLO_STORAGE_DIR), 0);
+    while (fs_readdir(&dir, &ent) == 0 && ent.name[0] != '\0') {
+        size_t len = strlen(ent.name);
+        if (len > 4 && (strcmp(ent.name + len - 4, ".upt") == 0 || strcmp(ent.name + len - 4, ".bin") == 0) &&
+            chunks < MAX_CHUNKS) {
+            memcpy(names[chunks++], ent.name, len + 1);
+        }
+        /* Nothing may be left half-written */
+        CHECK(len <= 4 || strcmp(ent.name + len - 4, ".tmp") != 0);
+    }
+    fs_closedir(&dir);
+    qsort(names, (size_t) chunks, sizeof(names[0]), cmp_str);
+
+    uint32_t found = 0;
+    int64_t  last  = -1;
+    for (int c = 0; c < chunks; c++) {
+        char path[sizeof(RECLO_STORAGE_DIR) + sizeof(names[0])];
+        snprintf(path, sizeof(path), RECLO_STORAGE_DIR "/%.*s", MAX_FILE_NAME, names[c]);
+        size_t   size;
+        uint8_t *buf = read_file(path, &size);
+        CHECK(buf != NULL);
+        if (!buf) {
+            continue;
+        }
+
+        struct reclo_chunk_hdr hdr;
+        CHECK_EQ(reclo_chunk_hdr_parse(buf, size, &hdr), 0);
+        /* Larger for a chunk reopened mid-stream, to keep its slots aligned */
+        CHECK(hdr.hdr_size >= RECLO_FILE_HDR_SIZE);
+        CHECK_EQ(hdr.data_size, size - hdr.hdr_size);
+        CHECK_EQ(hdr.crc32, crc32_ieee(buf + hdr.hdr_size, hdr.data_size));
+
+        /* A chunk closed early may end part way through a record */
+        size_t off = hdr.hdr_size;
+        while (off + 2 <= size) {
+            uint16_t len = (uint16_t) (buf[off] | (buf[off + 1] << 8));
+            if (off + 2 + len > size) {
+                break;
+            }
+            CHECK_EQ(len, FRAME_BYTES);
+            uint32_t seq;
+            memcpy(&seq, &buf[off + 2], sizeof(seq));
+            CHECK((int64_t) seq > last);
+            CHECK_EQ(buf[off + 2 + FRAME_BYTES - 1], seq & 0xFF);
+            last = seq;
+            found++;
+            off += 2 + (size_t) len;
+        }
+        free(buf);
+    }
+    *chunks_out = chunks;
+    return found;
+}
+
+static void check_accounted(const char *scenario, int expect_chunks)
+{
+    int      chunks;
+    uint32_t found   = check_chunks(&chunks);
+    uint32_t dropped = reclo_recorder_dropped_frames();
+    printf("%s: %u frames fed, %u on the card in %d chunk(s), %u dropped; %u chunk writes\n", scenario, fed,
+           found, chunks, dropped, chunk_writes);
+    CHECK_EQ(found + dropped, fed);
+    CHECK_EQ(chunks, expect_chunks);
+    CHECK_EQ(unaligned_writes, 0);
+}
+
+static void reset(void)
+{
+    fake_fs_reset();
+    CHECK_EQ(reclo_index_init(), 0);
+    atomic_clear(&_dropped_frames);
+    _level_gap = false;
+    fed = 0;
+    chunk_writes = 0;
+    unaligned_writes = 0;
+}
+
+/* ── Scenarios ───────────────────────────────────────────────────────────────*/
+
+static void test_clean(void)
+{
+    reset();
+    start();
+    feed(200);
+    writer_run();
+    rotate();
+    feed(200);
+    stop();
+    check_accounted("clean", 2);
+    CHECK_EQ(reclo_recorder_dropped_frames(), 0);
+}
+
+/* The first write of a chunk fails: the next slot must not be taken for
+ * the chunk's first and get a header written over its audio */
+static void test_first_write_fails(void)
+{
+    reset();
+    start();
+    fake_fs_fail_next(FAKE_FS_WRITE, 1);
+    feed(300);
+    stop();
+    check_accounted("first write fails", 1);
+    CHECK(reclo_recorder_dropped_frames() > 0);
+}
+
+/* A write fails mid-chunk: the chunk is published up to it and a new one
+ * carries on from the next slot */
+static void test_mid_chunk_write_fails(void)
+{
+    reset();
+    start();
+    feed(200);
+    writer_run();
+    fake_fs_fail_next(FAKE_FS_WRITE, 1);
+    feed(400);
+    stop();
+    check_accounted("mid-chunk write fails", 2);
+
+    /* The chunk picked up mid-stream has no level track to line up */
+    char path[64];
+    reclo_index_chunk_path(path, sizeof(path), _chunk_start_ts, RECLO_CHUNK_UNSYNCED);
+    size_t   size;
+    uint8_t *buf = read_file(path, &size);
+    struct reclo_chunk_hdr hdr;
+    CHECK(buf && reclo_chunk_hdr_parse(buf, size, &hdr) == 0 && hdr.level_count == 0);
+    free(buf);
+}
+
+/* The next chunk's open fails at rotation: it is retried with the chunk's
+ * first slot, and nothing is lost */
+static void test_rotate_open_retried(void)
+{
+    reset();
+    start();
+    feed(200);
+    writer_run();
+    fake_fs_fail_next(FAKE_FS_OPEN, 1);
+    rotate();
+    feed(1);
+    writer_run();
+    CHECK(!_file_open);
+    feed(200);
+    stop();
+    check_accounted("rotation open fails once", 2);
+    CHECK_EQ(reclo_recorder_dropped_frames(), 0);
+}
+
+/* The open keeps failing for a while: slots in the meantime are counted as
+ * dropped, and recording resumes once the card is back */
+static void test_rotate_open_keeps_failing(void)
+{
+    reset();
+    start();
+    feed(200);
+    writer_run();
+    fake_fs_fail_next(FAKE_FS_OPEN, 3);
+    rotate();
+    feed(300);
+    stop();
+    check_accounted("rotation open fails 3 times", 2);
+    CHECK(reclo_recorder_dropped_frames() > 0);
+}
+
+static uint16_t chunk_level_count(uint32_t ts)
+{
+    char path[64];
+    reclo_index_chunk_path(path, sizeof(path), ts, RECLO_CHUNK_UNSYNCED);
+    size_t   size;
+    uint8_t *buf = read_file(path, &size);
+    struct reclo_chunk_hdr hdr = { 0 };
+    CHECK(buf && reclo_chunk_hdr_parse(buf, size, &hdr) == 0);
+    free(buf);
+    return hdr.level_count;
+}
+
+/* The track covers the frames stored; a chunk that dropped frames for want
+ * of a slot has none, since it would no longer line up with the audio */
+static void test_level_track(void)
+{
+    reset();
+    start();
+    uint32_t first_ts = _chunk_start_ts;
+    feed(200);
+    writer_run();
+    rotate();
+    feed(1);
+    writer_run();
+    uint32_t second_ts = _chunk_start_ts;
+    writer_paused = true;
+    feed(300);
+    writer_paused = false;
+    stop();
+    check_accounted("level track", 2);
+    CHECK(reclo_recorder_dropped_frames() > 0);
+
+    CHECK_EQ(chunk_level_count(first_ts), 200 / (RECLO_LEVEL_WINDOW_MS / 20));
+    CHECK_EQ(chunk_level_count(second_ts), 0);
+}
+
+/* A whole 30 s chunk: the file is extended to RECLO_CHUNK_PREALLOC_SIZE when
+ * it is opened and written within that, then trimmed to its data */
+static void test_preallocated(void)
+{
+    reset();
+    start();
+    char path[sizeof(_active_path)];
+    memcpy(path, _active_path, sizeof(path));
+    CHECK_EQ(fake_fs_calls(FAKE_FS_EXTEND), 1);
+    CHECK_EQ(file_size(path), RECLO_CHUNK_PREALLOC_SIZE);
+
+    feed(RECLO_CHUNK_DURATION_S * 50);
+    writer_run();
+    CHECK_EQ(file_size(path), RECLO_CHUNK_PREALLOC_SIZE);
+    uint32_t written = _file_bytes;
+
+    stop();
+    check_accounted("one 30 s chunk", 1);
+    CHECK_EQ(fake_fs_calls(FAKE_FS_EXTEND), 1);
+    reclo_index_chunk_path(path, sizeof(path), _chunk_start_ts, RECLO_CHUNK_UNSYNCED);
+    CHECK_EQ(file_size(path), RECLO_FILE_HDR_SIZE + fed * (2 + FRAME_BYTES));
+    printf("one 30 s chunk: preallocated %u bytes, wrote %u before the last slot, %zu kept\n",
+           RECLO_CHUNK_PREALLOC_SIZE, written, file_size(path));
+}
+
+/* The clock is set while a chunk is open, then after one was published:
+ * each header is patched by rewriting its first sector */
+static void test_retimestamp_aligned(void)
+{
+    reset();
+    start();
+    feed(200);
+    writer_run();
+    utc_now = 1700000000U;
+    reclo_recorder_retimestamp();
+    writer_run();
+    CHECK(!_chunk_unsynced);
+    feed(100);
+    stop();
+    utc_now = 0;
+    check_accounted("retimestamped while open", 1);
+    CHECK_EQ(reclo_index_count(RECLO_CHUNK_READY), 1);
+
+    reset();
+    start();
+    feed(200);
+    stop();
+    utc_now = 1700000000U;
+    reclo_recorder_retimestamp();
+    utc_now = 0;
+    check_accounted("retimestamped once published", 1);
+    CHECK_EQ(reclo_index_count(RECLO_CHUNK_READY), 1);
+    CHECK_EQ(reclo_index_count(RECLO_CHUNK_UNSYNCED), 0);
+}
+
+/* ── Slow card ───────────────────────────────────────────────────────────────
+ * Frames arrive every PACE_MS, ten times as fast as from the codec, so a
+ * slot fills in about 130 ms. The writer thread first keeps up with writes
+ * of SLOW_WRITE_US, then falls behind with writes of STALL_WRITE_US.
+ */
+#define PACE_MS         2
+#define SLOW_WRITE_US   100000
+#define STALL_WRITE_US  400000
+
+struct callback_latency {
+    uint32_t calls_with_room;
+    uint32_t calls_without;
+    uint32_t max_with_room_us;
+    uint32_t max_without_us;
+    uint32_t dropped_with_room;   /* must stay 0 */
+};
+
+static void feed_paced(uint32_t frames, struct callback_latency *lat)
+{
+    for (uint32_t i = 0; i < frames; i++, fed++) {
+        const struct codec_packet *pkt = next_frame();
+
+        /* Only the writer changes this meanwhile, and only upwards */
+        bool     room    = slot_capacity() >= 2 + FRAME_BYTES;
+        uint32_t dropped = reclo_recorder_dropped_frames();
+
+        int64_t t0 = k_uptime_ticks();
+        on_codec_output(pkt);
+        uint32_t us = (uint32_t) (k_uptime_ticks() - t0);
+
+        if (room) {
+            lat->calls_with_room++;
+            lat->max_with_room_us = MAX(lat->max_with_room_us, us);
+            lat->dropped_with_room += reclo_recorder_dropped_frames() - dropped;
+        } else {
+            lat->calls_without++;
+            lat->max_without_us = MAX(lat->max_without_us, us);
+        }
+        k_msleep(PACE_MS);
+    }
+}
+
+/* on_codec_output() never waits for the card: with a free slot the frame is
+ * stored and the call returns in far less than one write, and with none it
+ * is dropped just as fast */
+static void test_slow_card(void)
+{
+    reset();
+    start();
+    fake_threads_enable();
+    k_thread_create(&_flush_thread, _flush_stack, FLUSH_THREAD_STACK, flush_thread_fn, NULL, NULL, NULL,
+                    FLUSH_THREAD_PRIO, 0, K_NO_WAIT);
+
+    struct callback_latency keeping_up = { 0 }, behind = { 0 };
+    fake_fs_set_latency(FAKE_FS_WRITE, SLOW_WRITE_US);
+    feed_paced(400, &keeping_up);
+    uint32_t dropped_keeping_up = reclo_recorder_dropped_frames();
+
+    fake_fs_set_latency(FAKE_FS_WRITE, STALL_WRITE_US);
+    feed_paced(400, &behind);
+    fake_fs_set_latency(FAKE_FS_WRITE, 0);
+    stop();
+
+    printf("slow card, %u ms writes: %u calls, longest %u us, %u dropped\n", SLOW_WRITE_US / 1000,
+           keeping_up.calls_with_room + keeping_up.calls_without, keeping_up.max_with_room_us, dropped_keeping_up);
+    printf("stalled card, %u ms writes: %u calls with a free slot, longest %u us; %u without, longest %u us\n",
+           STALL_WRITE_US / 1000, behind.calls_with_room, behind.max_with_room_us, behind.calls_without,
+           behind.max_without_us);
+    check_accounted("slow card", 1);
+
+    CHECK_EQ(keeping_up.calls_without, 0);
+    CHECK_EQ(dropped_keeping_up, 0);
+    CHECK(behind.calls_without > 0);
+    CHECK_EQ(keeping_up.dropped_with_room + behind.dropped_with_room, 0);
+    CHECK(keeping_up.max_with_room_us < SLOW_WRITE_US / 20);
+    CHECK(behind.max_with_room_us < SLOW_WRITE_US / 20);
+    CHECK(behind.max_without_us < SLOW_WRITE_US / 20);
+}
+
+int main(void)
+{
+    CHECK_EQ(reclo_recorder_init(), 0);
+    fake_fs_write_hook = on_fs_write;
+
+    test_clean();
+    test_first_write_fails();
+    test_mid_chunk_write_fails();
+    test_rotate_open_retried();
+    test_rotate_open_keeps_failing();
+    test_level_track();
+    test_preallocated();
+    test_retimestamp_aligned();
+    test_slow_card();   /* last: starts the writer thread */
+
+    return fake_test_result("test_recorder_write");
+}
@@ -0,0 +1,175 @@
+/*
+ * Control-characteristic latency with deferred deletion, cumulative ACKs of
+ * chunks completed by NACK retransmission, and REQUEST_UPLOAD's batch limit.
+ *
+ * Built with the module itself (#include below) to reach its static
+ * handlers. Unlinks are given a fixed cost standing in for a FAT delete on
+ * the SD card, and an observer on the fake card fails the test if any
+ * unlink happens while ctrl_write(), the BT callback, is running.
+ */
+
+#include "../omi/src/reclo_transfer.c"
+
+#include "fake_zephyr.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define CHUNKS           16
+#define UNLINK_COST_US   4000
+#define CHUNK_BYTES      1000
+#define FIRST_TS         1700000000U
+
+static struct bt_conn fake_conn;
+
+/* Unlinks seen, and those made from inside ctrl_write() */
+static bool     in_ctrl_write;
+static uint32_t unlinks_seen, unlinks_in_callback;
+
+static void on_unlink(const char *path)
+{
+    unlinks_seen++;
+    if (in_ctrl_write) {
+        printf("unlink of %s inside ctrl_write()\n", path);
+        unlinks_in_callback++;
+    }
+}
+
+static ssize_t ctrl_write_observed(const void *buf, uint16_t len)
+{
+    in_ctrl_write = true;
+    ssize_t ret = ctrl_write(&fake_conn, NULL, buf, len, 0, 0);
+    in_ctrl_write = false;
+    return ret;
+}
+
+static void store_chunks(bool mark_sent)
+{
+    uint8_t data[CHUNK_BYTES];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (uint8_t) (i * 7);
+    }
+    for (uint32_t i = 0; i < CHUNKS; i++) {
+        CHECK_EQ(reclo_transfer_store_chunk(FIRST_TS + i * 30, data, sizeof(data)), 0);
+        if (mark_sent) {
+            reclo_index_mark_sent(FIRST_TS + i * 30);
+        }
+    }
+}
+
+static ssize_t write_ack_upto(uint32_t upto)
+{
+    uint8_t cmd[5] = { RECLO_CMD_ACK_UPTO };
+    memcpy(&cmd[1], &upto, sizeof(upto));
+    return ctrl_write_observed(cmd, sizeof(cmd));
+}
+
+static int64_t elapsed_us(int64_t since)
+{
+    return k_uptime_ticks() - since;
+}
+
+/* ACK_UPTO only queues the range; the unlinks happen on the workqueue */
+static void test_ack_latency(void)
+{
+    store_chunks(true);
+    fake_fs_set_latency(FAKE_FS_UNLINK, UNLINK_COST_US);
+
+    uint32_t unlinks = unlinks_seen;
+    int64_t t0 = k_uptime_ticks();
+    CHECK_EQ(write_ack_upto(FIRST_TS + CHUNKS * 30), 5);
+    int64_t callback_us = elapsed_us(t0);
+    uint32_t callback_unlinks = unlinks_seen - unlinks;
+    CHECK_EQ(callback_unlinks, 0);
+    CHECK_EQ(reclo_transfer_count_chunks(), CHUNKS);
+
+    t0 = k_uptime_ticks();
+    fake_work_run_all();
+    int64_t work_us = elapsed_us(t0);
+    CHECK_EQ(reclo_transfer_count_chunks(), 0);
+    CHECK_EQ(unlinks_seen, unlinks + CHUNKS);
+    CHECK(callback_us < UNLINK_COST_US);
+
+    printf("ACK_UPTO of %d chunks, %d us per unlink: callback %lld us and %u unlinks, workqueue %lld us and "
+           "%u unlinks\n",
+           CHUNKS, UNLINK_COST_US, (long long) callback_us, callback_unlinks, (long long) work_us,
+           unlinks_seen - unlinks - callback_unlinks);
+
+    fake_fs_set_latency(FAKE_FS_UNLINK, 0);
+}
+
+/* A cumulative ACK leaves unsent chunks alone */
+static void test_ack_skips_unsent(void)
+{
+    store_chunks(false);
+    CHECK_EQ(write_ack_upto(FIRST_TS + CHUNKS * 30), 5);
+    fake_work_run_all();
+    CHECK_EQ(reclo_transfer_count_chunks(), CHUNKS);
+}
+
+/* A chunk whose DATA stream was cut short is complete once its NACK is
+ * served, and must then be deletable by ACK_UPTO (chunks from the previous
+ * test are still there, unsent) */
+static void test_nack_completes_chunk(void)
+{
+    _conn = &fake_conn;
+    _notify_enabled = true;
+    tx_credits_reset();
+    _batch.proto = RECLO_PROTO_V1;
+    _batch.payload = RECLO_PAYLOAD_SIZE;
+    _batch.total = CHUNKS;
+
+    struct upload_cmd nack = {
+        .type = UPLOAD_CMD_NACK,
+        .ts = FIRST_TS,
+        .chunk_idx = 0,
+        .first_seq = 1,
+        .nbytes = 1,
+        .bitmap = { 0x0F },   /* seqs 1-4: the whole 1000 B chunk */
+    };
+    CHECK_EQ(resend_chunk_seqs(&nack), 0);
+
+    CHECK_EQ(write_ack_upto(FIRST_TS + CHUNKS * 30), 5);
+    fake_work_run_all();
+    CHECK_EQ(reclo_transfer_count_chunks(), CHUNKS - 1);
+
+    char path[64];
+    reclo_index_chunk_path(path, sizeof(path), FIRST_TS, RECLO_CHUNK_READY);
+    CHECK(!fake_fs_exists(path));
+}
+
+/* REQUEST_UPLOAD's optional batch limit; older apps send none */
+static void test_request_batch_limit(void)
+{
+    const uint8_t bare[] = { RECLO_CMD_REQUEST_UPLOAD, RECLO_PROTO_V2 };
+    const uint8_t limited[] = { RECLO_CMD_REQUEST_UPLOAD, RECLO_PROTO_V2, 0x10, 0x01 };
+
+    CHECK_EQ(ctrl_write_observed(limited, sizeof(limited)), sizeof(limited));
+    CHECK_EQ(_batch_limit, 0x0110);
+    k_msgq_purge(&_cmd_q);
+    _upload_active = false;
+
+    CHECK_EQ(ctrl_write_observed(bare, sizeof(bare)), sizeof(bare));
+    CHECK_EQ(_batch_limit, 0);
+    CHECK_EQ(_proto_version, RECLO_PROTO_V2);
+    k_msgq_purge(&_cmd_q);
+    _upload_active = false;
+}
+
+int main(void)
+{
+    fake_fs_reset();
+    fake_fs_unlink_hook = on_unlink;
+    CHECK_EQ(reclo_transfer_init(), 0);
+
+    test_ack_latency();
+    test_ack_skips_unsent();
+    test_nack_completes_chunk();
+    test_request_batch_limit();
+
+    /* No command above deleted a chunk from inside ctrl_write() */
+    CHECK(unlinks_seen > 0);
+    CHECK_EQ(unlinks_in_callback, 0);
+
+    return fake_test_result("test_transfer_ack");
+}
@@ -0,0 +1,164 @@
+/*
+ * TX credits: the stack never holds more than TX_WINDOW of the module's
+ * notifications, and a notification it refuses is sent again, not lost.
+ *
+ * Runs the module's upload and reader threads on the threaded fake, with the
+ * modelled controller holding CONFIG_BT_CONN_TX_MAX notifications. Going
+ * past TX_WINDOW shows up as max_in_flight, and past the controller as
+ * refusals.
+ */
+
+#include "../omi/src/reclo_transfer.c"
+
+#include "fake_zephyr.h"
+#include "phone.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define CHUNKS        4
+#define CHUNK_BYTES   8000
+#define FIRST_TS      1700000000U
+#define AIR_US        300
+
+static struct bt_conn fake_conn;
+static uint8_t chunk_data[CHUNKS][CHUNK_BYTES];
+
+static void store_chunks(void)
+{
+    for (uint32_t c = 0; c < CHUNKS; c++) {
+        for (size_t i = 0; i < CHUNK_BYTES; i++) {
+            chunk_data[c][i] = (uint8_t) (i * 13 + i / 241 + c * 37);
+        }
+        CHECK_EQ(reclo_transfer_store_chunk(FIRST_TS + c * 30, chunk_data[c], CHUNK_BYTES), 0);
+    }
+}
+
+static void write_ctrl(const uint8_t *cmd, uint16_t len)
+{
+    CHECK_EQ(ctrl_write(&fake_conn, NULL, cmd, len, 0, 0), len);
+}
+
+static void request_upload(void)
+{
+    /* The upload thread clears this just after UPLOAD_DONE */
+    for (int i = 0; i < 1000 && _upload_active; i++) {
+        k_msleep(1);
+    }
+    const uint8_t cmd[] = { RECLO_CMD_REQUEST_UPLOAD, RECLO_PROTO_V2 };
+    write_ctrl(cmd, sizeof(cmd));
+}
+
+/* Every chunk arrived whole, and no packet more than it takes */
+static void check_chunks(void)
+{
+    for (uint32_t c = 0; c < CHUNKS; c++) {
+        const struct phone_chunk *chunk = phone_chunk(FIRST_TS + c * 30);
+        CHECK(chunk != NULL);
+        if (chunk) {
+            CHECK(phone_chunk_complete(chunk));
+            CHECK(memcmp(chunk->data, chunk_data[c], CHUNK_BYTES) == 0);
+            CHECK_EQ(chunk->packets, chunk->total_seqs);
+        }
+    }
+    CHECK_EQ(phone.strays, 0);
+}
+
+static uint32_t in_flight(void)
+{
+    return fake_bt_link_stats().in_flight;
+}
+
+/* ABORT and a new REQUEST_UPLOAD while a full window is still in flight: the
+ * new batch must wait for those completions instead of starting with a
+ * fresh window on top of them */
+static void test_abort_keeps_window(void)
+{
+    phone_reset();
+    fake_bt_link_stats_reset();
+    fake_bt_hold_completions(true);
+
+    request_upload();
+    for (int i = 0; i < 1000 && in_flight() < TX_WINDOW; i++) {
+        k_msleep(1);
+    }
+    CHECK_EQ(in_flight(), TX_WINDOW);
+
+    const uint8_t abort_cmd[] = { RECLO_CMD_ABORT };
+    const uint8_t request[] = { RECLO_CMD_REQUEST_UPLOAD, RECLO_PROTO_V2 };
+    write_ctrl(abort_cmd, sizeof(abort_cmd));
+    write_ctrl(request, sizeof(request));
+
+    /* Let completions through one at a time until the new batch has been
+     * sending for a few windows */
+    uint32_t released = 0;
+    uint32_t headers_before = phone.headers;
+    while (released < 1000) {
+        released += fake_bt_complete(1);
+        k_msleep(1);
+        if (phone.headers > headers_before && phone.packets > TX_WINDOW * 4) {
+            break;
+        }
+    }
+    struct fake_bt_link_stats link = fake_bt_link_stats();
+    printf("ABORT + REQUEST_UPLOAD with %d in flight: %u released one by one, "
+           "at most %u in flight, %u refused\n",
+           TX_WINDOW, released, link.max_in_flight, link.refused);
+    CHECK(link.max_in_flight <= TX_WINDOW);
+    CHECK_EQ(link.refused, 0);
+
+    fake_bt_set_air_time(AIR_US);
+    fake_bt_hold_completions(false);
+    CHECK(phone_wait_done(10000));
+    check_chunks();
+    CHECK(fake_bt_link_stats().max_in_flight <= TX_WINDOW);
+}
+
+/* One notification in three refused, as when other services hold the
+ * stack's buffers */
+static uint32_t refuse_state = 12345;
+static uint32_t refused;
+
+static int refuse_some(void)
+{
+    refuse_state = refuse_state * 1103515245U + 12345U;
+    if ((refuse_state >> 16) % 3 == 0) {
+        refused++;
+        return -ENOMEM;
+    }
+    return 0;
+}
+
+static void test_enomem_loses_nothing(void)
+{
+    phone_reset();
+    phone.refuse = refuse_some;
+    fake_bt_link_stats_reset();
+
+    request_upload();
+    CHECK(phone_wait_done(10000));
+    phone.refuse = NULL;
+
+    struct fake_bt_link_stats link = fake_bt_link_stats();
+    printf("-ENOMEM on %u of %u notifications: %u packets received, at most %u in flight\n", refused,
+           refused + link.sent, phone.packets, link.max_in_flight);
+    CHECK(refused > 0);
+    CHECK(link.max_in_flight <= TX_WINDOW);
+    check_chunks();
+}
+
+int main(void)
+{
+    fake_threads_enable();
+    fake_fs_reset();
+    CHECK_EQ(reclo_transfer_init(), 0);
+    store_chunks();
+
+    _on_connected(&fake_conn, 0);
+    data_ccc_changed(NULL, BT_GATT_CCC_NOTIFY);
+
+    test_abort_keeps_window();
+    test_enomem_loses_nothing();
+
+    return fake_test_result("test_transfer_credits");
+}
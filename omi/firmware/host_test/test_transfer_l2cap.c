@@ -0,0 +1,232 @@
+/*
+ * L2CAP bulk channel: a v2 batch goes over the CoC when the phone has it
+ * open and over notifications otherwise, and a throughput model of what
+ * each costs on air.
+ *
+ * Built with CONFIG_OMI_RECLO_L2CAP; the channel here is a stand-in for
+ * reclo_l2cap.c that hands each SDU to phone.c. The model counts the LL
+ * data PDUs every packet the module sends takes, and their air time on the
+ * 2M PHY with an encrypted link and 251-byte data length (omi.conf), as if
+ * the controller filled every connection event:
+ *
+ *   notification of n bytes:  ATT (3) + L2CAP (4) + n, in 251-byte PDUs
+ *   SDU of n bytes:           2-byte SDU length + n, in MPS-byte K-frames,
+ *                             each with its own L2CAP header (4)
+ *
+ * Each PDU costs its bytes on air, the central's empty PDU back and two
+ * inter-frame spaces. On those terms the channel is barely cheaper than
+ * notifications at MTU 498, and only with SDUs fitted to the MPS; what it
+ * saves is packets, each of which costs both hosts a buffer, a credit and
+ * a callback.
+ */
+
+#include "../omi/src/reclo_transfer.c"
+
+#include "fake_zephyr.h"
+#include "phone.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define CHUNKS        2
+#define CHUNK_BYTES   120000   /* 30 s at 32 kbps */
+#define FIRST_TS      1700000000U
+
+/* ── Link model ─────────────────────────────────────────────────────────────*/
+
+#define LL_DATA_MAX     251   /* CONFIG_BT_CTLR_DATA_LENGTH_MAX */
+#define LL_PDU_OVERHEAD 15    /* preamble 2, access address 4, header 2, MIC 4, CRC 3 */
+#define LL_US_PER_BYTE  4     /* 2M PHY */
+#define LL_T_IFS_US     150
+#define ATT_NOTIFY_HDR  3
+#define L2CAP_HDR       4
+#define COC_MPS         247   /* one K-frame per PDU at LL_DATA_MAX */
+
+struct link_cost {
+    uint32_t packets;
+    uint32_t pdus;
+    uint64_t air_us;
+};
+
+static void add_pdus(struct link_cost *cost, uint32_t bytes, uint32_t per_pdu, uint32_t pdu_hdr)
+{
+    while (bytes > 0) {
+        uint32_t n = MIN(bytes, per_pdu);
+        cost->pdus++;
+        cost->air_us += (LL_PDU_OVERHEAD + pdu_hdr + n) * LL_US_PER_BYTE + 2 * LL_T_IFS_US +
+                        (LL_PDU_OVERHEAD - 4) * LL_US_PER_BYTE;   /* empty PDU back, no MIC */
+        bytes -= n;
+    }
+}
+
+/* The first PDU carries the L2CAP header, the rest are continuations */
+static void add_notification(struct link_cost *cost, uint32_t len)
+{
+    cost->packets++;
+    add_pdus(cost, L2CAP_HDR + ATT_NOTIFY_HDR + len, LL_DATA_MAX, 0);
+}
+
+static void add_sdu(struct link_cost *cost, uint32_t len, uint32_t mps)
+{
+    cost->packets++;
+    add_pdus(cost, RECLO_L2CAP_SDU_HDR + len, mps, L2CAP_HDR);
+}
+
+/* ── Bulk channel stand-in ──────────────────────────────────────────────────*/
+
+static bool             coc_open;
+static uint16_t         coc_mtu;
+static struct link_cost coc_cost;
+static struct link_cost gatt_cost;
+
+int reclo_l2cap_init(void)
+{
+    return 0;
+}
+
+bool reclo_l2cap_connected(void)
+{
+    return coc_open;
+}
+
+uint16_t reclo_l2cap_sdu_max(void)
+{
+    return coc_open ? reclo_l2cap_sdu_fit(MIN(coc_mtu, RECLO_L2CAP_SDU_MAX), COC_MPS) : 0;
+}
+
+int reclo_l2cap_send(const void *data, uint16_t len)
+{
+    if (!coc_open) {
+        return -ENOTCONN;
+    }
+    add_sdu(&coc_cost, len, COC_MPS);
+    return phone_receive(data, len);
+}
+
+static int gatt_receive(const void *data, uint16_t len)
+{
+    int err = phone_receive(data, len);
+    if (!err) {
+        add_notification(&gatt_cost, len);
+    }
+    return err;
+}
+
+/* ── Batches ────────────────────────────────────────────────────────────────*/
+
+static struct bt_conn fake_conn;
+static uint8_t chunk_data[CHUNKS][CHUNK_BYTES];
+
+static void store_chunks(void)
+{
+    for (uint32_t c = 0; c < CHUNKS; c++) {
+        for (size_t i = 0; i < CHUNK_BYTES; i++) {
+            chunk_data[c][i] = (uint8_t) (i * 19 + i / 227 + c * 43);
+        }
+        CHECK_EQ(reclo_transfer_store_chunk(FIRST_TS + c * 30, chunk_data[c], CHUNK_BYTES), 0);
+    }
+}
+
+/* One batch; returns the link cost of the transport it went over */
+static struct link_cost run_batch(uint8_t proto)
+{
+    phone_reset();
+    fake_bt_notify_hook = gatt_receive;
+    memset(&coc_cost, 0, sizeof(coc_cost));
+    memset(&gatt_cost, 0, sizeof(gatt_cost));
+
+    for (int i = 0; i < 1000 && _upload_active; i++) {
+        k_msleep(1);
+    }
+    const uint8_t request[] = { RECLO_CMD_REQUEST_UPLOAD, proto };
+    CHECK_EQ(ctrl_write(&fake_conn, NULL, request, sizeof(request), 0, 0), sizeof(request));
+    CHECK(phone_wait_done(10000));
+
+    for (uint32_t c = 0; c < CHUNKS; c++) {
+        const struct phone_chunk *chunk = phone_chunk(FIRST_TS + c * 30);
+        CHECK(chunk != NULL);
+        if (chunk) {
+            CHECK(phone_chunk_complete(chunk));
+            CHECK(memcmp(chunk->data, chunk_data[c], CHUNK_BYTES) == 0);
+        }
+    }
+    CHECK_EQ(phone.strays, 0);
+    CHECK_EQ(phone.proto, proto);
+
+    /* Exactly one transport carried the batch */
+    CHECK(coc_cost.packets == 0 || gatt_cost.packets == 0);
+    return coc_cost.packets > 0 ? coc_cost : gatt_cost;
+}
+
+static void report(const char *name, struct link_cost cost)
+{
+    uint64_t bytes = (uint64_t) CHUNKS * CHUNK_BYTES;
+    printf("%-26s %5u packets, %5u LL PDUs, %4llu ms on air, %4llu kbps\n", name, cost.packets, cost.pdus,
+           (unsigned long long) cost.air_us / 1000, (unsigned long long) (bytes * 8 * 1000 / cost.air_us));
+}
+
+int main(void)
+{
+    fake_threads_enable();
+    fake_fs_reset();
+    CHECK_EQ(reclo_transfer_init(), 0);
+    store_chunks();
+
+    _on_connected(&fake_conn, 0);
+    data_ccc_changed(NULL, BT_GATT_CCC_NOTIFY);
+
+    fake_bt_mtu = 247;
+    struct link_cost gatt_247 = run_batch(RECLO_PROTO_V2);
+    CHECK(gatt_cost.packets > 0);
+    report("GATT, MTU 247", gatt_247);
+
+    fake_bt_mtu = 498;
+    struct link_cost gatt_498 = run_batch(RECLO_PROTO_V2);
+    CHECK(gatt_cost.packets > 0);
+    report("GATT, MTU 498", gatt_498);
+
+    /* Channel open: v2 goes over it, in SDUs fitted to the MPS */
+    coc_open = true;
+    coc_mtu  = RECLO_L2CAP_SDU_MAX;
+    struct link_cost coc = run_batch(RECLO_PROTO_V2);
+    CHECK(coc_cost.packets > 0);
+    CHECK_EQ(phone.max_len, reclo_l2cap_sdu_fit(RECLO_L2CAP_SDU_MAX, COC_MPS));
+    report("L2CAP CoC, fitted SDU", coc);
+
+    /* What unfitted 2048-byte SDUs would have cost for the same chunks */
+    struct link_cost unfitted = { 0 };
+    uint32_t payload = RECLO_L2CAP_SDU_MAX - RECLO_V2_DATA_HDR_SIZE;
+    for (uint32_t c = 0; c < CHUNKS; c++) {
+        add_sdu(&unfitted, sizeof(RecloHeaderV2), COC_MPS);
+        for (uint32_t off = 0; off < CHUNK_BYTES; off += payload) {
+            add_sdu(&unfitted, RECLO_V2_DATA_HDR_SIZE + MIN(payload, CHUNK_BYTES - off), COC_MPS);
+        }
+    }
+    add_sdu(&unfitted, 1, COC_MPS);   /* UPLOAD_DONE */
+    report("L2CAP CoC, 2048-byte SDU", unfitted);
+
+    CHECK(coc.pdus < gatt_247.pdus);
+    CHECK(coc.pdus <= gatt_498.pdus);
+    CHECK(coc.pdus < unfitted.pdus);
+    CHECK(coc.packets * 3 < gatt_498.packets);
+    CHECK(coc.air_us < gatt_247.air_us);
+
+    /* v1 framing, or the channel closed: back on notifications */
+    struct link_cost v1 = run_batch(RECLO_PROTO_V1);
+    CHECK(gatt_cost.packets > 0);
+    CHECK_EQ(coc_cost.packets, 0);
+    report("GATT v1 with the CoC open", v1);
+
+    coc_open = false;
+    fake_bt_mtu = 247;
+    struct link_cost fallback = run_batch(RECLO_PROTO_V2);
+    CHECK(gatt_cost.packets > 0);
+    CHECK_EQ(fallback.pdus, gatt_247.pdus);
+
+    /* The PSM is published whether or not a phone uses it */
+    uint16_t psm = 0;
+    CHECK_EQ(psm_read(&fake_conn, NULL, &psm, sizeof(psm), 0), sizeof(psm));
+    CHECK_EQ(psm, RECLO_L2CAP_PSM);
+
+    return fake_test_result("test_transfer_l2cap");
+}
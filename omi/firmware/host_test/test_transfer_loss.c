@@ -0,0 +1,158 @@
+/*
+ * Loss recovery: DATA packets lost in the air are restored byte for byte by
+ * NACK_CHUNK resends, in v1 and v2 framing.
+ *
+ * Runs the module's upload and reader threads on the threaded fake. The
+ * phone loses a random tenth of the DATA packets (each seq at most once),
+ * NACKs a chunk's gaps once the next chunk has started, which the upload
+ * thread serves between chunks, and NACKs whatever is still missing after
+ * UPLOAD_DONE until every chunk is whole.
+ */
+
+#include "../omi/src/reclo_transfer.c"
+
+#include "fake_zephyr.h"
+#include "phone.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define CHUNKS        5
+#define CHUNK_BYTES   20000   /* plus c * 777: ragged last packets */
+#define FIRST_TS      1700000000U
+#define AIR_US        200
+#define LOSS_PERCENT  10
+
+static struct bt_conn fake_conn;
+static uint8_t chunk_data[CHUNKS][CHUNK_BYTES + CHUNKS * 777];
+
+static size_t chunk_bytes(uint32_t c)
+{
+    return CHUNK_BYTES + c * 777;
+}
+
+static void store_chunks(void)
+{
+    for (uint32_t c = 0; c < CHUNKS; c++) {
+        for (size_t i = 0; i < chunk_bytes(c); i++) {
+            chunk_data[c][i] = (uint8_t) (i * 11 + i / 239 + c * 59);
+        }
+        CHECK_EQ(reclo_transfer_store_chunk(FIRST_TS + c * 30, chunk_data[c], chunk_bytes(c)), 0);
+    }
+}
+
+/* ── Loss ───────────────────────────────────────────────────────────────────*/
+
+static uint32_t loss_state;
+static bool     lost_once[PHONE_MAX_CHUNKS][PHONE_MAX_SEQS];
+static uint32_t lost;
+
+static bool lose_some(const struct phone_chunk *chunk, uint16_t seq)
+{
+    bool *once = &lost_once[chunk - phone.chunks][seq];
+    loss_state = loss_state * 1103515245U + 12345U;
+    if (*once || (loss_state >> 16) % 100 >= LOSS_PERCENT) {
+        return false;
+    }
+    *once = true;
+    lost++;
+    return true;
+}
+
+/* ── Phone side ─────────────────────────────────────────────────────────────*/
+
+static uint32_t nacks;
+
+static bool send_nack(const struct phone_chunk *chunk)
+{
+    uint8_t cmd[9 + RECLO_NACK_MAX_BITMAP];
+    size_t len = phone_nack(chunk, cmd);
+    if (len == 0) {
+        return false;
+    }
+    CHECK_EQ(ctrl_write(&fake_conn, NULL, cmd, (uint16_t) len, 0, 0), len);
+    nacks++;
+    return true;
+}
+
+static bool all_complete(void)
+{
+    for (uint32_t c = 0; c < CHUNKS; c++) {
+        const struct phone_chunk *chunk = phone_chunk(FIRST_TS + c * 30);
+        if (!chunk || !phone_chunk_complete(chunk)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void run_batch(uint8_t proto, uint32_t seed)
+{
+    phone_reset();
+    phone.lose = lose_some;
+    memset(lost_once, 0, sizeof(lost_once));
+    loss_state = seed;
+    lost = 0;
+    nacks = 0;
+
+    for (int i = 0; i < 1000 && _upload_active; i++) {
+        k_msleep(1);
+    }
+    const uint8_t request[] = { RECLO_CMD_REQUEST_UPLOAD, proto };
+    CHECK_EQ(ctrl_write(&fake_conn, NULL, request, sizeof(request), 0, 0), sizeof(request));
+
+    /* During the batch: NACK each chunk once the next one has begun */
+    int nacked = 0;
+    bool done = false;
+    while (!done) {
+        done = phone_wait_done(2);
+        while (nacked < phone.chunk_count - 1) {
+            send_nack(&phone.chunks[nacked++]);
+        }
+    }
+
+    /* After UPLOAD_DONE: NACK until nothing is missing */
+    for (int round = 0; round < 200 && !all_complete(); round++) {
+        for (uint32_t c = 0; c < CHUNKS; c++) {
+            const struct phone_chunk *chunk = phone_chunk(FIRST_TS + c * 30);
+            if (chunk) {
+                send_nack(chunk);
+            }
+        }
+        k_msleep(20);
+    }
+
+    uint32_t packets = 0;
+    for (uint32_t c = 0; c < CHUNKS; c++) {
+        const struct phone_chunk *chunk = phone_chunk(FIRST_TS + c * 30);
+        CHECK(chunk != NULL);
+        if (!chunk) {
+            continue;
+        }
+        CHECK(phone_chunk_complete(chunk));
+        CHECK_EQ(chunk->data_size, chunk_bytes(c));
+        CHECK(memcmp(chunk->data, chunk_data[c], chunk_bytes(c)) == 0);
+        packets += chunk->total_seqs;
+    }
+    CHECK_EQ(phone.strays, 0);
+    CHECK(lost > 0);
+
+    printf("v%u: %u of %u packets lost, restored by %u NACK(s)\n", proto, lost, packets, nacks);
+}
+
+int main(void)
+{
+    fake_threads_enable();
+    fake_fs_reset();
+    CHECK_EQ(reclo_transfer_init(), 0);
+    store_chunks();
+
+    _on_connected(&fake_conn, 0);
+    data_ccc_changed(NULL, BT_GATT_CCC_NOTIFY);
+    fake_bt_set_air_time(AIR_US);
+
+    run_batch(RECLO_PROTO_V1, 1);
+    run_batch(RECLO_PROTO_V2, 2);
+
+    return fake_test_result("test_transfer_loss");
+}
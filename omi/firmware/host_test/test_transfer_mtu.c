@@ -0,0 +1,91 @@
+/*
+ * v2 framing: DATA packets fill the negotiated MTU, so a chunk takes fewer
+ * packets as the MTU grows.
+ *
+ * Runs one batch per MTU on the threaded fake. Every DATA packet but a
+ * chunk's last must be MIN(MTU - 3, RECLO_V2_MAX_PACKET) bytes, and the
+ * chunk must arrive in its header plus DIV_ROUND_UP(size, payload) of them.
+ */
+
+#include "../omi/src/reclo_transfer.c"
+
+#include "fake_zephyr.h"
+#include "phone.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define CHUNKS        3
+#define CHUNK_BYTES   60000   /* plus c * 333 */
+#define FIRST_TS      1700000000U
+
+static struct bt_conn fake_conn;
+static uint8_t chunk_data[CHUNKS][CHUNK_BYTES + CHUNKS * 333];
+
+static size_t chunk_bytes(uint32_t c)
+{
+    return CHUNK_BYTES + c * 333;
+}
+
+static void store_chunks(void)
+{
+    for (uint32_t c = 0; c < CHUNKS; c++) {
+        for (size_t i = 0; i < chunk_bytes(c); i++) {
+            chunk_data[c][i] = (uint8_t) (i * 17 + i / 233 + c * 71);
+        }
+        CHECK_EQ(reclo_transfer_store_chunk(FIRST_TS + c * 30, chunk_data[c], chunk_bytes(c)), 0);
+    }
+}
+
+static void run_batch(uint16_t mtu, uint16_t expect_payload)
+{
+    fake_bt_mtu = mtu;
+    phone_reset();
+
+    for (int i = 0; i < 1000 && _upload_active; i++) {
+        k_msleep(1);
+    }
+    const uint8_t request[] = { RECLO_CMD_REQUEST_UPLOAD, RECLO_PROTO_V2 };
+    CHECK_EQ(ctrl_write(&fake_conn, NULL, request, sizeof(request), 0, 0), sizeof(request));
+    CHECK(phone_wait_done(10000));
+
+    CHECK_EQ(phone.proto, RECLO_PROTO_V2);
+    CHECK_EQ(phone.max_len, RECLO_V2_DATA_HDR_SIZE + expect_payload);
+    CHECK(phone.max_len <= mtu - 3);
+    CHECK_EQ(phone.strays, 0);
+
+    uint32_t packets = 0;
+    for (uint32_t c = 0; c < CHUNKS; c++) {
+        const struct phone_chunk *chunk = phone_chunk(FIRST_TS + c * 30);
+        CHECK(chunk != NULL);
+        if (!chunk) {
+            continue;
+        }
+        CHECK_EQ(chunk->payload, expect_payload);
+        CHECK_EQ(chunk->total_seqs, 1 + DIV_ROUND_UP(chunk_bytes(c), expect_payload));
+        CHECK_EQ(chunk->packets, chunk->total_seqs);
+        CHECK(phone_chunk_complete(chunk));
+        CHECK(memcmp(chunk->data, chunk_data[c], chunk_bytes(c)) == 0);
+        packets += chunk->packets;
+    }
+
+    printf("MTU %u: %u B per DATA packet, %u packets for %u chunks of ~%u B\n", mtu, expect_payload, packets,
+           CHUNKS, CHUNK_BYTES);
+}
+
+int main(void)
+{
+    fake_threads_enable();
+    fake_fs_reset();
+    CHECK_EQ(reclo_transfer_init(), 0);
+    store_chunks();
+
+    _on_connected(&fake_conn, 0);
+    data_ccc_changed(NULL, BT_GATT_CCC_NOTIFY);
+
+    run_batch(185, 185 - 3 - RECLO_V2_DATA_HDR_SIZE);
+    run_batch(247, 247 - 3 - RECLO_V2_DATA_HDR_SIZE);
+    run_batch(498, RECLO_V2_MAX_PACKET - RECLO_V2_DATA_HDR_SIZE);
+
+    return fake_test_result("test_transfer_mtu");
+}
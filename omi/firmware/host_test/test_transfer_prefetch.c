@@ -0,0 +1,100 @@
+/*
+ * Prefetch utilisation: while each SD read fits in the air time of the
+ * packets it fills, the link never waits on the card.
+ *
+ * Runs the module's upload and reader threads on the threaded fake. Every
+ * notification takes AIR_US on air, so at MTU 247 a 4 KB block (17 v2 DATA
+ * packets) leaves its read about 17 ms. A second run with reads over that
+ * budget checks that the measurement does see the link waiting.
+ */
+
+#include "../omi/src/reclo_transfer.c"
+
+#include "fake_zephyr.h"
+#include "phone.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define CHUNKS        6
+#define CHUNK_BYTES   (32 * 1024)
+#define FIRST_TS      1700000000U
+#define AIR_US        1000
+#define OPEN_US       5000
+#define FAST_READ_US  8000    /* per read: within the ~17 ms budget */
+#define SLOW_READ_US  30000   /* per read: well over it */
+
+static struct bt_conn fake_conn;
+static uint8_t chunk_data[CHUNKS][CHUNK_BYTES];
+
+static void store_chunks(void)
+{
+    for (uint32_t c = 0; c < CHUNKS; c++) {
+        for (size_t i = 0; i < CHUNK_BYTES; i++) {
+            chunk_data[c][i] = (uint8_t) (i * 7 + i / 251 + c * 101);
+        }
+        CHECK_EQ(reclo_transfer_store_chunk(FIRST_TS + c * 30, chunk_data[c], CHUNK_BYTES), 0);
+    }
+}
+
+static void request_upload(void)
+{
+    /* The upload thread clears this just after UPLOAD_DONE */
+    for (int i = 0; i < 1000 && _upload_active; i++) {
+        k_msleep(1);
+    }
+    const uint8_t cmd[] = { RECLO_CMD_REQUEST_UPLOAD, RECLO_PROTO_V2 };
+    CHECK_EQ(ctrl_write(&fake_conn, NULL, cmd, sizeof(cmd), 0, 0), sizeof(cmd));
+}
+
+/* One batch of every chunk with @p read_us per read. Returns the time the
+ * link sat idle between its first and last packet, as a share of the batch. */
+static double run_batch(const char *name, uint32_t read_us)
+{
+    fake_fs_set_latency(FAKE_FS_OPEN, OPEN_US);
+    fake_fs_set_latency(FAKE_FS_READ, read_us);
+    phone_reset();
+    fake_bt_link_stats_reset();
+
+    int64_t t0 = k_uptime_ticks();
+    request_upload();
+    CHECK(phone_wait_done(30000));
+    int64_t elapsed_us = k_uptime_ticks() - t0;
+    struct fake_bt_link_stats link = fake_bt_link_stats();
+
+    for (uint32_t c = 0; c < CHUNKS; c++) {
+        const struct phone_chunk *chunk = phone_chunk(FIRST_TS + c * 30);
+        CHECK(chunk != NULL);
+        if (chunk) {
+            CHECK(phone_chunk_complete(chunk));
+            CHECK(memcmp(chunk->data, chunk_data[c], CHUNK_BYTES) == 0);
+        }
+    }
+    CHECK_EQ(phone.strays, 0);
+    CHECK(link.max_in_flight <= TX_WINDOW);
+
+    double idle = (double) link.idle_us / (double) elapsed_us;
+    printf("%s: %u us per read, %u packets in %lld ms, link idle %lld ms (%.1f%%), "
+           "sender idle %lld ms\n",
+           name, read_us, link.sent, (long long) elapsed_us / 1000, (long long) link.idle_us / 1000,
+           idle * 100, (long long) k_ticks_to_ms_floor64(_sender_time.idle));
+    return idle;
+}
+
+int main(void)
+{
+    fake_threads_enable();
+    fake_fs_reset();
+    CHECK_EQ(reclo_transfer_init(), 0);
+    store_chunks();
+
+    _on_connected(&fake_conn, 0);
+    data_ccc_changed(NULL, BT_GATT_CCC_NOTIFY);
+    fake_bt_set_air_time(AIR_US);
+
+    /* Only the wait for the very first block should show */
+    CHECK(run_batch("card within budget", FAST_READ_US) < 0.05);
+    CHECK(run_batch("card over budget", SLOW_READ_US) > 0.25);
+
+    return fake_test_result("test_transfer_prefetch");
+}
@@ -0,0 +1,263 @@
+/*
+ * VAD on synthetic input: speech is caught in its first frame, the hangover
+ * runs for exactly the configured frames, the noise floor follows a change
+ * of background, and quiet high-frequency fricatives count as speech where
+ * low-frequency noise of the same level does not.
+ *
+ * Signals are 16 kHz frames of 20 ms: white noise from a fixed-seed LCG,
+ * "speech" as a 150 Hz harmonic series, and fricatives as differenced
+ * (high-passed) noise. A minute of synthetic conversation then reports the
+ * share of frames the recorder would store as silence runs, with the
+ * default threshold, hangover and pre-roll.
+ */
+
+#include "vad.h"
+
+#include "fake_zephyr.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#define RATE        16000
+#define FRAME       320                /* 20 ms */
+#define THRESH_DB   9                  /* Kconfig defaults */
+#define HANGOVER    (600 / 20)
+#define PREROLL     (200 / 20)
+
+#define NOISE_RMS   100.0              /* about -50 dBFS */
+#define SPEECH_RMS  2000.0
+
+static uint32_t rng = 12345;
+
+/* Uniform in [-1, 1) */
+static double uniform(void)
+{
+    rng = rng * 1664525U + 1013904223U;
+    return (double) (int32_t) rng / 2147483648.0;
+}
+
+static int16_t clip(double x)
+{
+    return (int16_t) CLAMP(lround(x), -32768, 32767);
+}
+
+/* White noise of @p rms; uniform noise has an RMS of 1/sqrt(3) */
+static void noise(int16_t *pcm, double rms)
+{
+    for (int i = 0; i < FRAME; i++) {
+        pcm[i] = clip(uniform() * rms * sqrt(3.0));
+    }
+}
+
+/* Low-passed noise of about @p rms: a running mean of 8, few zero crossings */
+static void rumble(int16_t *pcm, double rms)
+{
+    static double hist[8];
+    for (int i = 0; i < FRAME; i++) {
+        double acc = 0;
+        for (int k = 7; k > 0; k--) {
+            hist[k] = hist[k - 1];
+            acc += hist[k];
+        }
+        hist[0] = uniform() * rms * sqrt(3.0) * sqrt(8.0);
+        pcm[i] = clip((acc + hist[0]) / 8);
+    }
+}
+
+/* First difference of white noise, about @p rms: mostly above 4 kHz */
+static void fricative(int16_t *pcm, double rms)
+{
+    static double prev;
+    for (int i = 0; i < FRAME; i++) {
+        double x = uniform() * rms * sqrt(3.0) / sqrt(2.0);
+        pcm[i] = clip(x - prev);
+        prev = x;
+    }
+}
+
+/* Noise plus a voiced 150 Hz harmonic series of @p rms, from sample @p from */
+static void speech(int16_t *pcm, double rms, int from)
+{
+    static uint32_t t;
+    noise(pcm, NOISE_RMS);
+    for (int i = from; i < FRAME; i++, t++) {
+        double x = 0;
+        for (int h = 1; h <= 8; h++) {
+            x += sin(2 * M_PI * 150.0 * h * t / RATE) / h;
+        }
+        pcm[i] = clip(pcm[i] + x * rms / 0.95);   /* the series' RMS is ~0.95 */
+    }
+}
+
+static struct vad v;
+static int16_t    pcm[FRAME];
+
+static bool frame_noise(double rms)
+{
+    noise(pcm, rms);
+    return vad_frame(&v, pcm, FRAME);
+}
+
+static double db(uint32_t energy)
+{
+    return 10 * log10((double) energy);
+}
+
+static void settle(void)
+{
+    vad_init(&v, THRESH_DB, HANGOVER);
+    for (int i = 0; i < 150; i++) {
+        CHECK(!frame_noise(NOISE_RMS));
+    }
+}
+
+static void test_onset_and_hangover(void)
+{
+    settle();
+
+    /* Aligned with the frame, and starting three quarters of the way in */
+    for (int from = 0; from < FRAME; from += FRAME * 3 / 4) {
+        speech(pcm, SPEECH_RMS, from);
+        bool first = vad_frame(&v, pcm, FRAME);
+        speech(pcm, SPEECH_RMS, 0);
+        bool second = vad_frame(&v, pcm, FRAME);
+        CHECK(from == 0 ? first : first || second);
+        for (int i = 0; i < 50; i++) {
+            speech(pcm, SPEECH_RMS, 0);
+            CHECK(vad_frame(&v, pcm, FRAME));
+        }
+
+        /* Exactly HANGOVER frames of noise still count, then none */
+        int kept = 0;
+        while (frame_noise(NOISE_RMS) && kept <= HANGOVER) {
+            kept++;
+        }
+        CHECK_EQ(kept, HANGOVER);
+        for (int i = 0; i < 50; i++) {
+            CHECK(!frame_noise(NOISE_RMS));
+        }
+        printf("onset %d samples into a frame: caught in frame %d, %d hangover frames\n", from, first ? 1 : 2,
+               kept);
+    }
+}
+
+/* Seconds a background 12 dB louder than the floor reads as speech; the
+ * floor must then be within 1 dB of it */
+static double louder_background(void (*source)(int16_t *, double))
+{
+    int last = 0;
+    for (int f = 0; f < 30 * 50; f++) {
+        source(pcm, NOISE_RMS * 4);
+        if (vad_frame(&v, pcm, FRAME)) {
+            last = f + 1;
+        }
+    }
+    CHECK(last > 0);
+    CHECK(fabs(db(v.noise) - db((uint32_t) (NOISE_RMS * NOISE_RMS * 16))) < 1.0);
+    return last / 50.0;
+}
+
+static void test_noise_floor(void)
+{
+    /* While the louder background counts as speech the floor rises at only
+     * ~0.4 dB/s. Hum and rumble are learned once within the threshold;
+     * broadband hiss has to come within half of it, as fricatives do. */
+    settle();
+    double floor0 = db(v.noise);
+    double rumble_s = louder_background(rumble);
+    CHECK(rumble_s <= 10);
+
+    /* Back down it follows within a few frames */
+    int down = 0;
+    while (db(v.noise) > floor0 + 1.0 && down < 50) {
+        CHECK(!frame_noise(NOISE_RMS));
+        down++;
+    }
+    CHECK(down < 25);
+
+    settle();
+    double hiss_s = louder_background(noise);
+    CHECK(hiss_s <= 20);
+
+    printf("noise floor %.1f dB; +12 dB background kept as speech for %.1f s (rumble), %.1f s (hiss); "
+           "back down in %d frames\n",
+           floor0, rumble_s, hiss_s, down);
+}
+
+static void test_fricatives(void)
+{
+    settle();
+
+    /* 7.6 dB above the floor: between half the threshold and the threshold */
+    double rms = NOISE_RMS * 2.4;
+    int high = 0, low = 0;
+    for (int i = 0; i < 10; i++) {
+        fricative(pcm, rms);
+        high += vad_frame(&v, pcm, FRAME);
+    }
+    for (int i = 0; i < HANGOVER + 1; i++) {
+        frame_noise(NOISE_RMS);
+    }
+    for (int i = 0; i < 10; i++) {
+        rumble(pcm, rms);
+        low += vad_frame(&v, pcm, FRAME);
+    }
+    CHECK_EQ(high, 10);
+    CHECK_EQ(low, 0);
+    printf("+7.6 dB: %d of 10 fricative frames, %d of 10 low-frequency frames kept\n", high, low);
+}
+
+/* A minute of talk: bursts of 0.5-3 s with pauses of 0.2-5 s */
+static void test_conversation(void)
+{
+    settle();
+
+    enum { FRAMES = 60 * 50 };
+    static bool voiced[FRAMES], talking[FRAMES];
+    int left = 0;
+    bool on = false;
+    for (int f = 0; f < FRAMES; f++) {
+        if (left == 0) {
+            on = !on;
+            double u = (uniform() + 1) / 2;
+            left = on ? 25 + (int) (u * 125) : 10 + (int) (u * 240);
+        }
+        left--;
+        talking[f] = on;
+        if (on) {
+            /* Syllables: the level swings by 12 dB at 4 Hz */
+            speech(pcm, SPEECH_RMS * (0.625 + 0.375 * sin(2 * M_PI * 4 * f / 50.0)), 0);
+            voiced[f] = vad_frame(&v, pcm, FRAME);
+        } else {
+            voiced[f] = frame_noise(NOISE_RMS);
+        }
+    }
+
+    /* Silent frames are stored as runs unless pre-roll keeps them */
+    int talk = 0, missed = 0, stored_silent = 0;
+    for (int f = 0; f < FRAMES; f++) {
+        talk += talking[f];
+        missed += talking[f] && !voiced[f];
+        if (!voiced[f]) {
+            bool preroll = false;
+            for (int k = 1; k <= PREROLL && f + k < FRAMES; k++) {
+                preroll |= voiced[f + k];
+            }
+            stored_silent += !preroll;
+        }
+    }
+    CHECK_EQ(missed, 0);
+    CHECK(stored_silent > 0);
+    printf("60 s conversation, %d%% talking: %d%% of frames stored as silence runs\n", talk * 100 / FRAMES,
+           stored_silent * 100 / FRAMES);
+}
+
+int main(void)
+{
+    test_onset_and_hangover();
+    test_noise_floor();
+    test_fricatives();
+    test_conversation();
+
+    return fake_test_result("test_vad");
+}
@@ -1,13 +1,16 @@
 #include "codec.h"
 
 #include <zephyr/logging/log.h>
-#include <zephyr/sys/ring_buffer.h>
 
 #include "config.h"
+#include "mic_dsp.h"
 #include "utils.h"
 #ifdef CODEC_OPUS
 #include "lib/opus-1.2.1/opus.h"
 #endif
+#ifdef CONFIG_OMI_RECLO_VAD
+#include "vad.h"
+#endif
 
 LOG_MODULE_REGISTER(codec, CONFIG_LOG_DEFAULT_LEVEL);
 
@@ -15,40 +18,173 @@ LOG_MODULE_REGISTER(codec, CONFIG_LOG_DEFAULT_LEVEL);
 // Output
 //
 
-static volatile codec_callback _callback = NULL;
+#define BUS_QUEUE_DEPTH CONFIG_OMI_CODEC_SUBSCRIBER_QUEUE_DEPTH
+#define BUS_MAX_SUBSCRIBERS CONFIG_OMI_CODEC_MAX_SUBSCRIBERS
+
+// Every subscriber can fill its queue and hold one more packet while the
+// codec encodes the next, so the pool never runs dry because of one slow
+// subscriber.
+#define BUS_POOL_SIZE (BUS_MAX_SUBSCRIBERS * (BUS_QUEUE_DEPTH + 1) + 1)
+#define BUS_PACKET_SIZE ROUND_UP(sizeof(struct codec_packet) + CODEC_OUTPUT_MAX_BYTES, 4)
+
+K_MEM_SLAB_DEFINE_STATIC(codec_packet_slab, BUS_PACKET_SIZE, BUS_POOL_SIZE, 4);
+
+struct codec_subscriber {
+    const char *name;
+    bool active;
+    atomic_t dropped;
+    struct k_msgq queue;
+    char __aligned(4) queue_buf[BUS_QUEUE_DEPTH * sizeof(struct codec_packet *)];
+};
+
+static struct codec_subscriber m_subscribers[BUS_MAX_SUBSCRIBERS];
+static atomic_t m_subscriber_count;
+static K_MUTEX_DEFINE(m_bus_lock);
+
+#ifdef CONFIG_OMI_RECLO_VAD
+static struct vad m_vad;
+#endif
 
-void set_codec_callback(codec_callback callback)
+int codec_subscribe(const char *name)
 {
-    _callback = callback;
+    int sub = -ENOSPC;
+    k_mutex_lock(&m_bus_lock, K_FOREVER);
+    for (int i = 0; i < BUS_MAX_SUBSCRIBERS; i++) {
+        struct codec_subscriber *s = &m_subscribers[i];
+        if (!s->active) {
+            k_msgq_init(&s->queue, s->queue_buf, sizeof(struct codec_packet *), BUS_QUEUE_DEPTH);
+            atomic_clear(&s->dropped);
+            s->name = name;
+            s->active = true;
+            atomic_inc(&m_subscriber_count);
+            sub = i;
+            break;
+        }
+    }
+    k_mutex_unlock(&m_bus_lock);
+
+    if (sub < 0) {
+        LOG_ERR("No codec subscriber slot for %s", name);
+    } else {
+        LOG_INF("Codec subscriber %d: %s", sub, name);
+    }
+    return sub;
+}
+
+void codec_unsubscribe(int sub)
+{
+    if (sub < 0 || sub >= BUS_MAX_SUBSCRIBERS) {
+        return;
+    }
+    struct codec_subscriber *s = &m_subscribers[sub];
+
+    k_mutex_lock(&m_bus_lock, K_FOREVER);
+    bool was_active = s->active;
+    s->active = false;
+    k_mutex_unlock(&m_bus_lock);
+    if (!was_active) {
+        return;
+    }
+    atomic_dec(&m_subscriber_count);
+
+    // Nothing is published to it any more; hand back what is still queued
+    struct codec_packet *pkt;
+    while (k_msgq_get(&s->queue, &pkt, K_NO_WAIT) == 0) {
+        codec_packet_release(pkt);
+    }
+}
+
+struct codec_packet *codec_packet_get(int sub, k_timeout_t timeout)
+{
+    struct codec_packet *pkt;
+    if (sub < 0 || sub >= BUS_MAX_SUBSCRIBERS || k_msgq_get(&m_subscribers[sub].queue, &pkt, timeout) != 0) {
+        return NULL;
+    }
+    return pkt;
+}
+
+void codec_packet_release(struct codec_packet *pkt)
+{
+    if (atomic_dec(&pkt->refs) == 1) {
+        k_mem_slab_free(&codec_packet_slab, pkt);
+    }
+}
+
+uint32_t codec_subscriber_dropped(int sub)
+{
+    if (sub < 0 || sub >= BUS_MAX_SUBSCRIBERS) {
+        return 0;
+    }
+    return (uint32_t) atomic_get(&m_subscribers[sub].dropped);
+}
+
+static struct codec_packet *bus_alloc(void)
+{
+    void *block;
+    if (k_mem_slab_alloc(&codec_packet_slab, &block, K_NO_WAIT) != 0) {
+        return NULL;
+    }
+    struct codec_packet *pkt = block;
+    atomic_set(&pkt->refs, 1); // the codec's own reference
+    return pkt;
+}
+
+// Queue the packet for every subscriber without waiting; a full queue costs
+// only that subscriber the frame
+static void bus_publish(struct codec_packet *pkt)
+{
+    k_mutex_lock(&m_bus_lock, K_FOREVER);
+    for (int i = 0; i < BUS_MAX_SUBSCRIBERS; i++) {
+        struct codec_subscriber *s = &m_subscribers[i];
+        if (!s->active) {
+            continue;
+        }
+        atomic_inc(&pkt->refs);
+        if (k_msgq_put(&s->queue, &pkt, K_NO_WAIT) != 0) {
+            atomic_dec(&pkt->refs);
+            if (atomic_inc(&s->dropped) == 0) {
+                LOG_WRN("Codec subscriber %s is falling behind", s->name);
+            }
+        }
+    }
+    k_mutex_unlock(&m_bus_lock);
+
+    codec_packet_release(pkt);
 }
 
 //
 // Input
 //
 
-uint8_t codec_ring_buffer_data[AUDIO_BUFFER_SAMPLES * 2]; // 2 bytes per sample
-struct ring_buf codec_ring_buf;
-int codec_receive_pcm(int16_t *data, size_t len) // this gets called after mic data is finished
-{
+// Pool of frames. The mic downmixes straight into these and the codec
+// encodes them in place, so a sample is written once on its way in.
+K_MEM_SLAB_DEFINE_STATIC(codec_frame_slab, CODEC_PACKAGE_SAMPLES * 2, CODEC_FRAME_POOL_SIZE, 4);
+
+// Filled frames in arrival order; the codec thread sleeps on it
+K_MSGQ_DEFINE(codec_frame_q, sizeof(int16_t *), CODEC_FRAME_POOL_SIZE, 4);
 
-    int written = ring_buf_put(&codec_ring_buf, (uint8_t *) data, len * 2);
-    if (written != len * 2) {
-        LOG_ERR("Failed to write %d bytes to codec ring buffer", len * 2);
-        return -1;
+int16_t *codec_frame_alloc(void)
+{
+    void *frame;
+    if (k_mem_slab_alloc(&codec_frame_slab, &frame, K_NO_WAIT) != 0) {
+        return NULL;
     }
+    return (int16_t *) frame;
+}
 
-    return 0;
+int codec_frame_submit(int16_t *frame) // this gets called after mic data is finished
+{
+    // Cannot fail: the queue has room for every frame in the pool
+    return k_msgq_put(&codec_frame_q, &frame, K_NO_WAIT);
 }
 
 //
 // Thread
 //
 
-int16_t codec_input_samples[CODEC_PACKAGE_SAMPLES];
-uint8_t codec_output_bytes[CODEC_OUTPUT_MAX_BYTES];
 K_THREAD_STACK_DEFINE(codec_stack, 19000);
 static struct k_thread codec_thread;
-uint16_t execute_codec();
+uint16_t execute_codec(const int16_t *input, uint8_t *output);
 
 #if CODEC_OPUS
 #if (CONFIG_OPUS_MODE == CONFIG_OPUS_MODE_CELT)
@@ -62,28 +198,165 @@ static uint8_t m_opus_encoder[OPUS_ENCODER_SIZE];
 static OpusEncoder *const m_opus_state = (OpusEncoder *) m_opus_encoder;
 #endif
 
+//
+// Settings
+//
+
+static struct codec_settings m_settings = {
+    .complexity = CODEC_OPUS_COMPLEXITY,
+    .low_power = false,
+    .bitrate = CODEC_OPUS_BITRATE,
+};
+static struct k_spinlock m_settings_lock;
+
+void codec_get_settings(struct codec_settings *settings)
+{
+    k_spinlock_key_t key = k_spin_lock(&m_settings_lock);
+    *settings = m_settings;
+    k_spin_unlock(&m_settings_lock, key);
+}
+
+//
+// Governor
+//
+// Once a second, compares the mean opus_encode() time against the 20 ms
+// frame period and steps complexity down above the target duty cycle, or up
+// below half of it. Frames piling up in the queue force a step down straight
+// away; the next forced step waits until the backlog grows past where it
+// stood, so one step gets the chance to drain it before quality drops again.
+// Below the battery threshold the low-power profile caps complexity and
+// lowers the bitrate.
+//
+
+#ifdef CONFIG_OMI_CODEC_GOVERNOR
+
+extern uint8_t battery_percentage;
+
+#define GOVERNOR_WINDOW_FRAMES 50 // 1s of 20ms frames
+#define GOVERNOR_BACKLOG_FRAMES (CODEC_FRAME_POOL_SIZE / 2)
+#define GOVERNOR_FRAME_PERIOD_US ((CODEC_PACKAGE_SAMPLES) * 1000000U / 16000U)
+
+static uint32_t m_governor_cycles = 0;
+static uint32_t m_governor_frames = 0;
+static uint32_t m_governor_backlog = 0; // backlog at the last forced step, 0 once drained
+
+static void governor_apply(uint8_t complexity, uint32_t bitrate, bool low_power)
+{
+    struct codec_settings cur;
+    codec_get_settings(&cur);
+    if (complexity == cur.complexity && bitrate == cur.bitrate && low_power == cur.low_power) {
+        return;
+    }
+
+    if (complexity != cur.complexity &&
+        opus_encoder_ctl(m_opus_state, OPUS_SET_COMPLEXITY(complexity)) != OPUS_OK) {
+        complexity = cur.complexity;
+    }
+    if (bitrate != cur.bitrate && opus_encoder_ctl(m_opus_state, OPUS_SET_BITRATE(bitrate)) != OPUS_OK) {
+        bitrate = cur.bitrate;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&m_settings_lock);
+    m_settings.complexity = complexity;
+    m_settings.bitrate = bitrate;
+    m_settings.low_power = low_power;
+    k_spin_unlock(&m_settings_lock, key);
+
+    LOG_INF("Codec governor: complexity %u, %u bps%s", complexity, bitrate, low_power ? " (low power)" : "");
+}
+
+static void governor_update(uint32_t encode_cycles)
+{
+    m_governor_cycles += encode_cycles;
+    m_governor_frames++;
+
+    uint32_t backlog = k_msgq_num_used_get(&codec_frame_q);
+    if (backlog < GOVERNOR_BACKLOG_FRAMES) {
+        m_governor_backlog = 0;
+    }
+    bool behind = backlog >= GOVERNOR_BACKLOG_FRAMES && backlog > m_governor_backlog;
+    if (m_governor_frames < GOVERNOR_WINDOW_FRAMES && !behind) {
+        return;
+    }
+
+    uint32_t mean_us = k_cyc_to_us_floor32(m_governor_cycles / m_governor_frames);
+    uint32_t duty_pct = mean_us * 100U / GOVERNOR_FRAME_PERIOD_US;
+    m_governor_cycles = 0;
+    m_governor_frames = 0;
+
+    // 0 means the battery has not been read yet
+    bool low_power = battery_percentage > 0 && battery_percentage < CONFIG_OMI_CODEC_LOW_BATTERY_PCT;
+    uint8_t ceiling = low_power ? CONFIG_OMI_CODEC_LOW_POWER_COMPLEXITY : CONFIG_OMI_CODEC_MAX_COMPLEXITY;
+    uint32_t bitrate = low_power ? CONFIG_OMI_CODEC_LOW_POWER_BITRATE : CODEC_OPUS_BITRATE;
+
+    struct codec_settings cur;
+    codec_get_settings(&cur);
+    uint8_t complexity = cur.complexity;
+    if (behind || duty_pct > CONFIG_OMI_CODEC_TARGET_DUTY_PCT) {
+        if (complexity > 0) {
+            complexity--;
+        }
+        if (behind) {
+            m_governor_backlog = backlog;
+        }
+    } else if (duty_pct < CONFIG_OMI_CODEC_TARGET_DUTY_PCT / 2 && complexity < ceiling) {
+        complexity++;
+    }
+    complexity = MIN(complexity, ceiling);
+
+    LOG_DBG("Codec governor: %u us/frame, duty %u%%, backlog %u", mean_us, duty_pct, backlog);
+    governor_apply(complexity, bitrate, low_power);
+}
+
+#endif
+
 void codec_entry()
 {
 
-    uint16_t output_size;
+    int16_t *frame;
     while (1) {
 
-        // Check if we have enough data
-        if (ring_buf_size_get(&codec_ring_buf) < CODEC_PACKAGE_SAMPLES * 2) {
-            // LOG_PRINTK("waiting on data....\n");
-            k_sleep(K_MSEC(10));
-            continue;
-        }
-        // Read package
-        ring_buf_get(&codec_ring_buf, (uint8_t *) codec_input_samples, CODEC_PACKAGE_SAMPLES * 2);
+        // Wait for a frame
+        k_msgq_get(&codec_frame_q, &frame, K_FOREVER);
 
-        // Run Codec
-        output_size = execute_codec();
+        // Encode up to CONFIG_OMI_CODEC_MAX_FRAMES_PER_WAKEUP frames back-to-back
+        int frames = 0;
+        do {
+            // Nobody listening: skip the encode altogether
+            struct codec_packet *pkt = NULL;
+            if (atomic_get(&m_subscriber_count) > 0) {
+                pkt = bus_alloc();
+                if (!pkt) {
+                    LOG_WRN("Codec packet pool exhausted; frame dropped");
+                }
+            }
 
-        // Notify
-        if (_callback) {
-            _callback(codec_output_bytes, output_size);
-        }
+            if (pkt) {
+                // Measure and classify the frame for the subscribers
+                pkt->energy = (uint32_t) (mic_dsp_energy(frame, CODEC_PACKAGE_SAMPLES) / (CODEC_PACKAGE_SAMPLES));
+#ifdef CONFIG_OMI_RECLO_VAD
+                pkt->voiced = vad_frame(&m_vad, frame, CODEC_PACKAGE_SAMPLES);
+#else
+                pkt->voiced = true;
+#endif
+
+                // Encode straight into the shared packet
+#ifdef CONFIG_OMI_CODEC_GOVERNOR
+                uint32_t start = k_cycle_get_32();
+                pkt->len = execute_codec(frame, pkt->data);
+                governor_update(k_cycle_get_32() - start);
+#else
+                pkt->len = execute_codec(frame, pkt->data);
+#endif
+            }
+
+            // Hand the frame back to the mic, then publish
+            k_mem_slab_free(&codec_frame_slab, frame);
+            if (pkt) {
+                bus_publish(pkt);
+            }
+        } while (++frames < CONFIG_OMI_CODEC_MAX_FRAMES_PER_WAKEUP &&
+                 k_msgq_get(&codec_frame_q, &frame, K_NO_WAIT) == 0);
 
         // Yield
         k_yield();
@@ -108,8 +381,11 @@ int codec_start()
     ASSERT_TRUE(opus_encoder_ctl(m_opus_state, OPUS_SET_PACKET_LOSS_PERC(0)) == OPUS_OK);
 #endif
 
+#ifdef CONFIG_OMI_RECLO_VAD
+    vad_init(&m_vad, CONFIG_OMI_RECLO_VAD_THRESHOLD_DB, CONFIG_OMI_RECLO_VAD_HANGOVER_MS / 20);
+#endif
+
     // Thread
-    ring_buf_init(&codec_ring_buf, sizeof(codec_ring_buffer_data), codec_ring_buffer_data);
     k_thread_create(&codec_thread,
                     codec_stack,
                     K_THREAD_STACK_SIZEOF(codec_stack),
@@ -131,10 +407,9 @@ int codec_start()
 
 #if CODEC_OPUS
 
-uint16_t execute_codec()
+uint16_t execute_codec(const int16_t *input, uint8_t *output)
 {
-    opus_int32 size = opus_encode(
-        m_opus_state, codec_input_samples, CODEC_PACKAGE_SAMPLES, codec_output_bytes, sizeof(codec_output_bytes));
+    opus_int32 size = opus_encode(m_opus_state, input, CODEC_PACKAGE_SAMPLES, output, CODEC_OUTPUT_MAX_BYTES);
     if (size < 0) {
         LOG_WRN("Opus encoding failed: %d", size);
         return 0;
@@ -2,13 +2,87 @@
 #define CODEC_H
 #include <zephyr/kernel.h>
 
-// Callback
-typedef void (*codec_callback)(uint8_t *data, size_t len);
-void set_codec_callback(codec_callback callback);
+// Output bus
+//
+// Every encoded frame is published to all subscribers as one shared,
+// reference-counted packet. Each subscriber has its own bounded queue and
+// drains it from its own thread; a subscriber that falls behind loses frames
+// from its queue only, counted in codec_subscriber_dropped(), and never
+// stalls the encoder or the other subscribers.
+
+struct codec_packet {
+    atomic_t refs;   // owned by the bus
+    uint32_t energy; // mean square of the input frame, 0 to 2^30
+    bool voiced;     // VAD decision, hangover included; always true without CONFIG_OMI_RECLO_VAD
+    uint16_t len;    // encoded bytes in data, 0 if encoding failed
+    uint8_t data[];
+};
+
+/**
+ * @brief Claim a subscriber slot
+ *
+ * Safe to call before codec_start(). Frames are only encoded while at least
+ * one slot is claimed.
+ *
+ * @return subscriber handle, or -ENOSPC if all
+ *         CONFIG_OMI_CODEC_MAX_SUBSCRIBERS slots are taken
+ */
+int codec_subscribe(const char *name);
+
+/**
+ * @brief Release a subscriber slot and the packets still queued for it
+ */
+void codec_unsubscribe(int sub);
+
+/**
+ * @brief Take the next packet from a subscriber's queue
+ *
+ * Hold at most one packet at a time and hand it back with
+ * codec_packet_release(); the pool is sized on that basis.
+ *
+ * @return the packet, or NULL on timeout
+ */
+struct codec_packet *codec_packet_get(int sub, k_timeout_t timeout);
+
+/**
+ * @brief Drop a reference taken with codec_packet_get()
+ */
+void codec_packet_release(struct codec_packet *pkt);
+
+/**
+ * @brief Frames lost because the subscriber's queue was full
+ */
+uint32_t codec_subscriber_dropped(int sub);
 
 // Integration
 
-int codec_receive_pcm(int16_t *data, size_t len);
+/**
+ * @brief Take an empty frame of CODEC_PACKAGE_SAMPLES samples from the pool
+ *
+ * @return the frame, or NULL if every frame is still queued for encoding
+ */
+int16_t *codec_frame_alloc(void);
+
+/**
+ * @brief Queue a filled frame for encoding; the codec frees it afterwards
+ *
+ * @return 0 if successful, negative errno code if error
+ */
+int codec_frame_submit(int16_t *frame);
+
+// Encoder settings in effect, as chosen by the governor
+struct codec_settings {
+    uint8_t complexity;
+    bool low_power;
+    uint32_t bitrate; // bit/s
+};
+
+/**
+ * @brief Read the encoder settings in effect for the next frame
+ *
+ * Safe to call from any thread.
+ */
+void codec_get_settings(struct codec_settings *settings);
 
 /**
  * @brief Initialize the Codec
@@ -3,9 +3,7 @@
 // #define SAMPLE_RATE 16000
 #define MIC_GAIN 64
 #define MIC_IRC_PRIORITY 7
-#define MIC_BUFFER_SAMPLES 1600    // 100ms
-#define AUDIO_BUFFER_SAMPLES 16000 // 1s
-#define NETWORK_RING_BUF_SIZE 32   // number of frames * CODEC_OUTPUT_MAX_BYTES
+#define CODEC_FRAME_POOL_SIZE 16   // 320ms of 20ms frames queued for the codec
 #define MINIMAL_PACKET_SIZE 100    // Less than that doesn't make sence to send anything at all
 
 // PIN definitions
@@ -30,6 +30,10 @@
 
 # include "armcpu.h"
 
+# if defined(FIXED_POINT) && defined(OPUS_ARM_PRESUME_V8M_DSP)
+#  include "pitch_armv8m.h"
+# endif
+
 # if defined(OPUS_ARM_MAY_HAVE_NEON_INTR)
 opus_val32 celt_inner_prod_neon(const opus_val16 *x, const opus_val16 *y, int N);
 void dual_inner_prod_neon(const opus_val16 *x, const opus_val16 *y01,
@@ -0,0 +1,118 @@
+/* Copyright (c) 2026 Based Hardware Contributors */
+/*
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Fixed-point inner-product kernels for Armv8-M Mainline with the DSP
+   extension (Cortex-M33). SMLAD does two 16x16 multiply-accumulates per
+   instruction; the 32-bit accumulation wraps exactly like the C versions
+   in pitch.h, so results are bit-identical (checked on the host by
+   firmware/host_test/test_opus_pitch.c). */
+
+#if !defined(PITCH_ARMV8M_H)
+# define PITCH_ARMV8M_H
+
+# include <arm_acle.h>
+# include <string.h>
+
+/* Two adjacent samples as one word; memcpy keeps unaligned pointers legal
+   and compiles to a single LDR. */
+static OPUS_INLINE int16x2_t load_pair_armv8m(const opus_val16 *p)
+{
+   int16x2_t w;
+   memcpy(&w, p, sizeof(w));
+   return w;
+}
+
+static OPUS_INLINE opus_val32 celt_inner_prod_armv8m(const opus_val16 *x,
+      const opus_val16 *y, int N)
+{
+   int i;
+   opus_val32 xy=0;
+   for (i=0;i<N-1;i+=2)
+      xy = __smlad(load_pair_armv8m(&x[i]), load_pair_armv8m(&y[i]), xy);
+   if (i<N)
+      xy = MAC16_16(xy, x[i], y[i]);
+   return xy;
+}
+
+static OPUS_INLINE void dual_inner_prod_armv8m(const opus_val16 *x,
+      const opus_val16 *y01, const opus_val16 *y02, int N,
+      opus_val32 *xy1, opus_val32 *xy2)
+{
+   int i;
+   opus_val32 xy01=0;
+   opus_val32 xy02=0;
+   for (i=0;i<N-1;i+=2)
+   {
+      int16x2_t xx = load_pair_armv8m(&x[i]);
+      xy01 = __smlad(xx, load_pair_armv8m(&y01[i]), xy01);
+      xy02 = __smlad(xx, load_pair_armv8m(&y02[i]), xy02);
+   }
+   if (i<N)
+   {
+      xy01 = MAC16_16(xy01, x[i], y01[i]);
+      xy02 = MAC16_16(xy02, x[i], y02[i]);
+   }
+   *xy1 = xy01;
+   *xy2 = xy02;
+}
+
+/* Same contract as xcorr_kernel_c(): len >= 3, reads y[0..len+2]. */
+static OPUS_INLINE void xcorr_kernel_armv8m(const opus_val16 *x,
+      const opus_val16 *y, opus_val32 sum[4], int len)
+{
+   int j;
+   opus_val32 s0=sum[0], s1=sum[1], s2=sum[2], s3=sum[3];
+   for (j=0;j<len-1;j+=2)
+   {
+      int16x2_t xx = load_pair_armv8m(&x[j]);
+      s0 = __smlad(xx, load_pair_armv8m(&y[j]),   s0);
+      s1 = __smlad(xx, load_pair_armv8m(&y[j+1]), s1);
+      s2 = __smlad(xx, load_pair_armv8m(&y[j+2]), s2);
+      s3 = __smlad(xx, load_pair_armv8m(&y[j+3]), s3);
+   }
+   if (j<len)
+   {
+      s0 = MAC16_16(s0, x[j], y[j]);
+      s1 = MAC16_16(s1, x[j], y[j+1]);
+      s2 = MAC16_16(s2, x[j], y[j+2]);
+      s3 = MAC16_16(s3, x[j], y[j+3]);
+   }
+   sum[0]=s0; sum[1]=s1; sum[2]=s2; sum[3]=s3;
+}
+
+# define OVERRIDE_CELT_INNER_PROD (1)
+# define celt_inner_prod(x, y, N, arch) \
+    ((void)(arch), celt_inner_prod_armv8m(x, y, N))
+
+# define OVERRIDE_DUAL_INNER_PROD (1)
+# define dual_inner_prod(x, y01, y02, N, xy1, xy2, arch) \
+    ((void)(arch), dual_inner_prod_armv8m(x, y01, y02, N, xy1, xy2))
+
+# define OVERRIDE_XCORR_KERNEL (1)
+# define xcorr_kernel(x, y, sum, len, arch) \
+    ((void)(arch), xcorr_kernel_armv8m(x, y, sum, len))
+
+#endif
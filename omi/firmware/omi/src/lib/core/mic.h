@@ -2,10 +2,15 @@
 #define MIC_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+// Called with each filled frame; the handler takes ownership of it
 typedef void (*mix_handler)(int16_t *);
 
+// Returns an empty frame to downmix into, or NULL if none is free
+typedef int16_t *(*mic_frame_allocator)(void);
+
 /**
  * @brief Initialize the Microphone
  *
@@ -16,6 +21,14 @@ typedef void (*mix_handler)(int16_t *);
 int mic_start();
 void set_mic_callback(mix_handler _callback);
 
+/**
+ * @brief Set where mono frames come from
+ *
+ * The mic downmixes each PDM block straight into frames of @p samples
+ * samples taken from @p alloc; a frame may span several blocks.
+ */
+void set_mic_frame_allocator(mic_frame_allocator alloc, size_t samples);
+
 void mic_off();
 void mic_on();
 void mic_set_gain(uint8_t gain_level);
@@ -15,10 +15,10 @@
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
 #include <zephyr/sys/atomic.h>
-#include <zephyr/sys/ring_buffer.h>
 
 #include "accel.h"
 #include "button.h"
+#include "codec.h"
 #include "config.h"
 #include "features.h"
 #include "haptic.h"
@@ -40,7 +40,6 @@ static const struct gpio_dt_spec rfsw_en = GPIO_DT_SPEC_GET_OR(DT_NODELABEL(rfsw
 #ifdef CONFIG_OMI_ENABLE_OFFLINE_STORAGE
 extern struct bt_gatt_service storage_service;
 extern bool storage_is_on;
-static bool storage_full_warned = false;
 #endif
 
 extern bool is_connected;
@@ -654,60 +653,25 @@ static void update_mtu(struct bt_conn *conn)
 }
 
 //
-// Ring Buffer
+// Audio source
 //
 
 #define NET_BUFFER_HEADER_SIZE 3
-#define RING_BUFFER_HEADER_SIZE 2
-static uint8_t tx_queue[NETWORK_RING_BUF_SIZE * (CODEC_OUTPUT_MAX_BYTES + RING_BUFFER_HEADER_SIZE)];
-static uint8_t tx_buffer[CODEC_OUTPUT_MAX_BYTES + RING_BUFFER_HEADER_SIZE];
-static uint8_t tx_buffer_2[CODEC_OUTPUT_MAX_BYTES + RING_BUFFER_HEADER_SIZE];
-static uint32_t tx_buffer_size = 0;
-static struct ring_buf ring_buf;
-
-static bool write_to_tx_queue(uint8_t *data, size_t size)
-{
-#ifdef CONFIG_OMI_ENABLE_MONITOR
-    // Increment the counter
-    monitor_inc_tx_queue_write();
-#endif
 
-    if (size > CODEC_OUTPUT_MAX_BYTES) {
-        return false;
-    }
-
-    // Copy data (TODO: Avoid this copy)
-    tx_buffer_2[0] = size & 0xFF;
-    tx_buffer_2[1] = (size >> 8) & 0xFF;
-    memcpy(tx_buffer_2 + RING_BUFFER_HEADER_SIZE, data, size);
-
-    // Write to ring buffer
-    int written =
-        ring_buf_put(&ring_buf,
-                     tx_buffer_2,
-                     (CODEC_OUTPUT_MAX_BYTES + RING_BUFFER_HEADER_SIZE)); // It always fits completely or not at all
-    if (written != CODEC_OUTPUT_MAX_BYTES + RING_BUFFER_HEADER_SIZE) {
-        return false;
-    } else {
-        return true;
-    }
-}
+// The pusher's codec subscription and the packet it is sending
+static int tx_subscriber = -1;
+static struct codec_packet *tx_packet = NULL;
 
 static bool read_from_tx_queue()
 {
-
-    // Read from ring buffer
-    // memset(tx_buffer, 0, sizeof(tx_buffer));
-    uint32_t package_size = CODEC_OUTPUT_MAX_BYTES + RING_BUFFER_HEADER_SIZE;
-    tx_buffer_size = ring_buf_get(&ring_buf, tx_buffer, package_size); // It always fits completely or not at all
-    if (tx_buffer_size != package_size) {
-        // LOG_ERR("Failed to read from ring buffer. not enough data %d", tx_buffer_size);
+    tx_packet = codec_packet_get(tx_subscriber, K_MSEC(10));
+    if (!tx_packet) {
         return false;
     }
 
-    // Adjust size
-    tx_buffer_size = tx_buffer[0] + (tx_buffer[1] << 8);
-
+#ifdef CONFIG_OMI_ENABLE_MONITOR
+    monitor_inc_tx_queue_write();
+#endif
     return true;
 }
 
@@ -726,7 +690,8 @@ static uint8_t pusher_temp_data[MAX_POSSIBLE_MTU];
 
 static bool push_to_gatt(struct bt_conn *conn)
 {
-    uint8_t *buffer = tx_buffer + RING_BUFFER_HEADER_SIZE;
+    uint8_t *buffer = tx_packet->data;
+    uint32_t tx_buffer_size = tx_packet->len;
     uint32_t offset = 0;
     uint8_t index = 0;
     int retry_count = 0;
@@ -780,86 +745,31 @@ static bool push_to_gatt(struct bt_conn *conn)
     return true;
 }
 
-#define OPUS_PREFIX_LENGTH 1
-#define OPUS_PADDED_LENGTH 80
-#define MAX_WRITE_SIZE 440
-static uint32_t offset = 0;
-static uint16_t buffer_offset = 0;
-
-#ifdef CONFIG_OMI_ENABLE_OFFLINE_STORAGE
-static uint8_t storage_temp_data[MAX_WRITE_SIZE];
-bool write_to_storage(void)
+// True while the connected phone has audio notifications enabled; the
+// reference is handed to the caller
+static struct bt_conn *streaming_connection(void)
 {
-    uint8_t *buffer = tx_buffer + 2;
-    uint8_t packet_size = (uint8_t) (tx_buffer_size + OPUS_PREFIX_LENGTH);
-
-    // buffer_offset = buffer_offset+amount_to_fill;
-    // check if adding the new packet will cause a overflow
-    if (buffer_offset + packet_size > MAX_WRITE_SIZE - 1) {
-
-        storage_temp_data[buffer_offset] = tx_buffer_size;
-        uint8_t *write_ptr = storage_temp_data;
-        write_to_file(write_ptr, MAX_WRITE_SIZE);
-
-        buffer_offset = packet_size;
-        storage_temp_data[0] = tx_buffer_size;
-        memcpy(storage_temp_data + 1, buffer, tx_buffer_size);
-
-    } else if (buffer_offset + packet_size == MAX_WRITE_SIZE - 1) {
-        // exact frame needed
-        storage_temp_data[buffer_offset] = tx_buffer_size;
-        memcpy(storage_temp_data + buffer_offset + 1, buffer, tx_buffer_size);
-        buffer_offset = 0;
-        uint8_t *write_ptr = (uint8_t *) storage_temp_data;
-        write_to_file(write_ptr, MAX_WRITE_SIZE);
-    } else {
-        storage_temp_data[buffer_offset] = tx_buffer_size;
-        memcpy(storage_temp_data + buffer_offset + 1, buffer, tx_buffer_size);
-        buffer_offset = buffer_offset + packet_size;
+    struct bt_conn *conn = current_connection;
+    if (!conn) {
+        return NULL;
     }
-
-#ifdef CONFIG_OMI_ENABLE_MONITOR
-    monitor_inc_storage_write();
-#endif
-    return true;
+    conn = bt_conn_ref(conn);
+    if (current_mtu >= MINIMAL_PACKET_SIZE && bt_gatt_is_subscribed(conn, &audio_service.attrs[1], BT_GATT_CCC_NOTIFY)) {
+        return conn;
+    }
+    bt_conn_unref(conn);
+    return NULL;
 }
-#endif
-
-static bool use_storage = true;
-#define MAX_FILES 10
-#define MAX_AUDIO_FILE_SIZE 300000
-static int recent_file_size_updated = 0;
-static uint8_t heartbeat_count = 0;
 
-void test_pusher(void)
+static void stop_streaming(void)
 {
-    uint32_t runs_count = 0;
-    while (1) {
-        k_sleep(K_MSEC(1));
-        struct bt_conn *conn = current_connection;
-        if (conn) {
-            conn = bt_conn_ref(conn);
-        }
-        bool valid = true;
-        if (current_mtu < MINIMAL_PACKET_SIZE) {
-            valid = false;
-        } else if (!conn) {
-            valid = false;
-        } else if (runs_count % 100 == 0) {
-            valid = bt_gatt_is_subscribed(conn, &audio_service.attrs[1], BT_GATT_CCC_NOTIFY); // Check if subscribed
-        }
-        if (valid) {
-            // Expected 100 packages per seconds
-            bool sent = push_to_gatt(conn);
-            if (!sent) {
-                // k_sleep(K_MSEC(50));
-            }
-        }
-        if (conn) {
-            bt_conn_unref(conn);
-        }
-        runs_count++;
-        k_yield();
+    if (tx_packet) {
+        codec_packet_release(tx_packet);
+        tx_packet = NULL;
+    }
+    if (tx_subscriber >= 0) {
+        codec_unsubscribe(tx_subscriber);
+        tx_subscriber = -1;
     }
 }
 
@@ -867,45 +777,37 @@ void pusher(void)
 {
     k_msleep(500);
     while (!atomic_get(&pusher_stop_flag)) {
-        // Check if there is a new buffer
-        if (!read_from_tx_queue()) {
-            k_sleep(K_MSEC(10));
+        // Only take frames off the codec bus while someone listens for them;
+        // offline audio is recorded by RecLo, not here
+        struct bt_conn *conn = streaming_connection();
+        if (!conn) {
+            stop_streaming();
+            k_msleep(50);
             continue;
         }
-
-        // Check BT connection and subscription
-        struct bt_conn *conn = current_connection;
-        bool is_subscribed = false;
-        if (conn) {
-            conn = bt_conn_ref(conn);
-            if (current_mtu >= MINIMAL_PACKET_SIZE) {
-                is_subscribed = bt_gatt_is_subscribed(conn, &audio_service.attrs[1], BT_GATT_CCC_NOTIFY);
+        if (tx_subscriber < 0) {
+            tx_subscriber = codec_subscribe("ble_stream");
+            if (tx_subscriber < 0) {
+                bt_conn_unref(conn);
+                k_msleep(1000);
+                continue;
             }
         }
 
-        if (conn && is_subscribed) {
-            // Push to GATT if connected and subscribed
-            push_to_gatt(conn);
+        // Wait for the next encoded frame, or retry the one that failed
+        if (!tx_packet && !read_from_tx_queue()) {
             bt_conn_unref(conn);
-        } else if (!conn) {
-#ifdef CONFIG_OMI_ENABLE_OFFLINE_STORAGE
-            // No BT connection, write to storage
-            if (get_file_size() < MAX_STORAGE_BYTES && is_sd_on()) {
-                storage_full_warned = false;
-                write_to_storage();
-            } else {
-                if (!storage_full_warned) {
-                    LOG_WRN("Storage full, stopping offline storage");
-                    storage_full_warned = true;
-                }
-            }
-#endif
-        } else {
-            // Connected but not subscribed, just sleep (buffer will be retried)
-            if (conn) bt_conn_unref(conn);
-            k_sleep(K_MSEC(10));
+            continue;
+        }
+
+        bool sent = push_to_gatt(conn);
+        bt_conn_unref(conn);
+        if (sent) {
+            codec_packet_release(tx_packet);
+            tx_packet = NULL;
         }
     }
+    stop_streaming();
 }
 
 int transport_off()
@@ -1026,7 +928,6 @@ int transport_start()
 
 #ifdef CONFIG_OMI_ENABLE_OFFLINE_STORAGE
     // Register storage service for offline audio
-    memset(storage_temp_data, 0, OPUS_PADDED_LENGTH * 4);
     bt_gatt_service_register(&storage_service);
 #endif
     err = bt_le_adv_start(BT_LE_ADV_CONN, bt_ad, ARRAY_SIZE(bt_ad), bt_sd, ARRAY_SIZE(bt_sd));
@@ -1049,15 +950,8 @@ int transport_start()
     k_work_schedule(&battery_work, K_MSEC(3000));
 #endif
 
-    // Start pusher
-    ring_buf_init(&ring_buf, sizeof(tx_queue), tx_queue);
-    if (ring_buf_is_empty(&ring_buf)) {
-        LOG_INF("Ring buffer successfully initialized");
-    } else {
-        LOG_ERR("Ring buffer initialization failed");
-        return -1;
-    }
-
+    // Start pusher; it subscribes to the codec's output bus while a phone
+    // has audio notifications enabled
     struct k_thread *thread = k_thread_create(&pusher_thread,
                                               pusher_stack,
                                               K_THREAD_STACK_SIZEOF(pusher_stack),
@@ -1082,11 +976,3 @@ struct bt_conn *get_current_connection()
 {
     return current_connection;
 }
-
-int broadcast_audio_packets(uint8_t *buffer, size_t size)
-{
-    if (!write_to_tx_queue(buffer, size)) {
-        return -1;
-    }
-    return 0;
-}
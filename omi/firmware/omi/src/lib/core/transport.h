@@ -21,15 +21,6 @@ int transport_start();
  */
 int transport_off();
 
-/**
- * @brief Broadcast audio packets over BLE
- *
- * @param buffer Buffer containing audio data
- * @param size Size of the audio data
- * @return 0 if successful, negative errno code if error
- */
-int broadcast_audio_packets(uint8_t *buffer, size_t size);
-
 /**
  * @brief Get the current BLE connection
  *
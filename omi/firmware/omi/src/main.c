@@ -72,7 +72,7 @@ static void mic_handler(int16_t *buffer)
     monitor_inc_mic_buffer();
 #endif
 
-    int err = codec_receive_pcm(buffer, MIC_BUFFER_SAMPLES);
+    int err = codec_frame_submit(buffer);
     if (err) {
         LOG_ERR("Failed to process PCM data: %d", err);
     }
@@ -329,6 +329,7 @@ int main(void)
 
     // Initialize microphone
     LOG_INF("Initializing microphone...\n");
+    set_mic_frame_allocator(codec_frame_alloc, CODEC_PACKAGE_SAMPLES);
     set_mic_callback(mic_handler);
     ret = mic_start();
     if (ret) {
@@ -12,6 +12,7 @@
 #include <zephyr/logging/log.h>
 
 #include "lib/core/settings.h"
+#include "mic_dsp.h"
 
 LOG_MODULE_REGISTER(mic, CONFIG_LOG_DEFAULT_LEVEL);
 
@@ -23,15 +24,17 @@ LOG_MODULE_REGISTER(mic, CONFIG_LOG_DEFAULT_LEVEL);
 /* Milliseconds to wait for a block to be read. */
 #define READ_TIMEOUT 1000
 
-/* Size of a block for 100 ms of audio data. */
-#define BLOCK_SIZE(sample_rate, number_of_channels) (BYTES_PER_SAMPLE * (sample_rate / 10) * number_of_channels)
+/* Size of a block for CONFIG_OMI_MIC_BLOCK_MS of audio data. */
+#define BLOCK_SIZE(sample_rate, number_of_channels) \
+    (BYTES_PER_SAMPLE * ((sample_rate) * CONFIG_OMI_MIC_BLOCK_MS / 1000) * (number_of_channels))
 
 /* Driver will allocate blocks from this slab to receive audio data into them.
  * Application, after getting a given block from the driver and processing its
- * data, needs to free that block.
+ * data, needs to free that block. At least 80 ms of blocks, so short blocks
+ * still leave the mic thread time to catch up; never fewer than 4.
  */
 #define MAX_BLOCK_SIZE BLOCK_SIZE(MAX_SAMPLE_RATE, 2)
-#define BLOCK_COUNT 4
+#define BLOCK_COUNT MAX(4, 80 / CONFIG_OMI_MIC_BLOCK_MS)
 
 K_MEM_SLAB_DEFINE_STATIC(mem_slab, MAX_BLOCK_SIZE, BLOCK_COUNT, 4);
 
@@ -39,24 +42,24 @@ static const struct device *dmic_dev;
 static volatile mix_handler callback_func = NULL;
 static volatile bool mic_running = false;
 
-#define MAX_FRAMES (MAX_SAMPLE_RATE / 10)
-static int16_t mono_buffer[MAX_FRAMES];
+/* Mono output frames, filled in place by the downmix */
+static volatile mic_frame_allocator frame_alloc = NULL;
+static size_t frame_samples;
+static int16_t *cur_frame;
+static size_t cur_fill;
 
-static inline void
-interleaved_stereo_to_mono(const int16_t *restrict interleaved, size_t frames, int16_t *restrict mono_out)
+#ifdef CONFIG_OMI_MIC_DC_REMOVAL
+static struct mic_dsp_dc_state dc_state;
+#endif
+
+/* Downmix into mono_out, then apply the optional DC removal and digital gain there */
+static void condition_audio(const int16_t *interleaved, size_t frames, int16_t *mono_out)
 {
-    /* Mix L and R channels directly from interleaved format: L0, R0, L1, R1, ... */
-    for (size_t i = 0, j = 0; i < frames; ++i, j += 2) {
-        int32_t left = (int32_t) interleaved[j + 0];
-        int32_t right = (int32_t) interleaved[j + 1];
-        int32_t sum = left + right;
-        sum >>= 1; /* divide by 2 to avoid clipping */
-        if (sum > 32767)
-            sum = 32767;
-        if (sum < -32768)
-            sum = -32768;
-        mono_out[i] = (int16_t) sum;
-    }
+    mic_dsp_downmix(interleaved, frames, mono_out);
+#ifdef CONFIG_OMI_MIC_DC_REMOVAL
+    mic_dsp_dc_block(&dc_state, mono_out, frames);
+#endif
+    mic_dsp_gain(mono_out, frames, CONFIG_OMI_MIC_DIGITAL_GAIN_SHIFT);
 }
 
 static void process_audio_buffer(void *buffer, uint32_t size)
@@ -64,19 +67,33 @@ static void process_audio_buffer(void *buffer, uint32_t size)
     /* size is total interleaved stereo size: frames * 2ch * 2bytes */
     __ASSERT_NO_MSG((size % (BYTES_PER_SAMPLE * CHANNELS)) == 0);
     size_t frames = size / (BYTES_PER_SAMPLE * CHANNELS);
-    int16_t *inter = (int16_t *) buffer;
-
-    /* Verify we don't exceed static buffer size */
-    if (frames > MAX_FRAMES) {
-        LOG_ERR("Frame count %zu exceeds MAX_FRAMES %d", frames, MAX_FRAMES);
-        k_mem_slab_free(&mem_slab, buffer);
-        return;
-    }
-
-    interleaved_stereo_to_mono(inter, frames, mono_buffer);
+    const int16_t *inter = (const int16_t *) buffer;
+
+    /* Downmix into output frames; a block may finish one frame and start the next */
+    size_t done = 0;
+    while (done < frames) {
+        if (!cur_frame) {
+            cur_frame = frame_alloc ? frame_alloc() : NULL;
+            cur_fill = 0;
+            if (!cur_frame) {
+                LOG_WRN("No free frame: dropped %zu samples", frames - done);
+                break;
+            }
+        }
 
-    if (callback_func) {
-        callback_func(mono_buffer);
+        size_t n = MIN(frames - done, frame_samples - cur_fill);
+        condition_audio(&inter[done * CHANNELS], n, &cur_frame[cur_fill]);
+        done += n;
+        cur_fill += n;
+
+        if (cur_fill == frame_samples) {
+            if (callback_func) {
+                callback_func(cur_frame);
+                cur_frame = NULL;
+            } else {
+                cur_fill = 0; /* nobody to hand it to; reuse it */
+            }
+        }
     }
 
     k_mem_slab_free(&mem_slab, buffer);
@@ -155,7 +172,11 @@ int mic_start()
 
     };
 
-    LOG_INF("PCM output rate: %u, channels: %u", cfg.streams[0].pcm_rate, cfg.channel.req_num_chan);
+    LOG_INF("PCM output rate: %u, channels: %u, %u ms blocks (%u bytes of slab)",
+            cfg.streams[0].pcm_rate,
+            cfg.channel.req_num_chan,
+            CONFIG_OMI_MIC_BLOCK_MS,
+            (unsigned int) (MAX_BLOCK_SIZE * BLOCK_COUNT));
 
     ret = dmic_configure(dmic_dev, &cfg);
     if (ret < 0) {
@@ -185,6 +206,12 @@ void set_mic_callback(mix_handler callback)
     callback_func = callback;
 }
 
+void set_mic_frame_allocator(mic_frame_allocator alloc, size_t samples)
+{
+    frame_samples = samples;
+    frame_alloc = alloc;
+}
+
 void mic_pause()
 {
     LOG_INF("Pausing microphone");
@@ -0,0 +1,145 @@
+#include "mic_dsp.h"
+
+#include <string.h>
+
+#if defined(CONFIG_OMI_MIC_DSP_SIMD) && defined(__ARM_FEATURE_SIMD32)
+#include <arm_acle.h>
+#define MIC_DSP_SIMD 1
+#endif
+
+/* 0.995 in Q15 */
+#define DC_POLE_Q15  32604
+
+static inline int16_t sat16(int32_t v)
+{
+    if (v > INT16_MAX) return INT16_MAX;
+    if (v < INT16_MIN) return INT16_MIN;
+    return (int16_t)v;
+}
+
+/* ── Portable reference ──────────────────────────────────────────────────────*/
+
+void mic_dsp_downmix_ref(const int16_t *restrict interleaved, size_t frames, int16_t *restrict mono)
+{
+    /* L0, R0, L1, R1, ... — (L + R) >> 1 always fits, so no clamp is needed */
+    for (size_t i = 0, j = 0; i < frames; ++i, j += 2) {
+        mono[i] = (int16_t)(((int32_t)interleaved[j] + interleaved[j + 1]) >> 1);
+    }
+}
+
+void mic_dsp_gain_ref(int16_t *buf, size_t n, unsigned shift)
+{
+    for (size_t i = 0; i < n; i++) {
+        buf[i] = sat16((int32_t)buf[i] * (1 << shift));
+    }
+}
+
+uint64_t mic_dsp_energy_ref(const int16_t *buf, size_t n)
+{
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; i++) {
+        sum += (uint64_t)((int32_t)buf[i] * buf[i]);
+    }
+    return sum;
+}
+
+/* ── DSP extension ───────────────────────────────────────────────────────────
+ * Samples are moved as 32-bit words holding two halfwords. memcpy keeps the
+ * loads legal for any alignment and compiles to a single LDR/STR.
+ */
+
+#ifdef MIC_DSP_SIMD
+
+void mic_dsp_downmix(const int16_t *restrict interleaved, size_t frames, int16_t *restrict mono)
+{
+    size_t i = 0;
+
+    for (; i + 2 <= frames; i += 2) {
+        uint32_t w0, w1;
+        memcpy(&w0, &interleaved[2 * i], 4);       /* R0:L0 */
+        memcpy(&w1, &interleaved[2 * i + 2], 4);   /* R1:L1 */
+
+        uint32_t left  = (w0 & 0xFFFFU) | (w1 << 16);         /* PKHBT: L1:L0 */
+        uint32_t right = (w0 >> 16)     | (w1 & 0xFFFF0000U); /* PKHTB: R1:R0 */
+        uint32_t out   = (uint32_t)__shadd16((int16x2_t)left, (int16x2_t)right);
+
+        memcpy(&mono[i], &out, 4);
+    }
+
+    mic_dsp_downmix_ref(&interleaved[2 * i], frames - i, &mono[i]);
+}
+
+void mic_dsp_gain(int16_t *buf, size_t n, unsigned shift)
+{
+    if (shift == 0) return;
+
+    size_t i = 0;
+
+    for (; i + 2 <= n; i += 2) {
+        int16x2_t w;
+        memcpy(&w, &buf[i], 4);
+        /* Saturating doubling, once per 6 dB */
+        for (unsigned s = 0; s < shift; s++) {
+            w = __qadd16(w, w);
+        }
+        memcpy(&buf[i], &w, 4);
+    }
+
+    mic_dsp_gain_ref(&buf[i], n - i, shift);
+}
+
+uint64_t mic_dsp_energy(const int16_t *buf, size_t n)
+{
+    /* SMLALD: two squares into a 64-bit accumulator per instruction. Every
+     * partial sum is non-negative and below 2^63, so the signed accumulator
+     * gives the same result as the unsigned reference. */
+    int64_t sum = 0;
+    size_t  i   = 0;
+
+    for (; i + 2 <= n; i += 2) {
+        int16x2_t w;
+        memcpy(&w, &buf[i], 4);
+        sum = __smlald(w, w, sum);
+    }
+
+    return (uint64_t)sum + mic_dsp_energy_ref(&buf[i], n - i);
+}
+
+#else
+
+void mic_dsp_downmix(const int16_t *restrict interleaved, size_t frames, int16_t *restrict mono)
+{
+    mic_dsp_downmix_ref(interleaved, frames, mono);
+}
+
+void mic_dsp_gain(int16_t *buf, size_t n, unsigned shift)
+{
+    if (shift == 0) return;
+    mic_dsp_gain_ref(buf, n, shift);
+}
+
+uint64_t mic_dsp_energy(const int16_t *buf, size_t n)
+{
+    return mic_dsp_energy_ref(buf, n);
+}
+
+#endif /* MIC_DSP_SIMD */
+
+/* ── DC removal ──────────────────────────────────────────────────────────────*/
+
+void mic_dsp_dc_block(struct mic_dsp_dc_state *st, int16_t *buf, size_t n)
+{
+    int32_t x_prev = st->x_prev;
+    int32_t y_prev = st->y_prev;
+
+    for (size_t i = 0; i < n; i++) {
+        int32_t x = buf[i];
+        y_prev = (int32_t)((uint32_t)(x - x_prev) << 12) +
+                 (int32_t)(((int64_t)y_prev * DC_POLE_Q15) >> 15);
+        x_prev = x;
+        buf[i] = sat16((y_prev + (1 << 11)) >> 12);
+    }
+
+    st->x_prev = x_prev;
+    st->y_prev = y_prev;
+}
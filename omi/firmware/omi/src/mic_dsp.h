@@ -0,0 +1,42 @@
+#ifndef MIC_DSP_H
+#define MIC_DSP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * mic_dsp — PCM kernels for the microphone path.
+ *
+ * Each kernel has a portable C reference (*_ref). The plain entry points use
+ * the Armv8-M DSP extension's packed halfword instructions when built with
+ * CONFIG_OMI_MIC_DSP_SIMD, two samples per instruction, and fall back to the
+ * reference otherwise. Both produce bit-identical output.
+ *
+ * Pure C with no Zephyr dependencies.
+ */
+
+/** Average the L and R channels of @p frames interleaved stereo frames. */
+void mic_dsp_downmix(const int16_t *restrict interleaved, size_t frames, int16_t *restrict mono);
+void mic_dsp_downmix_ref(const int16_t *restrict interleaved, size_t frames, int16_t *restrict mono);
+
+/** Multiply @p n samples in place by 2^@p shift, saturating to int16. */
+void mic_dsp_gain(int16_t *buf, size_t n, unsigned shift);
+void mic_dsp_gain_ref(int16_t *buf, size_t n, unsigned shift);
+
+/** Sum of squares of @p n samples; 64-bit, so it cannot overflow. */
+uint64_t mic_dsp_energy(const int16_t *buf, size_t n);
+uint64_t mic_dsp_energy_ref(const int16_t *buf, size_t n);
+
+/* DC blocker state; zero-initialise before the first block */
+struct mic_dsp_dc_state {
+    int32_t x_prev;
+    int32_t y_prev;   /* Q12 */
+};
+
+/**
+ * One-pole DC blocker, y[n] = x[n] - x[n-1] + 0.995·y[n-1] (about 13 Hz at
+ * 16 kHz), in place. Recursive, so there is only the scalar version.
+ */
+void mic_dsp_dc_block(struct mic_dsp_dc_state *st, int16_t *buf, size_t n);
+
+#endif /* MIC_DSP_H */
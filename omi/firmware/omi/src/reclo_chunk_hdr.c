@@ -0,0 +1,130 @@
+#include "reclo_chunk_hdr.h"
+
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+
+/* All multi-byte fields are little-endian on disk regardless of host order */
+
+static void put_le16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_le32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint16_t get_le16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void reclo_chunk_hdr_encode(uint8_t out[RECLO_FILE_HDR_SIZE], const struct reclo_chunk_hdr *hdr)
+{
+    memset(out, 0, RECLO_FILE_HDR_SIZE);
+    out[0] = 'R'; out[1] = 'C'; out[2] = 'L'; out[3] = 'V';
+    put_le32(&out[RECLO_FILE_OFF_TS], hdr->ts);
+    out[8] = hdr->codec_id;
+    put_le32(&out[9], hdr->sample_rate);
+    put_le32(&out[RECLO_FILE_OFF_DATA_SIZE], hdr->data_size);
+    out[17] = RECLO_FILE_VERSION;
+    put_le16(&out[18], hdr->hdr_size > RECLO_FILE_HDR_SIZE ? hdr->hdr_size : RECLO_FILE_HDR_SIZE);
+    put_le32(&out[20], hdr->crc32);
+    out[24] = hdr->enc_complexity;
+    out[25] = hdr->enc_flags;
+    put_le16(&out[26], hdr->enc_bitrate_kbps);
+
+    uint16_t levels = hdr->levels ? hdr->level_count : 0;
+    if (levels > RECLO_LEVEL_MAX) {
+        levels = RECLO_LEVEL_MAX;
+    }
+    put_le16(&out[28], levels);
+    out[30] = hdr->packet_frames ? hdr->packet_frames : 1;
+    if (levels > 0) {
+        memcpy(&out[RECLO_FILE_OFF_LEVELS], hdr->levels, levels);
+    }
+}
+
+uint8_t reclo_level_from_energy(uint32_t mean_square)
+{
+    if (mean_square == 0) {
+        return RECLO_LEVEL_SILENT;
+    }
+    /* -2·dBFS, full scale being a mean square of 2^30 */
+    float level = 20.0f * log10f((float)(1UL << 30) / (float)mean_square);
+    if (level >= RECLO_LEVEL_SILENT) {
+        return RECLO_LEVEL_SILENT;
+    }
+    return (uint8_t)(level + 0.5f);
+}
+
+int reclo_chunk_hdr_parse(const uint8_t *buf, size_t len, struct reclo_chunk_hdr *hdr)
+{
+    if (len < 4) {
+        return -ENODATA;
+    }
+
+    bool v1 = memcmp(buf, "RCLO", 4) == 0;
+    if (!v1 && memcmp(buf, "RCLV", 4) != 0) {
+        return -EILSEQ;
+    }
+
+    size_t need = v1 ? RECLO_FILE_V1_HDR_SIZE : 20;
+    if (len < need) {
+        return -ENODATA;
+    }
+
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->ts          = get_le32(&buf[RECLO_FILE_OFF_TS]);
+    hdr->codec_id    = buf[8];
+    hdr->sample_rate = get_le32(&buf[9]);
+    hdr->data_size   = get_le32(&buf[RECLO_FILE_OFF_DATA_SIZE]);
+
+    if (v1) {
+        hdr->version  = 1;
+        hdr->hdr_size = RECLO_FILE_V1_HDR_SIZE;
+        return 0;
+    }
+
+    hdr->version  = buf[17];
+    hdr->hdr_size = get_le16(&buf[18]);
+    if (hdr->version < 2 || hdr->hdr_size < 24) {
+        return -EINVAL;
+    }
+    if (len < 24) {
+        return -ENODATA;
+    }
+    hdr->crc32 = get_le32(&buf[20]);
+    hdr->packet_frames = 1;
+
+    if (hdr->hdr_size >= 28 && len >= 28) {
+        hdr->enc_complexity   = buf[24];
+        hdr->enc_flags        = buf[25];
+        hdr->enc_bitrate_kbps = get_le16(&buf[26]);
+    }
+
+    if (hdr->version >= 3 && hdr->hdr_size >= RECLO_FILE_OFF_LEVELS && len >= RECLO_FILE_OFF_LEVELS) {
+        uint16_t levels = get_le16(&buf[28]);
+        if (levels <= hdr->hdr_size - RECLO_FILE_OFF_LEVELS &&
+            len >= (size_t)RECLO_FILE_OFF_LEVELS + levels) {
+            hdr->level_count = levels;
+            hdr->levels      = &buf[RECLO_FILE_OFF_LEVELS];
+        }
+        if (buf[30] > 1) {
+            hdr->packet_frames = buf[30];
+        }
+    }
+    return 0;
+}
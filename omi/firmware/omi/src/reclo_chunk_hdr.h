@@ -0,0 +1,120 @@
+#ifndef RECLO_CHUNK_HDR_H
+#define RECLO_CHUNK_HDR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * reclo_chunk_hdr — on-SD chunk file header.
+ *
+ * v1 (17 bytes, magic 'RCLO'):
+ *   [0..3]   magic        'RCLO'
+ *   [4..7]   timestamp    uint32 LE
+ *   [8]      codec_id     21 (Opus)
+ *   [9..12]  sample_rate  uint32 LE (16000)
+ *   [13..16] data_size    uint32 LE, 0 until the chunk is finalised
+ *
+ * v2+ (32 bytes for v2, RECLO_FILE_HDR_SIZE from v3, magic 'RCLV'): the v1
+ * fields at the same offsets, followed by
+ *   [17]     version      RECLO_FILE_VERSION
+ *   [18..19] hdr_size     uint16 LE — data starts here
+ *   [20..23] crc32        CRC-32/ISO-HDLC of the data bytes, uint32 LE
+ *   [24]     enc_complexity  Opus complexity when the chunk was opened
+ *   [25]     enc_flags       RECLO_ENC_F_*
+ *   [26..27] enc_bitrate     kbit/s when the chunk was opened, uint16 LE;
+ *                            0 in files written before these fields existed
+ *   [28..29] level_count  100 ms windows in the level track, uint16 LE (v3+)
+ *   [30]     packet_frames  codec variant: 20 ms Opus frames per stored
+ *                         packet, 1 to 3 (v3+; 0 in older v3 files means 1)
+ *   [31]     reserved     zero
+ *   [32..]   level track  RECLO_LEVEL_MAX bytes, the first level_count used
+ *                         (v3+): the input RMS of each 100 ms window, one
+ *                         byte each, silence runs included, so the phone can
+ *                         find speech without decoding
+ *
+ * The data that follows is a stream of records, [len:2 LE][Opus packet].
+ * A packet holds packet_frames 20 ms frames, or fewer where the encoder
+ * changed bandwidth or a silence run or the chunk end cut it short; its TOC
+ * byte gives the exact count. A len of RECLO_SILENCE_RUN_MARK instead
+ * introduces a silence run, [frames:2 LE]: that many 20 ms frames of
+ * silence that were not stored.
+ * Only chunks with RECLO_ENC_F_VAD set contain silence runs.
+ *
+ * Readers locate the data with hdr_size, so later versions can grow the
+ * header without breaking older parsers. v1 files carry no CRC; the reader
+ * has to compute it.
+ *
+ * Pure C with no Zephyr dependencies.
+ */
+
+#define RECLO_FILE_VERSION      3
+#define RECLO_FILE_V1_HDR_SIZE  17
+
+/* Level track: a byte per 100 ms, room for a little over one chunk */
+#define RECLO_LEVEL_WINDOW_MS   100
+#define RECLO_LEVEL_MAX         320
+
+/* A level byte L means an RMS of -L/2 dBFS; RECLO_LEVEL_SILENT stands for
+ * -127.5 dBFS or less, digital silence included. */
+#define RECLO_LEVEL_SILENT      255
+
+/* enc_flags */
+#define RECLO_ENC_F_CHANGED    0x01  /* governor changed settings mid-chunk */
+#define RECLO_ENC_F_LOW_POWER  0x02  /* low-power profile at chunk open */
+#define RECLO_ENC_F_VAD        0x04  /* silent stretches stored as runs */
+
+/* Data stream records */
+#define RECLO_SILENCE_RUN_MARK  0xFFFF
+#define RECLO_SILENCE_RUN_MAX   0xFFFF   /* frames in one silence-run record */
+
+/* Field offsets shared by every version, for in-place patches */
+#define RECLO_FILE_OFF_TS         4
+#define RECLO_FILE_OFF_DATA_SIZE  13
+#define RECLO_FILE_OFF_LEVELS     32
+
+/* Size of the header written today */
+#define RECLO_FILE_HDR_SIZE  (RECLO_FILE_OFF_LEVELS + RECLO_LEVEL_MAX)
+
+struct reclo_chunk_hdr {
+    uint32_t ts;
+    uint8_t  codec_id;
+    uint32_t sample_rate;
+    uint32_t data_size;
+    uint32_t crc32;
+    uint8_t  version;    /* 1 for legacy files */
+    uint16_t hdr_size;   /* offset of the first data byte */
+    uint8_t  enc_complexity;
+    uint8_t  enc_flags;
+    uint16_t enc_bitrate_kbps;  /* 0 = unknown */
+    uint16_t level_count;       /* 0 when the chunk has no level track */
+    uint8_t  packet_frames;     /* 20 ms frames per stored packet, at most */
+    const uint8_t *levels;      /* encode: source; parse: points into the buffer */
+};
+
+/**
+ * Serialise @p hdr as a current-version header into @p out. The version
+ * field of @p hdr is ignored; level_count is clamped to RECLO_LEVEL_MAX.
+ * hdr_size is RECLO_FILE_HDR_SIZE unless @p hdr asks for more, in which
+ * case the caller pads the header out to it with zeros.
+ */
+void reclo_chunk_hdr_encode(uint8_t out[RECLO_FILE_HDR_SIZE], const struct reclo_chunk_hdr *hdr);
+
+/**
+ * Parse a v1 or v2+ header from the first @p len bytes of a chunk file.
+ *
+ * @return 0 on success, -EILSEQ on a bad magic, -EINVAL on a malformed
+ *         header, or -ENODATA if @p len is too short for the header.
+ */
+int reclo_chunk_hdr_parse(const uint8_t *buf, size_t len, struct reclo_chunk_hdr *hdr);
+
+/** Level byte for a mean-square sample value (0 to 2^30). */
+uint8_t reclo_level_from_energy(uint32_t mean_square);
+
+/** True when the header carries a CRC of the (finalised) data. */
+static inline bool reclo_chunk_hdr_has_crc(const struct reclo_chunk_hdr *hdr)
+{
+    return hdr->version >= 2 && hdr->data_size != 0;
+}
+
+#endif /* RECLO_CHUNK_HDR_H */
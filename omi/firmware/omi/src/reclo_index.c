@@ -0,0 +1,654 @@
+#include "reclo_index.h"
+#include "reclo_transfer.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/fs/fs.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/crc.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+LOG_MODULE_REGISTER(reclo_index, LOG_LEVEL_INF);
+
+#define RECLO_INDEX_PATH      RECLO_STORAGE_DIR "/index.jnl"
+#define RECLO_INDEX_NEW_PATH  RECLO_STORAGE_DIR "/index.new"
+#define RECLO_INDEX_MAGIC     0x58494352U   /* 'RCIX' little-endian */
+#define RECLO_INDEX_VERSION   1
+
+/* Compact once the journal holds this many more records than live chunks */
+#define COMPACT_SLACK  512
+
+/* Snapshot records written per compaction step: one 512-byte sector */
+#define COMPACT_BATCH  32
+
+/* ── Journal records ─────────────────────────────────────────────────────────*/
+
+enum {
+    REC_HEADER      = 0x48,
+    REC_ADD         = 0x01,
+    REC_REMOVE      = 0x02,
+    REC_RETIMESTAMP = 0x03,
+};
+
+typedef struct __attribute__((packed)) {
+    uint8_t  op;
+    uint8_t  state;
+    uint16_t reserved;
+    uint32_t ts;
+    uint32_t val;
+    uint32_t crc;     /* crc32_ieee of the preceding 12 bytes */
+} RecloIndexRec;
+
+_Static_assert(sizeof(RecloIndexRec) == 16, "RecloIndexRec must be 16 bytes");
+
+/* ── State ───────────────────────────────────────────────────────────────────*/
+
+struct index_entry {
+    uint32_t ts;
+    uint32_t size  : 24;
+    uint32_t state : 7;
+    uint32_t sent  : 1;   /* uploaded since boot; not journaled */
+};
+
+static struct index_entry _entries[RECLO_INDEX_MAX_ENTRIES];
+static int                _count;
+static int                _state_count[RECLO_CHUNK_READY + 1];
+static bool               _overflowed;   /* a chunk exists that is not indexed */
+
+static struct fs_file_t   _jnl;
+static bool               _jnl_open;
+static uint32_t           _jnl_records;
+
+/* Snapshot being written to RECLO_INDEX_NEW_PATH (see Compaction) */
+static struct fs_file_t   _snap;
+static bool               _snap_open;
+static uint32_t           _snap_next;      /* every chunk below this ts is in it */
+static uint32_t           _snap_records;
+static RecloIndexRec      _snap_batch[COMPACT_BATCH];
+
+static K_MUTEX_DEFINE(_idx_mutex);
+static struct k_work      _rebuild_work;
+static struct k_work      _compact_work;
+
+/* ── Path helper ─────────────────────────────────────────────────────────────*/
+
+void reclo_index_chunk_path(char *buf, size_t len, uint32_t ts, uint8_t state)
+{
+    snprintf(buf, len, "%s/%010u.%s", RECLO_STORAGE_DIR, ts,
+             state == RECLO_CHUNK_UNSYNCED ? "upt" : "bin");
+}
+
+/* ── In-RAM table (sorted by ts) ─────────────────────────────────────────────
+ * Must be called with _idx_mutex held.
+ */
+static int lower_bound(uint32_t ts)
+{
+    int lo = 0, hi = _count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (_entries[mid].ts < ts) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/* Index of the entry for @p ts, or -1 */
+static int table_find(uint32_t ts)
+{
+    int i = lower_bound(ts);
+    return (i < _count && _entries[i].ts == ts) ? i : -1;
+}
+
+static void table_clear(void)
+{
+    _count      = 0;
+    _overflowed = false;
+    memset(_state_count, 0, sizeof(_state_count));
+}
+
+static int table_insert(uint32_t ts, uint8_t state, uint32_t size)
+{
+    if (state != RECLO_CHUNK_UNSYNCED && state != RECLO_CHUNK_READY) {
+        return -EINVAL;
+    }
+
+    int i = lower_bound(ts);
+    if (i < _count && _entries[i].ts == ts) {
+        _state_count[_entries[i].state]--;
+    } else {
+        if (_count == RECLO_INDEX_MAX_ENTRIES) {
+            /* Keep the oldest chunks, which upload first: a rescan meets
+             * the files in directory order, not time order */
+            _overflowed = true;
+            if (i == _count) {
+                return -ENOSPC;
+            }
+            _count--;
+            _state_count[_entries[_count].state]--;
+        }
+        memmove(&_entries[i + 1], &_entries[i], (size_t)(_count - i) * sizeof(_entries[0]));
+        _count++;
+    }
+
+    _entries[i].ts    = ts;
+    _entries[i].size  = MIN(size, 0xFFFFFFU);
+    _entries[i].state = state;
+    _entries[i].sent  = 0;
+    _state_count[state]++;
+    return 0;
+}
+
+static int table_erase(uint32_t ts)
+{
+    int i = lower_bound(ts);
+    if (i >= _count || _entries[i].ts != ts) {
+        return -ENOENT;
+    }
+
+    _state_count[_entries[i].state]--;
+    memmove(&_entries[i], &_entries[i + 1], (size_t)(_count - i - 1) * sizeof(_entries[0]));
+    _count--;
+    return 0;
+}
+
+/* Move the entry at @p old_ts to @p new_ts as READY, keeping its size */
+static int table_retimestamp(uint32_t old_ts, uint32_t new_ts)
+{
+    int i = table_find(old_ts);
+    if (i < 0) {
+        return -ENOENT;
+    }
+    uint32_t size = _entries[i].size;
+    table_erase(old_ts);
+    return table_insert(new_ts, RECLO_CHUNK_READY, size);
+}
+
+/* ── Journal I/O ─────────────────────────────────────────────────────────────
+ * Must be called with _idx_mutex held.
+ */
+static void rec_seal(RecloIndexRec *rec)
+{
+    rec->crc = crc32_ieee((const uint8_t *)rec, offsetof(RecloIndexRec, crc));
+}
+
+static void rec_fill(RecloIndexRec *rec, uint8_t op, uint8_t state, uint32_t ts, uint32_t val)
+{
+    memset(rec, 0, sizeof(*rec));
+    rec->op    = op;
+    rec->state = state;
+    rec->ts    = ts;
+    rec->val   = val;
+    rec_seal(rec);
+}
+
+static bool rec_valid(const RecloIndexRec *rec)
+{
+    return rec->crc == crc32_ieee((const uint8_t *)rec, offsetof(RecloIndexRec, crc));
+}
+
+static int journal_open_append(void)
+{
+    fs_file_t_init(&_jnl);
+    int err = fs_open(&_jnl, RECLO_INDEX_PATH, FS_O_WRITE | FS_O_APPEND);
+    if (err) {
+        LOG_ERR("fs_open(%s): %d", RECLO_INDEX_PATH, err);
+        return err;
+    }
+    _jnl_open = true;
+    return 0;
+}
+
+static void journal_close(void)
+{
+    if (_jnl_open) {
+        fs_close(&_jnl);
+        _jnl_open = false;
+    }
+}
+
+/* ── Compaction ──────────────────────────────────────────────────────────────
+ * The journal is rewritten as header + one ADD per live chunk into
+ * RECLO_INDEX_NEW_PATH, which then replaces it with a single rename, so a
+ * crash leaves one complete journal or the other. In the background this
+ * goes a sector of records per step on the system work queue, with
+ * _idx_mutex released in between: changes keep going to the old journal,
+ * and a change to a chunk the snapshot has already passed is written to the
+ * snapshot too. Must be called with _idx_mutex held.
+ */
+static void snapshot_abort(void)
+{
+    if (_snap_open) {
+        fs_close(&_snap);
+        _snap_open = false;
+        fs_unlink(RECLO_INDEX_NEW_PATH);
+    }
+}
+
+static int snapshot_begin(void)
+{
+    snapshot_abort();
+
+    fs_file_t_init(&_snap);
+    int err = fs_open(&_snap, RECLO_INDEX_NEW_PATH, FS_O_CREATE | FS_O_WRITE | FS_O_TRUNC);
+    if (err) {
+        LOG_ERR("fs_open(%s): %d", RECLO_INDEX_NEW_PATH, err);
+        return err;
+    }
+    _snap_open    = true;
+    _snap_next    = 0;
+    _snap_records = 0;
+
+    RecloIndexRec hdr;
+    rec_fill(&hdr, REC_HEADER, 0, RECLO_INDEX_MAGIC, RECLO_INDEX_VERSION);
+    if (fs_write(&_snap, &hdr, sizeof(hdr)) != (ssize_t)sizeof(hdr)) {
+        LOG_ERR("Index snapshot write failed");
+        snapshot_abort();
+        return -EIO;
+    }
+    _snap_records = 1;
+    return 0;
+}
+
+/* Swap the finished snapshot in for the journal */
+static int snapshot_finish(void)
+{
+    fs_close(&_snap);
+    _snap_open = false;
+    journal_close();
+
+    int err = fs_rename(RECLO_INDEX_NEW_PATH, RECLO_INDEX_PATH);
+    if (err) {
+        LOG_ERR("fs_rename(%s): %d", RECLO_INDEX_NEW_PATH, err);
+        fs_unlink(RECLO_INDEX_NEW_PATH);
+        journal_open_append();
+        return err;
+    }
+
+    _jnl_records = _snap_records;
+    return journal_open_append();
+}
+
+/* Write the next COMPACT_BATCH chunks.
+ * @return -EAGAIN while chunks remain, 0 once the snapshot has replaced the
+ * journal, or another negative errno (the snapshot is dropped). */
+static int snapshot_step(void)
+{
+    size_t n = 0;
+    int    i = lower_bound(_snap_next);
+    for (; i < _count && n < COMPACT_BATCH; i++) {
+        rec_fill(&_snap_batch[n++], REC_ADD, _entries[i].state, _entries[i].ts, _entries[i].size);
+    }
+
+    if (n > 0) {
+        if (fs_write(&_snap, _snap_batch, n * sizeof(_snap_batch[0])) !=
+            (ssize_t)(n * sizeof(_snap_batch[0]))) {
+            LOG_ERR("Index snapshot write failed");
+            snapshot_abort();
+            return -EIO;
+        }
+        _snap_records += n;
+        _snap_next     = _entries[i - 1].ts + 1;
+    }
+
+    return (i < _count) ? -EAGAIN : snapshot_finish();
+}
+
+/* A chunk changed: if the snapshot has already passed it, record its new
+ * state (present or not) there as well */
+static void snapshot_track(uint32_t ts)
+{
+    if (!_snap_open || ts >= _snap_next) {
+        return;
+    }
+
+    RecloIndexRec rec;
+    int i = table_find(ts);
+    if (i >= 0) {
+        rec_fill(&rec, REC_ADD, _entries[i].state, ts, _entries[i].size);
+    } else {
+        rec_fill(&rec, REC_REMOVE, 0, ts, 0);
+    }
+    if (fs_write(&_snap, &rec, sizeof(rec)) != (ssize_t)sizeof(rec)) {
+        LOG_ERR("Index snapshot write failed");
+        snapshot_abort();
+        return;
+    }
+    _snap_records++;
+}
+
+/* Write the whole snapshot now (boot and rescans) */
+static int journal_write_snapshot(void)
+{
+    int err = snapshot_begin();
+    while (err == 0) {
+        err = snapshot_step();
+        if (err == -EAGAIN) {
+            err = 0;
+        } else {
+            break;
+        }
+    }
+    return err;
+}
+
+static void compact_work_fn(struct k_work *work)
+{
+    ARG_UNUSED(work);
+
+    k_mutex_lock(&_idx_mutex, K_FOREVER);
+    int err = 0;
+    if (!_snap_open) {
+        /* Already compacted, e.g. by a rescan, since this was queued */
+        if (_jnl_records <= (uint32_t)_count + COMPACT_SLACK) {
+            k_mutex_unlock(&_idx_mutex);
+            return;
+        }
+        err = snapshot_begin();
+    }
+    if (err == 0 && snapshot_step() == -EAGAIN) {
+        k_work_submit(&_compact_work);
+    }
+    k_mutex_unlock(&_idx_mutex);
+}
+
+static int journal_append(uint8_t op, uint8_t state, uint32_t ts, uint32_t val)
+{
+    if (!_jnl_open) {
+        return -EBADF;
+    }
+
+    RecloIndexRec rec;
+    rec_fill(&rec, op, state, ts, val);
+
+    if (fs_write(&_jnl, &rec, sizeof(rec)) != (ssize_t)sizeof(rec)) {
+        LOG_ERR("Index journal append failed");
+        return -EIO;
+    }
+    /* Persist the directory entry (file size) so the record survives power loss */
+    fs_sync(&_jnl);
+    _jnl_records++;
+
+    if (_jnl_records > (uint32_t)_count + COMPACT_SLACK && !_snap_open) {
+        k_work_submit(&_compact_work);
+    }
+    return 0;
+}
+
+/* Replay the journal into the table.
+ * @return 0 if the journal is consistent, negative errno if it must be rebuilt. */
+static int journal_replay(void)
+{
+    struct fs_file_t f;
+    fs_file_t_init(&f);
+    int err = fs_open(&f, RECLO_INDEX_PATH, FS_O_READ);
+    if (err) {
+        return err;
+    }
+
+    RecloIndexRec rec;
+    if (fs_read(&f, &rec, sizeof(rec)) != (ssize_t)sizeof(rec) || !rec_valid(&rec) ||
+        rec.op != REC_HEADER || rec.ts != RECLO_INDEX_MAGIC || rec.val != RECLO_INDEX_VERSION) {
+        fs_close(&f);
+        return -EBADMSG;
+    }
+
+    table_clear();
+    _jnl_records = 1;
+
+    bool     have_last_add = false;
+    uint32_t last_add_ts   = 0;
+    ssize_t  n;
+
+    while ((n = fs_read(&f, &rec, sizeof(rec))) == (ssize_t)sizeof(rec)) {
+        if (!rec_valid(&rec)) {
+            err = -EBADMSG;
+            break;
+        }
+        _jnl_records++;
+
+        switch (rec.op) {
+        case REC_ADD:
+            table_insert(rec.ts, rec.state, rec.val);
+            have_last_add = true;
+            last_add_ts   = rec.ts;
+            break;
+        case REC_REMOVE:
+            table_erase(rec.ts);
+            break;
+        case REC_RETIMESTAMP:
+            /* The entry being moved precedes this record, so the size
+             * carries over from it */
+            table_retimestamp(rec.ts, rec.val);
+            if (have_last_add && last_add_ts == rec.ts) {
+                last_add_ts = rec.val;
+            }
+            break;
+        default:
+            err = -EBADMSG;
+            break;
+        }
+        if (err) {
+            break;
+        }
+    }
+    fs_close(&f);
+
+    if (err) {
+        return err;
+    }
+    if (n < 0) {
+        return (int)n;
+    }
+
+    /* The newest chunk is the one most likely to be out of step with the
+     * card (crash between journal append and rename). Check it exists. */
+    if (have_last_add) {
+        int i = table_find(last_add_ts);
+        if (i >= 0) {
+            char path[64];
+            struct fs_dirent ent;
+            reclo_index_chunk_path(path, sizeof(path), last_add_ts, _entries[i].state);
+            if (fs_stat(path, &ent) != 0) {
+                LOG_WRN("Index: newest chunk %s missing", path);
+                return -ENOENT;
+            }
+        }
+    }
+
+    if (_overflowed) {
+        return -ENOSPC;
+    }
+
+    /* n > 0 means a torn trailing record — the append that was in flight at
+     * power loss. Everything before it is valid. */
+    return (n == 0) ? 0 : -EAGAIN;
+}
+
+/* ── Rebuild from directory scan ─────────────────────────────────────────────
+ * Must be called with _idx_mutex held.
+ */
+static int rebuild_from_scan(void)
+{
+    struct fs_dir_t  dir;
+    struct fs_dirent ent;
+    fs_dir_t_init(&dir);
+
+    table_clear();
+
+    int err = fs_opendir(&dir, RECLO_STORAGE_DIR);
+    if (err) {
+        return err;
+    }
+
+    while (fs_readdir(&dir, &ent) == 0 && ent.name[0] != '\0') {
+        size_t nlen = strlen(ent.name);
+        /* Expect exactly "0123456789.bin" / ".upt" = 14 chars */
+        if (ent.type != FS_DIR_ENTRY_FILE || nlen != 14) {
+            continue;
+        }
+
+        uint8_t state;
+        if (strcmp(ent.name + 10, ".bin") == 0) {
+            state = RECLO_CHUNK_READY;
+        } else if (strcmp(ent.name + 10, ".upt") == 0) {
+            state = RECLO_CHUNK_UNSYNCED;
+        } else {
+            continue;
+        }
+
+        char ts_str[11];
+        memcpy(ts_str, ent.name, 10);
+        ts_str[10] = '\0';
+        table_insert((uint32_t)strtoul(ts_str, NULL, 10), state, (uint32_t)ent.size);
+    }
+    fs_closedir(&dir);
+
+    LOG_INF("Index rebuilt from scan: %d chunk(s)%s", _count,
+            _overflowed ? " [overflow]" : "");
+    return journal_write_snapshot();
+}
+
+static void rebuild_work_fn(struct k_work *work)
+{
+    ARG_UNUSED(work);
+
+    k_mutex_lock(&_idx_mutex, K_FOREVER);
+    rebuild_from_scan();
+    k_mutex_unlock(&_idx_mutex);
+}
+
+/* ── Public API ──────────────────────────────────────────────────────────────*/
+
+int reclo_index_init(void)
+{
+    k_work_init(&_rebuild_work, rebuild_work_fn);
+    k_work_init(&_compact_work, compact_work_fn);
+
+    struct fs_dirent ent;
+    if (fs_stat(RECLO_STORAGE_DIR, &ent) != 0) {
+        fs_mkdir(RECLO_STORAGE_DIR);
+    }
+
+    k_mutex_lock(&_idx_mutex, K_FOREVER);
+
+    int err = journal_replay();
+    if (err == 0) {
+        err = journal_open_append();
+    } else if (err == -EAGAIN) {
+        /* Drop the torn tail by rewriting the journal */
+        err = journal_write_snapshot();
+    } else {
+        LOG_WRN("Index journal unusable (%d); rebuilding from scan", err);
+        err = rebuild_from_scan();
+    }
+
+    LOG_INF("Chunk index: %d ready, %d unsynced (%u journal records)",
+            _state_count[RECLO_CHUNK_READY], _state_count[RECLO_CHUNK_UNSYNCED],
+            _jnl_records);
+
+    k_mutex_unlock(&_idx_mutex);
+    return err;
+}
+
+int reclo_index_add(uint32_t ts, uint8_t state, uint32_t size)
+{
+    k_mutex_lock(&_idx_mutex, K_FOREVER);
+    int err = table_insert(ts, state, size);
+    if (err == 0) {
+        err = journal_append(REC_ADD, state, ts, size);
+        snapshot_track(ts);
+    } else if (err == -ENOSPC) {
+        LOG_WRN("Chunk index full; ts=%u will be picked up by a later rescan", ts);
+    }
+    k_mutex_unlock(&_idx_mutex);
+    return err;
+}
+
+int reclo_index_remove(uint32_t ts)
+{
+    k_mutex_lock(&_idx_mutex, K_FOREVER);
+    int err = table_erase(ts);
+    if (err == 0) {
+        err = journal_append(REC_REMOVE, 0, ts, 0);
+        snapshot_track(ts);
+    }
+
+    /* Chunks were dropped from the index while it was full; once the
+     * backlog has drained by half, rescan to pick them back up. */
+    if (_overflowed && _count <= RECLO_INDEX_MAX_ENTRIES / 2) {
+        _overflowed = false;
+        k_work_submit(&_rebuild_work);
+    }
+    k_mutex_unlock(&_idx_mutex);
+    return err;
+}
+
+int reclo_index_retimestamp(uint32_t old_ts, uint32_t new_ts)
+{
+    k_mutex_lock(&_idx_mutex, K_FOREVER);
+
+    int err = table_retimestamp(old_ts, new_ts);
+    if (err == 0) {
+        err = journal_append(REC_RETIMESTAMP, RECLO_CHUNK_READY, old_ts, new_ts);
+        snapshot_track(old_ts);
+        snapshot_track(new_ts);
+    }
+
+    k_mutex_unlock(&_idx_mutex);
+    return err;
+}
+
+int reclo_index_count(uint8_t state)
+{
+    if (state != RECLO_CHUNK_UNSYNCED && state != RECLO_CHUNK_READY) {
+        return 0;
+    }
+
+    k_mutex_lock(&_idx_mutex, K_FOREVER);
+    int count = _state_count[state];
+    k_mutex_unlock(&_idx_mutex);
+    return count;
+}
+
+int reclo_index_find_from(uint8_t state, uint32_t from_ts, struct reclo_chunk_info *info)
+{
+    int err = -ENOENT;
+
+    k_mutex_lock(&_idx_mutex, K_FOREVER);
+    for (int i = lower_bound(from_ts); i < _count; i++) {
+        if (_entries[i].state == state) {
+            info->ts    = _entries[i].ts;
+            info->size  = _entries[i].size;
+            info->state = _entries[i].state;
+            info->sent  = _entries[i].sent;
+            err = 0;
+            break;
+        }
+    }
+    k_mutex_unlock(&_idx_mutex);
+    return err;
+}
+
+int reclo_index_mark_sent(uint32_t ts)
+{
+    int err = -ENOENT;
+
+    k_mutex_lock(&_idx_mutex, K_FOREVER);
+    int i = table_find(ts);
+    if (i >= 0) {
+        _entries[i].sent = 1;
+        err = 0;
+    }
+    k_mutex_unlock(&_idx_mutex);
+    return err;
+}
+
+void reclo_index_mark_inconsistent(void)
+{
+    LOG_WRN("Chunk index out of step with SD card; scheduling rescan");
+    k_work_submit(&_rebuild_work);
+}
@@ -0,0 +1,94 @@
+#ifndef RECLO_INDEX_H
+#define RECLO_INDEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * reclo_index — persistent index of chunk files on the SD card.
+ *
+ * Keeps a sorted in-RAM table of every published chunk (ts, state, size) so
+ * that counting, listing, retimestamping and deleting chunks never needs an
+ * fs_opendir() scan of RECLO_STORAGE_DIR. The table is backed by an
+ * append-only journal on the card (RECLO_INDEX_PATH):
+ *
+ *   header  (16 bytes): REC_HEADER, magic 'RCIX', version, crc32
+ *   records (16 bytes): op[1] + state[1] + rsvd[2] + ts[4] + val[4] + crc32[4]
+ *
+ *   ADD          val = file size in bytes
+ *   REMOVE       val unused
+ *   RETIMESTAMP  ts = old uptime ts, val = new UTC ts (state UNSYNCED → READY;
+ *                the size carries over from the entry at the old ts)
+ *
+ * On boot the journal is replayed. The index is rebuilt from a directory scan
+ * only when the journal is missing, fails its CRC checks, or its newest ADD
+ * names a file that does not exist. Once the journal grows well past the
+ * number of live chunks it is compacted into a snapshot of ADD records, a
+ * sector at a time on the system work queue, so no caller ever waits for
+ * more than one sector write.
+ *
+ * All functions are thread-safe; they serialise on an internal mutex and may
+ * perform SD I/O, so they must not be called from ISR context.
+ */
+
+/* Chunk states — map 1:1 to the file extension */
+#define RECLO_CHUNK_UNSYNCED  0x01   /* .upt — uptime timestamp, awaiting UTC */
+#define RECLO_CHUNK_READY     0x02   /* .bin — UTC timestamp, ready to upload */
+
+/* Maximum chunks tracked in RAM (8 bytes each; see Kconfig). Past this,
+ * new chunks are still recorded and the index rescans the card once enough
+ * of the backlog has been uploaded to make room. */
+#define RECLO_INDEX_MAX_ENTRIES  CONFIG_OMI_RECLO_INDEX_MAX_ENTRIES
+
+struct reclo_chunk_info {
+    uint32_t ts;
+    uint32_t size;    /* file size in bytes, header included */
+    uint8_t  state;   /* RECLO_CHUNK_* */
+    bool     sent;    /* uploaded since boot (RAM only) */
+};
+
+/**
+ * Load the index from the journal, rebuilding it from a directory scan if the
+ * journal is missing or inconsistent. Call once after the SD card is mounted.
+ */
+int reclo_index_init(void);
+
+/** Record a newly published chunk. Replaces any existing entry for @p ts. */
+int reclo_index_add(uint32_t ts, uint8_t state, uint32_t size);
+
+/** Forget a chunk (after its file was deleted). */
+int reclo_index_remove(uint32_t ts);
+
+/** Move an UNSYNCED chunk to its UTC timestamp and mark it READY. */
+int reclo_index_retimestamp(uint32_t old_ts, uint32_t new_ts);
+
+/** Number of chunks in @p state. O(1). */
+int reclo_index_count(uint8_t state);
+
+/**
+ * Find the oldest chunk in @p state with ts >= @p from_ts.
+ * Iterate with from_ts = info.ts + 1. O(log n) for the common all-READY case.
+ *
+ * @return 0 and fills @p info, or -ENOENT if there is none.
+ */
+int reclo_index_find_from(uint8_t state, uint32_t from_ts, struct reclo_chunk_info *info);
+
+/**
+ * Flag a chunk as uploaded. Cumulative and range ACKs only delete flagged
+ * chunks, so a chunk that joins the index mid-upload (e.g. retimestamped
+ * into the middle of the range) is never deleted unseen. The flag lives in
+ * RAM only and is cleared whenever the entry is re-added.
+ */
+int reclo_index_mark_sent(uint32_t ts);
+
+/**
+ * Report that the card disagrees with the index (e.g. an indexed file could
+ * not be opened). Schedules a background rebuild from a directory scan.
+ */
+void reclo_index_mark_inconsistent(void);
+
+/** Format the SD card path of a chunk: RECLO_STORAGE_DIR/%010u.{bin,upt}. */
+void reclo_index_chunk_path(char *buf, size_t len, uint32_t ts, uint8_t state);
+
+#endif /* RECLO_INDEX_H */
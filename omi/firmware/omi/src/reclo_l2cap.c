@@ -0,0 +1,123 @@
+#include "reclo_l2cap.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/l2cap.h>
+#include <zephyr/net/buf.h>
+#include <zephyr/logging/log.h>
+#include <string.h>
+
+LOG_MODULE_REGISTER(reclo_l2cap, LOG_LEVEL_INF);
+
+/* ── SDU buffers ─────────────────────────────────────────────────────────────
+ * One buffer per SDU in flight. A buffer returns to the pool once the stack
+ * has sent its SDU, so net_buf_alloc() blocking is the upload's flow control.
+ */
+
+#define SDU_BUF_COUNT      4
+#define SDU_ALLOC_TIMEOUT  K_SECONDS(5)
+
+NET_BUF_POOL_FIXED_DEFINE(_sdu_pool, SDU_BUF_COUNT,
+                          BT_L2CAP_SDU_BUF_SIZE(RECLO_L2CAP_SDU_MAX),
+                          CONFIG_BT_CONN_TX_USER_DATA_SIZE, NULL);
+
+/* ── Channel ─────────────────────────────────────────────────────────────────*/
+
+static struct bt_l2cap_le_chan _chan;
+static atomic_t       _chan_in_use;   /* one bulk channel at a time */
+static volatile bool  _connected;
+
+static void chan_connected(struct bt_l2cap_chan *chan)
+{
+    ARG_UNUSED(chan);
+    _connected = true;
+    LOG_INF("Bulk channel open: tx mtu %u, mps %u", _chan.tx.mtu, _chan.tx.mps);
+}
+
+static void chan_disconnected(struct bt_l2cap_chan *chan)
+{
+    ARG_UNUSED(chan);
+    _connected = false;
+    atomic_clear(&_chan_in_use);
+    LOG_INF("Bulk channel closed");
+}
+
+static int chan_recv(struct bt_l2cap_chan *chan, struct net_buf *buf)
+{
+    ARG_UNUSED(chan); ARG_UNUSED(buf);
+    /* Commands go over the control characteristic; nothing to read here */
+    return 0;
+}
+
+static const struct bt_l2cap_chan_ops _chan_ops = {
+    .connected    = chan_connected,
+    .disconnected = chan_disconnected,
+    .recv         = chan_recv,
+};
+
+static int server_accept(struct bt_conn *conn, struct bt_l2cap_server *server,
+                         struct bt_l2cap_chan **chan)
+{
+    ARG_UNUSED(conn); ARG_UNUSED(server);
+
+    if (!atomic_cas(&_chan_in_use, 0, 1)) {
+        LOG_WRN("Bulk channel already open; rejecting");
+        return -ENOMEM;
+    }
+
+    memset(&_chan, 0, sizeof(_chan));
+    _chan.chan.ops = &_chan_ops;
+    *chan = &_chan.chan;
+    return 0;
+}
+
+static struct bt_l2cap_server _server = {
+    .psm       = RECLO_L2CAP_PSM,
+    .sec_level = BT_SECURITY_L1,
+    .accept    = server_accept,
+};
+
+/* ── Public API ──────────────────────────────────────────────────────────────*/
+
+int reclo_l2cap_init(void)
+{
+    int err = bt_l2cap_server_register(&_server);
+    if (err) {
+        LOG_ERR("bt_l2cap_server_register(0x%04x): %d", RECLO_L2CAP_PSM, err);
+        return err;
+    }
+    LOG_INF("Bulk upload channel on PSM 0x%04x", RECLO_L2CAP_PSM);
+    return 0;
+}
+
+bool reclo_l2cap_connected(void)
+{
+    return _connected;
+}
+
+uint16_t reclo_l2cap_sdu_max(void)
+{
+    return _connected ? reclo_l2cap_sdu_fit(MIN(_chan.tx.mtu, RECLO_L2CAP_SDU_MAX), _chan.tx.mps) : 0;
+}
+
+int reclo_l2cap_send(const void *data, uint16_t len)
+{
+    if (!_connected) return -ENOTCONN;
+
+    struct net_buf *buf = net_buf_alloc(&_sdu_pool, SDU_ALLOC_TIMEOUT);
+    if (!buf) {
+        LOG_ERR("Bulk channel stalled: no SDU sent in 5 s");
+        return -ETIMEDOUT;
+    }
+
+    net_buf_reserve(buf, BT_L2CAP_SDU_CHAN_SEND_RESERVE);
+    net_buf_add_mem(buf, data, len);
+
+    int err = bt_l2cap_chan_send(&_chan.chan, buf);
+    if (err < 0) {
+        LOG_ERR("bt_l2cap_chan_send: %d", err);
+        net_buf_unref(buf);
+        return err;
+    }
+    return 0;
+}
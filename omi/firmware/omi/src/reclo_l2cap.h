@@ -0,0 +1,78 @@
+#ifndef RECLO_L2CAP_H
+#define RECLO_L2CAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+
+/*
+ * reclo_l2cap — optional LE L2CAP connection-oriented channel for bulk
+ * chunk upload (CONFIG_OMI_RECLO_L2CAP).
+ *
+ * The device listens on RECLO_L2CAP_PSM, which it also publishes through the
+ * RecLo service's PSM characteristic (0 when the mode is compiled out). If
+ * the phone has the channel open when it sends REQUEST_UPLOAD, the batch is
+ * streamed over it instead of GATT notifications: the same v2 packets
+ * (reclo_transfer.h), but each DATA packet is one SDU of up to
+ * RECLO_L2CAP_SDU_MAX bytes, which the stack segments into PDUs and paces
+ * with the channel's own credits. Control commands (ACK, NACK, ABORT) still
+ * go through the control characteristic.
+ */
+
+/* LE PSM in the dynamic range (0x0080–0x00FF) */
+#define RECLO_L2CAP_PSM      0x00C5
+
+/* Largest SDU sent; a 30 s chunk is about 60 of these */
+#define RECLO_L2CAP_SDU_MAX  2048
+
+/* Bytes ahead of an SDU's data in its first K-frame */
+#define RECLO_L2CAP_SDU_HDR  2
+
+/**
+ * Largest SDU of at most @p mtu bytes whose K-frames are all full: the SDU
+ * and its length field in a whole number of @p mps segments. A short last
+ * segment still takes a whole LL PDU, so at MPS 247 a 2048-byte SDU needs
+ * nine PDUs where 1974 bytes need eight (see host_test/test_transfer_l2cap.c).
+ */
+static inline uint16_t reclo_l2cap_sdu_fit(uint16_t mtu, uint16_t mps)
+{
+    if (mps == 0 || mtu + RECLO_L2CAP_SDU_HDR < mps) {
+        return mtu;
+    }
+    return (uint16_t)((mtu + RECLO_L2CAP_SDU_HDR) / mps * mps - RECLO_L2CAP_SDU_HDR);
+}
+
+#ifdef CONFIG_OMI_RECLO_L2CAP
+
+/** Register the L2CAP server. Call once after bt_enable(). */
+int reclo_l2cap_init(void);
+
+/** True while the phone has the bulk channel open. */
+bool reclo_l2cap_connected(void);
+
+/** SDU size for the open channel: what it accepts, capped at
+ *  RECLO_L2CAP_SDU_MAX and fitted to its MPS; 0 when it is closed. */
+uint16_t reclo_l2cap_sdu_max(void);
+
+/**
+ * Queue one SDU. Blocks while every SDU buffer is still in flight.
+ *
+ * @return 0 on success, -ENOTCONN if the channel is closed, -ETIMEDOUT if
+ *         no buffer was released in time, or the stack's error.
+ */
+int reclo_l2cap_send(const void *data, uint16_t len);
+
+#else
+
+static inline int reclo_l2cap_init(void) { return 0; }
+static inline bool reclo_l2cap_connected(void) { return false; }
+static inline uint16_t reclo_l2cap_sdu_max(void) { return 0; }
+static inline int reclo_l2cap_send(const void *data, uint16_t len)
+{
+    (void)data; (void)len;
+    return -ENOTSUP;
+}
+
+#endif /* CONFIG_OMI_RECLO_L2CAP */
+
+#endif /* RECLO_L2CAP_H */
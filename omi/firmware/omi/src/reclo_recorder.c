@@ -1,55 +1,168 @@
 #include "reclo_recorder.h"
+#include "reclo_index.h"
 #include "reclo_transfer.h"
 
 #include <zephyr/kernel.h>
 #include <zephyr/fs/fs.h>
 #include <zephyr/logging/log.h>
+#include <zephyr/sys/crc.h>
 #include <string.h>
 #include <stdio.h>
-#include <stdlib.h>
+#ifdef CONFIG_FAT_FILESYSTEM_ELM
+#include <ff.h>
+#endif
 
 #include "lib/core/codec.h"
+#if RECLO_PACKET_FRAMES > 1
+#include "lib/core/lib/opus-1.2.1/opus.h"
+#endif
 #include "rtc.h"
 
 LOG_MODULE_REGISTER(reclo_recorder, LOG_LEVEL_INF);
 
 /* ── State ──────────────────────────────────────────────────────────────────── */
 
+/* Writer-side state: only touched from the reclo_flush thread. */
 static struct fs_file_t _active_file;
 static bool             _file_open;
-static uint8_t          _write_buf[RECLO_STREAM_BUF_SIZE];
-static size_t           _write_buf_len;
-static uint32_t         _total_bytes_in_chunk;
+static uint32_t         _file_bytes;     /* bytes written, header included */
+static bool             _file_padded;    /* the last write ran on past _file_bytes */
+static uint16_t         _hdr_size;       /* offset of the open chunk's data */
+static uint8_t          _hdr_sector[RECLO_SECTOR_SIZE] __aligned(4); /* first sector as written */
 static char             _active_path[64];
 static uint32_t         _chunk_start_ts;
-static bool             _recording;
-
 static bool             _chunk_unsynced; /* true when _chunk_start_ts is uptime-s, not UTC */
+static uint32_t         _chunk_crc;      /* running CRC-32 of the data written so far */
+static bool             _chunk_has_levels; /* chunk began at a level-track boundary */
+static uint32_t         _dropped_at_chunk_start;
+static uint32_t         _silent_at_chunk_start;
+static struct codec_settings _chunk_enc; /* encoder settings at chunk open */
+static bool             _chunk_enc_changed;
+
+/* Receive-side state: the slot currently being filled, guarded by _mutex.
+ * _mutex is never held across an fs_* call, so the reclo_rx thread only ever
+ * waits for a memcpy. */
+static uint8_t          _slots[RECLO_WRITE_SLOTS][RECLO_STREAM_BUF_SIZE] __aligned(RECLO_SECTOR_SIZE);
+static size_t           _slot_len[RECLO_WRITE_SLOTS];
+static int              _active_slot;    /* -1 when no slot is claimed */
+static bool             _reserve_header; /* next slot starts a new chunk file */
+
+/* Record layout of each slot, so the writer can start a new chunk file part
+ * way through the stream after a failed write or open, and count what it
+ * had to throw away. Filled by the reclo_rx thread before the slot is
+ * queued. */
+#define SLOT_NO_RECORD  RECLO_STREAM_BUF_SIZE
+
+struct slot_meta {
+    uint16_t first_rec;    /* offset of the first record starting here */
+    uint32_t frames;       /* frames in the records starting here */
+    uint32_t head_frames;  /* frames in the record continued from the slot before */
+    bool     hdr;          /* starts with the space reserved for a chunk header */
+};
+static struct slot_meta _slot_meta[RECLO_WRITE_SLOTS];
+
+static volatile bool    _recording;
+static atomic_t         _rotate_pending;
+static atomic_t         _dropped_frames;
+static atomic_t         _silent_frames;  /* frames replaced by silence runs */
+static int              _codec_sub = -1; /* codec output bus subscription */
+
+/* Requests consumed by the writer thread, in order. */
+enum write_op {
+    WRITE_OP_SLOT,         /* write _slots[slot] to the open file, then free it */
+    WRITE_OP_ROTATE,       /* finalise the open chunk and open the next one     */
+    WRITE_OP_OPEN,         /* as ROTATE, but acknowledged via _writer_ack        */
+    WRITE_OP_CLOSE,        /* finalise the open chunk; acknowledged              */
+                           /* ROTATE and CLOSE pass the chunk's level track in
+                            * the slot field                                   */
+    WRITE_OP_RETIMESTAMP,  /* patch the open chunk's uptime ts to UTC            */
+};
+
+struct write_req {
+    uint8_t op;
+    uint8_t slot;
+};
+
+/* Free-slot indices and writer requests. The reclo_rx thread only ever uses
+ * K_NO_WAIT on these, so it can never block behind the SD card. The request
+ * queue holds every slot plus headroom for control requests. */
+K_MSGQ_DEFINE(_free_q,  sizeof(uint8_t),          RECLO_WRITE_SLOTS,     1);
+K_MSGQ_DEFINE(_write_q, sizeof(struct write_req), RECLO_WRITE_SLOTS + 4, 1);
 
 static K_MUTEX_DEFINE(_mutex);
-static K_TIMER_DEFINE(_chunk_timer, NULL, NULL);
+static K_SEM_DEFINE(_writer_ack, 0, 1);
 static struct k_work    _retimestamp_work;
 
+/* Level tracks (see reclo_chunk_hdr.h). The reclo_rx thread fills one while
+ * the writer finalises the chunk that used the other, so a track is only
+ * overwritten if the writer falls a whole chunk behind. */
+static uint8_t          _levels[2][RECLO_LEVEL_MAX];
+static uint16_t         _level_count[2];
+static uint8_t          _level_track;    /* track of the chunk being recorded */
+static uint64_t         _level_acc;      /* energy of the open window */
+static uint8_t          _level_frames;
+static bool             _level_gap;      /* frames dropped since the track began */
+
+static void chunk_timer_expiry(struct k_timer *timer)
+{
+    ARG_UNUSED(timer);
+    atomic_set(&_rotate_pending, 1);
+}
+
+static K_TIMER_DEFINE(_chunk_timer, chunk_timer_expiry, NULL);
+
 /* ── Header helper ───────────────────────────────────────────────────────────
- * Writes the 17-byte RCLO file header with data_size = 0.
- * reclo_transfer.c reads: magic[4] + ts[4] + codec_id[1] + sr[4] + data_size[4]
- * data_size (offset 13) is back-filled in finalize_chunk().
+ * Builds the RCLO file header for the open chunk (see reclo_chunk_hdr.h).
+ * Written with data_size = 0 and crc32 = 0 into the space the reclo_rx thread reserved
+ * at the start of the chunk's first slot (or on its own, for a chunk reopened
+ * after a write error); both are back-filled by
+ * finalize_chunk(), along with the encoder-changed flag and the level
+ * track (@p track, or -1 for none).
  */
-static void write_initial_header(struct fs_file_t *f, uint32_t ts)
+static void build_header(uint8_t *hdr, uint32_t data_size, uint32_t crc, int track)
 {
-    uint8_t hdr[17];
-    hdr[0] = 'R'; hdr[1] = 'C'; hdr[2] = 'L'; hdr[3] = 'O';
-    memcpy(&hdr[4], &ts, 4);
-    hdr[8] = 21;                   /* CODEC_ID — Omi consumer opusFS320 */
-    uint32_t sr = 16000U;
-    memcpy(&hdr[9], &sr, 4);
-    uint32_t ds = 0U;
-    memcpy(&hdr[13], &ds, 4);     /* placeholder; updated by finalize_chunk */
-    fs_write(f, hdr, sizeof(hdr));
+    struct reclo_chunk_hdr h = {
+        .ts               = _chunk_start_ts,
+        .codec_id         = 21,            /* CODEC_ID — Omi consumer opusFS320 */
+        .sample_rate      = 16000U,
+        .data_size        = data_size,
+        .crc32            = crc,
+        .enc_complexity   = _chunk_enc.complexity,
+        .enc_flags        = (_chunk_enc_changed ? RECLO_ENC_F_CHANGED : 0) |
+                            (_chunk_enc.low_power ? RECLO_ENC_F_LOW_POWER : 0) |
+                            (IS_ENABLED(CONFIG_OMI_RECLO_VAD) ? RECLO_ENC_F_VAD : 0),
+        .enc_bitrate_kbps = (uint16_t)(_chunk_enc.bitrate / 1000U),
+        .level_count      = track >= 0 ? _level_count[track] : 0,
+        .levels           = track >= 0 ? _levels[track] : NULL,
+        .packet_frames    = RECLO_PACKET_FRAMES,
+        .hdr_size         = _hdr_size,
+    };
+    reclo_chunk_hdr_encode(hdr, &h);
 }
 
-/* ── Open a new chunk file ───────────────────────────────────────────────────*/
+/* ── Preallocation ───────────────────────────────────────────────────────────
+ * Grows the new file's cluster chain to RECLO_CHUNK_PREALLOC_SIZE in one go.
+ * fs_truncate() would zero-fill the whole range, so on ELM FatFs this seeks
+ * past EOF directly (which allocates clusters without writing data) and
+ * rewinds. Best effort: on failure the file simply grows as it is written.
+ */
+static void preallocate_chunk_file(void)
+{
+#ifdef CONFIG_FAT_FILESYSTEM_ELM
+    FIL *fp = (FIL *)_active_file.filep;
+
+    FRESULT res = f_lseek(fp, RECLO_CHUNK_PREALLOC_SIZE);
+    if (res != FR_OK || f_tell(fp) != RECLO_CHUNK_PREALLOC_SIZE) {
+        LOG_WRN("Preallocate %s: res=%d, got %u bytes", _active_path, res,
+                (unsigned)f_tell(fp));
+    }
+    f_lseek(fp, 0);
+#endif
+}
 
+/* ── Open a new chunk file ───────────────────────────────────────────────────
+ * Writer thread only.
+ */
 static int open_chunk_file(uint32_t ts)
 {
     /* Always use uptime seconds as the chunk timestamp so that stale RTC
@@ -58,6 +171,11 @@ static int open_chunk_file(uint32_t ts)
     ARG_UNUSED(ts);
     bool unsynced = true;
     ts = (uint32_t)(k_uptime_get() / 1000);
+    /* A chunk reopened after a write error can start in the second the one
+     * it cut short did; keep their names apart */
+    if (_chunk_unsynced && ts <= _chunk_start_ts) {
+        ts = _chunk_start_ts + 1;
+    }
 
     struct fs_dirent ent;
     if (fs_stat(RECLO_STORAGE_DIR, &ent) != 0) {
@@ -75,113 +193,541 @@ static int open_chunk_file(uint32_t ts)
         return err;
     }
 
-    write_initial_header(&_active_file, ts);
-    _file_open            = true;
-    _chunk_unsynced       = unsynced;
-    _write_buf_len        = 0;
-    _total_bytes_in_chunk = 0;
-    _chunk_start_ts       = ts;
+    preallocate_chunk_file();
+    _file_open              = true;
+    _chunk_unsynced         = unsynced;
+    _file_bytes             = 0;
+    _file_padded            = false;
+    _hdr_size               = RECLO_FILE_HDR_SIZE;
+    _chunk_has_levels       = true;
+    _chunk_crc              = 0;
+    _chunk_start_ts         = ts;
+    _dropped_at_chunk_start = reclo_recorder_dropped_frames();
+    _silent_at_chunk_start  = (uint32_t)atomic_get(&_silent_frames);
+    _chunk_enc_changed      = false;
+    codec_get_settings(&_chunk_enc);
     return 0;
 }
 
 /* ── Finalise the current chunk file ─────────────────────────────────────────
- * Must be called with _mutex held.
+ * Writer thread only. Every slot queued before the request that triggered
+ * this has already been written, so the file is complete on entry.
  */
-static void finalize_chunk(void)
+static void finalize_chunk(int track)
 {
-    /* Flush any remaining RAM buffer */
-    if (_write_buf_len > 0) {
-        fs_write(&_active_file, _write_buf, _write_buf_len);
-        _write_buf_len = 0;
+    if (_file_bytes <= _hdr_size) {
+        /* No frame ever reached this chunk; don't publish an empty file */
+        fs_close(&_active_file);
+        _file_open = false;
+        fs_unlink(_active_path);
+        LOG_INF("Discarded empty chunk ts=%u", _chunk_start_ts);
+        return;
     }
 
-    /* Back-fill data_size at offset 13 so reclo_transfer can read it */
-    fs_seek(&_active_file, 13, FS_SEEK_SET);
-    fs_write(&_active_file, &_total_bytes_in_chunk,
-             sizeof(_total_bytes_in_chunk));
+    /* Back-fill data_size and crc32 so reclo_transfer can send the chunk
+     * header without reading the data. The whole first sector goes back, so
+     * the card is not asked to merge a partial one. */
+    uint32_t data_size = _file_bytes - _hdr_size;
+    build_header(_hdr_sector, data_size, _chunk_crc, _chunk_has_levels ? track : -1);
+    fs_seek(&_active_file, 0, FS_SEEK_SET);
+    fs_write(&_active_file, _hdr_sector, sizeof(_hdr_sector));
+
+    /* Release the unused tail of the preallocation and the last slot's
+     * padding */
+    fs_truncate(&_active_file, _file_bytes);
 
     fs_close(&_active_file);
     _file_open = false;
 
     /* Atomically publish the chunk.  Use .upt extension when the timestamp is
      * uptime-based (UTC was not synced); reclo_transfer ignores .upt files
-     * until reclo_recorder_retimestamp() renames them to .bin. */
+     * until reclo_recorder_retimestamp() renames them to .bin.
+     * The index entry is journaled first so that a crash before the rename
+     * shows up as a missing newest chunk and triggers a rescan on boot. */
+    uint8_t state = _chunk_unsynced ? RECLO_CHUNK_UNSYNCED : RECLO_CHUNK_READY;
     char final_path[64];
-    snprintf(final_path, sizeof(final_path),
-             "%s/%010u.%s", RECLO_STORAGE_DIR, _chunk_start_ts,
-             _chunk_unsynced ? "upt" : "bin");
+    reclo_index_chunk_path(final_path, sizeof(final_path), _chunk_start_ts, state);
+    reclo_index_add(_chunk_start_ts, state, _file_bytes);
     int rename_err = fs_rename(_active_path, final_path);
     if (rename_err) {
         LOG_ERR("fs_rename(%s → %s): %d", _active_path, final_path, rename_err);
+        reclo_index_remove(_chunk_start_ts);
+    }
+
+    uint32_t dropped = reclo_recorder_dropped_frames() - _dropped_at_chunk_start;
+    if (dropped > 0) {
+        LOG_WRN("Chunk ts=%u dropped %u frame(s): recorder fell behind or the card failed",
+                _chunk_start_ts, dropped);
     }
 
-    LOG_INF("Finalized chunk ts=%u (%u bytes) → %s%s",
-            _chunk_start_ts, _total_bytes_in_chunk, final_path,
+    uint32_t silent = (uint32_t)atomic_get(&_silent_frames) - _silent_at_chunk_start;
+
+    LOG_INF("Finalized chunk ts=%u (%u bytes, %u ms silence skipped) → %s%s",
+            _chunk_start_ts, data_size, silent * 20U, final_path,
             _chunk_unsynced ? " [unsynced]" : "");
 }
 
-/* ── Codec callback ──────────────────────────────────────────────────────────
- * Called by the Omi codec thread after each Opus frame is encoded.
- * Prepends a 2-byte LE length prefix, buffers the frame, and flushes
- * the 4KB buffer to the open SD card file when it gets full.
+/* ── Retimestamp the open chunk ──────────────────────────────────────────────
+ * Writer thread only. Patches the header and renames the .tmp file so that
+ * the chunk is published as .bin with its UTC start time.
+ *
+ *   real_ts = now_utc_s - (now_uptime_s - file_uptime_ts)
  */
-static void on_codec_output(uint8_t *data, size_t len)
+static void retimestamp_open_chunk(void)
 {
-    if (!_recording || len == 0 || len > UINT16_MAX) return;
+    if (!_file_open || !_chunk_unsynced) {
+        return;
+    }
 
-    k_mutex_lock(&_mutex, K_FOREVER);
+    uint32_t now_utc_s = get_utc_time();
+    if (now_utc_s == 0) {
+        return;
+    }
+    uint32_t now_up_s  = (uint32_t)(k_uptime_get() / 1000);
+    uint32_t uptime_ts = _chunk_start_ts;
+    uint32_t elapsed   = (now_up_s >= uptime_ts) ? (now_up_s - uptime_ts) : 0;
+    uint32_t real_ts   = now_utc_s - elapsed;
+
+    /* Patch the header timestamp, a whole sector as in finalize_chunk(). If
+     * the first slot has not been written yet, build_header() will pick up
+     * real_ts. */
+    if (_file_bytes > 0) {
+        memcpy(&_hdr_sector[RECLO_FILE_OFF_TS], &real_ts, sizeof(real_ts));
+        fs_seek(&_active_file, 0, FS_SEEK_SET);
+        fs_write(&_active_file, _hdr_sector, sizeof(_hdr_sector));
+    }
 
-    if (!_file_open) {
-        k_mutex_unlock(&_mutex);
+    /* Close → rename → reopen (FAT FS requires file closed for rename) */
+    fs_close(&_active_file);
+
+    char new_path[64];
+    snprintf(new_path, sizeof(new_path),
+             "%s/%010u.tmp", RECLO_STORAGE_DIR, real_ts);
+
+    if (fs_rename(_active_path, new_path) == 0) {
+        memcpy(_active_path, new_path, sizeof(_active_path));
+    } else {
+        LOG_ERR("retimestamp: rename open file failed");
+    }
+
+    fs_file_t_init(&_active_file);
+    int err = fs_open(&_active_file, _active_path, FS_O_WRITE);
+    if (err) {
+        LOG_ERR("retimestamp: reopen %s failed: %d", _active_path, err);
+        _file_open = false;
+    } else {
+        /* Not FS_SEEK_END: the file still spans the preallocated size */
+        fs_seek(&_active_file, _file_bytes, FS_SEEK_SET);
+        _file_padded = false;
+    }
+
+    _chunk_start_ts = real_ts;
+    _chunk_unsynced = false;
+    LOG_INF("Retimestamped open chunk: uptime=%u → utc=%u", uptime_ts, real_ts);
+}
+
+/* ── Slot hand-off (receive side) ────────────────────────────────────────────
+ * Must be called with _mutex held. Never blocks.
+ */
+static bool claim_slot(void)
+{
+    uint8_t idx;
+    if (k_msgq_get(&_free_q, &idx, K_NO_WAIT) != 0) {
+        return false;
+    }
+    _active_slot   = idx;
+    _slot_len[idx] = 0;
+    _slot_meta[idx] = (struct slot_meta){ .first_rec = SLOT_NO_RECORD };
+    return true;
+}
+
+static void submit_active_slot(void)
+{
+    if (_active_slot < 0 || _slot_len[_active_slot] == 0) {
         return;
     }
 
-    /* Guard: a single frame larger than the buffer can never be buffered */
-    if (2 + len > RECLO_STREAM_BUF_SIZE) {
-        LOG_WRN("Frame too large for write buffer (%zu bytes); dropping", len);
-        k_mutex_unlock(&_mutex);
+    struct write_req req = { .op = WRITE_OP_SLOT, .slot = (uint8_t)_active_slot };
+    if (k_msgq_put(&_write_q, &req, K_NO_WAIT) != 0) {
+        /* Cannot happen while the queue is sized for every slot, but never
+         * leak a slot if it does. */
+        LOG_ERR("Write queue full; discarding %zu bytes", _slot_len[_active_slot]);
+        k_msgq_put(&_free_q, &req.slot, K_NO_WAIT);
+    }
+    _active_slot = -1;
+}
+
+/* Bytes that can be appended right now without waiting for the writer.
+ * Only the reclo_rx thread takes from _free_q, so this can only grow. */
+static size_t slot_capacity(void)
+{
+    size_t room = (_active_slot < 0) ? 0 : RECLO_STREAM_BUF_SIZE - _slot_len[_active_slot];
+    return room + k_msgq_num_used_get(&_free_q) * RECLO_STREAM_BUF_SIZE;
+}
+
+/* Append bytes across slot boundaries, queueing each slot as soon as it is
+ * full so every full-slot write is sector-aligned. The caller has checked
+ * slot_capacity(). */
+static void append_bytes(const uint8_t *src, size_t n)
+{
+    while (n > 0) {
+        if (_active_slot < 0) {
+            claim_slot();
+        }
+        size_t room = RECLO_STREAM_BUF_SIZE - _slot_len[_active_slot];
+        size_t take = MIN(room, n);
+
+        memcpy(&_slots[_active_slot][_slot_len[_active_slot]], src, take);
+        _slot_len[_active_slot] += take;
+        src += take;
+        n   -= take;
+
+        if (_slot_len[_active_slot] == RECLO_STREAM_BUF_SIZE) {
+            submit_active_slot();
+        }
+    }
+}
+
+/* Queue a control request for the writer and wait for it to complete.
+ * Not for use from the reclo_rx thread. */
+static void submit_op_sync(enum write_op op, uint8_t arg)
+{
+    struct write_req req = { .op = (uint8_t)op, .slot = arg };
+    k_msgq_put(&_write_q, &req, K_FOREVER);
+    k_sem_take(&_writer_ack, K_FOREVER);
+}
+
+/* Append one [len:2 LE][bytes] record carrying @p frames frames, reserving
+ * the chunk header first when the record starts a new chunk. Records are
+ * all-or-nothing: never queue half of one. reclo_rx thread, _mutex held. */
+static bool append_record(uint16_t prefix_len, const uint8_t *data, size_t len, uint16_t frames)
+{
+    size_t need = 2 + len + (_reserve_header ? RECLO_FILE_HDR_SIZE : 0);
+    if (slot_capacity() < need) {
+        return false;
+    }
+
+    /* First bytes of a new chunk: leave room for the writer to fill the
+     * header, keeping the file and slot boundaries aligned. */
+    if (_reserve_header) {
+        static const uint8_t zero_hdr[RECLO_FILE_HDR_SIZE];
+        append_bytes(zero_hdr, sizeof(zero_hdr));
+        _slot_meta[_active_slot].hdr = true;
+        _reserve_header = false;
+    }
+
+    if (_active_slot < 0) {
+        claim_slot();
+    }
+    struct slot_meta *start = &_slot_meta[_active_slot];
+    if (start->first_rec == SLOT_NO_RECORD) {
+        start->first_rec = (uint16_t)_slot_len[_active_slot];
+    }
+    start->frames += frames;
+    bool spills = 2 + len > RECLO_STREAM_BUF_SIZE - _slot_len[_active_slot];
+
+    uint8_t prefix[2] = { (uint8_t)(prefix_len & 0xFF), (uint8_t)(prefix_len >> 8) };
+    append_bytes(prefix, sizeof(prefix));
+    append_bytes(data, len);
+
+    /* A record is far shorter than a slot, so the one it spilled into is
+     * still being filled */
+    if (spills && _active_slot >= 0) {
+        _slot_meta[_active_slot].head_frames = frames;
+    }
+    return true;
+}
+
+/* Count frames that found no room in the slots; the chunk's level track no
+ * longer lines up with its audio. reclo_rx thread, _mutex held. */
+static void drop_frames(uint32_t frames)
+{
+    atomic_add(&_dropped_frames, frames);
+    _level_gap = true;
+}
+
+/* ── Packet assembly ─────────────────────────────────────────────────────────
+ * With RECLO_PACKET_FRAMES above 1, consecutive 20 ms frames are merged by
+ * the Opus repacketizer into one 40 or 60 ms packet per record, which saves
+ * the length prefix and TOC byte of all but the first. A frame whose TOC
+ * does not match the ones held (the governor moved the bandwidth) closes
+ * the packet early, as do silence runs and chunk boundaries.
+ * reclo_rx thread, _mutex held.
+ */
+#if RECLO_PACKET_FRAMES > 1
+
+#define PACK_FRAME_MAX      160   /* CODEC_OUTPUT_MAX_BYTES */
+
+static uint8_t  _pack_frames[RECLO_PACKET_FRAMES][PACK_FRAME_MAX];
+/* Worst case for a VBR code-3 packet: TOC, count and a 2-byte length per
+ * frame but the last */
+static uint8_t  _pack_out[2 + 2 * (RECLO_PACKET_FRAMES - 1) + RECLO_PACKET_FRAMES * PACK_FRAME_MAX];
+static uint8_t  _pack_rp_mem[512] __aligned(4);
+static OpusRepacketizer *_pack_rp;
+static uint8_t  _pack_count;           /* frames held in _pack_rp */
+
+static void pack_init(void)
+{
+    __ASSERT_NO_MSG(opus_repacketizer_get_size() <= (int)sizeof(_pack_rp_mem));
+    _pack_rp    = opus_repacketizer_init((OpusRepacketizer *)_pack_rp_mem);
+    _pack_count = 0;
+}
+
+#endif
+
+/* Write out the frames held for the current packet. */
+static void pack_flush(void)
+{
+#if RECLO_PACKET_FRAMES > 1
+    if (_pack_count == 0) {
         return;
     }
+    opus_int32 len = opus_repacketizer_out(_pack_rp, _pack_out, sizeof(_pack_out));
+    if (len <= 0 || !append_record((uint16_t)len, _pack_out, (size_t)len, _pack_count)) {
+        drop_frames(_pack_count);
+    }
+    opus_repacketizer_init(_pack_rp);
+    _pack_count = 0;
+#endif
+}
 
-    /* Flush buffer to SD before it would overflow */
-    if (_write_buf_len + 2 + len > RECLO_STREAM_BUF_SIZE) {
-        fs_write(&_active_file, _write_buf, _write_buf_len);
-        _write_buf_len = 0;
+/* Store one encoded 20 ms frame. */
+static void store_frame(const uint8_t *data, size_t len)
+{
+#if RECLO_PACKET_FRAMES > 1
+    if (len <= PACK_FRAME_MAX) {
+        /* The repacketizer keeps pointers, so it is fed copies */
+        for (int attempt = 0; attempt < 2; attempt++) {
+            uint8_t *frame = _pack_frames[_pack_count];
+            memcpy(frame, data, len);
+            if (opus_repacketizer_cat(_pack_rp, frame, (opus_int32)len) == OPUS_OK) {
+                if (++_pack_count == RECLO_PACKET_FRAMES) {
+                    pack_flush();
+                }
+                return;
+            }
+            if (_pack_count == 0) {
+                break;
+            }
+            pack_flush();
+        }
+    }
+    pack_flush();
+#endif
+    if (!append_record((uint16_t)len, data, len, 1)) {
+        drop_frames(1);
     }
+}
+
+/* ── Silence suppression ─────────────────────────────────────────────────────
+ * With CONFIG_OMI_RECLO_VAD, frames the codec's VAD calls silent are not
+ * stored. The newest VAD_PREROLL_FRAMES of them are held back and written
+ * ahead of the next speech frame, so onsets keep their lead-in; older ones
+ * are only counted. The count goes out as a single silence-run record
+ * (see reclo_chunk_hdr.h) when speech resumes, the chunk rotates or
+ * recording stops. reclo_rx thread, _mutex held.
+ */
+#ifdef CONFIG_OMI_RECLO_VAD
 
-    /* Append 2-byte LE length prefix + frame bytes */
-    _write_buf[_write_buf_len]     = (uint8_t)(len & 0xFF);
-    _write_buf[_write_buf_len + 1] = (uint8_t)((len >> 8) & 0xFF);
-    _write_buf_len += 2;
-    memcpy(&_write_buf[_write_buf_len], data, len);
-    _write_buf_len        += len;
-    _total_bytes_in_chunk += (uint32_t)(2 + len);
+#define VAD_PREROLL_FRAMES  (CONFIG_OMI_RECLO_VAD_PREROLL_MS / 20)
+#define VAD_PREROLL_SLOTS   MAX(VAD_PREROLL_FRAMES, 1)
+#define VAD_FRAME_MAX       160   /* CODEC_OUTPUT_MAX_BYTES */
 
-    k_mutex_unlock(&_mutex);
+static uint8_t  _preroll[VAD_PREROLL_SLOTS][VAD_FRAME_MAX];
+static uint8_t  _preroll_len[VAD_PREROLL_SLOTS];
+static uint8_t  _preroll_head;         /* oldest held frame */
+static uint8_t  _preroll_count;
+static uint32_t _silent_run;           /* frames counted, not yet recorded */
+
+/* Write the pending silence run. If there is no room the frames are counted
+ * as dropped instead, exactly like frames that miss a full slot. */
+static void vad_flush_run(void)
+{
+    if (_silent_run > 0) {
+        pack_flush();
+    }
+    while (_silent_run > 0) {
+        uint16_t run    = (uint16_t)MIN(_silent_run, RECLO_SILENCE_RUN_MAX);
+        uint8_t  rec[2] = { (uint8_t)(run & 0xFF), (uint8_t)(run >> 8) };
+        if (append_record(RECLO_SILENCE_RUN_MARK, rec, sizeof(rec), run)) {
+            atomic_add(&_silent_frames, run);
+        } else {
+            drop_frames(run);
+        }
+        _silent_run -= run;
+    }
+}
+
+/* Close the current silent stretch: held frames become part of the run. */
+static void vad_end_run(void)
+{
+    _silent_run   += _preroll_count;
+    _preroll_count = 0;
+    vad_flush_run();
 }
 
-/* ── Chunk rotation ──────────────────────────────────────────────────────────
- * Finalises the current file and opens a new one.
- * Called by the flush thread every RECLO_CHUNK_DURATION_S seconds.
+/* Returns true when the frame was held back or counted. */
+static bool vad_hold_silent(const uint8_t *data, size_t len)
+{
+    if (len > VAD_FRAME_MAX) {
+        return false;
+    }
+    if (VAD_PREROLL_FRAMES == 0) {
+        _silent_run++;
+        return true;
+    }
+    if (_preroll_count == VAD_PREROLL_FRAMES) {
+        _preroll_head = (_preroll_head + 1) % VAD_PREROLL_SLOTS;
+        _preroll_count--;
+        _silent_run++;
+    }
+    uint8_t slot = (_preroll_head + _preroll_count) % VAD_PREROLL_SLOTS;
+    memcpy(_preroll[slot], data, len);
+    _preroll_len[slot] = (uint8_t)len;
+    _preroll_count++;
+    return true;
+}
+
+/* Speech is starting: record the run, then the held lead-in frames. */
+static void vad_release_preroll(void)
+{
+    vad_flush_run();
+    for (; _preroll_count > 0; _preroll_count--) {
+        uint8_t slot = _preroll_head;
+        store_frame(_preroll[slot], _preroll_len[slot]);
+        _preroll_head = (_preroll_head + 1) % VAD_PREROLL_SLOTS;
+    }
+}
+
+#endif /* CONFIG_OMI_RECLO_VAD */
+
+/* ── Level track ─────────────────────────────────────────────────────────────
+ * One byte per RECLO_LEVEL_WINDOW_MS, computed from every frame that
+ * reaches the recorder, silent ones included (they stay in the chunk's
+ * timeline as silence runs), so the track lines up with the stored audio.
+ * Frames the codec bus dropped reach neither. A chunk that loses frames
+ * here for want of a write slot gets no track, since everything after the
+ * gap would be misplaced. reclo_rx thread, _mutex held.
  */
-static void rotate_chunk(void)
+#define LEVEL_WINDOW_FRAMES  (RECLO_LEVEL_WINDOW_MS / 20)
+
+static void level_close_window(void)
+{
+    if (_level_frames == 0) {
+        return;
+    }
+    uint16_t *count = &_level_count[_level_track];
+    if (*count < RECLO_LEVEL_MAX) {
+        _levels[_level_track][(*count)++] =
+            reclo_level_from_energy((uint32_t)(_level_acc / _level_frames));
+    }
+    _level_acc    = 0;
+    _level_frames = 0;
+}
+
+static void level_add_frame(uint32_t energy)
 {
+    _level_acc += energy;
+    if (++_level_frames == LEVEL_WINDOW_FRAMES) {
+        level_close_window();
+    }
+}
+
+/* The chunk is ending: close its track and start the next one. Returns the
+ * closed track for the writer. */
+static uint8_t level_rotate(void)
+{
+    level_close_window();
+    uint8_t done = _level_track;
+    if (_level_gap) {
+        _level_count[done] = 0;
+        _level_gap         = false;
+    }
+    _level_track ^= 1;
+    _level_count[_level_track] = 0;
+    return done;
+}
+
+/* ── Codec output ────────────────────────────────────────────────────────────
+ * Called on the reclo_rx thread for each Opus frame taken off the codec bus.
+ * Prepends a 2-byte LE length prefix and appends the frame to the slot
+ * stream. Full slots are queued to the writer thread; no SD I/O happens here.
+ */
+static void on_codec_output(const struct codec_packet *pkt)
+{
+    const uint8_t *data = pkt->data;
+    size_t         len  = pkt->len;
+
+    if (len == 0 || len >= RECLO_SILENCE_RUN_MARK) return;
+
     k_mutex_lock(&_mutex, K_FOREVER);
 
-    if (_file_open) {
-        finalize_chunk();
+    /* Checked under the mutex so no frame lands behind stop()'s close */
+    if (!_recording) {
+        k_mutex_unlock(&_mutex);
+        return;
     }
 
-    uint32_t ts = get_utc_time();
-    int err = open_chunk_file(ts);
-    if (err) {
-        LOG_ERR("rotate: failed to open next chunk: %d", err);
+    /* Chunk timer fired: queue what we have, then the rotation, so the
+     * chunk boundary lands exactly between two frames. */
+    if (atomic_cas(&_rotate_pending, 1, 0)) {
+#ifdef CONFIG_OMI_RECLO_VAD
+        vad_end_run();
+#endif
+        pack_flush();
+        submit_active_slot();
+        struct write_req req = { .op = WRITE_OP_ROTATE, .slot = _level_track };
+        if (k_msgq_put(&_write_q, &req, K_NO_WAIT) == 0) {
+            level_rotate();
+            _reserve_header = true;
+        } else {
+            atomic_set(&_rotate_pending, 1);   /* retry on the next frame */
+        }
+    }
+
+    level_add_frame(pkt->energy);
+
+#ifdef CONFIG_OMI_RECLO_VAD
+    if (!pkt->voiced && vad_hold_silent(data, len)) {
+        k_mutex_unlock(&_mutex);
+        return;
     }
+    vad_release_preroll();
+#endif
+
+    store_frame(data, len);
 
     k_mutex_unlock(&_mutex);
 }
 
-/* ── Flush thread ────────────────────────────────────────────────────────────*/
+/* ── Codec bus thread ────────────────────────────────────────────────────────
+ * Drains the recorder's codec subscription. Frames arriving while the
+ * recorder is stopped are released unused.
+ */
+
+#define RX_THREAD_STACK  2048
+#define RX_THREAD_PRIO   7
+
+K_THREAD_STACK_DEFINE(_rx_stack, RX_THREAD_STACK);
+static struct k_thread _rx_thread;
+
+static void rx_thread_fn(void *a, void *b, void *c)
+{
+    ARG_UNUSED(a); ARG_UNUSED(b); ARG_UNUSED(c);
+
+    while (true) {
+        struct codec_packet *pkt = codec_packet_get(_codec_sub, K_FOREVER);
+        if (pkt) {
+            on_codec_output(pkt);
+            codec_packet_release(pkt);
+        }
+    }
+}
+
+/* ── Writer thread ───────────────────────────────────────────────────────────
+ * Sole owner of the open chunk file. Drains _write_q in order, so slot data
+ * and chunk rotations are applied exactly as the reclo_rx thread queued them.
+ */
 
 #define FLUSH_THREAD_STACK  4096
 #define FLUSH_THREAD_PRIO   6
@@ -189,15 +735,157 @@ static void rotate_chunk(void)
 K_THREAD_STACK_DEFINE(_flush_stack, FLUSH_THREAD_STACK);
 static struct k_thread _flush_thread;
 
+/* The open chunk cannot go on past a failed write: the next slot would land
+ * mid-record. Publish what was written (readers stop at a cut-off final
+ * record) and count the slot's frames as dropped; the next slot starts a new
+ * chunk file. */
+static void fail_chunk(uint8_t slot, int err)
+{
+    LOG_ERR("fs_write(%s): %d; closing chunk ts=%u early", _active_path, err, _chunk_start_ts);
+    atomic_add(&_dropped_frames, _slot_meta[slot].frames + _slot_meta[slot].head_frames);
+    finalize_chunk(-1);
+}
+
+/* Write @p slot whole; the CRC covers it from @p data_off. A slot that ends
+ * short is the chunk's last, and goes out padded to a whole sector that
+ * finalize_chunk() trims off again. */
+static void write_slot_bytes(uint8_t slot, size_t data_off)
+{
+    size_t len  = _slot_len[slot];
+    size_t want = ROUND_UP(len, RECLO_SECTOR_SIZE);
+
+    if (_file_padded) {
+        /* The chunk went on after all (its rotation could not be queued):
+         * write over the padding */
+        fs_seek(&_active_file, _file_bytes, FS_SEEK_SET);
+        _file_padded = false;
+    }
+
+    memset(&_slots[slot][len], 0, want - len);
+    ssize_t n = fs_write(&_active_file, _slots[slot], want);
+    if (n != (ssize_t)want) {
+        fail_chunk(slot, n < 0 ? (int)n : -ENOSPC);
+        return;
+    }
+    if (_file_bytes < RECLO_SECTOR_SIZE) {
+        memcpy(&_hdr_sector[_file_bytes], _slots[slot], MIN(want, RECLO_SECTOR_SIZE - _file_bytes));
+    }
+    if (len > data_off) {
+        _chunk_crc = crc32_ieee_update(_chunk_crc, &_slots[slot][data_off], len - data_off);
+    }
+    _file_bytes += (uint32_t)len;
+    _file_padded = want > len;
+}
+
+static void write_slot(uint8_t slot)
+{
+    const struct slot_meta *meta = &_slot_meta[slot];
+
+    /* No file after a failed write or a failed rotation: retry the open.
+     * A slot holding no record start carries only the tail of a lost one. */
+    if (!_file_open && meta->first_rec != SLOT_NO_RECORD) {
+        int err = open_chunk_file(get_utc_time());
+        if (err) {
+            LOG_ERR("Still no chunk file (%d); slot discarded", err);
+        } else {
+            /* The level track only lines up with a chunk begun at a boundary */
+            _chunk_has_levels = meta->hdr;
+        }
+    }
+
+    if (!_file_open) {
+        atomic_add(&_dropped_frames, meta->frames);
+    } else if (_file_bytes > 0) {
+        write_slot_bytes(slot, 0);
+    } else if (meta->hdr) {
+        /* The first slot of a chunk starts with the reserved header */
+        build_header(_slots[slot], 0, 0, -1);
+        write_slot_bytes(slot, RECLO_FILE_HDR_SIZE);
+    } else {
+        /* Reopened part way through the stream: the data starts at the
+         * slot's first whole record, and the header takes the place of what
+         * comes before it, with a sector of its own in front when that is
+         * too short. Either way the slot stays sector-aligned in the file;
+         * readers find the data by hdr_size. */
+        memset(_slots[slot], 0, meta->first_rec);
+        if (meta->first_rec >= RECLO_FILE_HDR_SIZE) {
+            _hdr_size = meta->first_rec;
+            build_header(_slots[slot], 0, 0, -1);
+            write_slot_bytes(slot, meta->first_rec);
+        } else {
+            _hdr_size = RECLO_SECTOR_SIZE + meta->first_rec;
+            memset(_hdr_sector, 0, sizeof(_hdr_sector));
+            build_header(_hdr_sector, 0, 0, -1);
+            if (fs_write(&_active_file, _hdr_sector, sizeof(_hdr_sector)) != (ssize_t)sizeof(_hdr_sector)) {
+                fail_chunk(slot, -EIO);
+            } else {
+                _file_bytes = RECLO_SECTOR_SIZE;
+                write_slot_bytes(slot, meta->first_rec);
+            }
+        }
+    }
+
+    if (_file_open) {
+        /* Note a governor step inside the chunk so the header can flag it */
+        struct codec_settings enc;
+        codec_get_settings(&enc);
+        if (enc.complexity != _chunk_enc.complexity || enc.bitrate != _chunk_enc.bitrate) {
+            _chunk_enc_changed = true;
+        }
+    }
+
+    _slot_len[slot] = 0;
+    k_msgq_put(&_free_q, &slot, K_NO_WAIT);
+}
+
+static void handle_write_req(const struct write_req *req)
+{
+    switch (req->op) {
+    case WRITE_OP_SLOT:
+        write_slot(req->slot);
+        break;
+
+    case WRITE_OP_ROTATE:
+    case WRITE_OP_OPEN: {
+        if (_file_open) {
+            finalize_chunk(req->slot);
+        }
+        int err = open_chunk_file(get_utc_time());
+        if (err) {
+            /* write_slot() retries with the chunk's first slot */
+            LOG_ERR("rotate: failed to open next chunk: %d", err);
+        }
+        if (req->op == WRITE_OP_OPEN) {
+            k_sem_give(&_writer_ack);
+        }
+        break;
+    }
+
+    case WRITE_OP_CLOSE:
+        if (_file_open) {
+            finalize_chunk(req->slot);
+        }
+        k_sem_give(&_writer_ack);
+        break;
+
+    case WRITE_OP_RETIMESTAMP:
+        retimestamp_open_chunk();
+        break;
+
+    default:
+        break;
+    }
+}
+
 static void flush_thread_fn(void *a, void *b, void *c)
 {
     ARG_UNUSED(a); ARG_UNUSED(b); ARG_UNUSED(c);
 
+    struct write_req req;
+
     while (true) {
-        k_timer_status_sync(&_chunk_timer);
-        if (_recording) {
-            rotate_chunk();
-        }
+        k_msgq_get(&_write_q, &req, K_FOREVER);
+        handle_write_req(&req);
     }
 }
 
@@ -207,9 +895,14 @@ static void flush_thread_fn(void *a, void *b, void *c)
  * For any chunk recorded while UTC was unsynced:
  *   real_ts = now_utc_s - (now_uptime_s - file_uptime_ts)
  *
- * Handles both the currently-open .tmp file and any finalized .upt files.
+ * The currently-open .tmp file is owned by the writer thread, so it is
+ * patched there via WRITE_OP_RETIMESTAMP; finalized .upt files are renamed
+ * here on the system work queue.
  */
 
+/* System work queue only */
+static uint8_t _patch_sector[RECLO_SECTOR_SIZE] __aligned(4);
+
 static void reclo_recorder_retimestamp(void)
 {
     uint32_t now_utc_s = get_utc_time();
@@ -218,108 +911,56 @@ static void reclo_recorder_retimestamp(void)
     }
     uint32_t now_up_s = (uint32_t)(k_uptime_get() / 1000);
 
-    /* ── Patch the currently-open chunk file if it was unsynced ─────────── */
-    k_mutex_lock(&_mutex, K_FOREVER);
-
-    if (_file_open && _chunk_unsynced) {
-        uint32_t uptime_ts = _chunk_start_ts;
-        uint32_t elapsed   = (now_up_s >= uptime_ts) ? (now_up_s - uptime_ts) : 0;
-        uint32_t real_ts   = now_utc_s - elapsed;
-
-        /* Flush write buffer before closing */
-        if (_write_buf_len > 0) {
-            fs_write(&_active_file, _write_buf, _write_buf_len);
-            _write_buf_len = 0;
-        }
-
-        /* Patch timestamp at file header offset 4 */
-        fs_seek(&_active_file, 4, FS_SEEK_SET);
-        fs_write(&_active_file, &real_ts, sizeof(real_ts));
-
-        /* Close → rename → reopen (FAT FS requires file closed for rename) */
-        fs_close(&_active_file);
-
-        char new_path[64];
-        snprintf(new_path, sizeof(new_path),
-                 "%s/%010u.tmp", RECLO_STORAGE_DIR, real_ts);
-
-        if (fs_rename(_active_path, new_path) == 0) {
-            memcpy(_active_path, new_path, sizeof(_active_path));
-        } else {
-            LOG_ERR("retimestamp: rename open file failed");
-        }
-
-        fs_file_t_init(&_active_file);
-        int err = fs_open(&_active_file, _active_path, FS_O_WRITE);
-        if (err) {
-            LOG_ERR("retimestamp: reopen %s failed: %d", _active_path, err);
-            _file_open = false;
-        } else {
-            fs_seek(&_active_file, 0, FS_SEEK_END);
-        }
-
-        _chunk_start_ts = real_ts;
-        _chunk_unsynced = false;
-        LOG_INF("Retimestamped open chunk: uptime=%u → utc=%u", uptime_ts, real_ts);
+    /* ── Ask the writer to patch the currently-open chunk ───────────────── */
+    struct write_req req = { .op = WRITE_OP_RETIMESTAMP };
+    if (k_msgq_put(&_write_q, &req, K_NO_WAIT) != 0) {
+        LOG_WRN("retimestamp: write queue full; open chunk stays unsynced");
     }
 
-    k_mutex_unlock(&_mutex);
-
-    /* ── Scan for .upt files; collect then rename outside enumeration ────── */
-    static uint32_t upt_ts[RECLO_MAX_CHUNKS];
-    int upt_count = 0;
+    /* ── Rename finalized .upt chunks, oldest first ────────────────────── */
+    struct reclo_chunk_info info;
+    uint32_t from_ts = 0;
+    int      renamed = 0;
 
-    struct fs_dir_t  dir;
-    struct fs_dirent ent;
-    fs_dir_t_init(&dir);
-
-    if (fs_opendir(&dir, RECLO_STORAGE_DIR) == 0) {
-        while (upt_count < RECLO_MAX_CHUNKS &&
-               fs_readdir(&dir, &ent) == 0 && ent.name[0] != '\0') {
-            size_t nlen = strlen(ent.name);
-            /* Expect exactly "0123456789.upt" = 14 chars */
-            if (ent.type == FS_DIR_ENTRY_FILE && nlen == 14 &&
-                strcmp(ent.name + 10, ".upt") == 0) {
-                char ts_str[11];
-                memcpy(ts_str, ent.name, 10);
-                ts_str[10] = '\0';
-                upt_ts[upt_count++] = (uint32_t)strtoul(ts_str, NULL, 10);
-            }
-        }
-        fs_closedir(&dir);
-    }
+    while (reclo_index_find_from(RECLO_CHUNK_UNSYNCED, from_ts, &info) == 0) {
+        from_ts = info.ts + 1;
 
-    for (int i = 0; i < upt_count; i++) {
-        uint32_t elapsed = (now_up_s >= upt_ts[i]) ? (now_up_s - upt_ts[i]) : 0;
+        uint32_t elapsed = (now_up_s >= info.ts) ? (now_up_s - info.ts) : 0;
         uint32_t real_ts = now_utc_s - elapsed;
 
         char old_path[64], new_path[64];
-        snprintf(old_path, sizeof(old_path),
-                 "%s/%010u.upt", RECLO_STORAGE_DIR, upt_ts[i]);
-        snprintf(new_path, sizeof(new_path),
-                 "%s/%010u.bin", RECLO_STORAGE_DIR, real_ts);
+        reclo_index_chunk_path(old_path, sizeof(old_path), info.ts, RECLO_CHUNK_UNSYNCED);
+        reclo_index_chunk_path(new_path, sizeof(new_path), real_ts, RECLO_CHUNK_READY);
 
-        /* Patch timestamp in file header */
+        /* Patch timestamp in file header: read back and rewrite the first
+         * sector (or the whole file, if shorter) */
         struct fs_file_t f;
         fs_file_t_init(&f);
         if (fs_open(&f, old_path, FS_O_RDWR) == 0) {
-            fs_seek(&f, 4, FS_SEEK_SET);
-            fs_write(&f, &real_ts, sizeof(real_ts));
+            ssize_t n = fs_read(&f, _patch_sector, sizeof(_patch_sector));
+            if (n >= RECLO_FILE_OFF_TS + (ssize_t)sizeof(real_ts)) {
+                memcpy(&_patch_sector[RECLO_FILE_OFF_TS], &real_ts, sizeof(real_ts));
+                fs_seek(&f, 0, FS_SEEK_SET);
+                fs_write(&f, _patch_sector, (size_t)n);
+            }
             fs_close(&f);
         }
 
         int err = fs_rename(old_path, new_path);
         if (err) {
             LOG_ERR("retimestamp: %s → %s failed: %d", old_path, new_path, err);
+            if (err == -ENOENT) {
+                reclo_index_mark_inconsistent();
+            }
         } else {
-            LOG_INF("Retimestamped chunk: uptime=%u → utc=%u", upt_ts[i], real_ts);
+            reclo_index_retimestamp(info.ts, real_ts);
+            LOG_INF("Retimestamped chunk: uptime=%u → utc=%u", info.ts, real_ts);
+            renamed++;
         }
     }
 
-    /* If we hit the max array size, there might be more .upt files waiting.
-     * Resubmit the work item to process the next batch. */
-    if (upt_count == RECLO_MAX_CHUNKS) {
-        k_work_submit(&_retimestamp_work);
+    if (renamed > 0) {
+        LOG_INF("Retimestamped %d chunk(s)", renamed);
     }
 }
 
@@ -341,10 +982,24 @@ int reclo_recorder_init(void)
     _file_open            = false;
     _recording            = false;
     _chunk_unsynced       = false;
-    _write_buf_len        = 0;
-    _total_bytes_in_chunk = 0;
+    _active_slot          = -1;
+    _reserve_header       = false;
+    _file_bytes           = 0;
+
+    for (uint8_t i = 0; i < RECLO_WRITE_SLOTS; i++) {
+        _slot_len[i] = 0;
+        k_msgq_put(&_free_q, &i, K_NO_WAIT);
+    }
 
     k_work_init(&_retimestamp_work, retimestamp_work_fn);
+#if RECLO_PACKET_FRAMES > 1
+    pack_init();
+#endif
+
+    _codec_sub = codec_subscribe("reclo_recorder");
+    if (_codec_sub < 0) {
+        return _codec_sub;
+    }
 
     k_thread_create(
         &_flush_thread, _flush_stack, FLUSH_THREAD_STACK,
@@ -353,8 +1008,15 @@ int reclo_recorder_init(void)
     );
     k_thread_name_set(&_flush_thread, "reclo_flush");
 
-    LOG_INF("RecLo recorder initialized (chunk=%ds, stream_buf=%d bytes)",
-            RECLO_CHUNK_DURATION_S, RECLO_STREAM_BUF_SIZE);
+    k_thread_create(
+        &_rx_thread, _rx_stack, RX_THREAD_STACK,
+        rx_thread_fn, NULL, NULL, NULL,
+        RX_THREAD_PRIO, 0, K_NO_WAIT
+    );
+    k_thread_name_set(&_rx_thread, "reclo_rx");
+
+    LOG_INF("RecLo recorder initialized (chunk=%ds, %d × %d byte write slots)",
+            RECLO_CHUNK_DURATION_S, RECLO_WRITE_SLOTS, RECLO_STREAM_BUF_SIZE);
     return 0;
 }
 
@@ -362,20 +1024,20 @@ void reclo_recorder_start(void)
 {
     if (_recording) return;
 
-    k_mutex_lock(&_mutex, K_FOREVER);
+    _level_count[_level_track] = 0;
+    _level_acc    = 0;
+    _level_frames = 0;
+    _level_gap    = false;
 
-    uint32_t ts = get_utc_time();
-    int err = open_chunk_file(ts);
-    if (err) {
-        LOG_ERR("RecLo: failed to open initial chunk file: %d", err);
-        k_mutex_unlock(&_mutex);
+    submit_op_sync(WRITE_OP_OPEN, 0);
+    if (!_file_open) {
+        LOG_ERR("RecLo: failed to open initial chunk file");
         return;
     }
 
+    atomic_clear(&_rotate_pending);
+    _reserve_header = true;
     _recording = true;
-    k_mutex_unlock(&_mutex);
-
-    set_codec_callback(on_codec_output);
 
     k_timer_start(&_chunk_timer,
                   K_SECONDS(RECLO_CHUNK_DURATION_S),
@@ -390,14 +1052,20 @@ void reclo_recorder_stop(void)
 
     k_timer_stop(&_chunk_timer);
     _recording = false;
-    set_codec_callback(NULL);
 
+    /* Queue the partially-filled slot, then close behind it */
     k_mutex_lock(&_mutex, K_FOREVER);
-    if (_file_open) {
-        finalize_chunk();
-    }
+#ifdef CONFIG_OMI_RECLO_VAD
+    vad_end_run();
+#endif
+    pack_flush();
+    submit_active_slot();
+    atomic_clear(&_rotate_pending);
+    uint8_t track = level_rotate();
     k_mutex_unlock(&_mutex);
 
+    submit_op_sync(WRITE_OP_CLOSE, track);
+
     LOG_INF("RecLo recorder stopped");
 }
 
@@ -405,3 +1073,8 @@ int reclo_recorder_chunk_count(void)
 {
     return reclo_transfer_count_chunks();
 }
+
+uint32_t reclo_recorder_dropped_frames(void)
+{
+    return (uint32_t)atomic_get(&_dropped_frames) + codec_subscriber_dropped(_codec_sub);
+}
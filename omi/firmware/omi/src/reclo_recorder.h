@@ -3,35 +3,78 @@
 
 #include <stdint.h>
 
+#include "reclo_chunk_hdr.h"
+
 /*
  * reclo_recorder — 30-second direct-to-SD Opus chunk recorder.
  *
- * Hooks into the Omi codec pipeline via set_codec_callback().
- * Each encoded Opus frame is stored with a 2-byte LE length prefix
- * and accumulated into a 4KB RAM buffer. When the buffer fills it is
- * flushed to an open SD card file. Every RECLO_CHUNK_DURATION_S seconds
- * the file is finalised (data_size header field back-filled) and a new
- * file is opened for the next chunk.
+ * Subscribes to the Omi codec output bus and drains it on its own reclo_rx
+ * thread. Each encoded Opus frame is stored with a 2-byte LE length prefix
+ * and appended into the active slot of a small pool of 4KB RAM buffers.
+ * The reclo_rx thread never touches the SD card: full slots are handed to
+ * the reclo_flush writer thread through a message queue, and the writer
+ * performs all fs_* calls. Every RECLO_CHUNK_DURATION_S seconds the reclo_rx
+ * thread queues a rotation at the next frame boundary; the writer then
+ * finalises the file (data_size and CRC-32 back-filled into the header) and
+ * opens a new one for the next chunk. The writer keeps a running CRC over
+ * the data as it goes, so uploads never have to re-read a chunk to check it.
+ *
+ * If every slot is still queued behind a slow SD write, incoming frames are
+ * dropped (and counted) rather than stalling the encoder or other codec
+ * subscribers.
+ *
+ * The file header is reserved at the start of the first slot of each chunk
+ * and frames are split across slot boundaries, so every full-slot write
+ * covers whole 512-byte sectors at a sector-aligned file offset. A chunk's
+ * last slot is padded out to a whole sector, and its header is back-filled
+ * by rewriting the first sector, of which the writer keeps a copy. Chunk files
+ * are preallocated to RECLO_CHUNK_PREALLOC_SIZE when opened and truncated to
+ * their real length on finalise, so FAT clusters are allocated once per
+ * chunk instead of as the file grows.
  *
- * RAM usage: ~4KB (vs 65KB with the old accumulate-then-save approach).
- * A crash or power loss loses at most ~1 second of audio (one buffer).
+ * RAM usage: RECLO_WRITE_SLOTS × 4KB + 2 × 512B (vs 65KB with the old
+ * accumulate-then-save approach). A crash or power loss loses at most
+ * ~RECLO_WRITE_SLOTS seconds of audio (the queued slots).
  *
  * Call order:
- *   reclo_recorder_init()   — once at boot
- *   reclo_recorder_start()  — opens first chunk file, sets codec callback
- *   reclo_recorder_stop()   — finalises current chunk, clears callback
+ *   reclo_recorder_init()   — once at boot; subscribes to the codec
+ *   reclo_recorder_start()  — opens first chunk file, starts taking frames
+ *   reclo_recorder_stop()   — finalises current chunk; later frames are discarded
  */
 
 /* Omi consumer codec: 320 samples/frame (20ms), 32kbps VBR Opus, CODEC_ID=21
  * 30s / 0.02s = 1500 frames; 4KB write buffer flushes roughly every 1 second. */
 #define RECLO_CHUNK_DURATION_S  30
 #define RECLO_STREAM_BUF_SIZE   4096
+#define RECLO_WRITE_SLOTS       3
+#define RECLO_SECTOR_SIZE       512
+
+/* 20 ms Opus frames merged into each stored packet (see reclo_chunk_hdr.h) */
+#define RECLO_PACKET_FRAMES     CONFIG_OMI_RECLO_PACKET_FRAMES
+
+_Static_assert(RECLO_STREAM_BUF_SIZE % RECLO_SECTOR_SIZE == 0,
+               "write slots must hold whole SD sectors");
+_Static_assert(RECLO_FILE_HDR_SIZE <= RECLO_SECTOR_SIZE,
+               "the chunk header must fit in the first sector");
+
+/* Expected size of a 32 kbps chunk (+2-byte prefix per 20ms frame + header),
+ * rounded up to whole write slots: 123352 → 126976 bytes. */
+#define RECLO_CHUNK_PREALLOC_SIZE \
+    (((RECLO_CHUNK_DURATION_S * (32000 / 8 + 50 * 2) + RECLO_FILE_HDR_SIZE) + RECLO_STREAM_BUF_SIZE - 1) / \
+     RECLO_STREAM_BUF_SIZE * RECLO_STREAM_BUF_SIZE)
 
 int  reclo_recorder_init(void);
 void reclo_recorder_start(void);
 void reclo_recorder_stop(void);
 int  reclo_recorder_chunk_count(void);
 
+/**
+ * Number of encoded frames dropped since boot because no free write slot
+ * was available (SD card writes falling behind the encoder), the codec
+ * bus queue was full, or a chunk write or open failed on the card.
+ */
+uint32_t reclo_recorder_dropped_frames(void);
+
 /**
  * Schedule a background pass to rename any uptime-based (.upt) chunk files
  * recorded before UTC was synchronized to proper .bin files with corrected
@@ -1,4 +1,6 @@
 #include "reclo_transfer.h"
+#include "reclo_index.h"
+#include "reclo_l2cap.h"
 
 #include <zephyr/kernel.h>
 #include <zephyr/bluetooth/bluetooth.h>
@@ -15,7 +17,11 @@ LOG_MODULE_REGISTER(reclo_transfer, LOG_LEVEL_INF);
 
 static struct bt_conn *_conn;
 static bool _notify_enabled;
-static bool _upload_active;
+static bool _upload_active;                       /* START queued or its batch running */
+static atomic_t _abort_gen;                       /* bumped by ABORT, disconnect, link failure */
+static uint8_t _proto_version = RECLO_PROTO_V1;   /* from the last REQUEST_UPLOAD */
+static uint16_t _batch_limit;                     /* likewise; 0 = no limit */
+static uint32_t _conn_gen;                        /* bumped on every connection */
 
 /* ── Upload thread ───────────────────────────────────────────────────────────*/
 
@@ -24,13 +30,57 @@ static bool _upload_active;
 
 K_THREAD_STACK_DEFINE(_upload_stack, UPLOAD_STACK_SIZE);
 static struct k_thread _upload_thread;
-static K_SEM_DEFINE(_upload_sem, 0, 1);
+
+/* Prefetch reader feeding the upload thread (see "Prefetch pipeline") */
+#define READER_STACK_SIZE    3072
+#define READER_THREAD_PRIO   UPLOAD_THREAD_PRIO
+#define PREFETCH_BLOCKS      4
+#define PREFETCH_BLOCK_SIZE  4096   /* sector multiple */
+
+K_THREAD_STACK_DEFINE(_reader_stack, READER_STACK_SIZE);
+static struct k_thread _reader_thread;
+
+/* Commands handed from the control characteristic (BT RX context, which
+ * must not touch the SD card) to the upload thread. */
+enum upload_cmd_type {
+    UPLOAD_CMD_START,   /* REQUEST_UPLOAD */
+    UPLOAD_CMD_NACK,    /* NACK_CHUNK: resend the seqs in bitmap */
+};
+
+struct upload_cmd {
+    uint8_t  type;
+    uint8_t  nbytes;      /* bitmap bytes used */
+    uint16_t chunk_idx;
+    uint16_t first_seq;
+    uint32_t ts;
+    uint32_t abort_gen;   /* START: _abort_gen when it was requested */
+    uint8_t  bitmap[RECLO_NACK_MAX_BITMAP];
+};
+
+K_MSGQ_DEFINE(_cmd_q, sizeof(struct upload_cmd), 4, 4);
+
+/* ── TX flow control ─────────────────────────────────────────────────────────
+ * One credit per notification the stack may hold at once. A credit is taken
+ * before each bt_gatt_notify_cb() and returned from its completion callback,
+ * so the controller always has packets queued but the stack never runs out
+ * of buffers. Leave two TX contexts for the other GATT services.
+ */
+
+#define TX_WINDOW  MAX(1, MIN(CONFIG_OMI_RECLO_UPLOAD_TX_WINDOW, CONFIG_BT_CONN_TX_MAX - 2))
+
+/* How long to wait for a credit before declaring the link stalled */
+#define TX_CREDIT_TIMEOUT  K_SECONDS(5)
+
+/* Back-off when the stack is out of buffers despite a credit */
+#define TX_RETRY_DELAY     K_MSEC(2)
+
+static struct k_sem _tx_credits;
+static atomic_t _tx_gen;   /* bumped by tx_credits_reset() */
 
 /* ── Forward declarations ────────────────────────────────────────────────────*/
 
 static void upload_thread_fn(void *a, void *b, void *c);
-static int  send_packet(const RecloPacket *pkt);
-static int  upload_one_chunk(const char *path, uint16_t idx, uint16_t total);
+static int  send_packet(const void *pkt, uint16_t len);
 
 /* ── GATT UUIDs ──────────────────────────────────────────────────────────────*/
 
@@ -46,6 +96,10 @@ static int  upload_one_chunk(const char *path, uint16_t idx, uint16_t total);
     BT_UUID_DECLARE_128(BT_UUID_128_ENCODE( \
         0x5c7d0001, 0xb5a3, 0x4f43, 0xc0a9, 0xe50e24dc0002ULL))
 
+#define RECLO_PSM_UUID \
+    BT_UUID_DECLARE_128(BT_UUID_128_ENCODE( \
+        0x5c7d0001, 0xb5a3, 0x4f43, 0xc0a9, 0xe50e24dc0003ULL))
+
 /* ── GATT: data CCC ──────────────────────────────────────────────────────────*/
 
 static void data_ccc_changed(const struct bt_gatt_attr *attr, uint16_t value)
@@ -54,6 +108,82 @@ static void data_ccc_changed(const struct bt_gatt_attr *attr, uint16_t value)
     LOG_INF("Data notifications: %s", _notify_enabled ? "on" : "off");
 }
 
+/* ── Deferred deletion ───────────────────────────────────────────────────────
+ * ACKs arrive in BT RX context, which must not block on the SD card. They are
+ * queued as ts ranges and unlinked on the system workqueue, as many as have
+ * accumulated per run.
+ */
+
+enum delete_kind {
+    DELETE_ONE,         /* ACK_CHUNK: exactly this ts */
+    DELETE_SENT_RANGE,  /* ACK_UPTO: uploaded chunks with first <= ts <= last */
+};
+
+struct delete_req {
+    uint32_t first;
+    uint32_t last;
+    uint8_t  kind;
+};
+
+K_MSGQ_DEFINE(_delete_q, sizeof(struct delete_req), 24, 4);
+static struct k_work _delete_work;
+
+static void queue_delete(uint32_t first, uint32_t last, uint8_t kind)
+{
+    struct delete_req req = { .first = first, .last = last, .kind = kind };
+    if (k_msgq_put(&_delete_q, &req, K_NO_WAIT) != 0) {
+        /* Not fatal: the chunks are simply uploaded again next time */
+        LOG_WRN("ACK ts=%u..%u dropped: deletion queue full", first, last);
+        return;
+    }
+    k_work_submit(&_delete_work);
+}
+
+static int delete_chunk(uint32_t ts)
+{
+    char path[64];
+    reclo_index_chunk_path(path, sizeof(path), ts, RECLO_CHUNK_READY);
+
+    int err = fs_unlink(path);
+    if (err && err != -ENOENT) {
+        LOG_WRN("Delete chunk ts=%u: %d", ts, err);
+        return err;
+    }
+    reclo_index_remove(ts);
+    return 0;
+}
+
+static void delete_work_fn(struct k_work *work)
+{
+    ARG_UNUSED(work);
+
+    struct delete_req req;
+    int deleted = 0;
+
+    while (k_msgq_get(&_delete_q, &req, K_NO_WAIT) == 0) {
+        if (req.kind == DELETE_ONE) {
+            deleted += delete_chunk(req.first) == 0;
+            continue;
+        }
+
+        struct reclo_chunk_info info;
+        uint32_t from_ts = req.first;
+
+        while (reclo_index_find_from(RECLO_CHUNK_READY, from_ts, &info) == 0 &&
+               info.ts <= req.last) {
+            if (info.sent) {
+                deleted += delete_chunk(info.ts) == 0;
+            }
+            if (info.ts == UINT32_MAX) break;
+            from_ts = info.ts + 1;
+        }
+    }
+
+    if (deleted > 0) {
+        LOG_INF("Deleted %d chunk(s)", deleted);
+    }
+}
+
 /* ── GATT: control write ─────────────────────────────────────────────────────*/
 
 static ssize_t ctrl_write(struct bt_conn *conn, const struct bt_gatt_attr *attr,
@@ -69,9 +199,40 @@ static ssize_t ctrl_write(struct bt_conn *conn, const struct bt_gatt_attr *attr,
     switch (data[0]) {
     case RECLO_CMD_REQUEST_UPLOAD:
         if (!_upload_active) {
+            /* Old apps send the bare command and get v1 framing */
+            _proto_version = (len >= 2 && data[1] >= RECLO_PROTO_V2) ? RECLO_PROTO_V2
+                                                                      : RECLO_PROTO_V1;
+            _batch_limit = 0;
+            if (len >= 4) {
+                memcpy(&_batch_limit, &data[2], sizeof(_batch_limit));
+            }
+            struct upload_cmd cmd = {
+                .type      = UPLOAD_CMD_START,
+                .abort_gen = (uint32_t)atomic_get(&_abort_gen),
+            };
+            /* Set first: the upload thread may run the whole batch, and
+             * clear the flag, before k_msgq_put() returns */
             _upload_active = true;
-            k_sem_give(&_upload_sem);
-            LOG_INF("Upload requested by phone");
+            if (k_msgq_put(&_cmd_q, &cmd, K_NO_WAIT) == 0) {
+                LOG_INF("Upload requested by phone (framing v%u, max %u chunk(s))",
+                        _proto_version, _batch_limit);
+            } else {
+                _upload_active = false;
+            }
+        }
+        break;
+
+    case RECLO_CMD_NACK_CHUNK:
+        if (len >= 10) {
+            struct upload_cmd cmd = { .type = UPLOAD_CMD_NACK };
+            memcpy(&cmd.ts,        &data[1], sizeof(cmd.ts));
+            memcpy(&cmd.chunk_idx, &data[5], sizeof(cmd.chunk_idx));
+            memcpy(&cmd.first_seq, &data[7], sizeof(cmd.first_seq));
+            cmd.nbytes = (uint8_t)MIN(len - 9, RECLO_NACK_MAX_BITMAP);
+            memcpy(cmd.bitmap, &data[9], cmd.nbytes);
+            if (k_msgq_put(&_cmd_q, &cmd, K_NO_WAIT) != 0) {
+                LOG_WRN("NACK ts=%u dropped: command queue full", cmd.ts);
+            }
         }
         break;
 
@@ -79,18 +240,32 @@ static ssize_t ctrl_write(struct bt_conn *conn, const struct bt_gatt_attr *attr,
         if (len >= 5) {
             uint32_t ts;
             memcpy(&ts, &data[1], sizeof(ts));
-            char path[64];
-            snprintf(path, sizeof(path), "%s/%010u.bin", RECLO_STORAGE_DIR, ts);
-            int err = fs_unlink(path);
-            if (err) {
-                LOG_WRN("Delete chunk ts=%u: %d", ts, err);
-            } else {
-                LOG_INF("Deleted chunk ts=%u", ts);
+            queue_delete(ts, ts, DELETE_ONE);
+        }
+        break;
+
+    case RECLO_CMD_ACK_UPTO:
+        if (len >= 5) {
+            uint32_t upto;
+            memcpy(&upto, &data[1], sizeof(upto));
+            if (upto != 0) {
+                queue_delete(0, upto, DELETE_SENT_RANGE);
+            }
+
+            unsigned ranges = MIN((len - 5U) / 8U, RECLO_ACK_MAX_RANGES);
+            for (unsigned r = 0; r < ranges; r++) {
+                uint32_t first, last;
+                memcpy(&first, &data[5 + r * 8],     sizeof(first));
+                memcpy(&last,  &data[5 + r * 8 + 4], sizeof(last));
+                if (first <= last) {
+                    queue_delete(first, last, DELETE_SENT_RANGE);
+                }
             }
         }
         break;
 
     case RECLO_CMD_ABORT:
+        atomic_inc(&_abort_gen);
         _upload_active = false;
         LOG_INF("Upload aborted by phone");
         break;
@@ -103,6 +278,19 @@ static ssize_t ctrl_write(struct bt_conn *conn, const struct bt_gatt_attr *attr,
     return (ssize_t)len;
 }
 
+/* ── GATT: bulk channel PSM read ─────────────────────────────────────────────*/
+
+static ssize_t psm_read(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                        void *buf, uint16_t len, uint16_t offset)
+{
+#ifdef CONFIG_OMI_RECLO_L2CAP
+    uint16_t psm = RECLO_L2CAP_PSM;
+#else
+    uint16_t psm = 0;
+#endif
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, &psm, sizeof(psm));
+}
+
 /* ── GATT service definition ─────────────────────────────────────────────────
  *
  * Attribute table layout (0-based indices):
@@ -112,6 +300,8 @@ static ssize_t ctrl_write(struct bt_conn *conn, const struct bt_gatt_attr *attr,
  *   3  data CCC descriptor
  *   4  control characteristic declaration
  *   5  control characteristic value
+ *   6  PSM characteristic declaration
+ *   7  PSM characteristic value
  */
 BT_GATT_SERVICE_DEFINE(reclo_svc,
     BT_GATT_PRIMARY_SERVICE(RECLO_SVC_UUID),
@@ -129,21 +319,72 @@ BT_GATT_SERVICE_DEFINE(reclo_svc,
         BT_GATT_CHRC_WRITE | BT_GATT_CHRC_WRITE_WITHOUT_RESP,
         BT_GATT_PERM_WRITE,
         NULL, ctrl_write, NULL),
+
+    /* PSM: L2CAP bulk channel, 0 if unsupported (read) */
+    BT_GATT_CHARACTERISTIC(RECLO_PSM_UUID,
+        BT_GATT_CHRC_READ,
+        BT_GATT_PERM_READ,
+        psm_read, NULL, NULL),
 );
 
 #define DATA_ATTR  (&reclo_svc.attrs[2])
 
 /* ── Packet transmission ─────────────────────────────────────────────────────*/
 
-static int send_packet(const RecloPacket *pkt)
+/* Each notification carries the credit generation it was sent under; one
+ * sent before the last reset returns nothing, or the window would overfill. */
+static void notify_sent(struct bt_conn *conn, void *user_data)
 {
-    if (!_conn || !_notify_enabled) return -ENOTCONN;
+    ARG_UNUSED(conn);
+    if ((uintptr_t)user_data == (uintptr_t)atomic_get(&_tx_gen)) {
+        k_sem_give(&_tx_credits);
+    }
+}
+
+/* Refill the window for a new connection. Within one connection credits are
+ * only handed back, never made: a batch started after an ABORT waits for
+ * the aborted batch's notifications to complete like any others. */
+static void tx_credits_reset(void)
+{
+    atomic_inc(&_tx_gen);
+    k_sem_init(&_tx_credits, TX_WINDOW, TX_WINDOW);
+}
 
-    int err = bt_gatt_notify(_conn, DATA_ATTR, pkt, RECLO_PACKET_SIZE);
-    if (err && err != -EAGAIN) {
-        LOG_ERR("bt_gatt_notify: %d", err);
+/* Queue one notification, waiting for a credit first. Retries while the
+ * stack is out of buffers, so a packet is only lost if the link goes away.
+ * Callers check for an abort between packets. */
+static int send_notify(const void *pkt, uint16_t len)
+{
+    struct bt_gatt_notify_params params = {
+        .attr = DATA_ATTR,
+        .data = pkt,
+        .len  = len,
+        .func = notify_sent,
+        .user_data = (void *)(uintptr_t)atomic_get(&_tx_gen),
+    };
+
+    while (true) {
+        if (!_conn || !_notify_enabled) return -ENOTCONN;
+
+        if (k_sem_take(&_tx_credits, TX_CREDIT_TIMEOUT) != 0) {
+            LOG_ERR("TX stalled: no notification completed in 5 s");
+            return -ETIMEDOUT;
+        }
+
+        int err = bt_gatt_notify_cb(_conn, &params);
+        if (err == 0) {
+            return 0;
+        }
+
+        /* Not queued, so no completion will return the credit */
+        k_sem_give(&_tx_credits);
+
+        if (err != -ENOMEM && err != -EAGAIN && err != -ENOBUFS) {
+            LOG_ERR("bt_gatt_notify_cb: %d", err);
+            return err;
+        }
+        k_sleep(TX_RETRY_DELAY);
     }
-    return err;
 }
 
 /* ── Storage ─────────────────────────────────────────────────────────────────*/
@@ -168,274 +409,730 @@ int reclo_transfer_store_chunk(uint32_t ts, const uint8_t *data, size_t len)
         return err;
     }
 
-    /*
-     * File header (17 bytes):
-     *   [0..3]   magic      'RCLO'
-     *   [4..7]   timestamp  uint32 LE
-     *   [8]      codec_id   20 (Opus)
-     *   [9..12]  sample_rate uint32 LE  (16000)
-     *   [13..16] data_size  uint32 LE
-     */
-    uint8_t hdr[17];
-    hdr[0] = 'R'; hdr[1] = 'C'; hdr[2] = 'L'; hdr[3] = 'O';
-
-    uint32_t ts_le = ts;
-    memcpy(&hdr[4], &ts_le, 4);
-
-    hdr[8] = 21;  /* CODEC_ID — matches Omi consumer firmware CODEC_ID */
-
-    uint32_t sr = 16000U;
-    memcpy(&hdr[9], &sr, 4);
-
-    uint32_t ds = (uint32_t)len;
-    memcpy(&hdr[13], &ds, 4);
+    struct reclo_chunk_hdr h = {
+        .ts          = ts,
+        .codec_id    = 21,   /* CODEC_ID — matches Omi consumer firmware CODEC_ID */
+        .sample_rate = 16000U,
+        .data_size   = (uint32_t)len,
+        .crc32       = crc32_ieee(data, len),
+    };
+    uint8_t hdr[RECLO_FILE_HDR_SIZE];
+    reclo_chunk_hdr_encode(hdr, &h);
 
     fs_write(&f, hdr, sizeof(hdr));
     fs_write(&f, data, len);
     fs_close(&f);
 
+    reclo_index_add(ts, RECLO_CHUNK_READY, (uint32_t)(sizeof(hdr) + len));
+
     LOG_INF("Stored chunk ts=%u (%zu bytes) → %s", ts, len, path);
     return 0;
 }
 
 int reclo_transfer_count_chunks(void)
 {
-    struct fs_dir_t dir;
-    struct fs_dirent ent;
-    fs_dir_t_init(&dir);
+    return reclo_index_count(RECLO_CHUNK_READY);
+}
 
-    if (fs_opendir(&dir, RECLO_STORAGE_DIR) != 0) return 0;
+/* ── Upload logic ────────────────────────────────────────────────────────────*/
 
-    int count = 0;
-    while (fs_readdir(&dir, &ent) == 0 && ent.name[0] != '\0') {
-        size_t nlen = strlen(ent.name);
-        if (ent.type == FS_DIR_ENTRY_FILE &&
-            nlen > 4 &&
-            strcmp(ent.name + nlen - 4, ".bin") == 0) {
-            count++;
-        }
+/* Packet buffer shared by all framings; upload thread only */
+#ifdef CONFIG_OMI_RECLO_L2CAP
+#define TX_BUF_SIZE  MAX(RECLO_V2_MAX_PACKET, RECLO_L2CAP_SDU_MAX)
+#else
+#define TX_BUF_SIZE  RECLO_V2_MAX_PACKET
+#endif
+
+_Static_assert(TX_BUF_SIZE >= RECLO_PACKET_SIZE, "TX buffer must hold a v1 packet");
+
+static uint8_t _tx_buf[TX_BUF_SIZE];
+
+/* Framing of the current (or last) upload batch. Retransmissions reuse it
+ * so that a resent seq covers exactly the bytes it did the first time. */
+static struct {
+    bool     l2cap;     /* streamed over the bulk channel, not notifications */
+    uint8_t  proto;
+    uint16_t payload;   /* Opus bytes per DATA packet */
+    uint16_t total;     /* chunks in the batch */
+    uint32_t conn_gen;  /* connection the batch was sent on */
+    uint32_t abort_gen; /* _abort_gen the batch was requested under */
+} _batch;
+
+/* Once aborted, a batch stays aborted: a later REQUEST_UPLOAD starts a new
+ * batch instead of resuming this one mid-chunk. */
+static bool batch_aborted(void)
+{
+    return (uint32_t)atomic_get(&_abort_gen) != _batch.abort_gen;
+}
+
+/* Opus bytes per v2 DATA packet: whatever the negotiated MTU leaves after
+ * the 3-byte ATT header and the data header. */
+static uint16_t v2_data_payload(void)
+{
+    uint16_t att_payload = MIN(bt_gatt_get_mtu(_conn) - 3, RECLO_V2_MAX_PACKET);
+    if (att_payload <= sizeof(RecloHeaderV2)) {
+        return 0;
     }
-    fs_closedir(&dir);
-    return count;
+    return att_payload - RECLO_V2_DATA_HDR_SIZE;
 }
 
-/* ── Upload logic ────────────────────────────────────────────────────────────*/
+static int send_packet(const void *pkt, uint16_t len)
+{
+    if (_batch.l2cap) {
+        return reclo_l2cap_send(pkt, len);
+    }
+    return send_notify(pkt, len);
+}
 
-static int upload_one_chunk(const char *path, uint16_t idx, uint16_t total)
+static int send_upload_done(void)
 {
-    struct fs_file_t f;
-    fs_file_t_init(&f);
+    if (_batch.proto >= RECLO_PROTO_V2) {
+        uint8_t done = RECLO_PKT_UPLOAD_DONE;
+        return send_packet(&done, sizeof(done));
+    }
+
+    RecloPacket *pkt = (RecloPacket *)_tx_buf;
+    memset(pkt, 0, sizeof(*pkt));
+    pkt->pkt_type = RECLO_PKT_UPLOAD_DONE;
+    return send_packet(pkt, RECLO_PACKET_SIZE);
+}
 
-    int err = fs_open(&f, path, FS_O_READ);
+/* Where fs_read() should put the Opus bytes of the next DATA packet */
+static uint8_t *data_payload_buf(void)
+{
+    return (_batch.proto >= RECLO_PROTO_V2) ? &_tx_buf[RECLO_V2_DATA_HDR_SIZE]
+                                            : ((RecloPacket *)_tx_buf)->payload;
+}
+
+/* Frame and send the @p n Opus bytes already in data_payload_buf() */
+static int send_data_packet(uint32_t ts, uint16_t idx, uint16_t seq,
+                            uint16_t total_seqs, size_t n)
+{
+    if (_batch.proto >= RECLO_PROTO_V2) {
+        RecloDataHdrV2 *d = (RecloDataHdrV2 *)_tx_buf;
+        d->pkt_type  = RECLO_PKT_CHUNK_DATA_V2;
+        d->chunk_tag = (uint8_t)idx;
+        d->seq       = seq;
+        return send_packet(_tx_buf, (uint16_t)(RECLO_V2_DATA_HDR_SIZE + n));
+    }
+
+    RecloPacket *pkt = (RecloPacket *)_tx_buf;
+    pkt->pkt_type     = RECLO_PKT_CHUNK_DATA;
+    pkt->chunk_ts     = ts;
+    pkt->chunk_idx    = idx;
+    pkt->total_chunks = _batch.total;
+    pkt->seq          = seq;
+    pkt->total_seqs   = total_seqs;
+    pkt->payload_len  = (uint16_t)n;
+    /* Zero the unused tail of a short final packet */
+    memset(&pkt->payload[n], 0, RECLO_PAYLOAD_SIZE - n);
+    return send_packet(pkt, RECLO_PACKET_SIZE);
+}
+
+static uint16_t chunk_total_seqs(uint32_t data_size)
+{
+    return (uint16_t)(1 + (data_size + _batch.payload - 1) / _batch.payload);
+}
+
+/* Open a chunk file and parse its header. Chunks left unfinalised by a power
+ * loss (data_size = 0) get their size from the file length. With @p levels,
+ * the level track is copied there (RECLO_LEVEL_MAX bytes of room);
+ * hdr->levels is never valid after return. */
+static int open_chunk(const char *path, struct fs_file_t *f, struct reclo_chunk_hdr *hdr,
+                      uint8_t *levels)
+{
+    fs_file_t_init(f);
+
+    int err = fs_open(f, path, FS_O_READ);
     if (err) {
         LOG_ERR("Cannot open %s: %d", path, err);
         return err;
     }
 
-    uint8_t file_hdr[17];
-    if (fs_read(&f, file_hdr, sizeof(file_hdr)) != (ssize_t)sizeof(file_hdr)) {
-        fs_close(&f);
-        return -EIO;
-    }
+    uint8_t file_hdr[RECLO_FILE_HDR_SIZE];
+    ssize_t hdr_len = fs_read(f, file_hdr, sizeof(file_hdr));
 
-    if (file_hdr[0] != 'R' || file_hdr[1] != 'C' ||
-        file_hdr[2] != 'L' || file_hdr[3] != 'O') {
+    err = reclo_chunk_hdr_parse(file_hdr, hdr_len > 0 ? (size_t)hdr_len : 0, hdr);
+    if (err == -EILSEQ) {
         LOG_ERR("Bad magic in %s", path);
-        fs_close(&f);
-        return -EILSEQ;
-    }
-
-    uint32_t ts, sample_rate, data_size;
-    uint8_t  codec_id;
-    memcpy(&ts,          &file_hdr[4],  4);
-    codec_id = file_hdr[8];
-    memcpy(&sample_rate, &file_hdr[9],  4);
-    memcpy(&data_size,   &file_hdr[13], 4);
-
-    /* Recover unfinalized chunks: power loss left data_size = 0.
-     * Seek to end to find the actual data size. */
-    if (data_size == 0) {
-        if (fs_seek(&f, 0, FS_SEEK_END) == 0) {
-            off_t file_sz = fs_tell(&f);
-            if (file_sz > (off_t)sizeof(file_hdr)) {
-                data_size = (uint32_t)(file_sz - sizeof(file_hdr));
-                LOG_WRN("Unfinalized chunk ts=%u: recovered data_size=%u", ts, data_size);
+    }
+    if (err) {
+        fs_close(f);
+        return err == -ENODATA ? -EIO : err;
+    }
+
+    if (levels && hdr->level_count > 0) {
+        memcpy(levels, hdr->levels, hdr->level_count);
+    } else {
+        hdr->level_count = 0;
+    }
+    hdr->levels = NULL;
+
+    if (hdr->data_size == 0) {
+        if (fs_seek(f, 0, FS_SEEK_END) == 0) {
+            off_t file_sz = fs_tell(f);
+            if (file_sz > (off_t)hdr->hdr_size) {
+                hdr->data_size = (uint32_t)(file_sz - hdr->hdr_size);
+                LOG_WRN("Unfinalized chunk ts=%u: recovered data_size=%u",
+                        hdr->ts, hdr->data_size);
             }
         }
-        if (data_size == 0) {
-            LOG_WRN("Skipping empty chunk ts=%u", ts);
-            fs_close(&f);
+        if (hdr->data_size == 0) {
+            LOG_WRN("Skipping empty chunk ts=%u", hdr->ts);
+            fs_close(f);
             return -ENODATA;
         }
     }
 
-    fs_close(&f);
+    return 0;
+}
+
+/* CRC-32 of the data bytes for chunks whose header does not carry one
+ * (v1 files, or chunks recovered after power loss). Leaves the file
+ * positioned at the start of the data. */
+static int compute_data_crc(struct fs_file_t *f, const struct reclo_chunk_hdr *hdr,
+                            uint8_t *buf, size_t buf_len, uint32_t *crc)
+{
+    int err = fs_seek(f, hdr->hdr_size, FS_SEEK_SET);
+    if (err) return err;
+
+    uint32_t remaining = hdr->data_size;
+    uint32_t c = 0;
+    while (remaining > 0) {
+        ssize_t n = fs_read(f, buf, MIN(buf_len, remaining));
+        if (n <= 0) break;
+        c = crc32_ieee_update(c, buf, (size_t)n);
+        remaining -= (uint32_t)n;
+    }
+    *crc = c;
+
+    return fs_seek(f, hdr->hdr_size, FS_SEEK_SET);
+}
+
+/* ── Prefetch pipeline ───────────────────────────────────────────────────────
+ * The reader thread walks the batch and streams each chunk into a small pool
+ * of blocks; the upload thread slices blocks into DATA packets. SD reads for
+ * the next blocks — and the next chunk's header — happen while the current
+ * ones are on air, so a slow card read no longer stalls the radio.
+ *
+ * Blocks after the first start on a PREFETCH_BLOCK_SIZE boundary of the file,
+ * so every read but the first and last is sector-aligned.
+ */
+
+enum prefetch_type {
+    PF_CHUNK_BEGIN,   /* header parsed; CRC known */
+    PF_DATA,          /* len bytes in _pf_blocks[block] */
+    PF_CHUNK_END,     /* all data of chunk ts queued (err set on a short read) */
+    PF_CHUNK_ERROR,   /* chunk ts could not be opened; nothing was queued */
+    PF_BATCH_END,     /* reader is idle again */
+};
+
+struct prefetch_item {
+    uint8_t  type;
+    uint8_t  block;
+    uint16_t len;
+    uint16_t idx;
+    int16_t  err;
+    uint32_t ts;
+    RecloChunkMeta meta;   /* PF_CHUNK_BEGIN */
+    RecloEncoderInfo enc;  /* PF_CHUNK_BEGIN; block/len hold the level track */
+};
 
-    /* Compute CRC-32 over the Opus data bytes */
+static uint8_t _pf_blocks[PREFETCH_BLOCKS][PREFETCH_BLOCK_SIZE] __aligned(4);
+
+K_MSGQ_DEFINE(_pf_free_q, sizeof(uint8_t), PREFETCH_BLOCKS, 1);
+K_MSGQ_DEFINE(_pf_q, sizeof(struct prefetch_item), PREFETCH_BLOCKS + 4, 4);
+static K_SEM_DEFINE(_pf_start, 0, 1);
+
+/* Per-stage time for the current batch, in ticks. Reader idle is time spent
+ * waiting for a free block (the radio is the bottleneck); sender idle is time
+ * spent waiting for data (the card is). */
+struct stage_time {
+    int64_t busy;
+    int64_t idle;
+};
+
+static struct stage_time _reader_time;
+static struct stage_time _sender_time;
+
+static void stage_account(int64_t *bucket, int64_t *mark)
+{
+    int64_t now = k_uptime_ticks();
+    *bucket += now - *mark;
+    *mark = now;
+}
+
+static void pf_put(const struct prefetch_item *item, int64_t *mark)
+{
+    stage_account(&_reader_time.busy, mark);
+    k_msgq_put(&_pf_q, item, K_FOREVER);
+    stage_account(&_reader_time.idle, mark);
+}
+
+static uint8_t pf_get_free_block(int64_t *mark)
+{
+    uint8_t block;
+
+    stage_account(&_reader_time.busy, mark);
+    k_msgq_get(&_pf_free_q, &block, K_FOREVER);
+    stage_account(&_reader_time.idle, mark);
+    return block;
+}
+
+static void pf_put_free_block(uint8_t block)
+{
+    k_msgq_put(&_pf_free_q, &block, K_NO_WAIT);
+}
+
+static void prefetch_chunk(uint32_t ts, uint16_t idx, int64_t *mark)
+{
+    struct prefetch_item item = { .ts = ts, .idx = idx };
+
+    /* Borrow a block up front: v1 chunks need it to compute their CRC */
+    uint8_t block = pf_get_free_block(mark);
+
+    char path[64];
+    reclo_index_chunk_path(path, sizeof(path), ts, RECLO_CHUNK_READY);
+
+    struct fs_file_t f;
+    struct reclo_chunk_hdr hdr;
+
+    int err = open_chunk(path, &f, &hdr, _pf_blocks[block]);
+    if (err == -ENOENT) {
+        /* Indexed but gone from the card */
+        reclo_index_remove(ts);
+        reclo_index_mark_inconsistent();
+    }
     uint32_t crc = 0;
-    {
-        struct fs_file_t f2;
-        fs_file_t_init(&f2);
-        fs_open(&f2, path, FS_O_READ);
-        fs_seek(&f2, sizeof(file_hdr), FS_SEEK_SET);
-
-        uint8_t tmp[256];
-        ssize_t n;
-        while ((n = fs_read(&f2, tmp, sizeof(tmp))) > 0) {
-            crc = crc32_ieee_update(crc, tmp, (size_t)n);
+    if (!err) {
+        crc = hdr.crc32;
+        if (reclo_chunk_hdr_has_crc(&hdr)) {
+            err = fs_seek(&f, hdr.hdr_size, FS_SEEK_SET);
+        } else {
+            /* Unfinalised, so it has no level track to overwrite */
+            err = compute_data_crc(&f, &hdr, _pf_blocks[block], PREFETCH_BLOCK_SIZE, &crc);
+            hdr.level_count = 0;
         }
-        fs_close(&f2);
-    }
-
-    uint16_t data_seqs  = (uint16_t)((data_size + RECLO_PAYLOAD_SIZE - 1) / RECLO_PAYLOAD_SIZE);
-    uint16_t total_seqs = 1 + data_seqs;
-
-    /* ── Send CHUNK_HEADER ── */
-    RecloPacket pkt;
-    memset(&pkt, 0, sizeof(pkt));
-    pkt.pkt_type     = RECLO_PKT_CHUNK_HEADER;
-    pkt.chunk_ts     = ts;
-    pkt.chunk_idx    = idx;
-    pkt.total_chunks = total;
-    pkt.seq          = 0;
-    pkt.total_seqs   = total_seqs;
-
-    RecloChunkMeta meta = {
-        .data_size   = data_size,
-        .codec_id    = codec_id,
-        .sample_rate = sample_rate,
-        .crc32       = crc,
-    };
-    memcpy(pkt.payload, &meta, sizeof(meta));
-    pkt.payload_len = sizeof(meta);
+        if (err) fs_close(&f);
+    }
+    if (err) {
+        pf_put_free_block(block);
+        item.type = PF_CHUNK_ERROR;
+        item.err  = (int16_t)err;
+        pf_put(&item, mark);
+        return;
+    }
 
-    err = send_packet(&pkt);
-    if (err) return err;
+    item.type             = PF_CHUNK_BEGIN;
+    item.meta.data_size   = hdr.data_size;
+    item.meta.codec_id    = hdr.codec_id;
+    item.meta.sample_rate = hdr.sample_rate;
+    item.meta.crc32       = crc;
+    item.enc.complexity   = hdr.enc_complexity;
+    item.enc.flags        = hdr.enc_flags;
+    item.enc.bitrate_kbps = hdr.enc_bitrate_kbps;
+    item.block            = block;
+    item.len              = hdr.level_count;
+    pf_put(&item, mark);
+
+    /* A level track travels with the header; the sender returns its block */
+    uint32_t remaining = hdr.data_size;
+    size_t   want      = PREFETCH_BLOCK_SIZE - hdr.hdr_size % PREFETCH_BLOCK_SIZE;
+    bool     have_block = hdr.level_count == 0;
+
+    item.type = PF_DATA;
+    while (remaining > 0 && !batch_aborted()) {
+        if (!have_block) {
+            block = pf_get_free_block(mark);
+            have_block = true;
+        }
+
+        ssize_t n = fs_read(&f, _pf_blocks[block], MIN(want, remaining));
+        if (n <= 0) {
+            err = n < 0 ? (int)n : -EIO;
+            break;
+        }
+        remaining -= (uint32_t)n;
+        want = PREFETCH_BLOCK_SIZE;
+
+        item.block = block;
+        item.len   = (uint16_t)n;
+        pf_put(&item, mark);
+        have_block = false;
+    }
+
+    if (have_block) {
+        pf_put_free_block(block);
+    }
+    fs_close(&f);
+
+    item.type = PF_CHUNK_END;
+    item.err  = (int16_t)err;
+    pf_put(&item, mark);
+}
+
+static void reader_thread_fn(void *a, void *b, void *c)
+{
+    ARG_UNUSED(a); ARG_UNUSED(b); ARG_UNUSED(c);
+
+    for (uint8_t i = 0; i < PREFETCH_BLOCKS; i++) {
+        pf_put_free_block(i);
+    }
+
+    while (true) {
+        k_sem_take(&_pf_start, K_FOREVER);
+
+        int64_t mark = k_uptime_ticks();
+        _reader_time = (struct stage_time){ 0 };
+
+        /* The index is sorted by timestamp, so walking it uploads oldest first */
+        struct reclo_chunk_info info;
+        uint32_t from_ts = 0;
+
+        for (uint16_t i = 0; i < _batch.total && !batch_aborted(); i++) {
+            if (reclo_index_find_from(RECLO_CHUNK_READY, from_ts, &info) != 0) {
+                break;
+            }
+            from_ts = info.ts + 1;
+            prefetch_chunk(info.ts, i, &mark);
+        }
+
+        struct prefetch_item end = { .type = PF_BATCH_END };
+        pf_put(&end, &mark);
+    }
+}
+
+/* ── Sender ──────────────────────────────────────────────────────────────────*/
+
+/* Chunk being sliced into DATA packets */
+static struct {
+    uint32_t ts;
+    uint16_t idx;
+    uint16_t seq;          /* next seq to send */
+    uint16_t total_seqs;
+    uint32_t data_size;
+    uint32_t sent;         /* bytes sent, not counting the packet being filled */
+    uint16_t fill;         /* bytes already in data_payload_buf() */
+    int64_t  start_ms;
+} _cur;
+
+/* v2: the level track in CHUNK_LEVELS_V2 packets of up to one data
+ * payload each */
+static int send_chunk_levels(const uint8_t *levels, uint16_t count, uint16_t idx)
+{
+    RecloDataHdrV2 *h = (RecloDataHdrV2 *)_tx_buf;
+
+    for (uint16_t first = 0; first < count; ) {
+        uint16_t n = MIN(count - first, _batch.payload);
+        h->pkt_type  = RECLO_PKT_CHUNK_LEVELS_V2;
+        h->chunk_tag = (uint8_t)(idx & 0xFF);
+        h->seq       = first;
+        memcpy(_tx_buf + sizeof(*h), &levels[first], n);
+
+        int err = send_packet(_tx_buf, sizeof(*h) + n);
+        if (err) return err;
+        first += n;
+    }
+    return 0;
+}
+
+static int send_chunk_header(const struct prefetch_item *item)
+{
+    _cur.ts         = item->ts;
+    _cur.idx        = item->idx;
+    _cur.seq        = 1;
+    _cur.total_seqs = chunk_total_seqs(item->meta.data_size);
+    _cur.data_size  = item->meta.data_size;
+    _cur.sent       = 0;
+    _cur.fill       = 0;
+    _cur.start_ms   = k_uptime_get();
+
+    if (_batch.proto >= RECLO_PROTO_V2) {
+        RecloHeaderV2 *h = (RecloHeaderV2 *)_tx_buf;
+        h->pkt_type     = RECLO_PKT_CHUNK_HEADER_V2;
+        h->chunk_ts     = item->ts;
+        h->chunk_idx    = item->idx;
+        h->total_chunks = _batch.total;
+        h->total_seqs   = _cur.total_seqs;
+        h->data_payload = _batch.payload;
+        h->meta         = item->meta;
+        h->enc          = item->enc;
+        h->level_count  = item->len;
+        int err = send_packet(h, sizeof(*h));
+        if (err) return err;
+        return send_chunk_levels(_pf_blocks[item->block], item->len, item->idx);
+    }
+
+    RecloPacket *pkt = (RecloPacket *)_tx_buf;
+    memset(pkt, 0, sizeof(*pkt));
+    pkt->pkt_type     = RECLO_PKT_CHUNK_HEADER;
+    pkt->chunk_ts     = item->ts;
+    pkt->chunk_idx    = item->idx;
+    pkt->total_chunks = _batch.total;
+    pkt->seq          = 0;
+    pkt->total_seqs   = _cur.total_seqs;
+    memcpy(pkt->payload, &item->meta, sizeof(item->meta));
+    memcpy(pkt->payload + sizeof(item->meta), &item->enc, sizeof(item->enc));
+    pkt->payload_len  = sizeof(item->meta) + sizeof(item->enc);
+    return send_packet(pkt, RECLO_PACKET_SIZE);
+}
+
+static int flush_data_packet(void)
+{
+    int err = send_data_packet(_cur.ts, _cur.idx, _cur.seq++, _cur.total_seqs, _cur.fill);
+    _cur.sent += _cur.fill;
+    _cur.fill  = 0;
+    return err;
+}
+
+/* Slice one prefetched block into DATA packets. Packets straddle block
+ * boundaries, so seq n still covers data bytes [(n-1)·payload, n·payload). */
+static int send_block(const uint8_t *src, size_t len)
+{
+    while (len > 0) {
+        size_t take = MIN(len, (size_t)(_batch.payload - _cur.fill));
+        memcpy(data_payload_buf() + _cur.fill, src, take);
+        _cur.fill += take;
+        src       += take;
+        len       -= take;
+
+        if (_cur.fill == _batch.payload || _cur.sent + _cur.fill == _cur.data_size) {
+            int err = flush_data_packet();
+            if (err) return err;
+        }
+    }
+    return 0;
+}
 
-    k_msleep(10);
+/* ── Selective retransmission ────────────────────────────────────────────────
+ * Resends the DATA packets whose bits are set in a NACK_CHUNK bitmap. Each
+ * packet is read from its own offset, seq × payload, within the chunk.
+ */
+static int resend_chunk_seqs(const struct upload_cmd *cmd)
+{
+    char path[64];
+    reclo_index_chunk_path(path, sizeof(path), cmd->ts, RECLO_CHUNK_READY);
+
+    struct fs_file_t f;
+    struct reclo_chunk_hdr hdr;
 
-    /* ── Send CHUNK_DATA packets ── */
-    struct fs_file_t fd;
-    fs_file_t_init(&fd);
-    err = fs_open(&fd, path, FS_O_READ);
+    int err = open_chunk(path, &f, &hdr, NULL);
     if (err) return err;
-    fs_seek(&fd, sizeof(file_hdr), FS_SEEK_SET);
 
-    uint16_t seq = 1;
-    uint8_t  buf[RECLO_PAYLOAD_SIZE];
-    ssize_t  n;
+    uint16_t total_seqs = chunk_total_seqs(hdr.data_size);
+    int      resent     = 0;
 
-    while ((n = fs_read(&fd, buf, RECLO_PAYLOAD_SIZE)) > 0) {
-        if (!_upload_active) {
-            fs_close(&fd);
-            return -ECANCELED;
+    for (unsigned bit = 0; bit < cmd->nbytes * 8U; bit++) {
+        if (!(cmd->bitmap[bit / 8] & BIT(bit % 8))) {
+            continue;
+        }
+        uint32_t seq = (uint32_t)cmd->first_seq + bit;
+        if (seq == 0 || seq >= total_seqs) {
+            continue;
         }
 
-        memset(&pkt, 0, sizeof(pkt));
-        pkt.pkt_type     = RECLO_PKT_CHUNK_DATA;
-        pkt.chunk_ts     = ts;
-        pkt.chunk_idx    = idx;
-        pkt.total_chunks = total;
-        pkt.seq          = seq++;
-        pkt.total_seqs   = total_seqs;
-        pkt.payload_len  = (uint16_t)n;
-        memcpy(pkt.payload, buf, (size_t)n);
-
-        err = send_packet(&pkt);
-        if (err && err != -EAGAIN) {
-            fs_close(&fd);
-            return err;
+        uint32_t off = (seq - 1) * _batch.payload;
+        size_t   len = MIN(_batch.payload, hdr.data_size - off);
+
+        err = fs_seek(&f, hdr.hdr_size + off, FS_SEEK_SET);
+        if (err) break;
+
+        ssize_t n = fs_read(&f, data_payload_buf(), len);
+        if (n != (ssize_t)len) {
+            err = -EIO;
+            break;
         }
 
-        k_msleep(8);
+        err = send_data_packet(cmd->ts, cmd->chunk_idx, (uint16_t)seq, total_seqs, len);
+        if (err) break;
+        resent++;
     }
 
-    fs_close(&fd);
-    LOG_INF("Uploaded chunk %u/%u ts=%u (%u seqs)", idx + 1, total, ts, seq);
-    return 0;
+    fs_close(&f);
+    LOG_INF("NACK ts=%u: resent %d packet(s)", cmd->ts, resent);
+
+    /* A chunk cut short by a read or send error is only complete once its
+     * NACKs are served; flag it so the phone's ACK_UPTO can delete it */
+    if (!err && resent > 0) {
+        reclo_index_mark_sent(cmd->ts);
+    }
+    return err;
 }
 
-/* ── Upload thread ───────────────────────────────────────────────────────────*/
+/* Serve the NACKs that arrived while a chunk was being sent. Stops at the
+ * first other command: a REQUEST_UPLOAD queued after an ABORT stays at the
+ * head of the queue for the upload thread to pick up once this batch ends. */
+static void drain_nacks(void)
+{
+    struct upload_cmd cmd;
+    while (k_msgq_peek(&_cmd_q, &cmd) == 0 && cmd.type == UPLOAD_CMD_NACK) {
+        k_msgq_get(&_cmd_q, &cmd, K_NO_WAIT);
+        resend_chunk_seqs(&cmd);
+    }
+}
 
-/* File-scope to keep off the upload thread stack (would consume entire 4KB) */
-static char _upload_paths[RECLO_MAX_CHUNKS][64];
+/* ── Upload thread ───────────────────────────────────────────────────────────*/
 
-static void upload_thread_fn(void *a, void *b, void *c)
+static void run_upload_batch(uint32_t abort_gen)
 {
-    ARG_UNUSED(a); ARG_UNUSED(b); ARG_UNUSED(c);
+    /* Let ACKs written just before this REQUEST_UPLOAD take effect, or the
+     * batch would include chunks the phone already has */
+    struct k_work_sync sync;
+    k_work_flush(&_delete_work, &sync);
+
+    _batch.conn_gen  = _conn_gen;
+    _batch.abort_gen = abort_gen;
+    _batch.l2cap     = false;
+    _batch.proto     = _proto_version;
+    _batch.payload   = RECLO_PAYLOAD_SIZE;
+
+    /* The bulk channel always carries v2 packets, one SDU each */
+    uint16_t sdu_max = reclo_l2cap_sdu_max();
+    if (_batch.proto >= RECLO_PROTO_V2 && sdu_max > sizeof(RecloHeaderV2)) {
+        _batch.l2cap   = true;
+        _batch.payload = sdu_max - RECLO_V2_DATA_HDR_SIZE;
+    } else if (_batch.proto >= RECLO_PROTO_V2) {
+        _batch.payload = v2_data_payload();
+        if (_batch.payload == 0) {
+            LOG_WRN("MTU %u too small for v2 framing; using v1", bt_gatt_get_mtu(_conn));
+            _batch.proto   = RECLO_PROTO_V1;
+            _batch.payload = RECLO_PAYLOAD_SIZE;
+        }
+    }
+
+    /* Snapshot the batch size; chunks finalized during the upload, and
+     * any past the phone's limit, are left for its next REQUEST_UPLOAD. */
+    int count = MIN(reclo_index_count(RECLO_CHUNK_READY), UINT16_MAX);
+    if (_batch_limit != 0) {
+        count = MIN(count, _batch_limit);
+    }
+    _batch.total = (uint16_t)count;
+
+    if (batch_aborted()) {
+        LOG_INF("Upload aborted before it started");
+        return;
+    }
+
+    if (count == 0) {
+        LOG_INF("No chunks to upload");
+        send_upload_done();
+        return;
+    }
+
+    LOG_INF("Starting upload: %d chunk(s) over %s, framing v%u (%u B/packet)",
+            count, _batch.l2cap ? "L2CAP" : "GATT", _batch.proto, _batch.payload);
+
+    /* Hand the walk to the reader and drain what it prefetches. After an
+     * error or abort keep draining, without sending, until the reader is
+     * idle again so every block is back in the pool. Nothing of the batch is
+     * sent after that point, so no chunk resumes with blocks missing. */
+    _sender_time = (struct stage_time){ 0 };
+    k_sem_give(&_pf_start);
+
+    int64_t mark    = k_uptime_ticks();
+    int64_t t_start = mark;
+    bool    failed  = false;
+    struct prefetch_item item;
 
     while (true) {
-        k_sem_take(&_upload_sem, K_FOREVER);
+        stage_account(&_sender_time.busy, &mark);
+        k_msgq_get(&_pf_q, &item, K_FOREVER);
+        stage_account(&_sender_time.idle, &mark);
 
-        if (!_conn || !_notify_enabled) {
-            _upload_active = false;
-            continue;
+        if (item.type == PF_BATCH_END) {
+            break;
         }
 
-        /* Enumerate chunk files */
-        struct fs_dir_t  dir;
-        struct fs_dirent ent;
-        fs_dir_t_init(&dir);
-
-        int count = 0;
-        if (fs_opendir(&dir, RECLO_STORAGE_DIR) == 0) {
-            while (count < RECLO_MAX_CHUNKS &&
-                   fs_readdir(&dir, &ent) == 0 &&
-                   ent.name[0] != '\0') {
-                size_t nlen = strlen(ent.name);
-                bool is_bin = (ent.type == FS_DIR_ENTRY_FILE &&
-                               nlen > 4 &&
-                               strcmp(ent.name + nlen - 4, ".bin") == 0);
-                if (is_bin) {
-                    snprintf(_upload_paths[count], sizeof(_upload_paths[count]),
-                             "%s/%s", RECLO_STORAGE_DIR, ent.name);
-                    count++;
-                }
+        int err = 0;
+        bool sending = !failed && !batch_aborted();
+
+        switch (item.type) {
+        case PF_CHUNK_BEGIN:
+            if (sending) err = send_chunk_header(&item);
+            if (item.len > 0) pf_put_free_block(item.block);
+            break;
+
+        case PF_DATA:
+            if (sending) err = send_block(_pf_blocks[item.block], item.len);
+            pf_put_free_block(item.block);
+            break;
+
+        case PF_CHUNK_END:
+            if (!sending) break;
+            if (_cur.fill > 0) {
+                /* Short read: send what arrived; the phone NACKs the rest */
+                err = flush_data_packet();
+            }
+            if (item.err) {
+                LOG_WRN("Chunk %u read error %d", item.idx, item.err);
+            } else if (!err) {
+                reclo_index_mark_sent(item.ts);
+                int64_t elapsed_ms = MAX(k_uptime_get() - _cur.start_ms, 1);
+                LOG_INF("Uploaded chunk %u/%u ts=%u (%u seqs, %u B/s)",
+                        item.idx + 1, _batch.total, item.ts, _cur.seq,
+                        (uint32_t)((int64_t)_cur.data_size * 1000 / elapsed_ms));
             }
-            fs_closedir(&dir);
+            drain_nacks();
+            break;
+
+        case PF_CHUNK_ERROR:
+            LOG_WRN("Chunk %u upload error %d — continuing", item.idx, item.err);
+            break;
         }
 
-        if (count == 0) {
-            LOG_INF("No chunks to upload");
-            RecloPacket done;
-            memset(&done, 0, sizeof(done));
-            done.pkt_type = RECLO_PKT_UPLOAD_DONE;
-            send_packet(&done);
+        if (err == -ENOTCONN || err == -ETIMEDOUT) {
+            /* Stops the reader too; DONE would not get through either */
+            failed = true;
+            atomic_inc(&_abort_gen);
             _upload_active = false;
-            continue;
+        } else if (err) {
+            LOG_WRN("Chunk %u send error %d — continuing", item.idx, err);
         }
+    }
+    stage_account(&_sender_time.busy, &mark);
+
+    LOG_INF("Pipeline %u ms: reader busy %u / idle %u ms, sender busy %u / idle %u ms",
+            (uint32_t)k_ticks_to_ms_floor64(mark - t_start),
+            (uint32_t)k_ticks_to_ms_floor64(_reader_time.busy),
+            (uint32_t)k_ticks_to_ms_floor64(_reader_time.idle),
+            (uint32_t)k_ticks_to_ms_floor64(_sender_time.busy),
+            (uint32_t)k_ticks_to_ms_floor64(_sender_time.idle));
+
+    if (!failed && !batch_aborted()) {
+        send_upload_done();
+        LOG_INF("Upload complete");
+    }
+}
 
-        /* Sort filenames ascending (zero-padded timestamps = lexicographic = numeric order) */
-        for (int i = 1; i < count; i++) {
-            char tmp[64];
-            int  j = i;
-            while (j > 0 && strcmp(_upload_paths[j - 1], _upload_paths[j]) > 0) {
-                memcpy(tmp,          _upload_paths[j - 1], sizeof(tmp));
-                memcpy(_upload_paths[j - 1], _upload_paths[j],     sizeof(tmp));
-                memcpy(_upload_paths[j],     tmp,           sizeof(tmp));
-                j--;
-            }
-        }
+static void upload_thread_fn(void *a, void *b, void *c)
+{
+    ARG_UNUSED(a); ARG_UNUSED(b); ARG_UNUSED(c);
 
-        LOG_INF("Starting upload: %d chunk(s)", count);
+    struct upload_cmd cmd;
 
-        for (int i = 0; i < count && _upload_active; i++) {
-            int err = upload_one_chunk(_upload_paths[i], (uint16_t)i, (uint16_t)count);
-            if (err == -ECANCELED) break;
-            if (err) LOG_WRN("Chunk %d upload error %d — continuing", i, err);
+    while (true) {
+        k_msgq_get(&_cmd_q, &cmd, K_FOREVER);
 
-            k_msleep(20);
+        if (!_conn || (!_notify_enabled && !reclo_l2cap_connected())) {
+            _upload_active = false;
+            continue;
         }
 
-        if (_upload_active) {
-            RecloPacket done;
-            memset(&done, 0, sizeof(done));
-            done.pkt_type = RECLO_PKT_UPLOAD_DONE;
-            send_packet(&done);
-            LOG_INF("Upload complete");
+        if (cmd.type == UPLOAD_CMD_NACK) {
+            /* The phone NACKs the last chunks after UPLOAD_DONE. Only
+             * serve it on the connection the batch's framing was sized for. */
+            if (_batch.payload != 0 && _batch.conn_gen == _conn_gen) {
+                resend_chunk_seqs(&cmd);
+            }
+            continue;
         }
 
-        _upload_active = false;
+        run_upload_batch(cmd.abort_gen);
+
+        /* After an ABORT the phone may already have queued the next batch */
+        if (!batch_aborted()) {
+            _upload_active = false;
+        }
     }
 }
 
@@ -446,11 +1143,14 @@ static void _on_connected(struct bt_conn *conn, uint8_t err)
     if (err) return;
     if (_conn) bt_conn_unref(_conn);
     _conn = bt_conn_ref(conn);
+    _conn_gen++;
+    tx_credits_reset();
     LOG_INF("Transfer: device connected");
 }
 
 static void _on_disconnected(struct bt_conn *conn, uint8_t reason)
 {
+    atomic_inc(&_abort_gen);
     _upload_active  = false;
     _notify_enabled = false;
     if (_conn) {
@@ -469,6 +1169,19 @@ BT_CONN_CB_DEFINE(reclo_conn_callbacks) = {
 
 int reclo_transfer_init(void)
 {
+    int err = reclo_index_init();
+    if (err) {
+        LOG_WRN("Chunk index init: %d", err);
+    }
+
+    tx_credits_reset();
+    k_work_init(&_delete_work, delete_work_fn);
+
+    err = reclo_l2cap_init();
+    if (err) {
+        LOG_WRN("Bulk channel unavailable (%d); GATT upload only", err);
+    }
+
     _conn           = NULL;
     _notify_enabled = false;
     _upload_active  = false;
@@ -480,6 +1193,13 @@ int reclo_transfer_init(void)
     );
     k_thread_name_set(&_upload_thread, "reclo_upload");
 
+    k_thread_create(
+        &_reader_thread, _reader_stack, READER_STACK_SIZE,
+        reader_thread_fn, NULL, NULL, NULL,
+        READER_THREAD_PRIO, 0, K_NO_WAIT
+    );
+    k_thread_name_set(&_reader_thread, "reclo_prefetch");
+
     LOG_INF("RecLo transfer service initialized");
     return 0;
 }
@@ -5,21 +5,33 @@
 #include <stdint.h>
 #include <stddef.h>
 
+#include "reclo_chunk_hdr.h"
+
 /*
  * reclo_transfer — BLE chunk upload protocol
  *
- * Provides a GATT service with two characteristics:
- *   • Data (NOTIFY):   device → phone, fixed 244-byte packets
+ * Provides a GATT service with three characteristics:
+ *   • Data (NOTIFY):   device → phone, 244-byte (v1) or MTU-sized (v2) packets
  *   • Control (WRITE): phone → device, command bytes
+ *   • PSM (READ):      uint16 LE L2CAP PSM of the bulk channel, 0 if absent
+ *
+ * v2 packets can instead be streamed as SDUs over an L2CAP CoC when the
+ * phone has opened one before REQUEST_UPLOAD (see reclo_l2cap.h).
  *
  * Protocol overview:
- *   1. Phone connects, writes REQUEST_UPLOAD to control char.
- *   2. Device enumerates stored chunks (sorted by timestamp).
+ *   1. Phone connects, writes REQUEST_UPLOAD to control char, optionally
+ *      followed by the highest framing version it understands and the most
+ *      chunks it can take in one batch.
+ *   2. Device walks its chunk index (reclo_index, sorted by timestamp),
+ *      oldest first, up to that many chunks.
  *   3. For each chunk, device sends:
  *        - One CHUNK_HEADER packet (metadata + no Opus payload)
  *        - N CHUNK_DATA packets   (229 bytes of Opus data each, last may be shorter)
- *   4. Phone sends ACK_CHUNK (control write) after saving each chunk.
- *      Device deletes the chunk on receipt of its ACK.
+ *      Packets are paced by BLE stack completions: at most
+ *      CONFIG_OMI_RECLO_UPLOAD_TX_WINDOW notifications are in flight.
+ *   4. Phone sends NACK_CHUNK for any DATA packets it missed, then
+ *      acknowledges saved chunks with ACK_CHUNK or, batched, ACK_UPTO.
+ *      Device deletes acknowledged chunks in the background.
  *   5. After the last chunk, device sends one UPLOAD_DONE packet.
  *
  * Packet layout (244 bytes, all multi-byte fields little-endian):
@@ -32,24 +44,73 @@
  *   [13..14] payload_len   — bytes used in payload[] (uint16, 0–229)
  *   [15..243] payload      — 229 bytes of data
  *
- * CHUNK_HEADER payload (13 bytes):
+ * CHUNK_HEADER payload (17 bytes):
  *   [0..3]   data_size    — total Opus data bytes for this chunk (uint32)
  *   [4]      codec_id     — 21 = Opus (matches Omi consumer CODEC_ID)
  *   [5..8]   sample_rate  — 16000 (uint32)
- *   [9..12]  crc32        — CRC-32/ISO-HDLC of the Opus data bytes (uint32)
+ *   [9..12]  crc32        — CRC-32/ISO-HDLC of the Opus data bytes (uint32),
+ *                            taken from the chunk file header (v2+)
+ *   [13..16] RecloEncoderInfo — Opus settings the chunk was encoded with:
+ *            [13]     complexity
+ *            [14]     flags        — bit 0: changed within the chunk,
+ *                                    bit 1: low-power profile,
+ *                                    bit 2: silence stored as runs
+ *            [15..16] bitrate_kbps — 0 if the chunk predates the field
  *
  * CHUNK_DATA payload:
  *   Raw Opus bytes (length-prefixed frames as stored on SD card).
  *
- * Control commands (phone → device, 1–5 bytes):
- *   0x01                   — REQUEST_UPLOAD
+ * v2 framing (REQUEST_UPLOAD [2]): packets fill the negotiated ATT MTU and
+ * data packets carry only what changes per packet. Phones that send a bare
+ * REQUEST_UPLOAD get v1.
+ *   CHUNK_HEADER_V2 (32 bytes):
+ *     [0]      pkt_type      — RECLO_PKT_CHUNK_HEADER_V2
+ *     [1..4]   chunk_ts      (uint32)
+ *     [5..6]   chunk_idx     (uint16)
+ *     [7..8]   total_chunks  (uint16)
+ *     [9..10]  total_seqs    — header + data packets (uint16)
+ *     [11..12] data_payload  — Opus bytes per DATA packet, last may be shorter
+ *     [13..25] RecloChunkMeta (as above)
+ *     [26..29] RecloEncoderInfo (as above)
+ *     [30..31] level_count   — 100 ms windows in the level track (uint16)
+ *   CHUNK_LEVELS_V2 (4-byte header + level bytes), sent right after the
+ *   header when level_count > 0, split to fit data_payload:
+ *     [0]      pkt_type      — RECLO_PKT_CHUNK_LEVELS_V2
+ *     [1]      chunk_tag     — chunk_idx & 0xFF
+ *     [2..3]   first         — window index of the first byte (uint16)
+ *     [4..]    levels, one byte per 100 ms: RMS = -L/2 dBFS, 255 = silent
+ *     Not covered by seqs or NACKs; a phone missing some decodes instead.
+ *   CHUNK_DATA_V2 (4-byte header + up to data_payload bytes):
+ *     [0]      pkt_type      — RECLO_PKT_CHUNK_DATA_V2
+ *     [1]      chunk_tag     — chunk_idx & 0xFF, rejects stray packets
+ *     [2..3]   seq           — 1-based (the header is seq 0) (uint16)
+ *     [4..]    Opus bytes; length is implied by the notification length
+ *   UPLOAD_DONE: the single byte RECLO_PKT_UPLOAD_DONE.
+ *
+ * Control commands (phone → device, 1–69 bytes):
+ *   0x01 [version:1][max_chunks:2], both optional
+ *                          — REQUEST_UPLOAD: max_chunks 0 or absent means the
+ *                            whole backlog. The phone asks again after
+ *                            UPLOAD_DONE for the rest.
  *   0x02 [ts:4 bytes LE]   — ACK_CHUNK   (5 bytes total)
  *   0x03                   — ABORT
+ *   0x04 [ts:4][chunk_idx:2][first_seq:2][bitmap:1–32]
+ *                          — NACK_CHUNK: resend DATA packet first_seq + i for
+ *                            every set bit i (LSB first). Resent packets use
+ *                            the chunk's original framing, chunk_idx and seq.
+ *                            Accepted during an upload and after UPLOAD_DONE.
+ *   0x05 [upto:4][first:4 last:4]×0–8
+ *                          — ACK_UPTO: every chunk with ts <= upto, plus every
+ *                            chunk with first <= ts <= last in each range, has
+ *                            been saved. Only chunks the device has actually
+ *                            uploaded are deleted. upto = 0 acknowledges no
+ *                            prefix (READY chunks carry UTC timestamps).
  *
  * BLE Service UUIDs:
  *   Service:  5c7d0001-b5a3-4f43-c0a9-e50e24dc0000
  *   Data:     5c7d0001-b5a3-4f43-c0a9-e50e24dc0001
  *   Control:  5c7d0001-b5a3-4f43-c0a9-e50e24dc0002
+ *   PSM:      5c7d0001-b5a3-4f43-c0a9-e50e24dc0003
  */
 
 /* ── Packet constants ───────────────────────────────────────────────────────*/
@@ -62,14 +123,31 @@
 #define RECLO_PKT_CHUNK_HEADER  0x01
 #define RECLO_PKT_CHUNK_DATA    0x02
 #define RECLO_PKT_UPLOAD_DONE   0x03
+#define RECLO_PKT_CHUNK_HEADER_V2  0x11
+#define RECLO_PKT_CHUNK_DATA_V2    0x12
+#define RECLO_PKT_CHUNK_LEVELS_V2  0x13
+
+/* Framing versions (REQUEST_UPLOAD argument) */
+#define RECLO_PROTO_V1  1
+#define RECLO_PROTO_V2  2
+
+/* v2: largest notification sent (CONFIG_BT_L2CAP_TX_MTU 498 - 3-byte ATT
+ * header); the actual size follows the connection's negotiated MTU. */
+#define RECLO_V2_MAX_PACKET     495
+#define RECLO_V2_DATA_HDR_SIZE    4
 
 /* Control commands (phone → device) */
 #define RECLO_CMD_REQUEST_UPLOAD  0x01
 #define RECLO_CMD_ACK_CHUNK       0x02   /* followed by 4-byte timestamp LE */
 #define RECLO_CMD_ABORT           0x03
+#define RECLO_CMD_NACK_CHUNK      0x04   /* ts[4] + chunk_idx[2] + first_seq[2] + bitmap */
+#define RECLO_CMD_ACK_UPTO        0x05   /* upto[4] + (first[4] + last[4]) × 0–8 */
+
+/* Largest NACK_CHUNK bitmap: 256 seqs per command */
+#define RECLO_NACK_MAX_BITMAP  32
 
-/* Maximum chunks the upload queue can hold */
-#define RECLO_MAX_CHUNKS  64
+/* Most ranges in one ACK_UPTO */
+#define RECLO_ACK_MAX_RANGES   8
 
 /* Storage directory on SD card filesystem */
 #define RECLO_STORAGE_DIR  "/SD:/reclo"
@@ -84,6 +162,13 @@ typedef struct __attribute__((packed)) {
     uint32_t crc32;        /* CRC-32 of the Opus data                */
 } RecloChunkMeta;
 
+/** Encoder settings a chunk was recorded with (4 bytes). */
+typedef struct __attribute__((packed)) {
+    uint8_t  complexity;   /* Opus complexity at chunk start         */
+    uint8_t  flags;        /* RECLO_ENC_F_* (reclo_chunk_hdr.h)      */
+    uint16_t bitrate_kbps; /* 0 = unknown                            */
+} RecloEncoderInfo;
+
 /** Full 244-byte BLE data packet. */
 typedef struct __attribute__((packed)) {
     uint8_t  pkt_type;        /* RECLO_PKT_*                              */
@@ -99,12 +184,39 @@ typedef struct __attribute__((packed)) {
 _Static_assert(sizeof(RecloPacket) == RECLO_PACKET_SIZE,
                "RecloPacket must be exactly 244 bytes");
 
+/** v2 CHUNK_HEADER packet (32 bytes). */
+typedef struct __attribute__((packed)) {
+    uint8_t  pkt_type;        /* RECLO_PKT_CHUNK_HEADER_V2                */
+    uint32_t chunk_ts;
+    uint16_t chunk_idx;
+    uint16_t total_chunks;
+    uint16_t total_seqs;      /* header + data packets                    */
+    uint16_t data_payload;    /* Opus bytes per DATA packet               */
+    RecloChunkMeta meta;
+    RecloEncoderInfo enc;
+    uint16_t level_count;     /* level bytes sent in CHUNK_LEVELS_V2      */
+} RecloHeaderV2;
+
+/** v2 CHUNK_DATA packet header; Opus bytes follow. CHUNK_LEVELS_V2 uses
+ *  the same layout with seq holding the first window index. */
+typedef struct __attribute__((packed)) {
+    uint8_t  pkt_type;        /* RECLO_PKT_CHUNK_DATA_V2                  */
+    uint8_t  chunk_tag;       /* chunk_idx & 0xFF                         */
+    uint16_t seq;             /* 1-based sequence within this chunk       */
+} RecloDataHdrV2;
+
+_Static_assert(sizeof(RecloEncoderInfo) == 4, "RecloEncoderInfo must be 4 bytes");
+_Static_assert(sizeof(RecloHeaderV2) == 32, "RecloHeaderV2 must be 32 bytes");
+_Static_assert(sizeof(RecloDataHdrV2) == RECLO_V2_DATA_HDR_SIZE,
+               "RecloDataHdrV2 must be 4 bytes");
+
 /* ── Public API ─────────────────────────────────────────────────────────────*/
 
 /**
  * Initialize the transfer service.
- * Spawns the upload thread. BT connection callbacks are registered
- * automatically via BT_CONN_CB_DEFINE — no manual wiring needed.
+ * Loads the chunk index (reclo_index_init) and spawns the upload thread.
+ * BT connection callbacks are registered automatically via
+ * BT_CONN_CB_DEFINE — no manual wiring needed.
  * Must be called once during boot, after transport_start().
  */
 int reclo_transfer_init(void);
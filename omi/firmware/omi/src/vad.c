@@ -0,0 +1,78 @@
+#include "vad.h"
+
+/* Frames quieter than this (RMS 32 LSB, about -60 dBFS) are never speech */
+#define VAD_ABS_MIN_ENERGY  1024U
+
+/* Lowest noise floor, so a digitally silent input cannot trigger on dither */
+#define VAD_MIN_NOISE       16U
+
+/* Zero crossings per sample above which a quiet frame is treated as an
+ * unvoiced consonant: 1/4 ≈ 2 kHz at 16 kHz. */
+#define VAD_ZCR_SHIFT       2
+
+void vad_init(struct vad *v, unsigned threshold_db, uint16_t hangover_frames)
+{
+    /* 10^(dB/10) in Q8, one dB (×1.2589) at a time */
+    uint32_t ratio = 256;
+    for (unsigned i = 0; i < threshold_db; i++) {
+        ratio = ratio * 1259U / 1000U;
+    }
+
+    v->noise     = VAD_MIN_NOISE;
+    v->ratio_q8  = ratio;
+    v->hangover  = hangover_frames;
+    v->hang_left = 0;
+    v->primed    = false;
+}
+
+bool vad_frame(struct vad *v, const int16_t *pcm, size_t n)
+{
+    if (n == 0) {
+        return v->hang_left > 0;
+    }
+
+    uint64_t sum = 0;
+    size_t   zc  = 0;
+    for (size_t i = 0; i < n; i++) {
+        int32_t s = pcm[i];
+        sum += (uint64_t)(s * s);
+        if (i > 0 && ((pcm[i - 1] ^ s) < 0)) {
+            zc++;
+        }
+    }
+    uint32_t energy = (uint32_t)(sum / n);
+
+    if (!v->primed) {
+        v->noise  = energy > VAD_MIN_NOISE ? energy : VAD_MIN_NOISE;
+        v->primed = true;
+    }
+
+    uint64_t scaled = (uint64_t)energy << 8;
+    uint64_t thresh = (uint64_t)v->noise * v->ratio_q8;
+    bool loud      = scaled > thresh;
+    bool fricative = scaled > thresh / 2 && zc > (n >> VAD_ZCR_SHIFT);
+    bool speech    = energy >= VAD_ABS_MIN_ENERGY && (loud || fricative);
+
+    /* Track the floor: down fast; up by at most ~3.4 dB/s, or ~0.4 dB/s
+     * during speech, so a sustained louder background still becomes the
+     * floor but a sentence does not. */
+    if (energy < v->noise) {
+        v->noise -= (v->noise - energy) / 4;
+    } else {
+        uint32_t step = v->noise / (speech ? 512U : 64U) + 1;
+        v->noise = (energy - v->noise > step) ? v->noise + step : energy;
+    }
+    if (v->noise < VAD_MIN_NOISE) {
+        v->noise = VAD_MIN_NOISE;
+    }
+
+    if (speech) {
+        v->hang_left = v->hangover;
+        return true;
+    }
+    if (v->hang_left > 0) {
+        v->hang_left--;
+        return true;
+    }
+    return false;
+}
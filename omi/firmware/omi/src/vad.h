@@ -0,0 +1,40 @@
+#ifndef VAD_H
+#define VAD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * vad — frame-level voice activity detector for the mic path.
+ *
+ * Compares each frame's mean-square energy against an adaptive noise floor,
+ * which falls quickly and rises slowly so steady background noise is learned
+ * within seconds. A frame is speech when it is threshold_db above the floor.
+ * Quieter frames with a high zero-crossing rate (fricatives such as "s" and
+ * "f") count as speech at half the threshold. After the last speech frame the
+ * detector keeps reporting speech for hangover_frames, so word endings and
+ * short pauses are kept.
+ *
+ * Pure C with no Zephyr dependencies.
+ */
+
+struct vad {
+    uint32_t noise;          /* noise floor, mean square */
+    uint32_t ratio_q8;       /* speech threshold as an energy ratio, Q8 */
+    uint16_t hangover;       /* frames kept after the last speech frame */
+    uint16_t hang_left;
+    bool     primed;         /* noise floor seeded from the first frame */
+};
+
+/** Reset @p v. @p threshold_db is 3–30 dB. */
+void vad_init(struct vad *v, unsigned threshold_db, uint16_t hangover_frames);
+
+/**
+ * Classify one frame of @p n mono samples.
+ *
+ * @return true for speech or hangover after speech, false for silence.
+ */
+bool vad_frame(struct vad *v, const int16_t *pcm, size_t n);
+
+#endif /* VAD_H */